@@ -0,0 +1,323 @@
+// Replays a GL trace written by a GLAD_TRACE build (gladTraceBegin / gladTraceEnd) as fast
+// as it can, headless, and reports what each frame cost the CPU.
+//
+// Record a session by building LearnProject with GLAD_TRACE defined; it writes
+// session.gltrace next to the executable. The replay runs on a pbuffer of the recorded
+// window size on a surfaceless EGL display, so it needs no window and no GPU: under Mesa's
+// llvmpipe the rasterizer is CPU threads too, which makes the numbers comparable between
+// two builds or two traces on the same machine. Each loop is a fresh process, so the
+// driver starts cold every time and hands out the object names the trace expects. On Linux:
+//
+//     gcc -O2 -DGLAD_TRACE -I../glad/include -c ../glad/src/glad.c -o glad.o
+//     g++ -O2 -DGLAD_TRACE -I../glad/include GladReplay.cpp glad.o -lEGL -o gladreplay
+//     LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe ./gladreplay session.gltrace
+//
+// Per frame it measures the time to issue the calls, the time until glFinish returns (the
+// frame is rendered) and the CPU time of the whole process over the frame, which includes
+// the driver's threads. The first frame is reported apart, since it usually compiles the
+// shaders and uploads the textures.
+//
+// Options:
+//     --loops N       replays of the whole trace, one process each (default 5); frame times
+//                     are the medians over the loops
+//     --no-finish     don't wait for each frame to render
+//     --csv FILE      write the per-frame medians to FILE
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#ifndef GLAD_TRACE
+#error build glad.c and this file with -DGLAD_TRACE
+#endif
+
+// ------------------------------------------------------------------------------------------------
+// one replay
+
+struct FrameTimes
+{
+	double issueMs;  // making the calls
+	double frameMs;  // until the frame has rendered
+	double cpuMs;    // process CPU time, all threads
+};
+
+struct Totals
+{
+	unsigned long long calls;
+	unsigned long long skipped;
+	unsigned long long mismatches;
+	unsigned long long frames;
+};
+
+static double nowMs(clockid_t clock)
+{
+	timespec now;
+	clock_gettime(clock, &now);
+	return now.tv_sec * 1e3 + now.tv_nsec * 1e-6;
+}
+
+static bool createContext(int width, int height)
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (!getPlatformDisplay)
+		return false;
+	EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+		return false;
+	if (!eglBindAPI(EGL_OPENGL_API))
+		return false;
+
+	// what GLFW gives the window by default
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, 24, EGL_STENCIL_SIZE, 8, EGL_NONE };
+	EGLConfig config;
+	EGLint count = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &count) || count == 0)
+		return false;
+	const EGLint surfaceAttributes[] = { EGL_WIDTH, std::max(1, width), EGL_HEIGHT, std::max(1, height), EGL_NONE };
+	EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+	if (surface == EGL_NO_SURFACE)
+		return false;
+	// the context main.cpp asks GLFW for
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	return context != EGL_NO_CONTEXT && eglMakeCurrent(display, surface, surface, context);
+}
+
+static bool replay(const char* path, bool finish, std::vector<FrameTimes>& frames, Totals& totals)
+{
+	gladTraceReplay* trace = gladTraceReplayOpen(path);
+	if (!trace)
+	{
+		std::cout << "ERROR::REPLAY can't read the trace " << path << std::endl;
+		return false;
+	}
+	const gladTraceInfo* info = gladTraceReplayInfo(trace);
+	if (!createContext(info->width, info->height))
+	{
+		std::cout << "ERROR::EGL can't create an OpenGL 3.3 core context on a pbuffer" << std::endl;
+		gladTraceReplayClose(trace);
+		return false;
+	}
+	if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+	{
+		std::cout << "ERROR::GLAD can't load GL" << std::endl;
+		gladTraceReplayClose(trace);
+		return false;
+	}
+
+	int result;
+	for (;;)
+	{
+		FrameTimes times;
+		double start = nowMs(CLOCK_MONOTONIC), cpuStart = nowMs(CLOCK_PROCESS_CPUTIME_ID);
+		result = gladTraceReplayFrame(trace);
+		if (result <= 0)
+			break;
+		times.issueMs = nowMs(CLOCK_MONOTONIC) - start;
+		if (finish)
+			glFinish();
+		times.frameMs = nowMs(CLOCK_MONOTONIC) - start;
+		times.cpuMs = nowMs(CLOCK_PROCESS_CPUTIME_ID) - cpuStart;
+		frames.push_back(times);
+	}
+	totals.calls = info->calls;
+	totals.skipped = info->skipped;
+	totals.mismatches = info->mismatches;
+	totals.frames = info->frames;
+	gladTraceReplayClose(trace);
+	if (result < 0)
+	{
+		std::cout << "ERROR::REPLAY the trace is damaged after " << frames.size() << " frames" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static bool readAll(int fd, void* data, size_t size)
+{
+	char* bytes = (char*)data;
+	while (size > 0)
+	{
+		ssize_t got = read(fd, bytes, size);
+		if (got <= 0)
+			return false;
+		bytes += got;
+		size -= (size_t)got;
+	}
+	return true;
+}
+
+// replays in a child process and reads the frame times back through a pipe
+static bool replayInChild(const char* path, bool finish, std::vector<FrameTimes>& frames, Totals& totals)
+{
+	int fds[2];
+	if (pipe(fds) != 0)
+		return false;
+	pid_t pid = fork();
+	if (pid < 0)
+		return false;
+	if (pid == 0)
+	{
+		close(fds[0]);
+		std::vector<FrameTimes> child;
+		Totals childTotals;
+		bool ok = replay(path, finish, child, childTotals);
+		size_t count = child.size();
+		ok = ok && write(fds[1], &childTotals, sizeof(childTotals)) == (ssize_t)sizeof(childTotals)
+			&& write(fds[1], &count, sizeof(count)) == (ssize_t)sizeof(count)
+			&& (count == 0 || write(fds[1], &child[0], count * sizeof(FrameTimes)) == (ssize_t)(count * sizeof(FrameTimes)));
+		_exit(ok ? 0 : 1);
+	}
+	close(fds[1]);
+	size_t count = 0;
+	bool ok = readAll(fds[0], &totals, sizeof(totals)) && readAll(fds[0], &count, sizeof(count));
+	if (ok)
+	{
+		frames.resize(count);
+		ok = count == 0 || readAll(fds[0], &frames[0], count * sizeof(FrameTimes));
+	}
+	close(fds[0]);
+	int status = 0;
+	waitpid(pid, &status, 0);
+	return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+// report
+
+static double median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	return values[values.size() / 2];
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+static double mean(const std::vector<double>& values)
+{
+	double sum = 0.0;
+	for (size_t i = 0; i < values.size(); ++i)
+		sum += values[i];
+	return sum / values.size();
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = NULL;
+	const char* csvPath = NULL;
+	int loops = 5;
+	bool finish = true;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--loops") == 0 && i + 1 < argc)
+			loops = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--no-finish") == 0)
+			finish = false;
+		else if (std::strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+			csvPath = argv[++i];
+		else if (argv[i][0] != '-' && !path)
+			path = argv[i];
+		else
+		{
+			path = NULL;
+			break;
+		}
+	}
+	if (!path)
+	{
+		std::cout << "usage: " << argv[0] << " TRACE [--loops N] [--no-finish] [--csv FILE]" << std::endl;
+		return 2;
+	}
+
+	std::vector<std::vector<FrameTimes> > runs(loops);
+	Totals totals;
+	for (int loop = 0; loop < loops; ++loop)
+	{
+		if (!replayInChild(path, finish, runs[loop], totals))
+			return 1;
+		if (runs[loop].size() != runs[0].size())
+		{
+			std::cout << "ERROR::REPLAY loop " << loop << " replayed " << runs[loop].size() << " frames, not " << runs[0].size() << std::endl;
+			return 1;
+		}
+	}
+	size_t frameCount = runs[0].size();
+	if (frameCount == 0)
+	{
+		std::cout << "ERROR::REPLAY the trace has no frames" << std::endl;
+		return 1;
+	}
+
+	// per frame, the median over the loops
+	std::vector<FrameTimes> frames(frameCount);
+	for (size_t f = 0; f < frameCount; ++f)
+	{
+		std::vector<double> issue, frame, cpu;
+		for (int loop = 0; loop < loops; ++loop)
+		{
+			issue.push_back(runs[loop][f].issueMs);
+			frame.push_back(runs[loop][f].frameMs);
+			cpu.push_back(runs[loop][f].cpuMs);
+		}
+		frames[f].issueMs = median(issue);
+		frames[f].frameMs = median(frame);
+		frames[f].cpuMs = median(cpu);
+	}
+
+	std::printf("%s: %llu frames, %llu calls, %llu replays\n", path, totals.frames, totals.calls, (unsigned long long)loops);
+	if (totals.skipped > 0)
+		std::printf("  %llu calls skipped: not captured, or missing in this context\n", totals.skipped);
+	if (totals.mismatches > 0)
+		std::printf("  %llu object names came back different from the trace's; later frames may differ\n", totals.mismatches);
+
+	std::printf("%-14s %10s %10s %10s %10s\n", "ms", "median", "mean", "p95", "max");
+	std::printf("%-14s %10.3f %10s %10s %10s   (issue %.3f, cpu %.3f)\n", "first frame", frames[0].frameMs, "", "", "", frames[0].issueMs, frames[0].cpuMs);
+	if (frameCount > 1)
+	{
+		const char* names[] = { "issue", finish ? "frame" : "frame (no finish)", "cpu" };
+		for (int column = 0; column < 3; ++column)
+		{
+			std::vector<double> values;
+			for (size_t f = 1; f < frameCount; ++f)
+				values.push_back(column == 0 ? frames[f].issueMs : column == 1 ? frames[f].frameMs : frames[f].cpuMs);
+			std::printf("%-14s %10.3f %10.3f %10.3f %10.3f\n", names[column], median(values), mean(values),
+				percentile(values, 0.95), *std::max_element(values.begin(), values.end()));
+		}
+	}
+
+	if (csvPath)
+	{
+		FILE* csv = std::fopen(csvPath, "w");
+		if (!csv)
+		{
+			std::cout << "ERROR::REPLAY can't write " << csvPath << std::endl;
+			return 1;
+		}
+		std::fprintf(csv, "frame,issue_ms,frame_ms,cpu_ms\n");
+		for (size_t f = 0; f < frameCount; ++f)
+			std::fprintf(csv, "%zu,%.4f,%.4f,%.4f\n", f, frames[f].issueMs, frames[f].frameMs, frames[f].cpuMs);
+		std::fclose(csv);
+	}
+	return 0;
+}
@@ -0,0 +1,290 @@
+// GLAD startup benchmark: eager vs lazy entry point resolution.
+//
+// Each run is a fresh process (the driver's symbol lookups are cached after the
+// first time, so repeating a load in one process would flatter both modes). A run
+// creates a surfaceless EGL context, loads GL with gladLoadGLLoader or
+// gladLoadGLLoaderLazy through eglGetProcAddress, then renders the first frame the
+// way LearnProject does: compile and link a shader, upload a texture, build a
+// VAO, draw into a framebuffer and read a pixel back. The times are the medians
+// over all runs of each stage. Needs EGL with EGL_MESA_platform_surfaceless, so
+// it runs headless under Mesa; on Linux:
+//
+//     gcc -O2 -DGLAD_LAZY -I../glad/include -c ../glad/src/glad.c -o glad.o
+//     g++ -O2 -DGLAD_LAZY -I../glad/include GladStartupBench.cpp glad.o -lEGL -o gladbench
+//     LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe ./gladbench
+//
+// Options:
+//     --runs N    processes per mode (default 15)
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#ifndef GLAD_LAZY
+#error build glad.c and this file with -DGLAD_LAZY
+#endif
+
+// ------------------------------------------------------------------------------------------------
+// one run
+
+struct Timings
+{
+	double contextMs; // EGL display and context
+	double loadMs;    // gladLoadGLLoader / gladLoadGLLoaderLazy
+	double frameMs;   // first frame, through glReadPixels
+	double totalMs() const { return contextMs + loadMs + frameMs; }
+};
+
+static double msSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool createContext()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (!getPlatformDisplay)
+		return false;
+	EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+		return false;
+	if (!eglBindAPI(EGL_OPENGL_API))
+		return false;
+
+	const EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config;
+	EGLint count = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &count) || count == 0)
+		return false;
+	// the context main.cpp asks GLFW for
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	return context != EGL_NO_CONTEXT && eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+}
+
+static unsigned int compileShader(GLenum type, const char* source)
+{
+	unsigned int shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	int success;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		char infoLog[512];
+		glGetShaderInfoLog(shader, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+	}
+	return shader;
+}
+
+// returns the red channel of the centre pixel, so the frame can't be optimized away or skipped
+static int firstFrame()
+{
+	const char* vertexSource =
+		"#version 330 core\n"
+		"layout (location = 0) in vec3 aPos;\n"
+		"layout (location = 1) in vec2 aTexCoord;\n"
+		"uniform mat4 transform;\n"
+		"out vec2 TexCoord;\n"
+		"void main() { gl_Position = transform * vec4(aPos, 1.0); TexCoord = aTexCoord; }\n";
+	const char* fragmentSource =
+		"#version 330 core\n"
+		"in vec2 TexCoord;\n"
+		"out vec4 FragColor;\n"
+		"uniform sampler2D texture1;\n"
+		"void main() { FragColor = texture(texture1, TexCoord); }\n";
+
+	unsigned int vertex = compileShader(GL_VERTEX_SHADER, vertexSource);
+	unsigned int fragment = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+	unsigned int program = glCreateProgram();
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+	glLinkProgram(program);
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+
+	const int size = 256;
+	std::vector<unsigned char> pixels((size_t)size * size * 4, 200);
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	float vertices[] = {
+		 1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+		 1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+		-1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+		-1.0f,  1.0f, 0.0f, 0.0f, 1.0f
+	};
+	unsigned int indices[] = { 0, 1, 3, 1, 2, 3 };
+	unsigned int VAO, VBO, EBO;
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+
+	// there is no window, so the frame goes to a framebuffer of the window's size
+	unsigned int framebuffer, color;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glGenRenderbuffers(1, &color);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 800, 600);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		return -1;
+
+	glViewport(0, 0, 800, 600);
+	glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "texture1"), 0);
+	const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	glUniformMatrix4fv(glGetUniformLocation(program, "transform"), 1, GL_FALSE, identity);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glBindVertexArray(VAO);
+	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+
+	unsigned char pixel[4];
+	glReadPixels(400, 300, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+	return glGetError() == GL_NO_ERROR ? pixel[0] : -1;
+}
+
+static bool run(bool lazy, Timings& timings)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (!createContext())
+	{
+		std::cout << "ERROR::EGL can't create a surfaceless OpenGL 3.3 core context" << std::endl;
+		return false;
+	}
+	timings.contextMs = msSince(start);
+
+	start = std::chrono::steady_clock::now();
+	int loaded = lazy ? gladLoadGLLoaderLazy((GLADloadproc)eglGetProcAddress)
+		: gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+	timings.loadMs = msSince(start);
+	if (!loaded)
+	{
+		std::cout << "ERROR::GLAD can't load GL" << std::endl;
+		return false;
+	}
+
+	start = std::chrono::steady_clock::now();
+	int red = firstFrame();
+	timings.frameMs = msSince(start);
+	if (red != 200)
+	{
+		std::cout << "ERROR::FRAME wrong result " << red << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// runs one measurement in a child process and reads its timings back through a pipe
+static bool runInChild(bool lazy, Timings& timings)
+{
+	int fds[2];
+	if (pipe(fds) != 0)
+		return false;
+	pid_t pid = fork();
+	if (pid < 0)
+		return false;
+	if (pid == 0)
+	{
+		close(fds[0]);
+		Timings child;
+		bool ok = run(lazy, child) && write(fds[1], &child, sizeof(child)) == (ssize_t)sizeof(child);
+		_exit(ok ? 0 : 1);
+	}
+	close(fds[1]);
+	bool ok = read(fds[0], &timings, sizeof(timings)) == (ssize_t)sizeof(timings);
+	close(fds[0]);
+	int status = 0;
+	waitpid(pid, &status, 0);
+	return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+// report
+
+static double median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	return values[values.size() / 2];
+}
+
+int main(int argc, char** argv)
+{
+	int runs = 15;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+			runs = std::max(1, std::atoi(argv[++i]));
+		else
+		{
+			std::cout << "usage: " << argv[0] << " [--runs N]" << std::endl;
+			return 2;
+		}
+	}
+
+	const char* modes[] = { "eager", "lazy" };
+	std::vector<Timings> results[2];
+	// alternate the modes so drift in machine load hits both the same
+	for (int r = 0; r < runs; ++r)
+		for (int lazy = 0; lazy < 2; ++lazy)
+		{
+			Timings timings;
+			if (!runInChild(lazy != 0, timings))
+				return 2;
+			results[lazy].push_back(timings);
+		}
+
+	double total[2];
+	std::printf("%-6s %12s %12s %12s %12s\n", "mode", "context ms", "load ms", "frame ms", "total ms");
+	for (int lazy = 0; lazy < 2; ++lazy)
+	{
+		std::vector<double> context, load, frame, sum;
+		for (size_t i = 0; i < results[lazy].size(); ++i)
+		{
+			context.push_back(results[lazy][i].contextMs);
+			load.push_back(results[lazy][i].loadMs);
+			frame.push_back(results[lazy][i].frameMs);
+			sum.push_back(results[lazy][i].totalMs());
+		}
+		total[lazy] = median(sum);
+		std::printf("%-6s %12.3f %12.3f %12.3f %12.3f\n", modes[lazy], median(context), median(load), median(frame), total[lazy]);
+	}
+	std::printf("lazy loading saves %.3f ms (%.1f%%) before the first frame\n",
+		total[0] - total[1], 100.0 * (total[0] - total[1]) / total[0]);
+	return 0;
+}
@@ -0,0 +1,1301 @@
+// stb_image decoder benchmark.
+//
+// Generates a corpus in memory (baseline and progressive JPEG, 8- and 16-bit PNG
+// with each filter type, Radiance HDR, TGA, BMP and GIF at several sizes), checks
+// that every file decodes back to what was encoded, then times the decode stages
+// of stbi_*_from_memory on each file with warm and cold caches. Needs no GPU or
+// window, so it runs headless; on Linux:
+//
+//     g++ -O2 -std=c++11 -I../stb ImageBench.cpp -o imagebench
+//     ./imagebench --json results.json
+//     ./imagebench --json new.json --baseline results.json   # exit code 1 on regressions
+//
+// Options:
+//     --quick             only the two smaller sizes, shorter runs
+//     --json FILE         write machine-readable results (one result per line)
+//     --baseline FILE     compare against an earlier --json file
+//     --threshold PCT     slowdown that counts as a regression (default 10)
+//     --filter TEXT       only run results whose name contains TEXT
+//     --write-corpus DIR  also save the generated files, e.g. to try other decoders
+//     --flush-mb N        size of the buffer written between cold runs (default 64)
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef std::vector<unsigned char> Bytes;
+
+// ------------------------------------------------------------------------------------------------
+// source images
+
+// deterministic noise, so every run (and every machine) benchmarks the same files
+struct Random
+{
+	unsigned int state;
+	explicit Random(unsigned int seed) : state(seed * 2654435761u + 1) {}
+	unsigned int next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+};
+
+// photo-like content: smooth gradients and waves for the entropy coders, flat
+// rectangles with hard edges for the filters and the IDCT, and a little noise
+struct Image
+{
+	int w, h;
+	std::vector<float> rgb; // linear 0..1, 3 floats per pixel
+
+	Image(int width, int height) : w(width), h(height), rgb((size_t)width * height * 3)
+	{
+		Random random(width * 31 + height);
+		for (int y = 0; y < h; ++y)
+			for (int x = 0; x < w; ++x)
+			{
+				float fx = (float)x / w, fy = (float)y / h;
+				float* p = &rgb[((size_t)y * w + x) * 3];
+				p[0] = 0.5f + 0.35f * std::sin(fx * 9.0f + fy * 4.0f);
+				p[1] = 0.3f + 0.5f * fy + 0.1f * std::sin(fx * 23.0f);
+				p[2] = 0.6f - 0.4f * fx * fy + 0.15f * std::cos(fy * 17.0f);
+			}
+		for (int i = 0; i < 24; ++i)
+		{
+			int x0 = random.next() % w, y0 = random.next() % h;
+			int x1 = std::min(w, x0 + 1 + (int)(random.next() % (w / 4 + 1)));
+			int y1 = std::min(h, y0 + 1 + (int)(random.next() % (h / 4 + 1)));
+			float c[3] = { (random.next() % 256) / 255.0f, (random.next() % 256) / 255.0f, (random.next() % 256) / 255.0f };
+			for (int y = y0; y < y1; ++y)
+				for (int x = x0; x < x1; ++x)
+					std::memcpy(&rgb[((size_t)y * w + x) * 3], c, sizeof(c));
+		}
+		for (size_t i = 0; i < rgb.size(); ++i)
+			rgb[i] = std::min(1.0f, std::max(0.0f, rgb[i] + ((int)(random.next() % 9) - 4) / 255.0f));
+	}
+
+	std::vector<unsigned char> rgb8() const
+	{
+		std::vector<unsigned char> out(rgb.size());
+		for (size_t i = 0; i < rgb.size(); ++i)
+			out[i] = (unsigned char)(rgb[i] * 255.0f + 0.5f);
+		return out;
+	}
+
+	std::vector<unsigned short> rgb16() const
+	{
+		std::vector<unsigned short> out(rgb.size());
+		for (size_t i = 0; i < rgb.size(); ++i)
+			out[i] = (unsigned short)(rgb[i] * 65535.0f + 0.5f);
+		return out;
+	}
+};
+
+// ------------------------------------------------------------------------------------------------
+// encoders
+
+static void put16be(Bytes& out, unsigned int v) { out.push_back((unsigned char)(v >> 8)); out.push_back((unsigned char)v); }
+static void put32be(Bytes& out, unsigned int v) { put16be(out, v >> 16); put16be(out, v & 0xffff); }
+static void put16le(Bytes& out, unsigned int v) { out.push_back((unsigned char)v); out.push_back((unsigned char)(v >> 8)); }
+static void put32le(Bytes& out, unsigned int v) { put16le(out, v & 0xffff); put16le(out, v >> 16); }
+
+// zlib stream with a single fixed-Huffman deflate block and greedy hash-chain matching
+static Bytes zlibCompress(const Bytes& data)
+{
+	static const unsigned short lengthBase[29] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+	static const unsigned char lengthExtra[29] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+	static const unsigned short distBase[30] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577 };
+	static const unsigned char distExtra[30] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+	Bytes out;
+	unsigned int bits = 0;
+	int count = 0;
+	auto put = [&](unsigned int value, int n)
+	{
+		bits |= value << count;
+		count += n;
+		while (count >= 8)
+		{
+			out.push_back((unsigned char)bits);
+			bits >>= 8;
+			count -= 8;
+		}
+	};
+	// Huffman codes go most significant bit first into an LSB-first stream
+	auto putCode = [&](unsigned int code, int n)
+	{
+		unsigned int reversed = 0;
+		for (int i = 0; i < n; ++i)
+			reversed |= ((code >> i) & 1) << (n - 1 - i);
+		put(reversed, n);
+	};
+	auto putSymbol = [&](int symbol)
+	{
+		if (symbol <= 143) putCode(0x30 + symbol, 8);
+		else if (symbol <= 255) putCode(0x190 + symbol - 144, 9);
+		else if (symbol <= 279) putCode(symbol - 256, 7);
+		else putCode(0xc0 + symbol - 280, 8);
+	};
+
+	out.push_back(0x78);
+	out.push_back(0x01);
+	put(1, 1); // final block
+	put(1, 2); // fixed Huffman codes
+
+	const int windowSize = 32768, hashSize = 1 << 15, maxChain = 32;
+	std::vector<int> head(hashSize, -1), prev(windowSize, -1);
+	auto hash = [&](size_t i) { return (int)(((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & (hashSize - 1)); };
+	size_t n = data.size(), i = 0;
+	while (i < n)
+	{
+		int bestLength = 0, bestDistance = 0;
+		if (i + 3 <= n)
+		{
+			int h = hash(i);
+			int candidate = head[h];
+			for (int chain = 0; chain < maxChain && candidate >= 0 && i - candidate <= (size_t)windowSize; ++chain)
+			{
+				int length = 0, limit = (int)std::min<size_t>(258, n - i);
+				while (length < limit && data[candidate + length] == data[i + length])
+					++length;
+				if (length > bestLength)
+				{
+					bestLength = length;
+					bestDistance = (int)(i - candidate);
+					if (length == limit)
+						break;
+				}
+				int older = prev[candidate & (windowSize - 1)];
+				if (older >= candidate)
+					break;
+				candidate = older;
+			}
+		}
+		int advance = bestLength >= 3 ? bestLength : 1;
+		if (bestLength >= 3)
+		{
+			int code = 28;
+			while (lengthBase[code] > bestLength) --code;
+			putSymbol(257 + code);
+			put(bestLength - lengthBase[code], lengthExtra[code]);
+			code = 29;
+			while (distBase[code] > bestDistance) --code;
+			putCode(code, 5);
+			put(bestDistance - distBase[code], distExtra[code]);
+		}
+		else
+		{
+			putSymbol(data[i]);
+		}
+		for (int k = 0; k < advance; ++k, ++i)
+			if (i + 3 <= n)
+			{
+				int h = hash(i);
+				prev[i & (windowSize - 1)] = head[h];
+				head[h] = (int)i;
+			}
+	}
+	putSymbol(256);
+	if (count > 0)
+		put(0, 8 - count);
+
+	unsigned int a = 1, b = 0;
+	for (size_t k = 0; k < n; ++k)
+	{
+		a = (a + data[k]) % 65521;
+		b = (b + a) % 65521;
+	}
+	put32be(out, (b << 16) | a);
+	return out;
+}
+
+static unsigned int crc32(const unsigned char* p, size_t n, unsigned int crc = 0)
+{
+	static unsigned int table[256];
+	if (table[1] == 0)
+		for (unsigned int i = 0; i < 256; ++i)
+		{
+			unsigned int c = i;
+			for (int k = 0; k < 8; ++k)
+				c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+	crc = ~crc;
+	for (size_t i = 0; i < n; ++i)
+		crc = table[(crc ^ p[i]) & 255] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void pngChunk(Bytes& out, const char* type, const Bytes& data)
+{
+	put32be(out, (unsigned int)data.size());
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	put32be(out, crc32(&out[start], out.size() - start));
+}
+
+// RGB PNG where every scanline uses the same filter (0 none, 1 sub, 2 up, 3 average, 4 Paeth)
+static Bytes encodePng(const Image& image, int depth, int filter)
+{
+	int bpp = 3 * depth / 8;
+	size_t rowBytes = (size_t)image.w * bpp;
+	Bytes raw(rowBytes * image.h);
+	if (depth == 8)
+	{
+		std::vector<unsigned char> p = image.rgb8();
+		std::memcpy(&raw[0], &p[0], raw.size());
+	}
+	else
+	{
+		std::vector<unsigned short> p = image.rgb16();
+		for (size_t i = 0; i < p.size(); ++i)
+		{
+			raw[i * 2] = (unsigned char)(p[i] >> 8);
+			raw[i * 2 + 1] = (unsigned char)p[i];
+		}
+	}
+
+	Bytes filtered;
+	filtered.reserve((rowBytes + 1) * image.h);
+	for (int y = 0; y < image.h; ++y)
+	{
+		const unsigned char* row = &raw[rowBytes * y];
+		const unsigned char* up = y > 0 ? row - rowBytes : NULL;
+		filtered.push_back((unsigned char)filter);
+		for (size_t i = 0; i < rowBytes; ++i)
+		{
+			int a = i >= (size_t)bpp ? row[i - bpp] : 0;
+			int b = up ? up[i] : 0;
+			int c = up && i >= (size_t)bpp ? up[i - bpp] : 0;
+			int predictor = 0;
+			switch (filter)
+			{
+			case 1: predictor = a; break;
+			case 2: predictor = b; break;
+			case 3: predictor = (a + b) >> 1; break;
+			case 4:
+			{
+				int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+				predictor = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+				break;
+			}
+			}
+			filtered.push_back((unsigned char)(row[i] - predictor));
+		}
+	}
+
+	static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	Bytes out(signature, signature + 8), header;
+	put32be(header, image.w);
+	put32be(header, image.h);
+	header.push_back((unsigned char)depth);
+	header.push_back(2); // RGB
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	pngChunk(out, "IHDR", header);
+	pngChunk(out, "IDAT", zlibCompress(filtered));
+	pngChunk(out, "IEND", Bytes());
+	return out;
+}
+
+// JPEG with the example tables from the standard (Annex K), 4:2:0 subsampled. The progressive variant
+// sends all DC coefficients first and then spectral bands per component, without successive approximation
+class JpegEncoder
+{
+public:
+	static Bytes encode(const Image& image, bool progressive, int quality = 85)
+	{
+		JpegEncoder encoder(image, quality);
+		return encoder.write(progressive);
+	}
+
+private:
+	struct Component
+	{
+		int id, blocksW, blocksH; // blocksW/H cover whole MCUs
+		int usedW, usedH;         // blocks that hold image data, the ones a non-interleaved scan codes
+		int quant, table;
+		std::vector<short> coefficients; // 64 per block, in zigzag order
+	};
+
+	int w, h, mcusX, mcusY;
+	Component components[3];
+	unsigned char quantTables[2][64]; // zigzag order
+	unsigned short codes[4][256];
+	unsigned char sizes[4][256];
+	Bytes out;
+	unsigned int bitBuffer;
+	int bitCount;
+
+	static const unsigned char zigzag[64];
+	static const unsigned char bits[4][16];
+	static const unsigned char values[4][162];
+
+	JpegEncoder(const Image& image, int quality) : w(image.w), h(image.h), bitBuffer(0), bitCount(0)
+	{
+		static const unsigned char baseQuant[2][64] = {
+			{ 16,11,10,16,24,40,51,61, 12,12,14,19,26,58,60,55, 14,13,16,24,40,57,69,56, 14,17,22,29,51,87,80,62,
+			  18,22,37,56,68,109,103,77, 24,35,55,64,81,104,113,92, 49,64,78,87,103,121,120,101, 72,92,95,98,112,100,103,99 },
+			{ 17,18,24,47,99,99,99,99, 18,21,26,66,99,99,99,99, 24,26,56,99,99,99,99,99, 47,66,99,99,99,99,99,99,
+			  99,99,99,99,99,99,99,99, 99,99,99,99,99,99,99,99, 99,99,99,99,99,99,99,99, 99,99,99,99,99,99,99,99 } };
+		int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+		for (int t = 0; t < 2; ++t)
+			for (int k = 0; k < 64; ++k)
+				quantTables[t][k] = (unsigned char)std::min(255, std::max(1, (baseQuant[t][zigzag[k]] * scale + 50) / 100));
+		for (int t = 0; t < 4; ++t)
+		{
+			int code = 0, k = 0;
+			for (int length = 1; length <= 16; ++length, code <<= 1)
+				for (int i = 0; i < bits[t][length - 1]; ++i, ++k, ++code)
+				{
+					codes[t][values[t][k]] = (unsigned short)code;
+					sizes[t][values[t][k]] = (unsigned char)length;
+				}
+		}
+
+		mcusX = (w + 15) / 16;
+		mcusY = (h + 15) / 16;
+		int paddedW = mcusX * 16, paddedH = mcusY * 16;
+		std::vector<float> planes[3];
+		for (int c = 0; c < 3; ++c)
+			planes[c].resize((size_t)paddedW * paddedH);
+		std::vector<unsigned char> rgb = image.rgb8();
+		for (int y = 0; y < paddedH; ++y)
+			for (int x = 0; x < paddedW; ++x)
+			{
+				const unsigned char* p = &rgb[((size_t)std::min(y, h - 1) * w + std::min(x, w - 1)) * 3];
+				size_t i = (size_t)y * paddedW + x;
+				planes[0][i] = 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2];
+				planes[1][i] = -0.168736f * p[0] - 0.331264f * p[1] + 0.5f * p[2] + 128.0f;
+				planes[2][i] = 0.5f * p[0] - 0.418688f * p[1] - 0.081312f * p[2] + 128.0f;
+			}
+
+		for (int c = 0; c < 3; ++c)
+		{
+			Component& comp = components[c];
+			int factor = c == 0 ? 2 : 1;
+			comp.id = c + 1;
+			comp.blocksW = mcusX * factor;
+			comp.blocksH = mcusY * factor;
+			comp.usedW = ((c == 0 ? w : (w + 1) / 2) + 7) / 8;
+			comp.usedH = ((c == 0 ? h : (h + 1) / 2) + 7) / 8;
+			comp.quant = c == 0 ? 0 : 1;
+			comp.table = c == 0 ? 0 : 1;
+			comp.coefficients.resize((size_t)comp.blocksW * comp.blocksH * 64);
+			for (int by = 0; by < comp.blocksH; ++by)
+				for (int bx = 0; bx < comp.blocksW; ++bx)
+				{
+					float block[64];
+					for (int y = 0; y < 8; ++y)
+						for (int x = 0; x < 8; ++x)
+						{
+							int px = bx * 8 + x, py = by * 8 + y;
+							const std::vector<float>& plane = planes[c];
+							float v = c == 0 ? plane[(size_t)py * paddedW + px]
+								: (plane[(size_t)(py * 2) * paddedW + px * 2] + plane[(size_t)(py * 2) * paddedW + px * 2 + 1]
+									+ plane[(size_t)(py * 2 + 1) * paddedW + px * 2] + plane[(size_t)(py * 2 + 1) * paddedW + px * 2 + 1]) * 0.25f;
+							block[y * 8 + x] = v - 128.0f;
+						}
+					forwardDct(block, quantTables[comp.quant], &comp.coefficients[((size_t)by * comp.blocksW + bx) * 64]);
+				}
+		}
+	}
+
+	static void forwardDct(const float* in, const unsigned char* quant, short* out)
+	{
+		static float cosines[8][8];
+		if (cosines[0][0] == 0.0f)
+			for (int u = 0; u < 8; ++u)
+				for (int x = 0; x < 8; ++x)
+					cosines[u][x] = (u == 0 ? std::sqrt(0.125f) : 0.5f) * std::cos((2 * x + 1) * u * 3.14159265358979f / 16.0f);
+		float rows[64];
+		for (int y = 0; y < 8; ++y)
+			for (int u = 0; u < 8; ++u)
+			{
+				float sum = 0.0f;
+				for (int x = 0; x < 8; ++x)
+					sum += in[y * 8 + x] * cosines[u][x];
+				rows[y * 8 + u] = sum;
+			}
+		for (int k = 0; k < 64; ++k)
+		{
+			int u = zigzag[k] & 7, v = zigzag[k] >> 3;
+			float sum = 0.0f;
+			for (int y = 0; y < 8; ++y)
+				sum += rows[y * 8 + u] * cosines[v][y];
+			out[k] = (short)std::lround(sum / quant[k]);
+		}
+	}
+
+	void putBits(unsigned int value, int n)
+	{
+		bitBuffer = (bitBuffer << n) | (value & ((1u << n) - 1));
+		bitCount += n;
+		while (bitCount >= 8)
+		{
+			unsigned char byte = (unsigned char)(bitBuffer >> (bitCount - 8));
+			out.push_back(byte);
+			if (byte == 0xff)
+				out.push_back(0); // byte stuffing
+			bitCount -= 8;
+		}
+	}
+
+	void flushBits()
+	{
+		if (bitCount > 0)
+			putBits(0x7f, 8 - bitCount); // pad with ones
+		bitBuffer = 0;
+	}
+
+	void putSymbol(int table, int symbol) { putBits(codes[table][symbol], sizes[table][symbol]); }
+
+	// Huffman symbol for a magnitude category, followed by the value's bits
+	void putValue(int table, int run, int value)
+	{
+		int magnitude = std::abs(value), size = 0;
+		while (magnitude >> size) ++size;
+		putSymbol(table, (run << 4) | size);
+		if (size)
+			putBits(value < 0 ? value - 1 : value, size);
+	}
+
+	void putDc(const Component& comp, const short* block, int& predictor)
+	{
+		putValue(comp.table, 0, block[0] - predictor);
+		predictor = block[0];
+	}
+
+	void putAc(const Component& comp, const short* block, int start, int end)
+	{
+		int table = 2 + comp.table, run = 0;
+		for (int k = start; k <= end; ++k)
+		{
+			if (block[k] == 0)
+			{
+				++run;
+				continue;
+			}
+			for (; run > 15; run -= 16)
+				putSymbol(table, 0xf0);
+			putValue(table, run, block[k]);
+			run = 0;
+		}
+		if (run > 0)
+			putSymbol(table, 0x00); // end of block (an EOB run of 1 in a progressive scan)
+	}
+
+	void marker(int code, const Bytes& payload)
+	{
+		out.push_back(0xff);
+		out.push_back((unsigned char)code);
+		put16be(out, (unsigned int)payload.size() + 2);
+		out.insert(out.end(), payload.begin(), payload.end());
+	}
+
+	void startScan(const int* ids, int count, int start, int end)
+	{
+		Bytes sos;
+		sos.push_back((unsigned char)count);
+		for (int i = 0; i < count; ++i)
+		{
+			const Component& comp = components[ids[i]];
+			sos.push_back((unsigned char)comp.id);
+			sos.push_back((unsigned char)((comp.table << 4) | comp.table));
+		}
+		sos.push_back((unsigned char)start);
+		sos.push_back((unsigned char)end);
+		sos.push_back(0); // no successive approximation
+		marker(0xda, sos);
+	}
+
+	const short* block(const Component& comp, int bx, int by) const
+	{
+		return &comp.coefficients[((size_t)by * comp.blocksW + bx) * 64];
+	}
+
+	// all components interleaved, MCU by MCU; the whole block, or only DC for a progressive first scan
+	void interleavedScan(bool dcOnly)
+	{
+		static const int all[3] = { 0, 1, 2 };
+		int predictors[3] = { 0, 0, 0 };
+		startScan(all, 3, 0, dcOnly ? 0 : 63);
+		for (int my = 0; my < mcusY; ++my)
+			for (int mx = 0; mx < mcusX; ++mx)
+				for (int c = 0; c < 3; ++c)
+				{
+					const Component& comp = components[c];
+					int factor = c == 0 ? 2 : 1;
+					for (int y = 0; y < factor; ++y)
+						for (int x = 0; x < factor; ++x)
+						{
+							const short* b = block(comp, mx * factor + x, my * factor + y);
+							putDc(comp, b, predictors[c]);
+							if (!dcOnly)
+								putAc(comp, b, 1, 63);
+						}
+				}
+		flushBits();
+	}
+
+	void acScan(int c, int start, int end)
+	{
+		const Component& comp = components[c];
+		startScan(&c, 1, start, end);
+		for (int by = 0; by < comp.usedH; ++by)
+			for (int bx = 0; bx < comp.usedW; ++bx)
+				putAc(comp, block(comp, bx, by), start, end);
+		flushBits();
+	}
+
+	Bytes write(bool progressive)
+	{
+		out.push_back(0xff);
+		out.push_back(0xd8);
+		static const unsigned char jfif[14] = { 'J','F','I','F',0, 1,1, 0, 0,1, 0,1, 0,0 };
+		marker(0xe0, Bytes(jfif, jfif + 14));
+
+		Bytes dqt;
+		for (int t = 0; t < 2; ++t)
+		{
+			dqt.push_back((unsigned char)t);
+			dqt.insert(dqt.end(), quantTables[t], quantTables[t] + 64);
+		}
+		marker(0xdb, dqt);
+
+		Bytes sof;
+		sof.push_back(8);
+		put16be(sof, h);
+		put16be(sof, w);
+		sof.push_back(3);
+		for (int c = 0; c < 3; ++c)
+		{
+			sof.push_back((unsigned char)components[c].id);
+			sof.push_back(c == 0 ? 0x22 : 0x11);
+			sof.push_back((unsigned char)components[c].quant);
+		}
+		marker(progressive ? 0xc2 : 0xc0, sof);
+
+		Bytes dht;
+		for (int t = 0; t < 4; ++t)
+		{
+			dht.push_back((unsigned char)((t >= 2 ? 0x10 : 0x00) | (t & 1)));
+			dht.insert(dht.end(), bits[t], bits[t] + 16);
+			int count = 0;
+			for (int i = 0; i < 16; ++i)
+				count += bits[t][i];
+			dht.insert(dht.end(), values[t], values[t] + count);
+		}
+		marker(0xc4, dht);
+
+		if (progressive)
+		{
+			interleavedScan(true);
+			acScan(0, 1, 5);
+			acScan(1, 1, 63);
+			acScan(2, 1, 63);
+			acScan(0, 6, 63);
+		}
+		else
+		{
+			interleavedScan(false);
+		}
+		out.push_back(0xff);
+		out.push_back(0xd9);
+		return out;
+	}
+};
+
+const unsigned char JpegEncoder::zigzag[64] = {
+	0,1,8,16,9,2,3,10,17,24,32,25,18,11,4,5,12,19,26,33,40,48,41,34,27,20,13,6,7,14,21,28,
+	35,42,49,56,57,50,43,36,29,22,15,23,30,37,44,51,58,59,52,45,38,31,39,46,53,60,61,54,47,55,62,63 };
+
+// DC luminance, DC chrominance, AC luminance, AC chrominance
+const unsigned char JpegEncoder::bits[4][16] = {
+	{ 0,1,5,1,1,1,1,1,1,0,0,0,0,0,0,0 },
+	{ 0,3,1,1,1,1,1,1,1,1,1,0,0,0,0,0 },
+	{ 0,2,1,3,3,2,4,3,5,5,4,4,0,0,1,0x7d },
+	{ 0,2,1,2,4,4,3,4,7,5,4,4,0,1,2,0x77 } };
+
+const unsigned char JpegEncoder::values[4][162] = {
+	{ 0,1,2,3,4,5,6,7,8,9,10,11 },
+	{ 0,1,2,3,4,5,6,7,8,9,10,11 },
+	{ 0x01,0x02,0x03,0x00,0x04,0x11,0x05,0x12,0x21,0x31,0x41,0x06,0x13,0x51,0x61,0x07,
+	  0x22,0x71,0x14,0x32,0x81,0x91,0xa1,0x08,0x23,0x42,0xb1,0xc1,0x15,0x52,0xd1,0xf0,
+	  0x24,0x33,0x62,0x72,0x82,0x09,0x0a,0x16,0x17,0x18,0x19,0x1a,0x25,0x26,0x27,0x28,
+	  0x29,0x2a,0x34,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,
+	  0x4a,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,
+	  0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x83,0x84,0x85,0x86,0x87,0x88,0x89,
+	  0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,
+	  0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,0xb5,0xb6,0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,
+	  0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,0xe1,0xe2,
+	  0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,
+	  0xf9,0xfa },
+	{ 0x00,0x01,0x02,0x03,0x11,0x04,0x05,0x21,0x31,0x06,0x12,0x41,0x51,0x07,0x61,0x71,
+	  0x13,0x22,0x32,0x81,0x08,0x14,0x42,0x91,0xa1,0xb1,0xc1,0x09,0x23,0x33,0x52,0xf0,
+	  0x15,0x62,0x72,0xd1,0x0a,0x16,0x24,0x34,0xe1,0x25,0xf1,0x17,0x18,0x19,0x1a,0x26,
+	  0x27,0x28,0x29,0x2a,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,
+	  0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5a,0x63,0x64,0x65,0x66,0x67,0x68,
+	  0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x82,0x83,0x84,0x85,0x86,0x87,
+	  0x88,0x89,0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,
+	  0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,0xb5,0xb6,0xb7,0xb8,0xb9,0xba,0xc2,0xc3,
+	  0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,
+	  0xe2,0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,
+	  0xf9,0xfa } };
+
+// Radiance RGBE with run-length encoded scanlines; the image is scaled up to exercise the exponent
+static Bytes encodeHdr(const Image& image)
+{
+	std::ostringstream header;
+	header << "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " << image.h << " +X " << image.w << "\n";
+	std::string text = header.str();
+	Bytes out(text.begin(), text.end());
+	std::vector<unsigned char> rgbe((size_t)image.w * 4);
+	for (int y = 0; y < image.h; ++y)
+	{
+		for (int x = 0; x < image.w; ++x)
+		{
+			const float* p = &image.rgb[((size_t)y * image.w + x) * 3];
+			float r = p[0] * p[0] * 8.0f, g = p[1] * p[1] * 8.0f, b = p[2] * p[2] * 8.0f;
+			float v = std::max(r, std::max(g, b));
+			unsigned char* e = &rgbe[(size_t)x * 4];
+			if (v < 1e-32f)
+			{
+				e[0] = e[1] = e[2] = e[3] = 0;
+			}
+			else
+			{
+				int exponent;
+				float scale = std::frexp(v, &exponent) * 256.0f / v;
+				e[0] = (unsigned char)(r * scale);
+				e[1] = (unsigned char)(g * scale);
+				e[2] = (unsigned char)(b * scale);
+				e[3] = (unsigned char)(exponent + 128);
+			}
+		}
+		out.push_back(2);
+		out.push_back(2);
+		put16be(out, image.w);
+		for (int c = 0; c < 4; ++c)
+		{
+			int x = 0;
+			while (x < image.w)
+			{
+				int run = 1;
+				while (x + run < image.w && run < 127 && rgbe[(size_t)(x + run) * 4 + c] == rgbe[(size_t)x * 4 + c])
+					++run;
+				if (run >= 4)
+				{
+					out.push_back((unsigned char)(128 + run));
+					out.push_back(rgbe[(size_t)x * 4 + c]);
+					x += run;
+					continue;
+				}
+				// literal bytes up to the next run of 4 or more
+				int count = 0;
+				while (x + count < image.w && count < 128)
+				{
+					int same = 1;
+					while (x + count + same < image.w && same < 4 && rgbe[(size_t)(x + count + same) * 4 + c] == rgbe[(size_t)(x + count) * 4 + c])
+						++same;
+					if (same >= 4)
+						break;
+					++count;
+				}
+				out.push_back((unsigned char)count);
+				for (int i = 0; i < count; ++i)
+					out.push_back(rgbe[(size_t)(x + i) * 4 + c]);
+				x += count;
+			}
+		}
+	}
+	return out;
+}
+
+// 24-bit TGA, top-down, optionally run-length encoded
+static Bytes encodeTga(const Image& image, bool rle)
+{
+	Bytes out;
+	out.push_back(0);
+	out.push_back(0);
+	out.push_back(rle ? 10 : 2);
+	out.insert(out.end(), 5, 0);
+	put16le(out, 0);
+	put16le(out, 0);
+	put16le(out, image.w);
+	put16le(out, image.h);
+	out.push_back(24);
+	out.push_back(0x20);
+	std::vector<unsigned char> rgb = image.rgb8();
+	size_t pixels = (size_t)image.w * image.h;
+	auto same = [&](size_t a, size_t b) { return std::memcmp(&rgb[a * 3], &rgb[b * 3], 3) == 0; };
+	auto putPixel = [&](size_t i) { out.push_back(rgb[i * 3 + 2]); out.push_back(rgb[i * 3 + 1]); out.push_back(rgb[i * 3]); };
+	for (size_t i = 0; i < pixels;)
+	{
+		if (!rle)
+		{
+			putPixel(i++);
+			continue;
+		}
+		size_t run = 1;
+		while (i + run < pixels && run < 128 && same(i, i + run))
+			++run;
+		if (run >= 2)
+		{
+			out.push_back((unsigned char)(0x80 | (run - 1)));
+			putPixel(i);
+			i += run;
+			continue;
+		}
+		size_t count = 1;
+		while (i + count < pixels && count < 128 && !(i + count + 1 < pixels && same(i + count, i + count + 1)))
+			++count;
+		out.push_back((unsigned char)(count - 1));
+		for (size_t k = 0; k < count; ++k)
+			putPixel(i + k);
+		i += count;
+	}
+	return out;
+}
+
+// 24-bit uncompressed BMP, bottom-up with rows padded to 4 bytes
+static Bytes encodeBmp(const Image& image)
+{
+	size_t stride = ((size_t)image.w * 3 + 3) & ~(size_t)3;
+	Bytes out;
+	out.push_back('B');
+	out.push_back('M');
+	put32le(out, (unsigned int)(54 + stride * image.h));
+	put32le(out, 0);
+	put32le(out, 54);
+	put32le(out, 40);
+	put32le(out, image.w);
+	put32le(out, image.h);
+	put16le(out, 1);
+	put16le(out, 24);
+	put32le(out, 0);
+	put32le(out, (unsigned int)(stride * image.h));
+	put32le(out, 2835);
+	put32le(out, 2835);
+	put32le(out, 0);
+	put32le(out, 0);
+	std::vector<unsigned char> rgb = image.rgb8();
+	for (int y = image.h - 1; y >= 0; --y)
+	{
+		size_t start = out.size();
+		for (int x = 0; x < image.w; ++x)
+		{
+			const unsigned char* p = &rgb[((size_t)y * image.w + x) * 3];
+			out.push_back(p[2]);
+			out.push_back(p[1]);
+			out.push_back(p[0]);
+		}
+		out.resize(start + stride, 0);
+	}
+	return out;
+}
+
+// single-frame GIF with a 6x7x6 color cube palette
+static Bytes encodeGif(const Image& image)
+{
+	Bytes out;
+	const char* signature = "GIF89a";
+	out.insert(out.end(), signature, signature + 6);
+	put16le(out, image.w);
+	put16le(out, image.h);
+	out.push_back(0xf7); // 256-entry global color table
+	out.push_back(0);
+	out.push_back(0);
+	for (int i = 0; i < 256; ++i)
+	{
+		int r = i / 42 % 6, g = i / 6 % 7, b = i % 6;
+		out.push_back((unsigned char)(i < 252 ? r * 51 : 0));
+		out.push_back((unsigned char)(i < 252 ? g * 255 / 6 : 0));
+		out.push_back((unsigned char)(i < 252 ? b * 51 : 0));
+	}
+	out.push_back(0x2c);
+	put16le(out, 0);
+	put16le(out, 0);
+	put16le(out, image.w);
+	put16le(out, image.h);
+	out.push_back(0);
+	out.push_back(8); // LZW minimum code size
+
+	std::vector<unsigned char> rgb = image.rgb8();
+	size_t pixels = (size_t)image.w * image.h;
+	std::vector<unsigned char> indices(pixels);
+	for (size_t i = 0; i < pixels; ++i)
+	{
+		const unsigned char* p = &rgb[i * 3];
+		indices[i] = (unsigned char)((p[0] * 6 / 256) * 42 + (p[1] * 7 / 256) * 6 + p[2] * 6 / 256);
+	}
+
+	Bytes lzw;
+	unsigned int bits = 0;
+	int count = 0, codeSize = 9, nextCode = 258;
+	auto put = [&](int code)
+	{
+		bits |= (unsigned int)code << count;
+		count += codeSize;
+		while (count >= 8)
+		{
+			lzw.push_back((unsigned char)bits);
+			bits >>= 8;
+			count -= 8;
+		}
+	};
+	std::unordered_map<int, int> dictionary;
+	put(256);
+	int prefix = indices[0];
+	for (size_t i = 1; i < pixels; ++i)
+	{
+		int key = (prefix << 8) | indices[i];
+		std::unordered_map<int, int>::const_iterator found = dictionary.find(key);
+		if (found != dictionary.end())
+		{
+			prefix = found->second;
+			continue;
+		}
+		put(prefix);
+		if (nextCode < 4096)
+		{
+			dictionary[key] = nextCode++;
+			if (nextCode > (1 << codeSize) && codeSize < 12)
+				++codeSize;
+		}
+		else
+		{
+			put(256);
+			dictionary.clear();
+			nextCode = 258;
+			codeSize = 9;
+		}
+		prefix = indices[i];
+	}
+	put(prefix);
+	put(257);
+	if (count > 0)
+		lzw.push_back((unsigned char)bits);
+	for (size_t i = 0; i < lzw.size(); i += 255)
+	{
+		size_t n = std::min<size_t>(255, lzw.size() - i);
+		out.push_back((unsigned char)n);
+		out.insert(out.end(), lzw.begin() + i, lzw.begin() + i + n);
+	}
+	out.push_back(0);
+	out.push_back(0x3b);
+	return out;
+}
+
+// ------------------------------------------------------------------------------------------------
+// corpus
+
+struct CorpusFile
+{
+	std::string format, extension;
+	int w, h;
+	Bytes data;
+	bool is16Bit, isHdr;
+	std::string name() const
+	{
+		std::ostringstream s;
+		s << format << "/" << w << "x" << h;
+		return s.str();
+	}
+};
+
+static std::vector<CorpusFile> buildCorpus(const std::vector<std::pair<int, int> >& sizes)
+{
+	static const char* filterNames[5] = { "none", "sub", "up", "average", "paeth" };
+	std::vector<CorpusFile> corpus;
+	for (size_t s = 0; s < sizes.size(); ++s)
+	{
+		Image image(sizes[s].first, sizes[s].second);
+		auto add = [&](const std::string& format, const char* extension, const Bytes& data, bool is16Bit, bool isHdr)
+		{
+			CorpusFile file = { format, extension, image.w, image.h, data, is16Bit, isHdr };
+			corpus.push_back(file);
+		};
+		add("jpeg_baseline", "jpg", JpegEncoder::encode(image, false), false, false);
+		add("jpeg_progressive", "jpg", JpegEncoder::encode(image, true), false, false);
+		for (int f = 0; f < 5; ++f)
+			add(std::string("png8_") + filterNames[f], "png", encodePng(image, 8, f), false, false);
+		for (int f = 0; f < 5; ++f)
+			add(std::string("png16_") + filterNames[f], "png", encodePng(image, 16, f), true, false);
+		add("hdr_rle", "hdr", encodeHdr(image), false, true);
+		add("tga", "tga", encodeTga(image, false), false, false);
+		add("tga_rle", "tga", encodeTga(image, true), false, false);
+		add("bmp", "bmp", encodeBmp(image), false, false);
+		add("gif", "gif", encodeGif(image), false, false);
+	}
+	return corpus;
+}
+
+// decode every file once and compare with what went in, so a broken encoder can't produce meaningless numbers
+static bool checkCorpus(const std::vector<CorpusFile>& corpus)
+{
+	bool ok = true;
+	for (size_t i = 0; i < corpus.size(); ++i)
+	{
+		const CorpusFile& file = corpus[i];
+		Image image(file.w, file.h);
+		int x, y, n;
+		double error = 0.0, limit = 0.0;
+		if (file.isHdr)
+		{
+			float* p = stbi_loadf_from_memory(&file.data[0], (int)file.data.size(), &x, &y, &n, 3);
+			if (p != NULL && x == file.w && y == file.h)
+			{
+				for (size_t k = 0; k < image.rgb.size(); ++k)
+					error = std::max(error, (double)std::fabs(p[k] - image.rgb[k] * image.rgb[k] * 8.0f) / 8.0);
+				limit = 1.0 / 128; // RGBE keeps 8 bits of mantissa
+			}
+			else
+			{
+				error = 1e9;
+			}
+			stbi_image_free(p);
+		}
+		else if (file.is16Bit)
+		{
+			stbi_us* p = stbi_load_16_from_memory(&file.data[0], (int)file.data.size(), &x, &y, &n, 3);
+			std::vector<unsigned short> expected = image.rgb16();
+			error = p != NULL && x == file.w && y == file.h && std::memcmp(p, &expected[0], expected.size() * 2) == 0 ? 0.0 : 1e9;
+			stbi_image_free(p);
+		}
+		else
+		{
+			stbi_uc* p = stbi_load_from_memory(&file.data[0], (int)file.data.size(), &x, &y, &n, 3);
+			std::vector<unsigned char> expected = image.rgb8();
+			if (p != NULL && x == file.w && y == file.h)
+			{
+				// RMS error: exact for the lossless formats, a few levels for the JPEG and palette (GIF) ones
+				double sum = 0.0;
+				for (size_t k = 0; k < expected.size(); ++k)
+					sum += (double)(p[k] - expected[k]) * (p[k] - expected[k]);
+				error = std::sqrt(sum / expected.size());
+				limit = file.format == "gif" ? 40.0 : file.extension == "jpg" ? 8.0 : 0.0;
+			}
+			else
+			{
+				error = 1e9;
+			}
+			stbi_image_free(p);
+		}
+		if (error > limit)
+		{
+			std::cout << "ERROR::CORPUS " << file.name() << " does not decode to its source image (error " << error << ")"
+				<< (error >= 1e9 ? std::string(": ") + stbi_failure_reason() : std::string()) << std::endl;
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+// ------------------------------------------------------------------------------------------------
+// timing
+
+struct Result
+{
+	std::string name, format, stage, cache;
+	int w, h, iterations;
+	size_t bytes;
+	double medianMs, minMs;
+	double mbPerSecond() const { return bytes / (medianMs * 1e-3) / 1e6; }
+	double mpixPerSecond() const { return (double)w * h / (medianMs * 1e-3) / 1e6; }
+};
+
+struct Options
+{
+	bool quick;
+	std::string jsonPath, baselinePath, filter, corpusDir;
+	double threshold;
+	size_t flushBytes;
+	Options() : quick(false), threshold(10.0), flushBytes((size_t)64 << 20) {}
+};
+
+// write through a buffer larger than the last-level cache, evicting the input, the decoder's tables and the allocator's memory
+static void flushCaches(std::vector<unsigned char>& scratch)
+{
+	static unsigned int counter = 0;
+	++counter;
+	for (size_t i = 0; i < scratch.size(); i += 64)
+		scratch[i] = (unsigned char)(scratch[i] + counter);
+}
+
+typedef void* (*DecodeStage)(const CorpusFile& file);
+
+static void* stageInfo(const CorpusFile& file)
+{
+	int x, y, n;
+	static char ok;
+	return stbi_info_from_memory(&file.data[0], (int)file.data.size(), &x, &y, &n) ? &ok : NULL;
+}
+static void* stageLoad(const CorpusFile& file)
+{
+	int x, y, n;
+	return stbi_load_from_memory(&file.data[0], (int)file.data.size(), &x, &y, &n, 0);
+}
+static void* stageLoadRgba(const CorpusFile& file)
+{
+	int x, y, n;
+	return stbi_load_from_memory(&file.data[0], (int)file.data.size(), &x, &y, &n, 4);
+}
+static void* stageLoad16(const CorpusFile& file)
+{
+	int x, y, n;
+	return stbi_load_16_from_memory(&file.data[0], (int)file.data.size(), &x, &y, &n, 0);
+}
+static void* stageLoadf(const CorpusFile& file)
+{
+	int x, y, n;
+	return stbi_loadf_from_memory(&file.data[0], (int)file.data.size(), &x, &y, &n, 0);
+}
+
+static bool measure(const CorpusFile& file, const char* stage, DecodeStage decode, bool cold, const Options& options,
+	std::vector<unsigned char>& scratch, Result& result)
+{
+	typedef std::chrono::steady_clock Clock;
+	const double minSeconds = options.quick ? 0.05 : 0.25;
+	const int minIterations = cold ? 3 : 5, maxIterations = cold ? 50 : 1000;
+
+	std::vector<double> times;
+	double total = 0.0;
+	if (!cold)
+	{
+		void* pixels = decode(file); // warm up: caches, page faults and the decoder's first-use setup
+		if (decode != stageInfo)
+			stbi_image_free(pixels);
+	}
+	while ((int)times.size() < minIterations || (total < minSeconds && (int)times.size() < maxIterations))
+	{
+		if (cold)
+			flushCaches(scratch);
+		Clock::time_point start = Clock::now();
+		void* pixels = decode(file);
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		if (pixels == NULL)
+		{
+			std::cout << "ERROR::DECODE " << file.name() << " " << stage << ": " << stbi_failure_reason() << std::endl;
+			return false;
+		}
+		if (decode != stageInfo)
+			stbi_image_free(pixels);
+		times.push_back(seconds);
+		total += seconds;
+	}
+	std::sort(times.begin(), times.end());
+	result.format = file.format;
+	result.stage = stage;
+	result.cache = cold ? "cold" : "warm";
+	result.name = file.name() + "/" + stage + "/" + result.cache;
+	result.w = file.w;
+	result.h = file.h;
+	result.bytes = file.data.size();
+	result.iterations = (int)times.size();
+	result.medianMs = times[times.size() / 2] * 1e3;
+	result.minMs = times[0] * 1e3;
+	return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+// reporting
+
+static std::string buildDescription()
+{
+	std::ostringstream s;
+#if defined(__clang__)
+	s << "clang " << __clang_major__ << "." << __clang_minor__;
+#elif defined(__GNUC__)
+	s << "gcc " << __GNUC__ << "." << __GNUC_MINOR__;
+#elif defined(_MSC_VER)
+	s << "msvc " << _MSC_VER;
+#else
+	s << "unknown compiler";
+#endif
+#if defined(STBI_NEON)
+	s << ", neon";
+#elif defined(STBI_SSE2)
+	s << ", sse2";
+#endif
+#ifdef STBI__SSSE3
+	s << ", ssse3";
+#endif
+#ifdef STBI__F16C
+	s << ", f16c";
+#endif
+	return s.str();
+}
+
+static bool writeJson(const std::string& path, const std::vector<Result>& results)
+{
+	std::ofstream out(path.c_str());
+	if (!out)
+		return false;
+	out << "{\n  \"benchmark\": \"stb_image\",\n  \"build\": \"" << buildDescription() << "\",\n  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const Result& r = results[i];
+		out << "    {\"name\": \"" << r.name << "\", \"format\": \"" << r.format << "\", \"width\": " << r.w
+			<< ", \"height\": " << r.h << ", \"stage\": \"" << r.stage << "\", \"cache\": \"" << r.cache
+			<< "\", \"bytes\": " << r.bytes << ", \"iterations\": " << r.iterations
+			<< ", \"median_ms\": " << r.medianMs << ", \"min_ms\": " << r.minMs
+			<< ", \"mb_per_s\": " << r.mbPerSecond() << ", \"mpix_per_s\": " << r.mpixPerSecond() << "}"
+			<< (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "  ]\n}\n";
+	return (bool)out;
+}
+
+// reads back the name and median of each result written by writeJson
+static std::map<std::string, double> readBaseline(const std::string& path)
+{
+	std::map<std::string, double> medians;
+	std::ifstream in(path.c_str());
+	std::string line;
+	while (std::getline(in, line))
+	{
+		size_t name = line.find("\"name\": \""), median = line.find("\"median_ms\": ");
+		if (name == std::string::npos || median == std::string::npos)
+			continue;
+		name += 9;
+		medians[line.substr(name, line.find('"', name) - name)] = std::atof(line.c_str() + median + 13);
+	}
+	return medians;
+}
+
+// prints every result that changed by more than the threshold; returns the number of slowdowns
+static int compareWithBaseline(const std::vector<Result>& results, const std::map<std::string, double>& baseline, double threshold)
+{
+	int regressions = 0, compared = 0;
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		std::map<std::string, double>::const_iterator old = baseline.find(results[i].name);
+		if (old == baseline.end() || old->second <= 0.0)
+			continue;
+		++compared;
+		double change = (results[i].medianMs / old->second - 1.0) * 100.0;
+		if (std::fabs(change) <= threshold)
+			continue;
+		if (change > 0.0)
+			++regressions;
+		std::printf("%-11s %-48s %9.3f ms -> %9.3f ms  %+6.1f%%\n", change > 0.0 ? "REGRESSION" : "improvement",
+			results[i].name.c_str(), old->second, results[i].medianMs, change);
+	}
+	std::printf("compared %d results with the baseline: %d regressions over %.0f%%\n", compared, regressions, threshold);
+	return regressions;
+}
+
+static bool parseOptions(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--quick") options.quick = true;
+		else if (arg == "--json" && hasValue) options.jsonPath = argv[++i];
+		else if (arg == "--baseline" && hasValue) options.baselinePath = argv[++i];
+		else if (arg == "--threshold" && hasValue) options.threshold = std::atof(argv[++i]);
+		else if (arg == "--filter" && hasValue) options.filter = argv[++i];
+		else if (arg == "--write-corpus" && hasValue) options.corpusDir = argv[++i];
+		else if (arg == "--flush-mb" && hasValue) options.flushBytes = (size_t)std::atoi(argv[++i]) << 20;
+		else
+		{
+			std::cout << "usage: " << argv[0] << " [--quick] [--json FILE] [--baseline FILE] [--threshold PCT]"
+				" [--filter TEXT] [--write-corpus DIR] [--flush-mb N]" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+		return 2;
+
+	std::vector<std::pair<int, int> > sizes;
+	sizes.push_back(std::make_pair(256, 256));
+	sizes.push_back(std::make_pair(1024, 768));
+	if (!options.quick)
+		sizes.push_back(std::make_pair(2048, 2048));
+
+	std::cout << "building corpus..." << std::endl;
+	std::vector<CorpusFile> corpus = buildCorpus(sizes);
+	if (!checkCorpus(corpus))
+		return 2;
+	if (!options.corpusDir.empty())
+		for (size_t i = 0; i < corpus.size(); ++i)
+		{
+			std::ostringstream path;
+			path << options.corpusDir << "/" << corpus[i].format << "_" << corpus[i].w << "x" << corpus[i].h << "." << corpus[i].extension;
+			std::ofstream file(path.str().c_str(), std::ios::binary);
+			file.write((const char*)&corpus[i].data[0], (std::streamsize)corpus[i].data.size());
+			if (!file)
+				std::cout << "ERROR::CORPUS can't write " << path.str() << std::endl;
+		}
+
+	std::vector<unsigned char> scratch(std::max(options.flushBytes, (size_t)1));
+	std::vector<Result> results;
+	std::printf("%-40s %-10s %-5s %10s %10s %10s\n", "file", "stage", "cache", "median ms", "MB/s", "Mpix/s");
+	for (size_t i = 0; i < corpus.size(); ++i)
+	{
+		const CorpusFile& file = corpus[i];
+		std::vector<std::pair<const char*, DecodeStage> > stages;
+		stages.push_back(std::make_pair("info", stageInfo));
+		stages.push_back(std::make_pair("load", stageLoad));
+		stages.push_back(std::make_pair("load_rgba", stageLoadRgba));
+		if (file.is16Bit)
+			stages.push_back(std::make_pair("load_16", stageLoad16));
+		if (file.isHdr)
+			stages.push_back(std::make_pair("loadf", stageLoadf));
+		for (size_t s = 0; s < stages.size(); ++s)
+			for (int cold = 0; cold < 2; ++cold)
+			{
+				std::string name = file.name() + "/" + stages[s].first + "/" + (cold ? "cold" : "warm");
+				if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+					continue;
+				Result result;
+				if (!measure(file, stages[s].first, stages[s].second, cold != 0, options, scratch, result))
+					return 2;
+				results.push_back(result);
+				std::printf("%-40s %-10s %-5s %10.3f %10.1f %10.1f\n", file.name().c_str(), result.stage.c_str(),
+					result.cache.c_str(), result.medianMs, result.mbPerSecond(), result.mpixPerSecond());
+				std::fflush(stdout);
+			}
+	}
+
+	if (!options.jsonPath.empty() && !writeJson(options.jsonPath, results))
+	{
+		std::cout << "ERROR::JSON can't write " << options.jsonPath << std::endl;
+		return 2;
+	}
+	if (!options.baselinePath.empty())
+	{
+		std::map<std::string, double> baseline = readBaseline(options.baselinePath);
+		if (baseline.empty())
+		{
+			std::cout << "ERROR::BASELINE no results in " << options.baselinePath << std::endl;
+			return 2;
+		}
+		return compareWithBaseline(results, baseline, options.threshold) > 0 ? 1 : 0;
+	}
+	return 0;
+}
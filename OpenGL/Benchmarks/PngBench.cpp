@@ -0,0 +1,221 @@
+// PngWriter benchmark and round-trip check.
+//
+// Encodes generated frames with LearnProject/PngWriter.h, decodes every file again with
+// stb_image and compares it with the source pixels, then times the encoder on one thread
+// against all of them. Exits with 1 if any file doesn't decode to its source, so it doubles
+// as the encoder's test. Needs no GPU or window; on Linux:
+//
+//     g++ -O2 -std=c++11 -pthread -I../stb -I../LearnProject PngBench.cpp -o pngbench
+//     ./pngbench
+//
+// Options:
+//     --quick         only check the small frames, and time 1080p instead of 4K
+//     --threads N     threads for the parallel runs (default: every hardware thread)
+//     --level L       compression level for the timed runs, 1-9 (default 4)
+//     --runs N        timed encodes per configuration, the median is reported (default 5)
+//     --write DIR     also save the timed frames' PNGs, e.g. to compare them with other encoders
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "PngWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::vector<unsigned char> Bytes;
+
+// ------------------------------------------------------------------------------------------------
+// source frames
+
+// deterministic noise, so every run (and every machine) encodes the same frames
+struct Random
+{
+	unsigned int state;
+	explicit Random(unsigned int seed) : state(seed * 2654435761u + 1) {}
+	unsigned int next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+};
+
+// what the renderer writes: a clear color, shaded gradients, flat-colored shapes with hard edges
+// and some textured (noisy) areas. photo = true adds noise everywhere, the hard case for deflate
+static Bytes makeFrame(int w, int h, int channels, bool photo)
+{
+	Bytes pixels((size_t)w * h * channels);
+	Random random(w * 7 + h * 13 + channels + (photo ? 1 : 0));
+	for (int y = 0; y < h; ++y)
+		for (int x = 0; x < w; ++x)
+		{
+			float fx = (float)x / w, fy = (float)y / h;
+			float c[4] = { 0.2f + 0.3f * fx, 0.3f + 0.2f * fy, 0.3f + 0.1f * std::sin(fx * 6.0f), 1.0f };
+			unsigned char* p = &pixels[((size_t)y * w + x) * channels];
+			for (int k = 0; k < channels; ++k)
+				p[k] = (unsigned char)(c[k] * 255.0f + 0.5f);
+		}
+	for (int i = 0; i < 40; ++i)
+	{
+		int x0 = random.next() % w, y0 = random.next() % h;
+		int x1 = std::min(w, x0 + 1 + (int)(random.next() % (w / 3 + 1)));
+		int y1 = std::min(h, y0 + 1 + (int)(random.next() % (h / 3 + 1)));
+		unsigned char color[4] = { (unsigned char)random.next(), (unsigned char)random.next(), (unsigned char)random.next(), 255 };
+		bool textured = i % 4 == 0;
+		for (int y = y0; y < y1; ++y)
+			for (int x = x0; x < x1; ++x)
+			{
+				unsigned char* p = &pixels[((size_t)y * w + x) * channels];
+				for (int k = 0; k < channels; ++k)
+					p[k] = textured && k < 3 ? (unsigned char)(color[k] + (random.next() & 31)) : color[k];
+			}
+	}
+	if (photo)
+		for (size_t i = 0; i < pixels.size(); ++i)
+			if (channels < 4 || i % 4 != 3)
+				pixels[i] = (unsigned char)std::min(255, std::max(0, pixels[i] + (int)(random.next() % 13) - 6));
+	return pixels;
+}
+
+// ------------------------------------------------------------------------------------------------
+// round trip
+
+static bool roundTrip(const std::string& name, const Bytes& pixels, int w, int h, int channels, bool flip,
+	int threads, int level, PngWriter::Filter filter)
+{
+	Bytes png;
+	int stride = w * channels;
+	if (flip)
+		PngWriter::encode(&pixels[(size_t)(h - 1) * stride], w, h, -stride, channels, png, threads, level, filter);
+	else
+		PngWriter::encode(&pixels[0], w, h, stride, channels, png, threads, level, filter);
+
+	int dw, dh, dc;
+	unsigned char* decoded = stbi_load_from_memory(&png[0], (int)png.size(), &dw, &dh, &dc, channels);
+	bool ok = decoded != NULL && dw == w && dh == h && dc == channels;
+	for (int y = 0; ok && y < h; ++y)
+	{
+		const unsigned char* expected = &pixels[(size_t)(flip ? h - 1 - y : y) * stride];
+		ok = std::equal(expected, expected + stride, decoded + (size_t)y * stride);
+	}
+	if (!ok)
+		std::cout << "ERROR::ROUND_TRIP " << name << ": " << (decoded ? "pixels differ" : stbi_failure_reason()) << std::endl;
+	stbi_image_free(decoded);
+	return ok;
+}
+
+static bool checkAll(bool quick, int threads)
+{
+	static const char* filterNames[6] = { "none", "sub", "up", "average", "paeth", "adaptive" };
+	struct Size { int w, h; };
+	static const Size sizes[] = { { 1, 1 }, { 3, 2 }, { 17, 5 }, { 333, 211 }, { 640, 360 }, { 1920, 1080 } };
+	int sizeCount = quick ? 5 : 6;
+	int checked = 0, failed = 0;
+	for (int s = 0; s < sizeCount; ++s)
+		for (int channels = 1; channels <= 4; ++channels)
+			for (int photo = 0; photo < 2; ++photo)
+			{
+				Bytes pixels = makeFrame(sizes[s].w, sizes[s].h, channels, photo != 0);
+				for (int filter = PngWriter::None; filter <= PngWriter::Adaptive; ++filter)
+				{
+					// every filter with both thread counts; the levels and the flip on the adaptive filter only
+					int levels[3] = { 4, 1, 9 };
+					int levelCount = filter == PngWriter::Adaptive && sizes[s].w < 1920 ? 3 : 1;
+					for (int l = 0; l < levelCount; ++l)
+						for (int t = 0; t < 2; ++t)
+							for (int flip = 0; flip < (filter == PngWriter::Adaptive ? 2 : 1); ++flip)
+							{
+								char name[128];
+								snprintf(name, sizeof(name), "%dx%d %dch%s %s level %d, %d threads%s", sizes[s].w, sizes[s].h,
+									channels, photo ? " photo" : "", filterNames[filter], levels[l], t ? threads : 1, flip ? ", flipped" : "");
+								++checked;
+								if (!roundTrip(name, pixels, sizes[s].w, sizes[s].h, channels, flip != 0, t ? threads : 1,
+									levels[l], (PngWriter::Filter)filter))
+									++failed;
+							}
+				}
+			}
+	std::cout << checked << " files checked, " << failed << " failed" << std::endl;
+	return failed == 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+// timing
+
+static double medianMs(const Bytes& pixels, int w, int h, int channels, int threads, int level, int runs, Bytes& png)
+{
+	std::vector<double> times;
+	for (int run = 0; run < runs; ++run)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		PngWriter::encode(&pixels[0], w, h, w * channels, channels, png, threads, level);
+		times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+static void timeAll(bool quick, int threads, int level, int runs, const std::string& writeDir)
+{
+	int w = quick ? 1920 : 3840, h = quick ? 1080 : 2160;
+	std::cout << "\n" << w << "x" << h << ", level " << level << ", median of " << runs << " runs\n";
+	printf("%-16s %12s %12s %10s %10s %8s\n", "frame", "1 thread ms", "N thread ms", "MB/s", "ratio", "speedup");
+	for (int channels = 3; channels <= 4; ++channels)
+		for (int photo = 0; photo < 2; ++photo)
+		{
+			Bytes pixels = makeFrame(w, h, channels, photo != 0);
+			Bytes single, parallel;
+			double one = medianMs(pixels, w, h, channels, 1, level, runs, single);
+			double many = medianMs(pixels, w, h, channels, threads, level, runs, parallel);
+			std::string name = std::string(channels == 3 ? "rgb" : "rgba") + (photo ? " photo" : " rendered");
+			printf("%-16s %12.1f %12.1f %10.0f %9.1f%% %7.2fx\n", name.c_str(), one, many,
+				pixels.size() / (many / 1000.0) / 1e6, 100.0 * parallel.size() / pixels.size(), one / many);
+			if (!writeDir.empty())
+			{
+				std::string path = writeDir + "/" + (channels == 3 ? "rgb" : "rgba") + (photo ? "_photo" : "_rendered") + ".png";
+				FILE* file = fopen(path.c_str(), "wb");
+				if (file == NULL || fwrite(&parallel[0], 1, parallel.size(), file) != parallel.size())
+					std::cout << "ERROR::WRITE can't write " << path << std::endl;
+				if (file != NULL)
+					fclose(file);
+			}
+		}
+	std::cout << threads << " threads for the N thread runs; ratio is the file size against the raw pixels" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = false;
+	int threads = (int)std::thread::hardware_concurrency(), level = 4, runs = 5;
+	std::string writeDir;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--quick") quick = true;
+		else if (arg == "--threads" && hasValue) threads = std::atoi(argv[++i]);
+		else if (arg == "--level" && hasValue) level = std::atoi(argv[++i]);
+		else if (arg == "--runs" && hasValue) runs = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--write" && hasValue) writeDir = argv[++i];
+		else
+		{
+			std::cout << "usage: " << argv[0] << " [--quick] [--threads N] [--level L] [--runs N] [--write DIR]" << std::endl;
+			return 2;
+		}
+	}
+	threads = std::max(1, threads);
+
+	std::cout << "checking round trips..." << std::endl;
+	if (!checkAll(quick, std::max(2, threads)))
+		return 1;
+	timeAll(quick, threads, level, runs, writeDir);
+	return 0;
+}
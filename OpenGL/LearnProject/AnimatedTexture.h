@@ -0,0 +1,165 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "stb_image.h"
+#include "GLStateCache.h"
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class AnimatedTexture
+{
+public:
+	// the texture array ID; the frame to show is in layer layer()
+	unsigned int ID;
+	int width, height;
+
+	// constructor opens the GIF, uploads its first frame and starts decoding the next frame on a worker thread;
+	// only one decoded frame is ever waiting, so memory does not grow with the number of frames
+	AnimatedTexture(const char* path, bool flipVertically = true, int ringSize = 3);
+	~AnimatedTexture();
+
+	// advance the animation by deltaTime seconds; once the current frame has been shown long enough, the next
+	// frame is uploaded into the next layer of the ring. returns true if layer() changed
+	bool update(float deltaTime);
+	// bind the texture array to the given texture unit; sample it with a sampler2DArray at layer()
+	void bind(unsigned int unit) const;
+	int layer() const { return currentLayer; }
+
+private:
+	stbi_gif_frames* frames;
+	int ringSize, currentLayer;
+	float shownFor, currentDelay; // seconds
+
+	// filled by the worker, emptied by update(); the worker only writes it while ready is false
+	std::vector<stbi_uc> decoded;
+	float decodedDelay;
+	bool ready, stopping;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::thread worker;
+
+	// decode the next frame into decoded, looping at the end; false if the GIF is corrupt
+	bool decodeNext();
+	void decodeLoop();
+	static float delaySeconds(int delayMs);
+};
+
+AnimatedTexture::AnimatedTexture(const char* path, bool flipVertically, int ringSize)
+	: ID(0), width(0), height(0), frames(NULL), ringSize(ringSize), currentLayer(0),
+	shownFor(0.0f), currentDelay(0.0f), decodedDelay(0.0f), ready(false), stopping(false)
+{
+	stbi_load_params params = {};
+	params.flip_vertically = flipVertically; // kept by the iterator, so the worker decodes with it too
+	frames = stbi_gif_open_with_params(path, &params, &width, &height);
+	if (frames == NULL)
+	{
+		std::cout << "ERROR::ANIMATED_TEXTURE::OPEN_FAILED " << path << "\n" << stbi_failure_reason() << std::endl;
+		return;
+	}
+	decoded.resize((size_t)width * height * 4);
+	if (!decodeNext())
+	{
+		std::cout << "ERROR::ANIMATED_TEXTURE::LOAD_FAILED " << path << "\n" << stbi_failure_reason() << std::endl;
+		return;
+	}
+
+	// every layer of the ring is allocated up front; a frame is written into the layer after the one on screen,
+	// so the upload never has to wait for draws that are still reading the current frame
+	glGenTextures(1, &ID);
+	GLStateCache::bindTexture(GL_TEXTURE_2D_ARRAY, ID);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // no mipmaps: they would have to be rebuilt every frame
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, ringSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, &decoded[0]);
+	currentDelay = decodedDelay;
+
+	worker = std::thread(&AnimatedTexture::decodeLoop, this);
+}
+
+AnimatedTexture::~AnimatedTexture()
+{
+	if (worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		worker.join();
+	}
+	stbi_gif_close(frames);
+	GLStateCache::deleteTextures(1, &ID);
+}
+
+bool AnimatedTexture::update(float deltaTime)
+{
+	shownFor += deltaTime;
+	if (shownFor < currentDelay)
+		return false;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!ready)
+			return false; // the worker is behind: keep showing this frame
+	}
+	// the worker does not touch decoded until ready is cleared, so it can be read without the lock
+	currentLayer = (currentLayer + 1) % ringSize;
+	GLStateCache::bindTexture(GL_TEXTURE_2D_ARRAY, ID);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, currentLayer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, &decoded[0]);
+	shownFor -= currentDelay;
+	if (shownFor > decodedDelay)
+		shownFor = 0.0f; // after a long stall, don't skip through frames to catch up
+	currentDelay = decodedDelay;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ready = false;
+	}
+	wake.notify_one();
+	return true;
+}
+
+void AnimatedTexture::bind(unsigned int unit) const
+{
+	GLStateCache::bindTextureUnit(unit, GL_TEXTURE_2D_ARRAY, ID);
+}
+
+bool AnimatedTexture::decodeNext()
+{
+	int delayMs = 0;
+	int result = stbi_gif_next_frame(frames, &decoded[0], 0, &delayMs);
+	if (result == 0 && stbi_gif_rewind(frames))
+		result = stbi_gif_next_frame(frames, &decoded[0], 0, &delayMs); // loop
+	decodedDelay = delaySeconds(delayMs);
+	return result > 0;
+}
+
+void AnimatedTexture::decodeLoop()
+{
+	for (;;)
+	{
+		// the frame update() just uploaded is on screen; decode the one after it
+		if (!decodeNext())
+		{
+			std::cout << "ERROR::ANIMATED_TEXTURE::DECODE_FAILED\n" << stbi_failure_reason() << std::endl;
+			return; // keeps showing the last good frame
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		ready = true;
+		wake.wait(lock, [this] { return !ready || stopping; });
+		if (stopping)
+			return;
+	}
+}
+
+float AnimatedTexture::delaySeconds(int delayMs)
+{
+	// like browsers, treat the 0 and 10 ms delays of many GIFs as 100 ms
+	return (delayMs <= 10 ? 100 : delayMs) / 1000.0f;
+}
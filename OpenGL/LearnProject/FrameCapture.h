@@ -0,0 +1,432 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "GLStateCache.h"
+#include "PngWriter.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes every rendered frame to disk without stalling the render loop. capture() only queues a
+// glReadPixels into the next pixel pack buffer of a ring and fences it; a buffer is mapped once its fence
+// has signalled, a few frames later, and the mapped pixels go straight to a pool of worker threads that
+// convert and write them. The render thread waits only when every buffer of the ring is still in flight,
+// which means the workers can't keep up.
+class FrameCapture
+{
+public:
+	enum Format
+	{
+		Raw, // one file of top-down rgb24 frames: ffmpeg -f rawvideo -pixel_format rgb24 -video_size WxH -i PATH
+		Y4M, // one YUV4MPEG2 stream, 4:4:4 BT.601
+		Png  // one file per frame; the path holds one %d or %0Nd for the frame number, like "frames/%05d.png"
+	};
+
+	int width, height;
+
+	// the frames are width x height from the lower left corner of the read framebuffer; threads = 0 leaves one
+	// hardware thread to the renderer, ringSize = 0 keeps two buffers more than there are workers
+	FrameCapture(const char* path, Format format, int width, int height, int fps = 60, int threads = 0, int ringSize = 0);
+	// finish()es, so the context has to still be current
+	~FrameCapture();
+
+	// format from the extension: .y4m, .png or anything else for raw
+	static Format formatOf(const char* path);
+
+	bool valid() const { return !ring.empty(); } // the ring is only made once the output is open
+	// call once a frame is drawn and before it is swapped
+	void capture();
+	// read back the frames still in flight and wait until all of them are written
+	void finish();
+
+	unsigned long long frames() const { return captured; }
+	unsigned long long stalls() const { return waits; }  // times capture() had to wait for a buffer
+	double captureMs() const { return spentMs; }         // total time spent in capture()
+
+private:
+	enum SlotState { Free, Reading, Encoding, Encoded };
+	struct Slot
+	{
+		GLuint PBO;
+		GLsync fence;
+		SlotState state;
+		const unsigned char* pixels; // mapped while Encoding
+		unsigned long long frame;
+	};
+
+	std::string path;
+	std::string namePrefix, nameSuffix; // Png: around the frame number
+	int nameDigits;                     // Png: zero-padded to this many digits
+	Format format;
+	int fps;
+	int pngThreads; // for each PNG; the workers already encode several frames at once
+	size_t frameBytes;
+	FILE* output; // Raw and Y4M
+	std::vector<Slot> ring;
+	unsigned long long captured, waits;
+	double spentMs;
+
+	// shared with the workers
+	std::mutex mutex;
+	std::condition_variable wake, done;
+	std::deque<int> jobs; // slots to encode, oldest frame first
+	unsigned long long nextToWrite;
+	bool stopping, failed;
+	std::vector<std::thread> workers;
+
+	// hands over the oldest Reading slots whose fences have signalled; with wait, the oldest one even if not
+	void collect(bool wait);
+	Slot* oldestReading();
+	// unmaps the slots the workers are done with
+	void release();
+	void encodeLoop();
+	void encode(const Slot& slot, std::vector<unsigned char>& out) const;
+	// splits a Png path around its one %d or %0Nd; %% stands for a percent sign
+	bool parseNamePattern(const char* path);
+};
+
+FrameCapture::FrameCapture(const char* path, Format format, int width, int height, int fps, int threads, int ringSize)
+	: width(width), height(height), path(path), nameDigits(0), format(format), fps(fps), pngThreads(1), frameBytes((size_t)width * height * 4),
+	output(NULL), captured(0), waits(0), spentMs(0.0), nextToWrite(0), stopping(false), failed(false)
+{
+	if (format != Png)
+	{
+		output = fopen(path, "wb");
+		if (output == NULL)
+		{
+			std::cout << "ERROR::FRAME_CAPTURE::OPEN_FAILED " << path << std::endl;
+			return;
+		}
+		if (format == Y4M)
+			fprintf(output, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, fps);
+	}
+	else if (!parseNamePattern(path))
+	{
+		std::cout << "ERROR::FRAME_CAPTURE::PNG_PATH_NEEDS_FRAME_NUMBER " << path << " (one %d or %0Nd)" << std::endl;
+		return;
+	}
+
+	if (threads <= 0)
+		threads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+	if (ringSize <= 0)
+		ringSize = threads + 2;
+	pngThreads = std::max(1, (int)std::thread::hardware_concurrency() / threads);
+
+	// RGBA rows need no pack alignment and are the format drivers read back without converting
+	ring.resize(ringSize);
+	for (size_t i = 0; i < ring.size(); i++)
+	{
+		Slot& slot = ring[i];
+		glGenBuffers(1, &slot.PBO);
+		GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+		slot.fence = 0;
+		slot.state = Free;
+		slot.pixels = NULL;
+		slot.frame = 0;
+	}
+	GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	for (int i = 0; i < threads; i++)
+		workers.push_back(std::thread(&FrameCapture::encodeLoop, this));
+}
+
+FrameCapture::~FrameCapture()
+{
+	finish();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	for (size_t i = 0; i < ring.size(); i++)
+		GLStateCache::deleteBuffers(1, &ring[i].PBO);
+	if (output != NULL)
+		fclose(output);
+}
+
+FrameCapture::Format FrameCapture::formatOf(const char* path)
+{
+	const char* extension = strrchr(path, '.');
+	if (extension != NULL && strcmp(extension, ".y4m") == 0)
+		return Y4M;
+	if (extension != NULL && strcmp(extension, ".png") == 0)
+		return Png;
+	return Raw;
+}
+
+void FrameCapture::capture()
+{
+	if (!valid())
+		return;
+	PROFILE_ZONE("capture");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	release();
+	collect(false);
+	Slot& slot = ring[captured % ring.size()];
+	std::unique_lock<std::mutex> lock(mutex);
+	if (slot.state != Free)
+	{
+		// the ring is full: take over what is still being read back, then wait for the workers to free this buffer
+		waits++;
+		while (slot.state == Reading)
+		{
+			lock.unlock();
+			collect(true);
+			lock.lock();
+		}
+		done.wait(lock, [&slot] { return slot.state == Encoded; });
+		lock.unlock();
+		release();
+	}
+	else
+		lock.unlock();
+
+	GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0); // into the buffer, returns at once
+	GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		slot.fence = fence;
+		slot.state = Reading;
+		slot.frame = captured++;
+	}
+
+	spentMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FrameCapture::finish()
+{
+	if (!valid())
+		return;
+	while (oldestReading() != NULL)
+		collect(true);
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return nextToWrite == captured; }); // counted even when a write fails
+	lock.unlock();
+	release();
+}
+
+void FrameCapture::collect(bool wait)
+{
+	for (;;)
+	{
+		Slot* oldest = oldestReading();
+		if (oldest == NULL)
+			return;
+
+		GLenum status = glClientWaitSync(oldest->fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+		if (status == GL_TIMEOUT_EXPIRED && wait)
+			continue;
+		if (status == GL_TIMEOUT_EXPIRED)
+			return;
+		glDeleteSync(oldest->fence);
+		oldest->fence = 0;
+
+		GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, oldest->PBO);
+		oldest->pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+		GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		if (oldest->pixels == NULL)
+			std::cout << "ERROR::FRAME_CAPTURE::MAP_FAILED frame " << oldest->frame << std::endl; // written as black
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			oldest->state = Encoding;
+			jobs.push_back((int)(oldest - &ring[0]));
+		}
+		wake.notify_one();
+		wait = false; // one was asked for; the rest only if they are ready
+	}
+}
+
+FrameCapture::Slot* FrameCapture::oldestReading()
+{
+	// the workers change the state of the slots they encode, so even a look needs the lock
+	std::lock_guard<std::mutex> lock(mutex);
+	Slot* oldest = NULL;
+	for (size_t i = 0; i < ring.size(); i++)
+		if (ring[i].state == Reading && (oldest == NULL || ring[i].frame < oldest->frame))
+			oldest = &ring[i];
+	return oldest;
+}
+
+void FrameCapture::release()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < ring.size(); i++)
+	{
+		Slot& slot = ring[i];
+		if (slot.state != Encoded)
+			continue;
+		if (slot.pixels != NULL)
+		{
+			GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			slot.pixels = NULL;
+		}
+		slot.state = Free;
+	}
+}
+
+void FrameCapture::encodeLoop()
+{
+	PROFILE_THREAD("capture worker");
+	std::vector<unsigned char> out; // reused from frame to frame
+	for (;;)
+	{
+		int index;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return !jobs.empty() || stopping; });
+			if (jobs.empty())
+				return;
+			index = jobs.front();
+			jobs.pop_front();
+		}
+		// the slot stays mapped and untouched by the render thread until it is marked Encoded
+		Slot& slot = ring[index];
+		unsigned long long frame = slot.frame;
+		PROFILE_BEGIN(encodeZone, "encode frame");
+		encode(slot, out);
+		PROFILE_END(encodeZone);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slot.state = Encoded; // the pixels are converted into out, the buffer can go back to the ring
+		}
+		done.notify_all();
+
+		// compressing and writing hold no lock, so the render thread never waits for the disk
+		PROFILE_BEGIN(writeZone, "write frame");
+		bool ok = true;
+		if (format == Png)
+		{
+			char file[1024];
+			snprintf(file, sizeof(file), "%s%0*llu%s", namePrefix.c_str(), nameDigits, frame, nameSuffix.c_str());
+			ok = PngWriter::write(file, &out[0], width, height, width * 3, 3, pngThreads);
+			if (!ok)
+				std::cout << "ERROR::FRAME_CAPTURE::WRITE_FAILED " << file << std::endl;
+		}
+		else
+		{
+			// one stream: frames go out in order, whichever worker finishes first. the others wait until
+			// nextToWrite moves past this frame, so the stream is this worker's alone while it writes
+			bool write;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				done.wait(lock, [this, frame] { return nextToWrite == frame || failed; });
+				write = !failed;
+			}
+			if (write && fwrite(&out[0], 1, out.size(), output) != out.size())
+			{
+				std::cout << "ERROR::FRAME_CAPTURE::WRITE_FAILED " << path << std::endl;
+				ok = false;
+			}
+		}
+		PROFILE_END(writeZone);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			failed = failed || !ok;
+			nextToWrite++;
+		}
+		done.notify_all();
+	}
+}
+
+void FrameCapture::encode(const Slot& slot, std::vector<unsigned char>& out) const
+{
+	// GL rows start at the bottom; every format here wants the top row first
+	size_t pixels = (size_t)width * height;
+	if (slot.pixels == NULL)
+	{
+		out.assign(format == Y4M ? 6 + pixels * 3 : pixels * 3, 0);
+		if (format == Y4M)
+			memcpy(&out[0], "FRAME\n", 6);
+		return;
+	}
+
+	if (format == Y4M)
+	{
+		out.resize(6 + pixels * 3);
+		memcpy(&out[0], "FRAME\n", 6);
+		unsigned char* y = &out[6];
+		unsigned char* u = y + pixels;
+		unsigned char* v = u + pixels;
+		for (int row = 0; row < height; row++)
+		{
+			const unsigned char* in = slot.pixels + (size_t)(height - 1 - row) * width * 4;
+			for (int x = 0; x < width; x++, in += 4)
+			{
+				// BT.601 studio range, in 8.8 fixed point
+				int r = in[0], g = in[1], b = in[2];
+				*y++ = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+				*u++ = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+				*v++ = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+			}
+		}
+		return;
+	}
+
+	// rgb24 rows, for raw files and for PngWriter
+	size_t rowBytes = (size_t)width * 3;
+	out.resize(rowBytes * height);
+	for (int row = 0; row < height; row++)
+	{
+		const unsigned char* in = slot.pixels + (size_t)(height - 1 - row) * width * 4;
+		unsigned char* o = &out[row * rowBytes];
+		for (int x = 0; x < width; x++, in += 4, o += 3)
+		{
+			o[0] = in[0];
+			o[1] = in[1];
+			o[2] = in[2];
+		}
+	}
+}
+
+bool FrameCapture::parseNamePattern(const char* path)
+{
+	std::string* part = &namePrefix;
+	bool number = false;
+	for (const char* c = path; *c; ++c)
+	{
+		if (*c != '%')
+		{
+			*part += *c;
+			continue;
+		}
+		if (c[1] == '%')
+		{
+			*part += '%';
+			++c;
+			continue;
+		}
+		// %d or %0Nd, once
+		const char* spec = c + 1;
+		int digits = 0;
+		if (*spec == '0')
+			for (++spec; *spec >= '0' && *spec <= '9' && digits < 100; ++spec)
+				digits = digits * 10 + (*spec - '0');
+		if (number || *spec != 'd' || (spec != c + 1 && (digits == 0 || digits > 20)))
+			return false;
+		number = true;
+		nameDigits = digits;
+		part = &nameSuffix;
+		c = spec;
+	}
+	return number;
+}
@@ -0,0 +1,387 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+
+// an opt-in shadow of the GL state this project sets every frame: the program, the vertex array, the buffer bound
+// to each target, the texture bound to each target of each unit, capabilities, blend/depth/polygon state and the
+// uniform values of each program. each function mirrors the GL call of the same name; with shadowing on, a call that
+// would not change anything is dropped. every call, issued or dropped, is counted per frame.
+// code that changes this state has to go through here once shadowing is on, or call invalidate() afterwards
+class GLStateCache
+{
+public:
+	// GL calls since the last endFrame()
+	struct Counts
+	{
+		unsigned int issued, skipped;
+	};
+
+	// turn shadowing on or off; off, every call goes straight to GL and is counted as issued
+	static void enableShadowing(bool on);
+	static bool shadowing() { return shadow; }
+	// forget what the context is known to hold, after GL calls that went around the cache
+	static void invalidate();
+	// the counts of the frame so far; endFrame() returns them and starts the next frame
+	static Counts frame() { return counts; }
+	static Counts endFrame();
+
+	static void useProgram(GLuint program);
+	// an unbind (array 0) is put off until something depends on it, so the usual bind, draw, unbind sequence
+	// costs nothing when the next bind is the same array. don't change vertex attributes or the element array
+	// buffer with direct GL calls while an unbind may be pending
+	static void bindVertexArray(GLuint array);
+	static void bindBuffer(GLenum target, GLuint buffer);
+	static void activeTexture(GLenum texture);
+	// binds texture on the active unit, for code that goes on to change the texture
+	static void bindTexture(GLenum target, GLuint texture);
+	// makes texture the one bound to target on unit; if it already is, the active unit is not touched either
+	static void bindTextureUnit(unsigned int unit, GLenum target, GLuint texture);
+	static void enable(GLenum cap);
+	static void disable(GLenum cap);
+	static void blendFunc(GLenum sfactor, GLenum dfactor);
+	static void depthFunc(GLenum func);
+	static void depthMask(GLboolean flag);
+	static void polygonMode(GLenum face, GLenum mode);
+
+	// locations are cached per program and name; the uniform setters apply to the current program
+	static GLint getUniformLocation(GLuint program, const char* name);
+	static void uniform1i(GLint location, GLint v0);
+	static void uniform1f(GLint location, GLfloat v0);
+	static void uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+	static void uniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+
+	// deleting an object unbinds it and frees its name for reuse, so deletes go through here as well
+	static void deleteProgram(GLuint program);
+	static void deleteVertexArrays(GLsizei n, const GLuint* arrays);
+	static void deleteBuffers(GLsizei n, const GLuint* buffers);
+	static void deleteTextures(GLsizei n, const GLuint* textures);
+
+private:
+	// a value that is not known to be in the context; calls are never dropped against it
+	static const GLuint unknown = 0xffffffffu;
+
+	struct Uniform
+	{
+		GLenum type;
+		unsigned char value[16];
+	};
+
+	static bool shadow;
+	static Counts counts;
+
+	static GLuint program, vertexArray, activeUnit;
+	static bool unbindPending; // bindVertexArray(0) was asked for but vertexArray is still bound
+	static GLuint blendSource, blendDestination, depthFunction, depthWrite, polygonFill;
+	static std::map<GLenum, GLuint> buffers;                       // by target
+	static std::map<std::pair<GLenum, GLenum>, GLuint> textures;   // by unit (GL_TEXTUREi) and target
+	static std::map<GLenum, bool> capabilities;
+	static std::map<GLuint, std::map<std::string, GLint> > locations; // by program, then name
+	static std::map<GLuint, std::map<GLint, Uniform> > uniforms;      // by program, then location
+
+	// counts a call and says whether it can be dropped
+	static bool redundant(bool same);
+	// issue a pending unbind before a call that depends on the vertex array binding
+	static void flushUnbind();
+	static void setCapability(GLenum cap, bool on);
+	// whether the current program's uniform at location already holds value; records value if not
+	static bool sameUniform(GLint location, GLenum type, const void* value, size_t size);
+};
+
+bool GLStateCache::shadow = false;
+GLStateCache::Counts GLStateCache::counts = { 0, 0 };
+GLuint GLStateCache::program = GLStateCache::unknown;
+GLuint GLStateCache::vertexArray = GLStateCache::unknown;
+GLuint GLStateCache::activeUnit = GLStateCache::unknown;
+bool GLStateCache::unbindPending = false;
+GLuint GLStateCache::blendSource = GLStateCache::unknown;
+GLuint GLStateCache::blendDestination = GLStateCache::unknown;
+GLuint GLStateCache::depthFunction = GLStateCache::unknown;
+GLuint GLStateCache::depthWrite = GLStateCache::unknown;
+GLuint GLStateCache::polygonFill = GLStateCache::unknown;
+std::map<GLenum, GLuint> GLStateCache::buffers;
+std::map<std::pair<GLenum, GLenum>, GLuint> GLStateCache::textures;
+std::map<GLenum, bool> GLStateCache::capabilities;
+std::map<GLuint, std::map<std::string, GLint> > GLStateCache::locations;
+std::map<GLuint, std::map<GLint, GLStateCache::Uniform> > GLStateCache::uniforms;
+
+void GLStateCache::enableShadowing(bool on)
+{
+	invalidate();
+	shadow = on;
+}
+
+void GLStateCache::invalidate()
+{
+	flushUnbind();
+	program = vertexArray = activeUnit = unknown;
+	blendSource = blendDestination = depthFunction = depthWrite = polygonFill = unknown;
+	buffers.clear();
+	textures.clear();
+	capabilities.clear();
+	uniforms.clear();
+	// locations don't live in the context; they stay valid until the program is deleted or relinked
+}
+
+GLStateCache::Counts GLStateCache::endFrame()
+{
+	Counts frame = counts;
+	counts.issued = counts.skipped = 0;
+	return frame;
+}
+
+bool GLStateCache::redundant(bool same)
+{
+	if (shadow && same)
+	{
+		++counts.skipped;
+		return true;
+	}
+	++counts.issued;
+	return false;
+}
+
+void GLStateCache::flushUnbind()
+{
+	if (!unbindPending)
+		return;
+	unbindPending = false;
+	++counts.issued;
+	glBindVertexArray(0);
+	vertexArray = 0;
+	buffers.erase(GL_ELEMENT_ARRAY_BUFFER); // part of the vertex array's state
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+	if (redundant(GLStateCache::program == program))
+		return;
+	glUseProgram(program);
+	GLStateCache::program = program;
+}
+
+void GLStateCache::bindVertexArray(GLuint array)
+{
+	if (unbindPending)
+	{
+		// the unbind asked for earlier is repeated or undone by this call, so it never has to reach GL
+		unbindPending = false;
+		++counts.skipped;
+	}
+	if (shadow && array == 0 && vertexArray != unknown && vertexArray != 0)
+	{
+		unbindPending = true; // counted once it is issued or dropped
+		return;
+	}
+	if (redundant(vertexArray == array))
+		return;
+	glBindVertexArray(array);
+	vertexArray = array;
+	buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+	if (target == GL_ELEMENT_ARRAY_BUFFER)
+		flushUnbind();
+	std::map<GLenum, GLuint>::iterator bound = buffers.find(target);
+	if (redundant(bound != buffers.end() && bound->second == buffer))
+		return;
+	glBindBuffer(target, buffer);
+	buffers[target] = buffer;
+}
+
+void GLStateCache::activeTexture(GLenum texture)
+{
+	if (redundant(activeUnit == texture))
+		return;
+	glActiveTexture(texture);
+	activeUnit = texture;
+}
+
+void GLStateCache::bindTexture(GLenum target, GLuint texture)
+{
+	if (activeUnit == unknown)
+	{
+		++counts.issued; // nowhere to record it
+		glBindTexture(target, texture);
+		return;
+	}
+	std::pair<GLenum, GLenum> key(activeUnit, target);
+	std::map<std::pair<GLenum, GLenum>, GLuint>::iterator bound = textures.find(key);
+	if (redundant(bound != textures.end() && bound->second == texture))
+		return;
+	glBindTexture(target, texture);
+	textures[key] = texture;
+}
+
+void GLStateCache::bindTextureUnit(unsigned int unit, GLenum target, GLuint texture)
+{
+	std::map<std::pair<GLenum, GLenum>, GLuint>::iterator bound = textures.find(std::make_pair(GL_TEXTURE0 + unit, target));
+	if (shadow && bound != textures.end() && bound->second == texture)
+	{
+		counts.skipped += 2; // glActiveTexture and glBindTexture
+		return;
+	}
+	activeTexture(GL_TEXTURE0 + unit);
+	bindTexture(target, texture);
+}
+
+void GLStateCache::setCapability(GLenum cap, bool on)
+{
+	std::map<GLenum, bool>::iterator state = capabilities.find(cap);
+	if (redundant(state != capabilities.end() && state->second == on))
+		return;
+	if (on)
+		glEnable(cap);
+	else
+		glDisable(cap);
+	capabilities[cap] = on;
+}
+
+void GLStateCache::enable(GLenum cap)
+{
+	setCapability(cap, true);
+}
+
+void GLStateCache::disable(GLenum cap)
+{
+	setCapability(cap, false);
+}
+
+void GLStateCache::blendFunc(GLenum sfactor, GLenum dfactor)
+{
+	if (redundant(blendSource == sfactor && blendDestination == dfactor))
+		return;
+	glBlendFunc(sfactor, dfactor);
+	blendSource = sfactor;
+	blendDestination = dfactor;
+}
+
+void GLStateCache::depthFunc(GLenum func)
+{
+	if (redundant(depthFunction == func))
+		return;
+	glDepthFunc(func);
+	depthFunction = func;
+}
+
+void GLStateCache::depthMask(GLboolean flag)
+{
+	if (redundant(depthWrite == flag))
+		return;
+	glDepthMask(flag);
+	depthWrite = flag;
+}
+
+void GLStateCache::polygonMode(GLenum face, GLenum mode)
+{
+	// the core profile only has GL_FRONT_AND_BACK; anything else is passed through and forgets the mode
+	if (redundant(face == GL_FRONT_AND_BACK && polygonFill == mode))
+		return;
+	glPolygonMode(face, mode);
+	if (face == GL_FRONT_AND_BACK)
+		polygonFill = mode;
+	else
+		polygonFill = unknown;
+}
+
+GLint GLStateCache::getUniformLocation(GLuint program, const char* name)
+{
+	std::map<std::string, GLint>& names = locations[program];
+	std::map<std::string, GLint>::iterator location = names.find(name);
+	if (redundant(location != names.end()))
+		return location->second;
+	GLint result = glGetUniformLocation(program, name);
+	names[name] = result;
+	return result;
+}
+
+bool GLStateCache::sameUniform(GLint location, GLenum type, const void* value, size_t size)
+{
+	if (program == unknown || location < 0)
+		return false;
+	Uniform& uniform = uniforms[program][location];
+	if (uniform.type == type && memcmp(uniform.value, value, size) == 0)
+		return true;
+	uniform.type = type;
+	memcpy(uniform.value, value, size);
+	return false;
+}
+
+void GLStateCache::uniform1i(GLint location, GLint v0)
+{
+	if (redundant(sameUniform(location, GL_INT, &v0, sizeof(v0))))
+		return;
+	glUniform1i(location, v0);
+}
+
+void GLStateCache::uniform1f(GLint location, GLfloat v0)
+{
+	if (redundant(sameUniform(location, GL_FLOAT, &v0, sizeof(v0))))
+		return;
+	glUniform1f(location, v0);
+}
+
+void GLStateCache::uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+{
+	GLfloat value[3] = { v0, v1, v2 };
+	if (redundant(sameUniform(location, GL_FLOAT_VEC3, value, sizeof(value))))
+		return;
+	glUniform3f(location, v0, v1, v2);
+}
+
+void GLStateCache::uniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+{
+	GLfloat value[4] = { v0, v1, v2, v3 };
+	if (redundant(sameUniform(location, GL_FLOAT_VEC4, value, sizeof(value))))
+		return;
+	glUniform4f(location, v0, v1, v2, v3);
+}
+
+void GLStateCache::deleteProgram(GLuint program)
+{
+	++counts.issued;
+	glDeleteProgram(program);
+	locations.erase(program);
+	uniforms.erase(program);
+	if (GLStateCache::program == program)
+		GLStateCache::program = unknown; // stays in use until another program is, but its name may come back
+}
+
+void GLStateCache::deleteVertexArrays(GLsizei n, const GLuint* arrays)
+{
+	flushUnbind();
+	++counts.issued;
+	glDeleteVertexArrays(n, arrays);
+	for (GLsizei i = 0; i < n; ++i)
+		if (arrays[i] != 0 && arrays[i] == vertexArray)
+		{
+			vertexArray = 0;
+			buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+		}
+}
+
+void GLStateCache::deleteBuffers(GLsizei n, const GLuint* buffers)
+{
+	++counts.issued;
+	glDeleteBuffers(n, buffers);
+	for (GLsizei i = 0; i < n; ++i)
+		for (std::map<GLenum, GLuint>::iterator bound = GLStateCache::buffers.begin(); bound != GLStateCache::buffers.end(); ++bound)
+			if (buffers[i] != 0 && bound->second == buffers[i])
+				bound->second = 0;
+}
+
+void GLStateCache::deleteTextures(GLsizei n, const GLuint* textures)
+{
+	++counts.issued;
+	glDeleteTextures(n, textures);
+	for (GLsizei i = 0; i < n; ++i)
+		for (std::map<std::pair<GLenum, GLenum>, GLuint>::iterator bound = GLStateCache::textures.begin(); bound != GLStateCache::textures.end(); ++bound)
+			if (textures[i] != 0 && bound->second == textures[i])
+				bound->second = 0;
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Measures how long named passes of the frame take on the GPU. begin() and end() each put a GL_TIMESTAMP
+// query into the command stream (glQueryCounter), so passes may nest or overlap, and the results are read
+// latency frames later, when the GPU has long finished them: nothing ever waits for the GPU. Every query of
+// a frame lives in one slot of a ring of latency + 1 slots; a frame whose results still aren't there when
+// its slot comes round again is dropped rather than waited for. Without timer queries (no GL 3.3 and no
+// ARB_timer_query, or a zero-bit counter) every call does nothing and the statistics stay empty.
+class GpuTimer
+{
+public:
+	struct Stats
+	{
+		std::string name;
+		double lastMs, minMs, avgMs, p99Ms;
+		int samples; // frames of the history the pass ran in
+	};
+
+	// times the GPU work issued from construction to the end of the scope as the pass
+	class Scope
+	{
+	public:
+		Scope(GpuTimer& timer, int pass) : timer(timer), pass(pass) { timer.begin(pass); }
+		~Scope() { timer.end(pass); }
+	private:
+		GpuTimer& timer;
+		int pass;
+	};
+
+	// the statistics cover the last history frames that have results
+	explicit GpuTimer(int latency = 4, int history = 300);
+	~GpuTimer();
+
+	bool supported() const { return available; }
+	// the index of the pass called name, added the first time the name is seen
+	int pass(const char* name);
+	void begin(int pass);
+	void end(int pass);
+	// once a frame, after its last pass: reads back whichever earlier frames are done
+	void endFrame();
+
+	std::vector<Stats> stats() const;
+	// one line of average pass times, like "clear 0.02 ms, draw 0.31 ms, swap 0.10 ms"
+	std::string summary() const;
+	// one row per frame of the history, one column of milliseconds per pass (empty if it didn't run)
+	bool writeCsv(const char* path) const;
+	unsigned long long droppedFrames() const { return dropped; }
+
+private:
+	struct Query
+	{
+		GLuint begin, end;
+		bool issued;
+	};
+	struct Slot
+	{
+		std::vector<Query> queries; // by pass
+		GLuint last;                // the query issued last; when it is done, the rest are too
+		unsigned long long frame;
+		bool pending;
+	};
+	struct Sample
+	{
+		unsigned long long frame;
+		std::vector<double> ms; // by pass, NaN if the pass didn't run
+	};
+
+	bool available;
+	size_t historySize;
+	std::vector<std::string> names;
+	std::vector<Slot> ring;
+	size_t current;
+	unsigned long long frame, dropped;
+	std::deque<Sample> history;
+
+	void collect(Slot& slot);
+};
+
+GpuTimer::GpuTimer(int latency, int history)
+	: available(false), historySize(std::max(1, history)), ring(std::max(1, latency) + 1), current(0), frame(0), dropped(0)
+{
+	for (size_t i = 0; i < ring.size(); ++i)
+	{
+		ring[i].last = 0;
+		ring[i].frame = 0;
+		ring[i].pending = false;
+	}
+	if (GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query)
+	{
+		GLint bits = 0;
+		glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+		available = bits > 0;
+	}
+	if (!available)
+		std::cout << "WARNING::GPU_TIMER::NOT_SUPPORTED pass times won't be measured" << std::endl;
+}
+
+GpuTimer::~GpuTimer()
+{
+	for (size_t i = 0; i < ring.size(); ++i)
+		for (size_t p = 0; p < ring[i].queries.size(); ++p)
+		{
+			glDeleteQueries(1, &ring[i].queries[p].begin);
+			glDeleteQueries(1, &ring[i].queries[p].end);
+		}
+}
+
+int GpuTimer::pass(const char* name)
+{
+	for (size_t i = 0; i < names.size(); ++i)
+		if (names[i] == name)
+			return (int)i;
+	names.push_back(name);
+	return (int)names.size() - 1;
+}
+
+void GpuTimer::begin(int pass)
+{
+	if (!available)
+		return;
+	Slot& slot = ring[current];
+	while (slot.queries.size() <= (size_t)pass)
+	{
+		Query query = { 0, 0, false };
+		glGenQueries(1, &query.begin);
+		glGenQueries(1, &query.end);
+		slot.queries.push_back(query);
+	}
+	glQueryCounter(slot.queries[pass].begin, GL_TIMESTAMP);
+}
+
+void GpuTimer::end(int pass)
+{
+	if (!available || (size_t)pass >= ring[current].queries.size())
+		return;
+	Slot& slot = ring[current];
+	glQueryCounter(slot.queries[pass].end, GL_TIMESTAMP);
+	slot.queries[pass].issued = true;
+	slot.last = slot.queries[pass].end;
+}
+
+void GpuTimer::endFrame()
+{
+	if (!available)
+		return;
+	ring[current].frame = frame++;
+	ring[current].pending = ring[current].last != 0;
+	current = (current + 1) % ring.size();
+
+	// oldest first, stopping at the first frame the GPU hasn't finished; the ones after it can't be done either
+	for (size_t k = 0; k < ring.size(); ++k)
+	{
+		Slot& slot = ring[(current + k) % ring.size()];
+		if (!slot.pending)
+			continue;
+		GLint done = 0;
+		glGetQueryObjectiv(slot.last, GL_QUERY_RESULT_AVAILABLE, &done);
+		if (!done)
+			break;
+		collect(slot);
+	}
+
+	// the slot about to be reused: its results are still outstanding after latency frames
+	Slot& next = ring[current];
+	if (next.pending)
+		++dropped;
+	next.pending = false;
+	next.last = 0;
+	for (size_t p = 0; p < next.queries.size(); ++p)
+		next.queries[p].issued = false;
+}
+
+void GpuTimer::collect(Slot& slot)
+{
+	Sample sample;
+	sample.frame = slot.frame;
+	sample.ms.assign(names.size(), NAN);
+	for (size_t p = 0; p < slot.queries.size(); ++p)
+	{
+		if (!slot.queries[p].issued)
+			continue;
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(slot.queries[p].begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(slot.queries[p].end, GL_QUERY_RESULT, &end);
+		sample.ms[p] = end >= begin ? (end - begin) / 1e6 : 0.0; // nanoseconds
+	}
+	slot.pending = false;
+	history.push_back(sample);
+	if (history.size() > historySize)
+		history.pop_front();
+}
+
+std::vector<GpuTimer::Stats> GpuTimer::stats() const
+{
+	std::vector<Stats> result;
+	for (size_t p = 0; p < names.size(); ++p)
+	{
+		std::vector<double> times;
+		double last = NAN;
+		for (size_t i = 0; i < history.size(); ++i)
+			if (p < history[i].ms.size() && !std::isnan(history[i].ms[p]))
+			{
+				times.push_back(history[i].ms[p]);
+				last = history[i].ms[p];
+			}
+		Stats stats = { names[p], last, NAN, NAN, NAN, (int)times.size() };
+		if (!times.empty())
+		{
+			std::sort(times.begin(), times.end());
+			double sum = 0.0;
+			for (size_t i = 0; i < times.size(); ++i)
+				sum += times[i];
+			stats.minMs = times.front();
+			stats.avgMs = sum / times.size();
+			stats.p99Ms = times[(size_t)std::ceil(times.size() * 0.99) - 1];
+		}
+		result.push_back(stats);
+	}
+	return result;
+}
+
+std::string GpuTimer::summary() const
+{
+	if (!available)
+		return "no GPU timers";
+	std::string line;
+	std::vector<Stats> all = stats();
+	for (size_t p = 0; p < all.size(); ++p)
+	{
+		char text[128];
+		if (all[p].samples == 0)
+			snprintf(text, sizeof(text), "%s -", all[p].name.c_str());
+		else
+			snprintf(text, sizeof(text), "%s %.2f ms", all[p].name.c_str(), all[p].avgMs);
+		line += (p ? ", " : "") + std::string(text);
+	}
+	return line;
+}
+
+bool GpuTimer::writeCsv(const char* path) const
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+		return false;
+	fprintf(file, "frame");
+	for (size_t p = 0; p < names.size(); ++p)
+		fprintf(file, ",%s_ms", names[p].c_str());
+	fprintf(file, "\n");
+	for (size_t i = 0; i < history.size(); ++i)
+	{
+		fprintf(file, "%llu", history[i].frame);
+		for (size_t p = 0; p < names.size(); ++p)
+			if (p < history[i].ms.size() && !std::isnan(history[i].ms[p]))
+				fprintf(file, ",%.4f", history[i].ms[p]);
+			else
+				fprintf(file, ",");
+		fprintf(file, "\n");
+	}
+	return fclose(file) == 0;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#ifdef LEARNOPENGL_HEADLESS
+#define EGL_NO_X11 // no display server to talk to, so keep Xlib out of eglplatform.h
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <cstring>
+#include <iostream>
+
+// An OpenGL 3.3 core context without a window, for render nodes and CI machines that have no display.
+// The context is made current on a surfaceless EGL display, so with Mesa it runs on llvmpipe when there
+// is no GPU, and every frame is drawn into a framebuffer object of the size asked for instead of a back
+// buffer. Only built in when LEARNOPENGL_HEADLESS is defined (Linux, link with -lEGL); otherwise the
+// constructor reports the error and valid() stays false.
+class HeadlessContext
+{
+public:
+	// the framebuffer the frames are drawn into
+	unsigned int FBO;
+	int width, height;
+
+	// creates the context and makes it current; call createFramebuffer() once GLAD is loaded
+	HeadlessContext(int width, int height);
+	~HeadlessContext();
+
+	bool valid() const { return current; }
+	// for gladLoadGLLoader / gladLoadGLLoaderLazy
+	static void* getProcAddress(const char* name);
+
+	// creates the FBO and leaves it bound for drawing and reading
+	bool createFramebuffer();
+	// stands in for glfwSwapBuffers: queues the frame and, like a swap chain, only waits when the GPU is
+	// framesInFlight frames behind
+	void swapBuffers();
+
+private:
+	static const int framesInFlight = 2;
+	unsigned int colorBuffer, depthStencilBuffer;
+	bool current;
+	GLsync fences[framesInFlight]; // one per frame still being drawn, oldest at nextFence
+	int nextFence;
+#ifdef LEARNOPENGL_HEADLESS
+	EGLDisplay display;
+	EGLContext context;
+#endif
+};
+
+#ifdef LEARNOPENGL_HEADLESS
+
+HeadlessContext::HeadlessContext(int width, int height)
+	: FBO(0), width(width), height(height), colorBuffer(0), depthStencilBuffer(0), current(false), fences(), nextFence(0),
+	display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT)
+{
+	// the surfaceless platform needs neither a display server nor a render node
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY); // not Mesa; the driver's own default display
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+	{
+		std::cout << "ERROR::HEADLESS::EGL_DISPLAY_FAILED" << std::endl;
+		display = EGL_NO_DISPLAY;
+		return;
+	}
+	const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+	if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context") || !eglBindAPI(EGL_OPENGL_API))
+	{
+		std::cout << "ERROR::HEADLESS::EGL_NO_SURFACELESS_OPENGL" << std::endl;
+		return;
+	}
+
+	// no surface is ever created, but the default would ask for window configs, which the surfaceless platform has none of
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+		EGL_NONE };
+	EGLConfig config;
+	EGLint count = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &count) || count == 0)
+	{
+		std::cout << "ERROR::HEADLESS::EGL_NO_CONFIG" << std::endl;
+		return;
+	}
+	// the same context the window asks GLFW for
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE };
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT)
+	{
+		std::cout << "ERROR::HEADLESS::EGL_CONTEXT_FAILED" << std::endl;
+		return;
+	}
+	current = eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) == EGL_TRUE;
+	if (!current)
+		std::cout << "ERROR::HEADLESS::EGL_MAKE_CURRENT_FAILED" << std::endl;
+}
+
+HeadlessContext::~HeadlessContext()
+{
+	if (current)
+	{
+		for (int i = 0; i < framesInFlight; i++)
+			if (fences[i] != 0)
+				glDeleteSync(fences[i]);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &FBO);
+		glDeleteRenderbuffers(1, &colorBuffer);
+		glDeleteRenderbuffers(1, &depthStencilBuffer);
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	}
+	if (context != EGL_NO_CONTEXT)
+		eglDestroyContext(display, context);
+	if (display != EGL_NO_DISPLAY)
+		eglTerminate(display);
+}
+
+void* HeadlessContext::getProcAddress(const char* name)
+{
+	return (void*)eglGetProcAddress(name);
+}
+
+#else
+
+HeadlessContext::HeadlessContext(int width, int height)
+	: FBO(0), width(width), height(height), colorBuffer(0), depthStencilBuffer(0), current(false), fences(), nextFence(0)
+{
+	std::cout << "ERROR::HEADLESS::NOT_BUILT_IN (define LEARNOPENGL_HEADLESS and link with EGL)" << std::endl;
+}
+
+HeadlessContext::~HeadlessContext()
+{
+}
+
+void* HeadlessContext::getProcAddress(const char*)
+{
+	return NULL;
+}
+
+#endif
+
+bool HeadlessContext::createFramebuffer()
+{
+	// 8-bit RGBA like the window's back buffer, with depth and stencil for when the scene needs them
+	glGenRenderbuffers(1, &colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &depthStencilBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthStencilBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO); // drawing and reading
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencilBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void HeadlessContext::swapBuffers()
+{
+	// nothing to present. Waiting for the frame framesInFlight frames back, rather than glFinish on this one,
+	// keeps the frame times honest without draining the pipeline, so readbacks and queries stay asynchronous
+	GLsync& oldest = fences[nextFence];
+	if (oldest != 0)
+	{
+		while (glClientWaitSync(oldest, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+			;
+		glDeleteSync(oldest);
+	}
+	oldest = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+	nextFence = (nextFence + 1) % framesInFlight;
+}
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGE_RESIZER_SSE2
+#endif
+
+class ImageResizer
+{
+public:
+	enum Filter
+	{
+		Area,    // average of the source pixels each output pixel covers; the usual choice for downscaling
+		Lanczos3 // sharper, with a little ringing at hard edges
+	};
+
+	// resample an 8-bit image with 1-4 interleaved channels from inWidth x inHeight to outWidth x outHeight.
+	// rows are inStride/outStride bytes apart. the output rows are split into bands that are resampled on
+	// their own threads; threads = 0 uses every hardware thread
+	static void resize(const unsigned char* in, int inWidth, int inHeight, int inStride,
+		unsigned char* out, int outWidth, int outHeight, int outStride, int channels,
+		Filter filter = Area, int threads = 0);
+	// the same for float pixels (e.g. HDR radiance), with the strides counted in floats. the output isn't
+	// rounded or limited above, but Lanczos undershoot is clamped to 0
+	static void resize(const float* in, int inWidth, int inHeight, int inStride,
+		float* out, int outWidth, int outHeight, int outStride, int channels,
+		Filter filter = Area, int threads = 0);
+
+private:
+	// output pixel i is the sum of weights[i * taps + k] * source pixel (first[i] + k); the source indices are
+	// clamped to the image, so every output pixel uses exactly taps (possibly zero-weighted) source pixels
+	struct Weights
+	{
+		int taps;
+		std::vector<int> first;
+		std::vector<float> weights;
+	};
+
+	template <typename Pixel>
+	static void resizeImage(const Pixel* in, int inWidth, int inHeight, int inStride,
+		Pixel* out, int outWidth, int outHeight, int outStride, int channels, Filter filter, int threads);
+	static Weights computeWeights(int inSize, int outSize, Filter filter);
+	static float lanczos3(float x);
+	// resample one source row horizontally into outWidth * channels floats
+	static void resizeRow(const unsigned char* row, const Weights& h, int outWidth, int channels, float* out);
+	static void resizeRow(const float* row, const Weights& h, int outWidth, int channels, float* out);
+	// resample output rows [y0, y1), keeping only the horizontally resampled source rows they need
+	template <typename Pixel>
+	static void resizeBand(const Pixel* in, int inStride, Pixel* out, int outStride,
+		int outWidth, int channels, const Weights* h, const Weights* v, int y0, int y1);
+	// write one resampled row of count floats as output pixels
+	static void storeRow(const float* sum, int count, unsigned char* dst);
+	static void storeRow(const float* sum, int count, float* dst);
+};
+
+void ImageResizer::resize(const unsigned char* in, int inWidth, int inHeight, int inStride,
+	unsigned char* out, int outWidth, int outHeight, int outStride, int channels,
+	Filter filter, int threads)
+{
+	resizeImage(in, inWidth, inHeight, inStride, out, outWidth, outHeight, outStride, channels, filter, threads);
+}
+
+void ImageResizer::resize(const float* in, int inWidth, int inHeight, int inStride,
+	float* out, int outWidth, int outHeight, int outStride, int channels,
+	Filter filter, int threads)
+{
+	resizeImage(in, inWidth, inHeight, inStride, out, outWidth, outHeight, outStride, channels, filter, threads);
+}
+
+template <typename Pixel>
+void ImageResizer::resizeImage(const Pixel* in, int inWidth, int inHeight, int inStride,
+	Pixel* out, int outWidth, int outHeight, int outStride, int channels, Filter filter, int threads)
+{
+	Weights h = computeWeights(inWidth, outWidth, filter);
+	Weights v = computeWeights(inHeight, outHeight, filter);
+
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	// a band has to be tall enough to pay for its thread and for the source rows it shares with its neighbours
+	threads = std::max(1, std::min(threads, outHeight / 32));
+
+	std::vector<std::thread> workers;
+	for (int i = 1; i < threads; ++i)
+	{
+		int y0 = (int)((long long)outHeight * i / threads);
+		int y1 = (int)((long long)outHeight * (i + 1) / threads);
+		workers.push_back(std::thread(&ImageResizer::resizeBand<Pixel>, in, inStride, out, outStride, outWidth, channels, &h, &v, y0, y1));
+	}
+	resizeBand(in, inStride, out, outStride, outWidth, channels, &h, &v, 0, outHeight / threads);
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+}
+
+ImageResizer::Weights ImageResizer::computeWeights(int inSize, int outSize, Filter filter)
+{
+	float scale = (float)inSize / outSize;
+	// when downscaling the filter is stretched over every source pixel an output pixel covers
+	float stretch = std::max(scale, 1.0f);
+	float support = filter == Area ? stretch * 0.5f : 3.0f * stretch;
+
+	Weights w;
+	w.taps = (int)std::ceil(support * 2.0f) + 2;
+	w.taps = std::min(w.taps, inSize);
+	w.first.resize(outSize);
+	w.weights.assign((size_t)outSize * w.taps, 0.0f);
+
+	std::vector<float> raw;
+	for (int i = 0; i < outSize; ++i)
+	{
+		float center = (i + 0.5f) * scale; // in source pixel edges, so source pixel j covers [j, j + 1)
+		int j0 = (int)std::floor(center - support);
+		int j1 = (int)std::ceil(center + support);
+		raw.assign(j1 - j0, 0.0f);
+		float total = 0.0f;
+		for (int j = j0; j < j1; ++j)
+		{
+			float weight;
+			if (filter == Area)
+			{
+				// the part of source pixel j inside this output pixel's footprint
+				float lo = std::max((float)j, center - support);
+				float hi = std::min((float)j + 1.0f, center + support);
+				weight = std::max(hi - lo, 0.0f);
+			}
+			else
+			{
+				weight = lanczos3((j + 0.5f - center) / stretch);
+			}
+			raw[j - j0] = weight;
+			total += weight;
+		}
+
+		// fold the taps that fall off the image onto the edge pixels, then slide the window inside the image
+		int first = std::max(0, std::min(j0, inSize - w.taps));
+		float* dst = &w.weights[(size_t)i * w.taps];
+		for (int j = j0; j < j1; ++j)
+		{
+			int k = std::min(std::max(j, 0), inSize - 1) - first;
+			if (raw[j - j0] != 0.0f && k >= 0 && k < w.taps)
+				dst[k] += raw[j - j0] / total;
+		}
+		w.first[i] = first;
+	}
+	return w;
+}
+
+float ImageResizer::lanczos3(float x)
+{
+	if (x == 0.0f)
+		return 1.0f;
+	if (x <= -3.0f || x >= 3.0f)
+		return 0.0f;
+	const float pi = 3.14159265358979f;
+	float px = pi * x;
+	return 3.0f * std::sin(px) * std::sin(px / 3.0f) / (px * px);
+}
+
+void ImageResizer::resizeRow(const unsigned char* row, const Weights& h, int outWidth, int channels, float* out)
+{
+#ifdef IMAGE_RESIZER_SSE2
+	if (channels == 4)
+	{
+		// one RGBA pixel per vector: widen the 4 bytes to floats and accumulate weight * pixel
+		const __m128i zero = _mm_setzero_si128();
+		for (int x = 0; x < outWidth; ++x)
+		{
+			const unsigned char* src = row + (size_t)h.first[x] * 4;
+			const float* weight = &h.weights[(size_t)x * h.taps];
+			__m128 sum = _mm_setzero_ps();
+			for (int k = 0; k < h.taps; ++k)
+			{
+				int bits;
+				memcpy(&bits, src + k * 4, 4);
+				__m128i pixel = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bits), zero), zero);
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_cvtepi32_ps(pixel), _mm_set1_ps(weight[k])));
+			}
+			_mm_storeu_ps(out + x * 4, sum);
+		}
+		return;
+	}
+#endif
+	for (int x = 0; x < outWidth; ++x)
+	{
+		const unsigned char* src = row + (size_t)h.first[x] * channels;
+		const float* weight = &h.weights[(size_t)x * h.taps];
+		for (int c = 0; c < channels; ++c)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < h.taps; ++k)
+				sum += weight[k] * src[k * channels + c];
+			out[x * channels + c] = sum;
+		}
+	}
+}
+
+void ImageResizer::resizeRow(const float* row, const Weights& h, int outWidth, int channels, float* out)
+{
+	for (int x = 0; x < outWidth; ++x)
+	{
+		const float* src = row + (size_t)h.first[x] * channels;
+		const float* weight = &h.weights[(size_t)x * h.taps];
+		for (int c = 0; c < channels; ++c)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < h.taps; ++k)
+				sum += weight[k] * src[k * channels + c];
+			out[x * channels + c] = sum;
+		}
+	}
+}
+
+template <typename Pixel>
+void ImageResizer::resizeBand(const Pixel* in, int inStride, Pixel* out, int outStride,
+	int outWidth, int channels, const Weights* h, const Weights* v, int y0, int y1)
+{
+	// source rows are needed in increasing order and never more than v->taps at a time, so a ring of
+	// v->taps horizontally resampled rows is enough; slot j % v->taps holds source row tag[j % v->taps]
+	int rowFloats = outWidth * channels;
+	std::vector<float> ring((size_t)v->taps * rowFloats);
+	std::vector<int> tag(v->taps, -1);
+	std::vector<float> sum(rowFloats);
+
+	for (int y = y0; y < y1; ++y)
+	{
+		int first = v->first[y];
+		const float* weight = &v->weights[(size_t)y * v->taps];
+		std::fill(sum.begin(), sum.end(), 0.0f);
+		for (int k = 0; k < v->taps; ++k)
+		{
+			if (weight[k] == 0.0f)
+				continue; // padding tap: don't resample a row nothing reads
+			int j = first + k;
+			int slot = j % v->taps;
+			float* row = &ring[(size_t)slot * rowFloats];
+			if (tag[slot] != j)
+			{
+				resizeRow(in + (size_t)j * inStride, *h, outWidth, channels, row);
+				tag[slot] = j;
+			}
+
+			int i = 0;
+#ifdef IMAGE_RESIZER_SSE2
+			__m128 w = _mm_set1_ps(weight[k]);
+			for (; i + 4 <= rowFloats; i += 4)
+				_mm_storeu_ps(&sum[i], _mm_add_ps(_mm_loadu_ps(&sum[i]), _mm_mul_ps(_mm_loadu_ps(row + i), w)));
+#endif
+			for (; i < rowFloats; ++i)
+				sum[i] += weight[k] * row[i];
+		}
+
+		storeRow(&sum[0], rowFloats, out + (size_t)y * outStride);
+	}
+}
+
+void ImageResizer::storeRow(const float* sum, int count, unsigned char* dst)
+{
+	// round and clamp to bytes; Lanczos can overshoot both ends
+	int i = 0;
+#ifdef IMAGE_RESIZER_SSE2
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i lo = _mm_cvtps_epi32(_mm_loadu_ps(sum + i));
+		__m128i hi = _mm_cvtps_epi32(_mm_loadu_ps(sum + i + 4));
+		__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128());
+		_mm_storel_epi64((__m128i*)(dst + i), bytes);
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i] = (unsigned char)std::min(std::max((int)std::lround(sum[i]), 0), 255);
+}
+
+void ImageResizer::storeRow(const float* sum, int count, float* dst)
+{
+	for (int i = 0; i < count; ++i)
+		dst[i] = std::max(sum[i], 0.0f);
+}
@@ -0,0 +1,707 @@
+#pragma once
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PNG_WRITER_SSE2
+#endif
+
+// PNG encoder for frames and screenshots that compresses on every core. The rows are split into bands the way
+// pigz splits a file: each band is filtered and deflated on its own thread with no matches reaching into the
+// band before it, and ends on a sync flush, so the compressed bands simply follow each other in the zlib
+// stream. Each band also goes out as its own IDAT chunk, which lets its thread compute the chunk CRC; only the
+// Adler-32 checksums are combined at the end. Needs nothing but the standard library.
+class PngWriter
+{
+public:
+	enum Filter
+	{
+		None, Sub, Up, Average, Paeth, // the same filter on every row
+		Adaptive                       // per row, the filter whose output has the smallest sum of magnitudes
+	};
+
+	// encode an 8-bit image with 1-4 interleaved channels (gray, gray + alpha, RGB, RGBA) into png. rows are
+	// stride bytes apart, top row first; pass the last row and a negative stride to write a bottom-up image,
+	// like glReadPixels returns, the right way up. threads = 0 uses every hardware thread. level 1 (fastest)
+	// to 9 (smallest) is how hard the compressor looks for matches
+	static void encode(const unsigned char* pixels, int width, int height, int stride, int channels,
+		std::vector<unsigned char>& png, int threads = 0, int level = 4, Filter filter = Adaptive);
+	// encode and write to path; false if the file can't be written
+	static bool write(const char* path, const unsigned char* pixels, int width, int height, int stride, int channels,
+		int threads = 0, int level = 4, Filter filter = Adaptive);
+
+private:
+	struct Band
+	{
+		int y0, y1;
+		std::vector<unsigned char> chunk; // "IDAT" and this band's part of the zlib stream
+		unsigned int adler;               // of the band's filtered rows
+		unsigned int crc;                 // of chunk
+		size_t filteredBytes;
+	};
+
+	// bits go out least significant first, as deflate wants them
+	struct BitWriter
+	{
+		std::vector<unsigned char>& out;
+		unsigned long long bits;
+		int count;
+
+		explicit BitWriter(std::vector<unsigned char>& out) : out(out), bits(0), count(0) {}
+		void put(unsigned int value, int n)
+		{
+			bits |= (unsigned long long)value << count;
+			count += n;
+			if (count >= 32)
+			{
+				for (int i = 0; i < 4; ++i)
+					out.push_back((unsigned char)(bits >> (8 * i)));
+				bits >>= 32;
+				count -= 32;
+			}
+		}
+		// pad to a byte boundary
+		void align()
+		{
+			for (; count > 0; count -= 8, bits >>= 8)
+				out.push_back((unsigned char)bits);
+			count = 0;
+			bits = 0;
+		}
+	};
+
+	// length and distance codes of deflate (RFC 1951, 3.2.5)
+	struct Tables
+	{
+		unsigned short lengthBase[29], distBase[30];
+		unsigned char lengthExtra[29], distExtra[30];
+		unsigned char lengthCode[259]; // by match length
+		unsigned char distCode[512];   // distances up to 256 directly, longer ones by 128s after that
+		unsigned int crc[256];
+		Tables();
+	};
+	static const Tables& tables();
+
+	static void encodeBand(const unsigned char* pixels, int width, int stride, int channels, int level, Filter filter,
+		bool first, bool last, Band* band);
+	// filter one row into out, without the filter type byte; returns the sum of the output bytes taken as signed
+	static unsigned int filterRow(Filter filter, const unsigned char* row, const unsigned char* up, int bytes, int bpp,
+		unsigned char* out);
+	// compress data as deflate blocks; the last band ends the stream, the others end on a sync flush
+	static void deflate(const unsigned char* data, size_t size, int level, bool last, std::vector<unsigned char>& out);
+	static void writeBlock(const std::vector<unsigned int>& tokens, bool final, BitWriter& bits);
+	// Huffman code lengths no longer than maxBits for the symbols with a nonzero frequency; needs two of them
+	static void buildLengths(const unsigned int* frequencies, int n, int maxBits, unsigned char* lengths);
+	// canonical codes, bit-reversed so that BitWriter can put them as they are
+	static void buildCodes(const unsigned char* lengths, int n, unsigned short* codes);
+	static void useTwoSymbols(unsigned int* frequencies, int n);
+
+	static unsigned int adler32(const unsigned char* data, size_t size, unsigned int adler = 1);
+	// the Adler-32 of A followed by B, from those of A and B
+	static unsigned int adler32Combine(unsigned int adlerA, unsigned int adlerB, size_t sizeB);
+	static unsigned int crc32(const unsigned char* data, size_t size, unsigned int crc = 0);
+	static void put32(std::vector<unsigned char>& out, unsigned int value);
+};
+
+void PngWriter::encode(const unsigned char* pixels, int width, int height, int stride, int channels,
+	std::vector<unsigned char>& png, int threads, int level, Filter filter)
+{
+	PROFILE_ZONE("PNG encode"); // not in the band threads: they only live for one frame
+	level = std::max(1, std::min(level, 9));
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	// a band restarts the compressor's history, so it has to be big enough for that not to show in the file size
+	size_t filteredBytes = ((size_t)width * channels + 1) * height;
+	int bandCount = (int)std::max<size_t>(1, std::min<size_t>(std::min(threads, height), filteredBytes / (128 * 1024)));
+
+	std::vector<Band> bands(bandCount);
+	for (int i = 0; i < bandCount; ++i)
+	{
+		bands[i].y0 = (int)((long long)height * i / bandCount);
+		bands[i].y1 = (int)((long long)height * (i + 1) / bandCount);
+	}
+	std::vector<std::thread> workers;
+	for (int i = 1; i < bandCount; ++i)
+		workers.push_back(std::thread(&PngWriter::encodeBand, pixels, width, stride, channels, level, filter,
+			false, i == bandCount - 1, &bands[i]));
+	encodeBand(pixels, width, stride, channels, level, filter, true, bandCount == 1, &bands[0]);
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	size_t size = 8 + 25 + 12;
+	for (int i = 0; i < bandCount; ++i)
+		size += bands[i].chunk.size() + 8 + 4;
+	png.clear();
+	png.reserve(size);
+	png.insert(png.end(), signature, signature + 8);
+
+	unsigned char header[17] = { 'I', 'H', 'D', 'R' };
+	for (int i = 0; i < 4; ++i)
+	{
+		header[4 + i] = (unsigned char)(width >> (24 - 8 * i));
+		header[8 + i] = (unsigned char)(height >> (24 - 8 * i));
+	}
+	static const unsigned char colorTypes[5] = { 0, 0, 4, 2, 6 }; // by channel count
+	header[12] = 8;
+	header[13] = colorTypes[channels];
+	put32(png, 13);
+	png.insert(png.end(), header, header + 17);
+	put32(png, crc32(header, 17));
+
+	// the bands in order; the last one carries the checksum of the whole stream
+	unsigned int adler = bands[0].adler;
+	for (int i = 1; i < bandCount; ++i)
+		adler = adler32Combine(adler, bands[i].adler, bands[i].filteredBytes);
+	for (int i = 0; i < bandCount; ++i)
+	{
+		const Band& band = bands[i];
+		bool last = i == bandCount - 1;
+		put32(png, (unsigned int)band.chunk.size() - 4 + (last ? 4 : 0));
+		png.insert(png.end(), band.chunk.begin(), band.chunk.end());
+		unsigned int crc = band.crc;
+		if (last)
+		{
+			unsigned char trailer[4] = { (unsigned char)(adler >> 24), (unsigned char)(adler >> 16), (unsigned char)(adler >> 8), (unsigned char)adler };
+			png.insert(png.end(), trailer, trailer + 4);
+			crc = crc32(trailer, 4, crc);
+		}
+		put32(png, crc);
+	}
+
+	static const unsigned char end[4] = { 'I', 'E', 'N', 'D' };
+	put32(png, 0);
+	png.insert(png.end(), end, end + 4);
+	put32(png, crc32(end, 4));
+}
+
+bool PngWriter::write(const char* path, const unsigned char* pixels, int width, int height, int stride, int channels,
+	int threads, int level, Filter filter)
+{
+	std::vector<unsigned char> png;
+	encode(pixels, width, height, stride, channels, png, threads, level, filter);
+	FILE* file = fopen(path, "wb");
+	if (file == NULL)
+		return false;
+	bool ok = fwrite(&png[0], 1, png.size(), file) == png.size();
+	return fclose(file) == 0 && ok;
+}
+
+PngWriter::Tables::Tables()
+{
+	int length = 3;
+	for (int code = 0; code < 28; ++code)
+	{
+		lengthExtra[code] = (unsigned char)(code < 8 ? 0 : (code - 4) / 4);
+		lengthBase[code] = (unsigned short)length;
+		for (int i = 0; i < (1 << lengthExtra[code]); ++i)
+			lengthCode[length++] = (unsigned char)code;
+	}
+	lengthExtra[28] = 0;
+	lengthBase[28] = 258;
+	lengthCode[258] = 28; // not 27 + 31, which would also say 258
+	lengthCode[0] = lengthCode[1] = lengthCode[2] = 0;
+
+	int distance = 1;
+	for (int code = 0; code < 30; ++code)
+	{
+		distExtra[code] = (unsigned char)(code < 4 ? 0 : (code - 2) / 2);
+		distBase[code] = (unsigned short)distance;
+		for (int i = 0; i < (1 << distExtra[code]); ++i, ++distance)
+			distCode[distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7)] = (unsigned char)code;
+	}
+
+	for (unsigned int n = 0; n < 256; ++n)
+	{
+		unsigned int c = n;
+		for (int k = 0; k < 8; ++k)
+			c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+		crc[n] = c;
+	}
+}
+
+const PngWriter::Tables& PngWriter::tables()
+{
+	static const Tables instance; // built once, by whichever thread gets here first
+	return instance;
+}
+
+void PngWriter::encodeBand(const unsigned char* pixels, int width, int stride, int channels, int level, Filter filter,
+	bool first, bool last, Band* band)
+{
+	int rowBytes = width * channels;
+	int rows = band->y1 - band->y0;
+	band->filteredBytes = ((size_t)rowBytes + 1) * rows;
+	std::vector<unsigned char> filtered(band->filteredBytes);
+	std::vector<unsigned char> zero(rowBytes, 0), candidate(rowBytes);
+
+	for (int y = band->y0; y < band->y1; ++y)
+	{
+		const unsigned char* row = pixels + (long long)y * stride;
+		const unsigned char* up = y > 0 ? row - stride : &zero[0]; // the row above the image counts as zeros
+		unsigned char* out = &filtered[((size_t)rowBytes + 1) * (y - band->y0)];
+		if (filter != Adaptive)
+		{
+			out[0] = (unsigned char)filter;
+			filterRow(filter, row, up, rowBytes, channels, out + 1);
+			continue;
+		}
+		// try every filter, keep the one that leaves the smallest values: they compress best
+		unsigned int best = filterRow(None, row, up, rowBytes, channels, out + 1);
+		out[0] = None;
+		for (int f = Sub; f <= Paeth; ++f)
+		{
+			unsigned int sum = filterRow((Filter)f, row, up, rowBytes, channels, &candidate[0]);
+			if (sum < best)
+			{
+				best = sum;
+				out[0] = (unsigned char)f;
+				memcpy(out + 1, &candidate[0], rowBytes);
+			}
+		}
+	}
+	band->adler = adler32(&filtered[0], filtered.size());
+
+	static const unsigned char idat[4] = { 'I', 'D', 'A', 'T' };
+	band->chunk.reserve(filtered.size() / 2 + 64);
+	band->chunk.insert(band->chunk.end(), idat, idat + 4);
+	if (first)
+	{
+		// zlib header: deflate with a 32K window, and how hard the compressor tried
+		band->chunk.push_back(0x78);
+		band->chunk.push_back(level == 1 ? 0x01 : level < 6 ? 0x5e : level == 6 ? 0x9c : 0xda);
+	}
+	deflate(&filtered[0], filtered.size(), level, last, band->chunk);
+	band->crc = crc32(&band->chunk[0], band->chunk.size());
+}
+
+unsigned int PngWriter::filterRow(Filter filter, const unsigned char* row, const unsigned char* up, int bytes, int bpp,
+	unsigned char* out)
+{
+	unsigned int sum = 0;
+	int i = 0;
+	// the first pixel has nothing to its left
+	for (; i < bpp && i < bytes; ++i)
+	{
+		int b = up[i];
+		int predictor = filter == Up || filter == Paeth ? b : filter == Average ? b >> 1 : 0;
+		out[i] = (unsigned char)(row[i] - predictor);
+		sum += out[i] < 128 ? out[i] : 256 - out[i];
+	}
+#ifdef PNG_WRITER_SSE2
+	// 16 bytes at a time; every filter predicts from the unfiltered neighbours, so nothing depends on the output
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sums = zero;
+	for (; i + 16 <= bytes; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+		__m128i predictor = zero;
+		if (filter == Sub)
+			predictor = _mm_loadu_si128((const __m128i*)(row + i - bpp));
+		else if (filter == Up)
+			predictor = _mm_loadu_si128((const __m128i*)(up + i));
+		else if (filter == Average)
+		{
+			// _mm_avg_epu8 rounds up; the filter rounds down
+			__m128i a = _mm_loadu_si128((const __m128i*)(row + i - bpp));
+			__m128i b = _mm_loadu_si128((const __m128i*)(up + i));
+			predictor = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+		}
+		else if (filter == Paeth)
+		{
+			__m128i a8 = _mm_loadu_si128((const __m128i*)(row + i - bpp));
+			__m128i b8 = _mm_loadu_si128((const __m128i*)(up + i));
+			__m128i c8 = _mm_loadu_si128((const __m128i*)(up + i - bpp));
+			__m128i halves[2];
+			for (int h = 0; h < 2; ++h)
+			{
+				__m128i a = h == 0 ? _mm_unpacklo_epi8(a8, zero) : _mm_unpackhi_epi8(a8, zero);
+				__m128i b = h == 0 ? _mm_unpacklo_epi8(b8, zero) : _mm_unpackhi_epi8(b8, zero);
+				__m128i c = h == 0 ? _mm_unpacklo_epi8(c8, zero) : _mm_unpackhi_epi8(c8, zero);
+				// p = a + b - c, so |p - a| = |b - c|, |p - b| = |a - c| and |p - c| = |b - c + a - c|
+				__m128i bc = _mm_sub_epi16(b, c), ac = _mm_sub_epi16(a, c);
+				__m128i pa = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+				__m128i pb = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+				__m128i abc = _mm_add_epi16(bc, ac);
+				__m128i pc = _mm_max_epi16(abc, _mm_sub_epi16(zero, abc));
+				__m128i notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+				__m128i notB = _mm_cmpgt_epi16(pb, pc);
+				__m128i bOrC = _mm_or_si128(_mm_andnot_si128(notB, b), _mm_and_si128(notB, c));
+				halves[h] = _mm_or_si128(_mm_andnot_si128(notA, a), _mm_and_si128(notA, bOrC));
+			}
+			predictor = _mm_packus_epi16(halves[0], halves[1]);
+		}
+		__m128i filtered = _mm_sub_epi8(x, predictor);
+		_mm_storeu_si128((__m128i*)(out + i), filtered);
+		// |signed byte| is the smaller of x and -x taken as unsigned
+		sums = _mm_add_epi64(sums, _mm_sad_epu8(_mm_min_epu8(filtered, _mm_sub_epi8(zero, filtered)), zero));
+	}
+	sum += (unsigned int)_mm_cvtsi128_si32(sums) + (unsigned int)_mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+#endif
+	for (; i < bytes; ++i)
+	{
+		int a = row[i - bpp], b = up[i], c = up[i - bpp];
+		int predictor = 0;
+		switch (filter)
+		{
+		case Sub: predictor = a; break;
+		case Up: predictor = b; break;
+		case Average: predictor = (a + b) >> 1; break;
+		case Paeth:
+		{
+			int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - 2 * c);
+			predictor = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+			break;
+		}
+		default: break;
+		}
+		out[i] = (unsigned char)(row[i] - predictor);
+		sum += out[i] < 128 ? out[i] : 256 - out[i];
+	}
+	return sum;
+}
+
+void PngWriter::deflate(const unsigned char* data, size_t size, int level, bool last, std::vector<unsigned char>& out)
+{
+	// how many earlier positions to try, a match long enough to stop looking, and the longest match whose
+	// positions all go into the hash chains; by level, like zlib's
+	static const int maxChain[10] = { 0, 4, 8, 16, 32, 64, 128, 256, 1024, 4096 };
+	static const int niceLength[10] = { 0, 8, 16, 32, 64, 128, 128, 258, 258, 258 };
+	static const int maxInsert[10] = { 0, 4, 8, 16, 32, 258, 258, 258, 258, 258 };
+	const int windowSize = 32768, hashBits = 15;
+	std::vector<int> head(1 << hashBits, -1), prev(windowSize, -1);
+
+	// a literal is its byte; a match is the top bit, then length - 3 and distance - 1
+	std::vector<unsigned int> tokens;
+	tokens.reserve(1 << 15);
+	BitWriter bits(out);
+
+	size_t i = 0;
+	while (i < size)
+	{
+		int bestLength = 0, bestDistance = 0;
+		if (i + 3 <= size)
+		{
+			unsigned int key = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+			int h = (int)((key * 2654435761u) >> (32 - hashBits));
+			int limit = (int)std::min<size_t>(258, size - i);
+			int candidate = head[h];
+			for (int chain = maxChain[level]; chain > 0 && candidate >= 0 && i - candidate <= (size_t)windowSize; --chain)
+			{
+				const unsigned char* a = data + candidate;
+				const unsigned char* b = data + i;
+				if (a[bestLength] == b[bestLength]) // can't beat the best match otherwise
+				{
+					int length = 0;
+					while (length + 8 <= limit)
+					{
+						unsigned long long x, y;
+						memcpy(&x, a + length, 8);
+						memcpy(&y, b + length, 8);
+						if (x != y)
+							break;
+						length += 8;
+					}
+					while (length < limit && a[length] == b[length])
+						++length;
+					if (length > bestLength)
+					{
+						bestLength = length;
+						bestDistance = (int)(i - candidate);
+						if (length >= niceLength[level] || length == limit)
+							break;
+					}
+				}
+				int older = prev[candidate & (windowSize - 1)];
+				if (older >= candidate)
+					break; // the slot was reused by a newer position
+				candidate = older;
+			}
+			prev[i & (windowSize - 1)] = head[h];
+			head[h] = (int)i;
+		}
+
+		if (bestLength >= 3)
+		{
+			tokens.push_back(0x80000000u | ((unsigned int)(bestLength - 3) << 16) | (unsigned int)(bestDistance - 1));
+			if (bestLength <= maxInsert[level])
+				for (size_t k = i + 1; k < i + bestLength && k + 3 <= size; ++k)
+				{
+					unsigned int key = data[k] | (data[k + 1] << 8) | (data[k + 2] << 16);
+					int h = (int)((key * 2654435761u) >> (32 - hashBits));
+					prev[k & (windowSize - 1)] = head[h];
+					head[h] = (int)k;
+				}
+			i += bestLength;
+		}
+		else
+			tokens.push_back(data[i++]);
+
+		if (tokens.size() >= (1 << 15) && i < size)
+		{
+			writeBlock(tokens, false, bits);
+			tokens.clear();
+		}
+	}
+	writeBlock(tokens, last, bits);
+	if (!last)
+	{
+		// sync flush: an empty stored block ends the band on a byte boundary
+		bits.put(0, 3);
+		bits.align();
+		static const unsigned char marker[4] = { 0x00, 0x00, 0xff, 0xff };
+		out.insert(out.end(), marker, marker + 4);
+	}
+	else
+		bits.align();
+}
+
+void PngWriter::writeBlock(const std::vector<unsigned int>& tokens, bool final, BitWriter& bits)
+{
+	const Tables& t = tables();
+	unsigned int litFrequencies[286] = { 0 }, distFrequencies[30] = { 0 };
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		unsigned int token = tokens[i];
+		if (token & 0x80000000u)
+		{
+			int length = ((token >> 16) & 0xff) + 3, distance = (token & 0xffff) + 1;
+			litFrequencies[257 + t.lengthCode[length]]++;
+			distFrequencies[t.distCode[distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7)]]++;
+		}
+		else
+			litFrequencies[token]++;
+	}
+	litFrequencies[256] = 1; // end of block
+	useTwoSymbols(litFrequencies, 286);
+	useTwoSymbols(distFrequencies, 30);
+
+	unsigned char litLengths[286], distLengths[30], lengths[286 + 30];
+	buildLengths(litFrequencies, 286, 15, litLengths);
+	buildLengths(distFrequencies, 30, 15, distLengths);
+	int litCount = 286, distCount = 30;
+	while (litCount > 257 && litLengths[litCount - 1] == 0)
+		--litCount;
+	while (distCount > 1 && distLengths[distCount - 1] == 0)
+		--distCount;
+	// the header sends both sets of lengths as one sequence
+	memcpy(lengths, litLengths, litCount);
+	memcpy(lengths + litCount, distLengths, distCount);
+
+	// the code lengths themselves, run-length coded: 16 repeats the previous length 3-6 times, 17 and 18 are
+	// runs of 3-10 and 11-138 zeros
+	std::vector<std::pair<int, int> > runs; // symbol, extra bits value
+	int total = litCount + distCount;
+	for (int i = 0; i < total; )
+	{
+		int length = lengths[i], run = 1;
+		while (i + run < total && lengths[i + run] == length)
+			++run;
+		i += run;
+		if (length == 0)
+		{
+			for (; run >= 11; run -= std::min(run, 138))
+				runs.push_back(std::make_pair(18, std::min(run, 138) - 11));
+			if (run >= 3)
+			{
+				runs.push_back(std::make_pair(17, run - 3));
+				run = 0;
+			}
+		}
+		else
+		{
+			runs.push_back(std::make_pair(length, 0));
+			for (--run; run >= 3; run -= std::min(run, 6))
+				runs.push_back(std::make_pair(16, std::min(run, 6) - 3));
+		}
+		for (; run > 0; --run)
+			runs.push_back(std::make_pair(length, 0));
+	}
+	unsigned int codeFrequencies[19] = { 0 };
+	for (size_t i = 0; i < runs.size(); ++i)
+		codeFrequencies[runs[i].first]++;
+	useTwoSymbols(codeFrequencies, 19);
+	unsigned char codeLengths[19];
+	unsigned short codeCodes[19];
+	buildLengths(codeFrequencies, 19, 7, codeLengths);
+	buildCodes(codeLengths, 19, codeCodes);
+	static const unsigned char order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	int codeCount = 19;
+	while (codeCount > 4 && codeLengths[order[codeCount - 1]] == 0)
+		--codeCount;
+
+	bits.put(final ? 1 : 0, 1);
+	bits.put(2, 2); // dynamic Huffman codes
+	bits.put(litCount - 257, 5);
+	bits.put(distCount - 1, 5);
+	bits.put(codeCount - 4, 4);
+	for (int i = 0; i < codeCount; ++i)
+		bits.put(codeLengths[order[i]], 3);
+	static const int runExtra[3] = { 2, 3, 7 };
+	for (size_t i = 0; i < runs.size(); ++i)
+	{
+		int symbol = runs[i].first;
+		bits.put(codeCodes[symbol], codeLengths[symbol]);
+		if (symbol >= 16)
+			bits.put(runs[i].second, runExtra[symbol - 16]);
+	}
+
+	unsigned short litCodes[286], distCodes[30];
+	buildCodes(litLengths, 286, litCodes);
+	buildCodes(distLengths, 30, distCodes);
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		unsigned int token = tokens[i];
+		if (token & 0x80000000u)
+		{
+			int length = ((token >> 16) & 0xff) + 3, distance = (token & 0xffff) + 1;
+			int code = t.lengthCode[length];
+			bits.put(litCodes[257 + code], litLengths[257 + code]);
+			bits.put(length - t.lengthBase[code], t.lengthExtra[code]);
+			code = t.distCode[distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7)];
+			bits.put(distCodes[code], distLengths[code]);
+			bits.put(distance - t.distBase[code], t.distExtra[code]);
+		}
+		else
+			bits.put(litCodes[token], litLengths[token]);
+	}
+	bits.put(litCodes[256], litLengths[256]);
+}
+
+void PngWriter::buildLengths(const unsigned int* frequencies, int n, int maxBits, unsigned char* lengths)
+{
+	std::vector<unsigned int> weights(frequencies, frequencies + n);
+	std::vector<int> parent(2 * n);
+	for (;;)
+	{
+		// plain Huffman: merge the two lightest nodes until one is left; leaves are 0..n-1
+		typedef std::pair<unsigned long long, int> Node;
+		std::priority_queue<Node, std::vector<Node>, std::greater<Node> > queue;
+		for (int i = 0; i < n; ++i)
+			if (weights[i] > 0)
+				queue.push(Node(weights[i], i));
+		int next = n;
+		while (queue.size() > 1)
+		{
+			Node a = queue.top();
+			queue.pop();
+			Node b = queue.top();
+			queue.pop();
+			parent[a.second] = parent[b.second] = next;
+			queue.push(Node(a.first + b.first, next++));
+		}
+		int root = next - 1, longest = 0;
+		for (int i = 0; i < n; ++i)
+		{
+			int depth = 0;
+			if (weights[i] > 0)
+				for (int node = i; node != root; node = parent[node])
+					++depth;
+			lengths[i] = (unsigned char)depth;
+			longest = std::max(longest, depth);
+		}
+		if (longest <= maxBits)
+			return;
+		// too deep: flatten the frequencies and build it again
+		for (int i = 0; i < n; ++i)
+			if (weights[i] > 0)
+				weights[i] = (weights[i] + 1) / 2;
+	}
+}
+
+void PngWriter::buildCodes(const unsigned char* lengths, int n, unsigned short* codes)
+{
+	int counts[16] = { 0 }, next[16] = { 0 };
+	for (int i = 0; i < n; ++i)
+		counts[lengths[i]]++;
+	counts[0] = 0;
+	for (int bits = 1, code = 0; bits < 16; ++bits)
+	{
+		code = (code + counts[bits - 1]) << 1;
+		next[bits] = code;
+	}
+	for (int i = 0; i < n; ++i)
+	{
+		int length = lengths[i];
+		unsigned int code = length ? next[length]++ : 0, reversed = 0;
+		for (int k = 0; k < length; ++k)
+			reversed |= ((code >> k) & 1) << (length - 1 - k);
+		codes[i] = (unsigned short)reversed;
+	}
+}
+
+void PngWriter::useTwoSymbols(unsigned int* frequencies, int n)
+{
+	// a code with a single symbol would be incomplete, which inflaters reject for the code length code
+	int used = 0;
+	for (int i = 0; i < n; ++i)
+		used += frequencies[i] > 0;
+	for (int i = 0; used < 2 && i < n; ++i)
+		if (frequencies[i] == 0)
+		{
+			frequencies[i] = 1;
+			++used;
+		}
+}
+
+unsigned int PngWriter::adler32(const unsigned char* data, size_t size, unsigned int adler)
+{
+	unsigned int a = adler & 0xffff, b = adler >> 16;
+	while (size > 0)
+	{
+		// 5552 bytes is the most that can be summed before b could overflow
+		size_t n = std::min<size_t>(size, 5552);
+		for (size_t i = 0; i < n; ++i)
+		{
+			a += data[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+		data += n;
+		size -= n;
+	}
+	return (b << 16) | a;
+}
+
+unsigned int PngWriter::adler32Combine(unsigned int adlerA, unsigned int adlerB, size_t sizeB)
+{
+	// every byte of B adds A's sum once more to the second sum (the same as zlib's adler32_combine)
+	const unsigned int base = 65521;
+	unsigned int remainder = (unsigned int)(sizeB % base);
+	unsigned int a = adlerA & 0xffff;
+	unsigned int b = (unsigned int)((unsigned long long)remainder * a % base);
+	a += (adlerB & 0xffff) + base - 1;
+	b += (adlerA >> 16) + (adlerB >> 16) + base - remainder;
+	if (a >= base) a -= base;
+	if (a >= base) a -= base;
+	if (b >= base << 1) b -= base << 1;
+	if (b >= base) b -= base;
+	return (b << 16) | a;
+}
+
+unsigned int PngWriter::crc32(const unsigned char* data, size_t size, unsigned int crc)
+{
+	const unsigned int* table = tables().crc;
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+void PngWriter::put32(std::vector<unsigned char>& out, unsigned int value)
+{
+	for (int i = 0; i < 4; ++i)
+		out.push_back((unsigned char)(value >> (24 - 8 * i)));
+}
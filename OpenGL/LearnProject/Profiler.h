@@ -0,0 +1,311 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#if defined(LEARNOPENGL_PROFILE) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define PROFILER_TSC // the time stamp counter is read in a few cycles; steady_clock goes through the OS
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// CPU profiling zones. PROFILE_ZONE("name") times the rest of the enclosing scope; PROFILE_BEGIN(zone, "name")
+// and PROFILE_END(zone) time a stretch of code that isn't a scope of its own. Names must be string literals:
+// only the pointer is stored. Every thread records into buffers of its own, so a zone costs two counter reads
+// and one store, without locks or atomic read-modify-writes; Profiler::writeChromeTrace writes everything
+// recorded so far as a Chrome trace, for chrome://tracing or ui.perfetto.dev. A thread keeps at most
+// maxZonesPerThread zones (24 MB); later ones are only counted, see droppedZones. Only built in when
+// LEARNOPENGL_PROFILE is defined; otherwise the macros expand to nothing and writeChromeTrace reports the error.
+#ifdef LEARNOPENGL_PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)("" name "")
+#define PROFILE_BEGIN(zone, name) Profiler::Zone zone("" name "")
+#define PROFILE_END(zone) zone.end()
+#define PROFILE_THREAD(name) Profiler::nameThread("" name "")
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_BEGIN(zone, name) ((void)0)
+#define PROFILE_END(zone) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
+
+class Profiler
+{
+public:
+#ifdef LEARNOPENGL_PROFILE
+	class Zone
+	{
+	public:
+		explicit Zone(const char* name) : name(name), begin(ticks()) {}
+		~Zone() { end(); }
+		void end()
+		{
+			if (name != NULL)
+				record(name, begin, ticks());
+			name = NULL;
+		}
+	private:
+		const char* name;
+		uint64_t begin;
+	};
+
+	// the name shown for the calling thread instead of its number
+	static void nameThread(const char* name) { local()->name.store(name, std::memory_order_release); }
+#endif
+
+	// while other threads keep recording; zones still open aren't in it
+	static bool writeChromeTrace(const char* path);
+	static size_t zoneCount();
+	// zones that ended after their thread had recorded maxZonesPerThread, and so aren't in the trace
+	static size_t droppedZones();
+	static const size_t maxZonesPerThread = 256 * 4096;
+
+private:
+#ifdef LEARNOPENGL_PROFILE
+	struct Event
+	{
+		const char* name;
+		uint64_t begin, end; // ticks
+	};
+	struct Chunk
+	{
+		static const size_t capacity = 4096;
+		Event events[capacity];
+		std::atomic<size_t> count; // published after the event is written, read by the exporter
+		std::atomic<Chunk*> next;
+		Chunk() : count(0), next(NULL) {}
+	};
+	static const size_t maxChunksPerThread = maxZonesPerThread / Chunk::capacity;
+	// written by its thread only; the exporter follows head and the counts
+	struct ThreadBuffer
+	{
+		int id;
+		std::atomic<const char*> name;
+		Chunk* head;
+		Chunk* tail;
+		size_t chunks;
+		std::atomic<size_t> dropped; // stored by its thread, so counting stays a plain add
+	};
+	struct Registry
+	{
+		std::mutex mutex; // registering threads and exporting, never recording
+		std::vector<ThreadBuffer*> threads;
+		uint64_t startTicks;
+		std::chrono::steady_clock::time_point startTime;
+		Registry();
+		~Registry();
+	};
+
+	static uint64_t ticks()
+	{
+#ifdef PROFILER_TSC
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	static void record(const char* name, uint64_t begin, uint64_t end)
+	{
+		ThreadBuffer* buffer = local();
+		Chunk* chunk = buffer->tail;
+		size_t n = chunk->count.load(std::memory_order_relaxed);
+		if (n == Chunk::capacity)
+		{
+			if (buffer->chunks == maxChunksPerThread)
+			{
+				buffer->dropped.store(buffer->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				return;
+			}
+			++buffer->chunks;
+			chunk = new Chunk();
+			buffer->tail->next.store(chunk, std::memory_order_release);
+			buffer->tail = chunk;
+			n = 0;
+		}
+		Event& event = chunk->events[n];
+		event.name = name;
+		event.begin = begin;
+		event.end = end;
+		chunk->count.store(n + 1, std::memory_order_release);
+	}
+
+	static ThreadBuffer* local()
+	{
+		static thread_local ThreadBuffer* buffer = NULL;
+		if (buffer == NULL)
+			buffer = addThread();
+		return buffer;
+	}
+
+	static Registry& registry();
+	static ThreadBuffer* addThread();
+	static double nsPerTick();
+	static void writeName(FILE* file, const char* name);
+#endif
+};
+
+const size_t Profiler::maxZonesPerThread;
+
+#ifdef LEARNOPENGL_PROFILE
+
+Profiler::Registry::Registry()
+	: startTicks(ticks()), startTime(std::chrono::steady_clock::now())
+{
+}
+
+Profiler::Registry::~Registry()
+{
+	for (size_t i = 0; i < threads.size(); ++i)
+	{
+		for (Chunk* chunk = threads[i]->head; chunk != NULL;)
+		{
+			Chunk* next = chunk->next.load(std::memory_order_acquire);
+			delete chunk;
+			chunk = next;
+		}
+		delete threads[i];
+	}
+}
+
+Profiler::Registry& Profiler::registry()
+{
+	static Registry registry; // thread-safe initialization, and the clock starts with the first zone
+	return registry;
+}
+
+Profiler::ThreadBuffer* Profiler::addThread()
+{
+	// buffers outlive their threads, so zones of finished workers are still exported
+	ThreadBuffer* buffer = new ThreadBuffer();
+	buffer->name.store(NULL, std::memory_order_relaxed);
+	buffer->head = buffer->tail = new Chunk();
+	buffer->chunks = 1;
+	buffer->dropped.store(0, std::memory_order_relaxed);
+	Registry& all = registry();
+	std::lock_guard<std::mutex> lock(all.mutex);
+	buffer->id = (int)all.threads.size();
+	all.threads.push_back(buffer);
+	return buffer;
+}
+
+double Profiler::nsPerTick()
+{
+#ifdef PROFILER_TSC
+	// the counter runs at a fixed rate on every CPU of the last decade; measure it against steady_clock
+	// over everything recorded so far
+	Registry& all = registry();
+	uint64_t elapsedTicks = ticks() - all.startTicks;
+	double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - all.startTime).count();
+	return elapsedTicks > 0 ? elapsedNs / elapsedTicks : 0.0;
+#else
+	return 1e9 * std::chrono::steady_clock::period::num / std::chrono::steady_clock::period::den;
+#endif
+}
+
+void Profiler::writeName(FILE* file, const char* name)
+{
+	fputc('"', file);
+	for (const char* c = name; *c; ++c)
+	{
+		if (*c == '"' || *c == '\\')
+			fputc('\\', file);
+		if ((unsigned char)*c >= 0x20)
+			fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+bool Profiler::writeChromeTrace(const char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+		return false;
+	double scale = nsPerTick() / 1000.0; // trace times are in microseconds
+	size_t dropped = droppedZones();
+	Registry& all = registry();
+	std::lock_guard<std::mutex> lock(all.mutex);
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"droppedZones\":\"%llu\"},\"traceEvents\":[\n",
+		(unsigned long long)dropped);
+	bool first = true;
+	for (size_t t = 0; t < all.threads.size(); ++t)
+	{
+		const ThreadBuffer* thread = all.threads[t];
+		const char* name = thread->name.load(std::memory_order_acquire);
+		if (name != NULL)
+		{
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", thread->id);
+			writeName(file, name);
+			fprintf(file, "}}");
+			first = false;
+		}
+		for (const Chunk* chunk = thread->head; chunk != NULL; chunk = chunk->next.load(std::memory_order_acquire))
+		{
+			size_t count = chunk->count.load(std::memory_order_acquire);
+			for (size_t i = 0; i < count; ++i)
+			{
+				const Event& event = chunk->events[i];
+				fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+				writeName(file, event.name);
+				// the first zone can start a moment before the registry does
+				double begin = std::max(0.0, (double)(int64_t)(event.begin - all.startTicks) * scale);
+				fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", thread->id,
+					begin, (event.end - event.begin) * scale);
+				first = false;
+			}
+		}
+	}
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
+
+size_t Profiler::zoneCount()
+{
+	Registry& all = registry();
+	std::lock_guard<std::mutex> lock(all.mutex);
+	size_t count = 0;
+	for (size_t t = 0; t < all.threads.size(); ++t)
+		for (const Chunk* chunk = all.threads[t]->head; chunk != NULL; chunk = chunk->next.load(std::memory_order_acquire))
+			count += chunk->count.load(std::memory_order_acquire);
+	return count;
+}
+
+size_t Profiler::droppedZones()
+{
+	Registry& all = registry();
+	std::lock_guard<std::mutex> lock(all.mutex);
+	size_t count = 0;
+	for (size_t t = 0; t < all.threads.size(); ++t)
+		count += all.threads[t]->dropped.load(std::memory_order_relaxed);
+	return count;
+}
+
+#else
+
+bool Profiler::writeChromeTrace(const char* path)
+{
+	std::cout << "ERROR::PROFILER::NOT_BUILT_IN define LEARNOPENGL_PROFILE to record " << path << std::endl;
+	return false;
+}
+
+size_t Profiler::zoneCount()
+{
+	return 0;
+}
+
+size_t Profiler::droppedZones()
+{
+	return 0;
+}
+
+#endif
@@ -2,6 +2,9 @@
 
 #include <glad/glad.h>
 
+#include "GLStateCache.h"
+#include "Profiler.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -29,6 +32,7 @@ public:
 
 Shader::Shader(const char* vertexPath, const char* fragmentPath)
 {
+	PROFILE_ZONE("Shader");
 	// 1. retrieve the vertex/fragment source code from filePath
 	std::string vertexCode;
 	std::string fragmentCode;
@@ -109,35 +113,35 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 
 Shader::~Shader()
 {
-	glDeleteProgram(ID);
+	GLStateCache::deleteProgram(ID);
 }
 
 void Shader::use()
 {
-	glUseProgram(ID);
+	GLStateCache::useProgram(ID);
 }
 
 void Shader::setBool(const std::string& name, bool value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	GLStateCache::uniform1i(GLStateCache::getUniformLocation(ID, name.c_str()), (int)value);
 }
 
 void Shader::setInt(const std::string& name, int value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	GLStateCache::uniform1i(GLStateCache::getUniformLocation(ID, name.c_str()), value);
 }
 
 void Shader::setFloat(const std::string& name, float value) const
 {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	GLStateCache::uniform1f(GLStateCache::getUniformLocation(ID, name.c_str()), value);
 }
 
 void Shader::setVec3(const std::string& name, float x, float y, float z) const
 {
-	glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+	GLStateCache::uniform3f(GLStateCache::getUniformLocation(ID, name.c_str()), x, y, z);
 }
 
 void Shader::setVec4(const std::string& name, float x, float y, float z, float w) const
 {
-	glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+	GLStateCache::uniform4f(GLStateCache::getUniformLocation(ID, name.c_str()), x, y, z, w);
 }
\ No newline at end of file
@@ -0,0 +1,389 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "stb_image.h"
+#include "GLStateCache.h"
+#include "ImageResizer.h"
+#include "Profiler.h"
+#include "TextureCache.h"
+
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// limits a texture is held to when it is loaded; an image over either limit is downscaled to fit.
+// give each class of texture (UI, props, terrain, ...) its own policy
+struct TexturePolicy
+{
+	int maxSize;        // largest width or height; 0 means GL_MAX_TEXTURE_SIZE, which is always enforced
+	size_t maxBytes;    // largest level-0 size in bytes; 0 means no budget
+	ImageResizer::Filter filter;
+	int threads;        // resampler threads, 0 for every hardware thread
+	// conversions done by the decoder: premultiplied alpha (blend with GL_ONE, GL_ONE_MINUS_SRC_ALPHA),
+	// and color in linear space, stored as 16 bits per channel so the shader needs no sRGB decode
+	bool premultiplyAlpha;
+	bool linear;
+
+	TexturePolicy(int maxSize = 0, size_t maxBytes = 0, ImageResizer::Filter filter = ImageResizer::Area, int threads = 0)
+		: maxSize(maxSize), maxBytes(maxBytes), filter(filter), threads(threads), premultiplyAlpha(false), linear(false) {}
+
+	// the largest width or height the policy and the driver both allow
+	int sizeLimit() const;
+	// the size w x h has to be scaled down to; false if it already fits
+	bool fit(int w, int h, int bytesPerPixel, int* fitW, int* fitH) const;
+};
+
+class Texture
+{
+public:
+	// the texture ID
+	unsigned int ID;
+	int width, height, nrChannels;
+
+	// constructor decodes the image straight into a pixel buffer object and uploads it from there;
+	// 16-bit images (e.g. height maps) keep all 16 bits only if keep16Bit is set.
+	// images larger than the policy allows are downscaled first (use TiledTexture to keep full resolution)
+	Texture(const char* path, bool flipVertically = true, bool keep16Bit = false, const TexturePolicy& policy = TexturePolicy());
+	~Texture();
+
+	// bind the texture to the given texture unit
+	void bind(unsigned int unit) const;
+
+	// textures loaded after this are looked up in cache first, and added to it on a miss; NULL turns caching off
+	static void useCache(TextureCache* cache);
+
+private:
+	static TextureCache* cache;
+	// what level 0 was created with, so the texture can be written to the cache
+	GLenum storageInternalFormat, storageFormat, storageType;
+
+	// images that decode to more bytes than this are uploaded a strip of rows at a time
+	// instead, so the whole decoded image never has to exist in memory
+	static const size_t streamThreshold = 64 * 1024 * 1024;
+
+	static GLenum formatFor(int channels);
+	static GLenum internalFormat16For(int channels);
+	// decode path and upload it, following the steps below
+	void load(const char* path, bool flipVertically, bool keep16Bit, const TexturePolicy& policy);
+	// upload every mip level of a cache entry; false if there is no usable entry for key
+	bool loadCached(const std::string& key);
+	// generate and bind the texture and allocate level 0, filled from pixels (may be NULL)
+	void createStorage(GLenum internalFormat, GLenum format, GLenum type, const void* pixels);
+	// HDR images keep their range as half floats; oversized ones are resampled as floats first
+	void loadHdr(const char* path, bool flipVertically, const TexturePolicy& policy);
+	// decode an 8-bit image and resample it to fitW x fitH before uploading it
+	void loadDownscaled(const char* path, bool flipVertically, const stbi_layout& layout, int fitW, int fitH, const TexturePolicy& policy);
+	// stbi_load_rows callback: copy one decoded strip into the bound texture
+	static void uploadRows(void* user, int y0, int count, const stbi_uc* rows, int stride);
+};
+
+int TexturePolicy::sizeLimit() const
+{
+	GLint limit = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &limit);
+	return maxSize > 0 && maxSize < limit ? maxSize : limit;
+}
+
+bool TexturePolicy::fit(int w, int h, int bytesPerPixel, int* fitW, int* fitH) const
+{
+	int limit = sizeLimit();
+	double scale = (double)std::max(w, h) / limit;
+	double bytes = (double)w * h * bytesPerPixel;
+	if (maxBytes > 0 && bytes > (double)maxBytes)
+		scale = std::max(scale, std::sqrt(bytes / (double)maxBytes));
+	if (scale <= 1.0)
+		return false;
+	// round down so neither limit is exceeded, but keep at least one pixel in each direction
+	*fitW = std::max(1, std::min(limit, (int)(w / scale)));
+	*fitH = std::max(1, std::min(limit, (int)(h / scale)));
+	return true;
+}
+
+TextureCache* Texture::cache = NULL;
+
+Texture::Texture(const char* path, bool flipVertically, bool keep16Bit, const TexturePolicy& policy)
+	: ID(0), width(0), height(0), nrChannels(0), storageInternalFormat(0), storageFormat(0), storageType(0)
+{
+	PROFILE_ZONE("Texture");
+	std::string key;
+	if (cache != NULL)
+	{
+		// everything that changes the uploaded pixels goes into the key, including the driver's size limit
+		std::ostringstream options;
+		options << "flip=" << flipVertically << " wide=" << keep16Bit << " limit=" << policy.sizeLimit()
+			<< " bytes=" << policy.maxBytes << " filter=" << policy.filter
+			<< " premultiply=" << policy.premultiplyAlpha << " linear=" << policy.linear;
+		key = cache->key(path, options.str());
+		if (!key.empty() && loadCached(key))
+			return;
+	}
+
+	load(path, flipVertically, keep16Bit, policy);
+
+	if (cache != NULL && !key.empty() && ID != 0)
+	{
+		GLStateCache::bindTexture(GL_TEXTURE_2D, ID);
+		cache->store(key, storageInternalFormat, storageFormat, storageType, width, height);
+	}
+}
+
+void Texture::load(const char* path, bool flipVertically, bool keep16Bit, const TexturePolicy& policy)
+{
+	PROFILE_ZONE("decode texture");
+	if (stbi_is_hdr(path))
+	{
+		loadHdr(path, flipVertically, policy);
+		return;
+	}
+
+	// without keep16Bit a 16-bit PNG is narrowed to 8 bits while it is decoded; linear color always takes 16
+	bool wide = (keep16Bit && stbi_is_16_bit(path)) || policy.linear;
+
+	// 1. ask stb_image how big the decoded image will be
+	stbi_layout layout;
+	if (!stbi_info_layout(path, 0, wide ? 2 : 1, &layout))
+	{
+		std::cout << "ERROR::TEXTURE::INFO_FAILED " << path << "\n" << stbi_failure_reason() << std::endl;
+		return;
+	}
+	GLenum format = formatFor(layout.channels);
+
+	int fitW, fitH;
+	if (policy.fit(layout.w, layout.h, layout.channels * (wide ? 2 : 1), &fitW, &fitH))
+	{
+		// 2. (oversized images) the resampler works on 8-bit pixels, so a downscaled image loses keep16Bit
+		// and is linearized by the sampler instead (see loadDownscaled)
+		loadDownscaled(path, flipVertically, layout, fitW, fitH, policy);
+		return;
+	}
+
+	if (!wide && !policy.premultiplyAlpha && layout.size > streamThreshold)
+	{
+		// 2. (large images) allocate the texture first and let the decoder fill it strip by strip
+		width = layout.w;
+		height = layout.h;
+		nrChannels = layout.channels;
+		createStorage(format, format, GL_UNSIGNED_BYTE, NULL);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // strips are tightly packed, rows need not start on 4-byte boundaries
+		stbi_load_params params = {};
+		params.flip_vertically = flipVertically;
+		bool loaded = stbi_load_rows_with_params(path, &params, uploadRows, this, &width, &height, &nrChannels) != 0;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		if (loaded)
+		{
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
+		else
+		{
+			std::cout << "ERROR::TEXTURE::LOAD_FAILED " << path << "\n" << stbi_failure_reason() << std::endl;
+			GLStateCache::deleteTextures(1, &ID);
+			ID = 0;
+		}
+		return;
+	}
+
+	// rows start on 4-byte boundaries, which is what GL_UNPACK_ALIGNMENT expects by default
+	int stride = (int)((layout.row_bytes + 3) & ~(size_t)3);
+	GLsizeiptr size = (GLsizeiptr)stride * layout.h;
+
+	// 2. decode into a mapped pixel buffer object instead of a malloc'd buffer; the settings go with the call,
+	// so textures can be loaded on several threads at once
+	stbi_load_params params = {};
+	params.bits_per_channel = wide ? 16 : 8;
+	params.flip_vertically = flipVertically; // OpenGL expects the 0.0 coordinate on the y-axis to be on the bottom side of the image
+	params.stride_in_bytes = stride;
+	params.premultiply_alpha = policy.premultiplyAlpha;
+	params.srgb_to_linear = policy.linear;
+	unsigned int PBO;
+	glGenBuffers(1, &PBO);
+	GLStateCache::bindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	void* pixels = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	const char* error = NULL;
+	if (pixels == NULL)
+		error = "glMapBufferRange failed";
+	else if (!stbi_load_with_params_into(path, &params, pixels, (size_t)size, &width, &height, &nrChannels))
+		error = stbi_failure_reason();
+	// the buffer contents are undefined if unmapping fails (e.g. the display mode changed)
+	if (pixels != NULL && glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE && error == NULL)
+		error = "glUnmapBuffer failed";
+
+	if (error == NULL)
+	{
+		// 3. create the texture; with a pixel unpack buffer bound, the data argument is an offset into it
+		if (wide)
+			createStorage(internalFormat16For(layout.channels), format, GL_UNSIGNED_SHORT, (void*)0);
+		else
+			createStorage(format, format, GL_UNSIGNED_BYTE, (void*)0);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	else
+	{
+		std::cout << "ERROR::TEXTURE::LOAD_FAILED " << path << "\n" << error << std::endl;
+	}
+
+	// the driver keeps the buffer alive until the upload has been consumed
+	GLStateCache::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	GLStateCache::deleteBuffers(1, &PBO);
+}
+
+Texture::~Texture()
+{
+	GLStateCache::deleteTextures(1, &ID);
+}
+
+void Texture::bind(unsigned int unit) const
+{
+	GLStateCache::bindTextureUnit(unit, GL_TEXTURE_2D, ID);
+}
+
+void Texture::useCache(TextureCache* cache)
+{
+	Texture::cache = cache;
+}
+
+bool Texture::loadCached(const std::string& key)
+{
+	PROFILE_ZONE("load cached texture");
+	TextureCache::Entry entry;
+	if (!cache->open(key, entry))
+		return false;
+	width = entry.width;
+	height = entry.height;
+	nrChannels = entry.format == GL_RED ? 1 : entry.format == GL_RG ? 2 : entry.format == GL_RGB ? 3 : 4;
+	// the entry already holds every mip level, so there is nothing to generate
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	createStorage(entry.internalFormat, entry.format, entry.type, entry.level(0));
+	for (int l = 1; l < entry.levels; ++l)
+		glTexImage2D(GL_TEXTURE_2D, l, entry.internalFormat, std::max(1, width >> l), std::max(1, height >> l), 0, entry.format, entry.type, entry.level(l));
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	return true;
+}
+
+GLenum Texture::formatFor(int channels)
+{
+	return channels == 1 ? GL_RED
+		: channels == 2 ? GL_RG
+		: channels == 3 ? GL_RGB
+		: GL_RGBA;
+}
+
+GLenum Texture::internalFormat16For(int channels)
+{
+	return channels == 1 ? GL_R16
+		: channels == 2 ? GL_RG16
+		: channels == 3 ? GL_RGB16
+		: GL_RGBA16;
+}
+
+void Texture::loadHdr(const char* path, bool flipVertically, const TexturePolicy& policy)
+{
+	// GL_RGB16F takes half the memory of GL_RGB32F, and stb_image converts straight from the file's RGBE pixels
+	stbi_load_params params = {};
+	params.desired_channels = 3;
+	params.flip_vertically = flipVertically;
+	int w, h, n, fitW, fitH;
+	if (stbi_info(path, &w, &h, &n) && policy.fit(w, h, 3 * 2, &fitW, &fitH))
+	{
+		// the resampler needs full floats, which the driver narrows to half floats on upload
+		float* data = stbi_loadf_with_params(path, &params, &w, &h, &n);
+		if (data == NULL)
+		{
+			std::cout << "ERROR::TEXTURE::LOAD_FAILED " << path << "\n" << stbi_failure_reason() << std::endl;
+			return;
+		}
+		std::vector<float> pixels((size_t)fitW * fitH * 3);
+		ImageResizer::resize(data, w, h, w * 3, &pixels[0], fitW, fitH, fitW * 3, 3, policy.filter, policy.threads);
+		stbi_image_free(data);
+		width = fitW;
+		height = fitH;
+		nrChannels = n;
+		createStorage(GL_RGB16F, GL_RGB, GL_FLOAT, &pixels[0]); // rows are 12 * width bytes, always 4-byte aligned
+		storageType = GL_HALF_FLOAT; // the cache reads level 0 back as the unscaled path stores it
+		glGenerateMipmap(GL_TEXTURE_2D);
+		return;
+	}
+	stbi_us* data = stbi_loadf16_with_params(path, &params, &width, &height, &nrChannels);
+	if (data == NULL)
+	{
+		std::cout << "ERROR::TEXTURE::LOAD_FAILED " << path << "\n" << stbi_failure_reason() << std::endl;
+		return;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 2); // rows are 6 * width bytes
+	createStorage(GL_RGB16F, GL_RGB, GL_HALF_FLOAT, data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	stbi_image_free(data);
+}
+
+void Texture::loadDownscaled(const char* path, bool flipVertically, const stbi_layout& layout, int fitW, int fitH, const TexturePolicy& policy)
+{
+	int w = layout.w, h = layout.h, n, channels = layout.channels;
+	stbi_uc* data = NULL;
+	// a JPEG can be decoded at 1/2, 1/4 or 1/8 size for much less than a full decode; take the smallest
+	// of those that is still no smaller than the target, and let the resampler do the rest
+	int denom = 8;
+	while (denom > 1 && ((w + denom - 1) / denom < fitW || (h + denom - 1) / denom < fitH))
+		denom /= 2;
+	if (denom > 1)
+	{
+		stbi_load_params params = {};
+		params.desired_channels = channels;
+		params.flip_vertically = flipVertically;
+		data = stbi_load_jpeg_scaled_with_params(path, &params, denom, &w, &h, &n); // NULL if it isn't a JPEG
+	}
+	if (data == NULL)
+	{
+		stbi_load_params params = {};
+		params.desired_channels = channels;
+		params.flip_vertically = flipVertically;
+		params.premultiply_alpha = policy.premultiplyAlpha; // before resampling, so transparent texels don't bleed (JPEGs have no alpha)
+		data = (stbi_uc*)stbi_load_with_params(path, &params, &w, &h, &n);
+	}
+	if (data == NULL)
+	{
+		std::cout << "ERROR::TEXTURE::LOAD_FAILED " << path << "\n" << stbi_failure_reason() << std::endl;
+		return;
+	}
+
+	std::vector<unsigned char> pixels((size_t)fitW * fitH * channels);
+	ImageResizer::resize(data, w, h, w * channels, &pixels[0], fitW, fitH, fitW * channels, channels, policy.filter, policy.threads);
+	stbi_image_free(data);
+
+	width = fitW;
+	height = fitH;
+	nrChannels = channels;
+	// the resampled pixels are still 8-bit sRGB; for linear color, sRGB storage has the sampler convert them
+	GLenum internalFormat = formatFor(channels);
+	if (policy.linear && channels >= 3)
+		internalFormat = channels == 3 ? GL_SRGB8 : GL_SRGB8_ALPHA8;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // rows are tightly packed
+	createStorage(internalFormat, formatFor(channels), GL_UNSIGNED_BYTE, &pixels[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+void Texture::createStorage(GLenum internalFormat, GLenum format, GLenum type, const void* pixels)
+{
+	glGenTextures(1, &ID);
+	GLStateCache::bindTexture(GL_TEXTURE_2D, ID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, pixels);
+	storageInternalFormat = internalFormat;
+	storageFormat = format;
+	storageType = type;
+}
+
+void Texture::uploadRows(void* user, int y0, int count, const stbi_uc* rows, int stride)
+{
+	Texture* texture = (Texture*)user;
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y0, texture->width, count, formatFor(texture->nrChannels), GL_UNSIGNED_BYTE, rows);
+	(void)stride; // always width * nrChannels: strips are tightly packed
+}
@@ -0,0 +1,404 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h> // _get_osfhandle
+// declared here rather than through windows.h, which would have to be included before glad
+#ifdef _WIN64
+typedef unsigned __int64 TextureCacheWinSize;
+#else
+typedef unsigned long TextureCacheWinSize;
+#endif
+extern "C" __declspec(dllimport) void* __stdcall CreateFileMappingA(void* hFile, struct _SECURITY_ATTRIBUTES* attributes, unsigned long protect, unsigned long max_size_high, unsigned long max_size_low, const char* name);
+extern "C" __declspec(dllimport) void* __stdcall MapViewOfFile(void* mapping, unsigned long access, unsigned long offset_high, unsigned long offset_low, TextureCacheWinSize bytes);
+extern "C" __declspec(dllimport) int __stdcall UnmapViewOfFile(const void* base);
+extern "C" __declspec(dllimport) int __stdcall CloseHandle(void* handle);
+#else
+#include <sys/mman.h>
+#endif
+
+// keeps the upload-ready pixels of every mip level of decoded textures in a directory, one file per texture.
+// an entry is named after a hash of the source file's contents and the load options, so an edited image
+// or a different load gets a new entry; entries are memory-mapped and uploaded straight from the mapping.
+// the directory is kept under maxBytes by deleting the least recently used entries
+class TextureCache
+{
+public:
+	// a mapped entry; the pixels stay valid until close() or the destructor
+	class Entry
+	{
+	public:
+		int width, height, levels;
+		GLenum internalFormat, format, type;
+
+		Entry();
+		~Entry();
+		// the pixels of mip level i, tightly packed (GL_UNPACK_ALIGNMENT 1)
+		const unsigned char* level(int i) const;
+		void close();
+
+	private:
+		friend class TextureCache;
+		void* view;
+		size_t viewSize;
+	};
+
+	TextureCache(const char* directory, size_t maxBytes);
+
+	// the entry name for path loaded with options (any string describing the load); empty if path can't be read
+	std::string key(const char* path, const std::string& options) const;
+	// map the entry for key; false if it is missing or corrupt. a corrupt entry is deleted, so it is rebuilt
+	bool open(const std::string& key, Entry& entry);
+	// read back every mip level of the texture bound to GL_TEXTURE_2D and write it as the entry for key
+	bool store(const std::string& key, GLenum internalFormat, GLenum format, GLenum type, int width, int height);
+
+private:
+	// bumped whenever the layout below changes; older entries then fail to open and are rebuilt
+	static const uint32_t version = 1;
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version, levels;
+		int32_t width, height;
+		uint32_t internalFormat, format, type, reserved;
+		uint64_t dataSize;
+		uint64_t checksum; // of the dataSize bytes after the header
+	};
+
+	std::filesystem::path directory;
+	size_t maxBytes;
+
+	std::filesystem::path entryPath(const std::string& key) const;
+	// fopen, without MSVC's deprecation error
+	static FILE* openFile(const char* path, const char* mode);
+	// bytes per pixel of tightly packed format/type pixels, 0 if unknown
+	static size_t pixelSize(GLenum format, GLenum type);
+	static int levelCount(int width, int height);
+	// 64-bit hash, fed in any number of pieces; the result only depends on the bytes
+	struct Hash
+	{
+		uint64_t h;
+		unsigned char tail[8];
+		size_t tailSize;
+		uint64_t length;
+		explicit Hash(uint64_t seed = 0);
+		void add(const void* data, size_t size);
+		uint64_t finish();
+		static uint64_t mix(uint64_t h, uint64_t word);
+	};
+	// delete least recently used entries until the directory holds at most maxBytes
+	void evict();
+};
+
+TextureCache::Entry::Entry()
+	: width(0), height(0), levels(0), internalFormat(0), format(0), type(0), view(NULL), viewSize(0)
+{
+}
+
+TextureCache::Entry::~Entry()
+{
+	close();
+}
+
+const unsigned char* TextureCache::Entry::level(int i) const
+{
+	const unsigned char* pixels = (const unsigned char*)view + sizeof(Header);
+	size_t bytes = pixelSize(format, type);
+	for (int l = 0; l < i; ++l)
+		pixels += (size_t)std::max(1, width >> l) * std::max(1, height >> l) * bytes;
+	return pixels;
+}
+
+void TextureCache::Entry::close()
+{
+	if (view == NULL)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(view);
+#else
+	munmap(view, viewSize);
+#endif
+	view = NULL;
+	viewSize = 0;
+}
+
+TextureCache::TextureCache(const char* directory, size_t maxBytes)
+	: directory(directory), maxBytes(maxBytes)
+{
+	std::error_code error;
+	std::filesystem::create_directories(this->directory, error);
+	if (error)
+		std::cout << "ERROR::TEXTURE_CACHE::CREATE_FAILED " << directory << "\n" << error.message() << std::endl;
+}
+
+std::string TextureCache::key(const char* path, const std::string& options) const
+{
+	FILE* f = openFile(path, "rb");
+	if (f == NULL)
+		return std::string();
+	Hash optionsHash;
+	optionsHash.add(options.data(), options.size());
+	Hash contents(optionsHash.finish());
+	std::vector<unsigned char> block(1 << 20);
+	size_t n;
+	while ((n = fread(&block[0], 1, block.size(), f)) > 0)
+		contents.add(&block[0], n);
+	bool failed = ferror(f) != 0;
+	fclose(f);
+	if (failed)
+		return std::string();
+
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)contents.finish());
+	return name;
+}
+
+bool TextureCache::open(const std::string& key, Entry& entry)
+{
+	PROFILE_ZONE("open cache entry");
+	entry.close();
+	std::filesystem::path path = entryPath(key);
+	std::error_code error;
+	uintmax_t size = std::filesystem::file_size(path, error);
+	if (error)
+		return false; // missing: not an error, just a miss
+	if (size < sizeof(Header))
+	{
+		std::filesystem::remove(path, error);
+		return false;
+	}
+
+	FILE* f = openFile(path.string().c_str(), "rb");
+	if (f == NULL)
+		return false;
+#ifdef _WIN32
+	void* mapping = CreateFileMappingA((void*)_get_osfhandle(_fileno(f)), NULL, 0x02 /* PAGE_READONLY */, 0, 0, NULL);
+	void* view = NULL;
+	if (mapping != NULL)
+	{
+		view = MapViewOfFile(mapping, 0x0004 /* FILE_MAP_READ */, 0, 0, 0);
+		CloseHandle(mapping); // the view keeps the mapping alive
+	}
+#else
+	void* view = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+	if (view == MAP_FAILED)
+		view = NULL;
+#endif
+	fclose(f); // so does the file
+	if (view == NULL)
+		return false;
+	entry.view = view;
+	entry.viewSize = (size_t)size;
+
+	// check everything before a single byte goes to the driver: a torn or truncated write must not upload garbage
+	Header header;
+	memcpy(&header, view, sizeof(header));
+	bool valid = memcmp(header.magic, "TEXCACHE", 8) == 0 && header.version == version
+		&& header.width > 0 && header.height > 0 && header.levels == (uint32_t)levelCount(header.width, header.height)
+		&& pixelSize(header.format, header.type) != 0 && header.dataSize == size - sizeof(Header);
+	if (valid)
+	{
+		size_t expected = 0;
+		for (uint32_t l = 0; l < header.levels; ++l)
+			expected += (size_t)std::max(1, header.width >> l) * std::max(1, header.height >> l) * pixelSize(header.format, header.type);
+		Hash checksum;
+		checksum.add((const unsigned char*)view + sizeof(Header), (size_t)header.dataSize);
+		valid = expected == header.dataSize && checksum.finish() == header.checksum;
+	}
+	if (!valid)
+	{
+		std::cout << "ERROR::TEXTURE_CACHE::CORRUPT_ENTRY " << path.string() << std::endl;
+		entry.close();
+		std::filesystem::remove(path, error);
+		return false;
+	}
+
+	entry.width = header.width;
+	entry.height = header.height;
+	entry.levels = (int)header.levels;
+	entry.internalFormat = header.internalFormat;
+	entry.format = header.format;
+	entry.type = header.type;
+	// the modification time doubles as the last use, which is what eviction sorts by
+	std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+	return true;
+}
+
+bool TextureCache::store(const std::string& key, GLenum internalFormat, GLenum format, GLenum type, int width, int height)
+{
+	PROFILE_ZONE("store cache entry");
+	size_t bytes = pixelSize(format, type);
+	if (key.empty() || bytes == 0)
+		return false;
+
+	Header header = {};
+	memcpy(header.magic, "TEXCACHE", 8);
+	header.version = version;
+	header.levels = (uint32_t)levelCount(width, height);
+	header.width = width;
+	header.height = height;
+	header.internalFormat = internalFormat;
+	header.format = format;
+	header.type = type;
+
+	std::vector<unsigned char> data;
+	for (uint32_t l = 0; l < header.levels; ++l)
+		data.resize(data.size() + (size_t)std::max(1, width >> l) * std::max(1, height >> l) * bytes);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	size_t offset = 0;
+	for (uint32_t l = 0; l < header.levels; ++l)
+	{
+		glGetTexImage(GL_TEXTURE_2D, (GLint)l, format, type, &data[offset]);
+		offset += (size_t)std::max(1, width >> l) * std::max(1, height >> l) * bytes;
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	header.dataSize = data.size();
+	Hash checksum;
+	checksum.add(&data[0], data.size());
+	header.checksum = checksum.finish();
+
+	// write a temporary file and rename it into place, so a crash never leaves a half-written entry behind
+	std::filesystem::path path = entryPath(key);
+	std::filesystem::path temporary = path;
+	temporary += ".tmp";
+	FILE* f = openFile(temporary.string().c_str(), "wb");
+	if (f == NULL)
+		return false;
+	bool written = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(&data[0], 1, data.size(), f) == data.size();
+	written = fclose(f) == 0 && written;
+	std::error_code error;
+	if (written)
+		std::filesystem::rename(temporary, path, error);
+	if (!written || error)
+	{
+		std::cout << "ERROR::TEXTURE_CACHE::WRITE_FAILED " << path.string() << std::endl;
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	evict();
+	return true;
+}
+
+std::filesystem::path TextureCache::entryPath(const std::string& key) const
+{
+	return directory / (key + ".tex");
+}
+
+FILE* TextureCache::openFile(const char* path, const char* mode)
+{
+#ifdef _MSC_VER
+	FILE* f = NULL;
+	return fopen_s(&f, path, mode) == 0 ? f : NULL;
+#else
+	return fopen(path, mode);
+#endif
+}
+
+size_t TextureCache::pixelSize(GLenum format, GLenum type)
+{
+	size_t channels = format == GL_RED ? 1 : format == GL_RG ? 2 : format == GL_RGB ? 3 : format == GL_RGBA ? 4 : 0;
+	size_t size = type == GL_UNSIGNED_BYTE ? 1 : (type == GL_UNSIGNED_SHORT || type == GL_HALF_FLOAT) ? 2 : type == GL_FLOAT ? 4 : 0;
+	return channels * size;
+}
+
+int TextureCache::levelCount(int width, int height)
+{
+	int levels = 1;
+	for (int size = std::max(width, height); size > 1; size >>= 1)
+		++levels;
+	return levels;
+}
+
+void TextureCache::evict()
+{
+	struct Item
+	{
+		std::filesystem::file_time_type used;
+		uintmax_t size;
+		std::filesystem::path path;
+	};
+	std::vector<Item> items;
+	uintmax_t total = 0;
+	std::error_code error;
+	for (std::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error))
+	{
+		if (it->path().extension() != ".tex")
+			continue;
+		Item item;
+		item.used = it->last_write_time(error);
+		item.size = it->file_size(error);
+		item.path = it->path();
+		if (error)
+			continue;
+		items.push_back(item);
+		total += item.size;
+	}
+	if (total <= maxBytes)
+		return;
+	std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.used < b.used; });
+	for (size_t i = 0; i < items.size() && total > maxBytes; ++i)
+	{
+		// on Windows a mapped entry can't be deleted; it stays until a later store tries again
+		if (std::filesystem::remove(items[i].path, error))
+			total -= items[i].size;
+	}
+}
+
+TextureCache::Hash::Hash(uint64_t seed)
+	: h(seed ^ 0xcbf29ce484222325ull), tailSize(0), length(0)
+{
+}
+
+void TextureCache::Hash::add(const void* data, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	length += size;
+	while (tailSize > 0 && tailSize < 8 && size > 0)
+	{
+		tail[tailSize++] = *p++;
+		--size;
+	}
+	if (tailSize == 8)
+	{
+		uint64_t word;
+		memcpy(&word, tail, 8);
+		h = mix(h, word);
+		tailSize = 0;
+	}
+	for (; size >= 8; p += 8, size -= 8)
+	{
+		uint64_t word;
+		memcpy(&word, p, 8);
+		h = mix(h, word);
+	}
+	memcpy(tail + tailSize, p, size);
+	tailSize += size;
+}
+
+uint64_t TextureCache::Hash::finish()
+{
+	uint64_t word = 0;
+	memcpy(&word, tail, tailSize);
+	return mix(mix(h, word), length);
+}
+
+uint64_t TextureCache::Hash::mix(uint64_t h, uint64_t word)
+{
+	h ^= word;
+	h *= 0x9e3779b97f4a7c15ull;
+	return h ^ (h >> 32);
+}
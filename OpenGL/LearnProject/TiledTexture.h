@@ -0,0 +1,136 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "stb_image.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+class TiledTexture
+{
+public:
+	// one texture covering the texels [x, x + width) x [y, y + height) of the image; with flipVertically,
+	// y = 0 is the bottom row, as it is for a single texture
+	struct Tile
+	{
+		unsigned int ID;
+		int x, y, width, height;
+	};
+
+	std::vector<Tile> tiles;
+	int width, height, nrChannels;
+
+	// constructor keeps the image at full resolution by splitting it into tiles no larger than tileSize
+	// (0 means GL_MAX_TEXTURE_SIZE), each its own texture. the image is streamed a strip of rows at a time
+	// into every tile the strip crosses, so the whole decoded image never has to exist in memory
+	TiledTexture(const char* path, bool flipVertically = true, int tileSize = 0);
+	~TiledTexture();
+
+	// bind the given tile to the given texture unit
+	void bind(size_t tile, unsigned int unit) const;
+
+private:
+	static GLenum formatFor(int channels);
+	// stbi_load_rows callback: copy one decoded strip into the tiles it overlaps
+	static void uploadRows(void* user, int y0, int count, const stbi_uc* rows, int stride);
+};
+
+TiledTexture::TiledTexture(const char* path, bool flipVertically, int tileSize)
+	: width(0), height(0), nrChannels(0)
+{
+	stbi_layout layout;
+	if (!stbi_info_layout(path, 0, 1, &layout))
+	{
+		std::cout << "ERROR::TILED_TEXTURE::INFO_FAILED " << path << "\n" << stbi_failure_reason() << std::endl;
+		return;
+	}
+	width = layout.w;
+	height = layout.h;
+	nrChannels = layout.channels;
+
+	GLint limit = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &limit);
+	if (tileSize <= 0 || tileSize > limit)
+		tileSize = limit;
+
+	// 1. allocate every tile up front; the last row and column of tiles take whatever is left over
+	GLenum format = formatFor(nrChannels);
+	for (int y = 0; y < height; y += tileSize)
+	{
+		for (int x = 0; x < width; x += tileSize)
+		{
+			Tile tile = { 0, x, y, std::min(tileSize, width - x), std::min(tileSize, height - y) };
+			glGenTextures(1, &tile.ID);
+			GLStateCache::bindTexture(GL_TEXTURE_2D, tile.ID);
+			// clamp, so linear filtering at a tile's border does not wrap around to the tile's other side
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexImage2D(GL_TEXTURE_2D, 0, format, tile.width, tile.height, 0, format, GL_UNSIGNED_BYTE, NULL);
+			tiles.push_back(tile);
+		}
+	}
+
+	// 2. stream the image into the tiles
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // strips are tightly packed
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, width); // a tile reads a window of each strip row
+	stbi_load_params params = {};
+	params.flip_vertically = flipVertically;
+	bool loaded = stbi_load_rows_with_params(path, &params, uploadRows, this, &width, &height, &nrChannels) != 0;
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	if (!loaded)
+	{
+		std::cout << "ERROR::TILED_TEXTURE::LOAD_FAILED " << path << "\n" << stbi_failure_reason() << std::endl;
+		for (size_t i = 0; i < tiles.size(); ++i)
+			GLStateCache::deleteTextures(1, &tiles[i].ID);
+		tiles.clear();
+		return;
+	}
+	for (size_t i = 0; i < tiles.size(); ++i)
+	{
+		GLStateCache::bindTexture(GL_TEXTURE_2D, tiles[i].ID);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+}
+
+TiledTexture::~TiledTexture()
+{
+	for (size_t i = 0; i < tiles.size(); ++i)
+		GLStateCache::deleteTextures(1, &tiles[i].ID);
+}
+
+void TiledTexture::bind(size_t tile, unsigned int unit) const
+{
+	GLStateCache::bindTextureUnit(unit, GL_TEXTURE_2D, tiles[tile].ID);
+}
+
+GLenum TiledTexture::formatFor(int channels)
+{
+	return channels == 1 ? GL_RED
+		: channels == 2 ? GL_RG
+		: channels == 3 ? GL_RGB
+		: GL_RGBA;
+}
+
+void TiledTexture::uploadRows(void* user, int y0, int count, const stbi_uc* rows, int stride)
+{
+	TiledTexture* texture = (TiledTexture*)user;
+	GLenum format = formatFor(texture->nrChannels);
+	for (size_t i = 0; i < texture->tiles.size(); ++i)
+	{
+		const Tile& tile = texture->tiles[i];
+		int top = std::max(y0, tile.y);
+		int bottom = std::min(y0 + count, tile.y + tile.height);
+		if (top >= bottom)
+			continue;
+		const stbi_uc* window = rows + (size_t)(top - y0) * stride + (size_t)tile.x * texture->nrChannels;
+		GLStateCache::bindTexture(GL_TEXTURE_2D, tile.ID);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, top - tile.y, tile.width, bottom - top, format, GL_UNSIGNED_BYTE, window);
+	}
+}
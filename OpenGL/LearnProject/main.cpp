@@ -1,19 +1,31 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 
 #include <glad/glad.h> // must be included before glfw3.h
 #include <glfw3.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
+#include "FrameCapture.h"
+#include "GLStateCache.h"
+#include "GpuTimer.h"
+#include "HeadlessContext.h"
+#include "Profiler.h"
 #include "Shader.h"
+#include "Texture.h"
+
+#define STB_IMAGE_IMPLEMENTATION // after Texture.h, which includes the stb_image declarations
+#include "stb_image.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
+double elapsedSeconds();
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// drop GL state calls that would not change anything; false issues every call, for comparing the counts
+const bool SHADOW_GL_STATE = true;
 
 // stores how much we're seeing of either texture
 float mixValue = 0.2f;
@@ -37,52 +49,127 @@ const char* fragmentShaderSource =
 "   FragColor = vec4(ourColor, 1.0);\n"
 "}\0";
 
-int main()
+int main(int argc, char* argv[])
 {
 	printf("Hello World!\n");
+	PROFILE_THREAD("main");
+	PROFILE_BEGIN(startup, "startup");
+
+	// --headless[=WIDTHxHEIGHT] renders into an offscreen framebuffer instead of a window (see HeadlessContext.h),
+	// --frames N stops after N frames; headless runs stop after 600 unless told otherwise,
+	// --capture PATH writes every frame to PATH (see FrameCapture.h for the formats),
+	// --gpu-times FILE writes the GPU time of each pass over the last frames to FILE as CSV,
+	// --profile FILE writes the CPU profiling zones of the run to FILE as a Chrome trace (see Profiler.h)
+	bool headless = false;
+	int width = SCR_WIDTH, height = SCR_HEIGHT;
+	long long frames = -1;
+	const char* capturePath = NULL;
+	const char* gpuTimesPath = NULL;
+	const char* profilePath = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], "--headless", 10) == 0 && (argv[i][10] == '\0' || argv[i][10] == '='))
+		{
+			headless = true;
+			if (argv[i][10] == '=' && (sscanf(argv[i] + 11, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0))
+			{
+				std::cout << "ERROR::MAIN::BAD_SIZE " << argv[i] + 11 << " (expected WIDTHxHEIGHT)" << std::endl;
+				return -1;
+			}
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			frames = atoll(argv[++i]);
+		else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+			capturePath = argv[++i];
+		else if (strcmp(argv[i], "--gpu-times") == 0 && i + 1 < argc)
+			gpuTimesPath = argv[++i];
+		else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+			profilePath = argv[++i];
+		else
+		{
+			std::cout << "usage: " << argv[0] << " [--headless[=WIDTHxHEIGHT]] [--frames N] [--capture PATH] [--gpu-times FILE] [--profile FILE]" << std::endl;
+			return -1;
+		}
+	}
+	if (headless && frames < 0)
+		frames = 600;
 
-	// Initialize GLFW
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	//glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // for Mac OS X
-
-	// Create a window object
-	GLFWwindow* window = glfwCreateWindow(
-		SCR_WIDTH,			// width
-		SCR_HEIGHT,			// height
-		"LearnOpenGL",	// title
-		NULL,			// monitor
-		NULL			// share
-	);
-	if (window == NULL)
+	PROFILE_BEGIN(createContext, "create context");
+	GLFWwindow* window = NULL;
+	HeadlessContext* offscreen = NULL;
+	if (headless)
 	{
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate(); // clean up all GLFW resources
-		return -1;
+		// no window and no display server; the context draws into an FBO of width x height
+		offscreen = new HeadlessContext(width, height);
+		if (!offscreen->valid())
+		{
+			delete offscreen;
+			return -1;
+		}
 	}
+	else
+	{
+		// Initialize GLFW
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		//glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // for Mac OS X
+
+		// Create a window object
+		window = glfwCreateWindow(
+			width,			// width
+			height,			// height
+			"LearnOpenGL",	// title
+			NULL,			// monitor
+			NULL			// share
+		);
+		if (window == NULL)
+		{
+			std::cout << "Failed to create GLFW window" << std::endl;
+			glfwTerminate(); // clean up all GLFW resources
+			return -1;
+		}
 
-	// make the context of the specified window current on the calling thread
-	glfwMakeContextCurrent(window); 
+		// make the context of the specified window current on the calling thread
+		glfwMakeContextCurrent(window); 
+	}
 
-	// Initialize GLAD before calling any OpenGL function
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	// Initialize GLAD before calling any OpenGL function; built with GLAD_LAZY, each function is resolved on its first call
+	GLADloadproc getProcAddress = headless ? (GLADloadproc)HeadlessContext::getProcAddress : (GLADloadproc)glfwGetProcAddress;
+#ifdef GLAD_LAZY
+	if (!gladLoadGLLoaderLazy(getProcAddress))
+#else
+	if (!gladLoadGLLoader(getProcAddress))
+#endif
 	{
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	if (headless && !offscreen->createFramebuffer())
+	{
+		delete offscreen;
+		return -1;
+	}
+	PROFILE_END(createContext);
+
+#ifdef GLAD_TRACE
+	// record every GL call from here on, for Benchmarks/GladReplay.cpp to replay headless
+	if (!gladTraceBegin("session.gltrace"))
+		std::cout << "ERROR::GLAD::TRACE_BEGIN_FAILED" << std::endl;
+#endif
 
 	// set the viewport of OpenGL
 	glViewport(
 		0, // lower left corner of the window
 		0,  // lower left corner of the window
-		SCR_WIDTH, // width
-		SCR_HEIGHT // height
+		width, // width
+		height // height
 	);
 
 	// register a callback function on window resize
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	if (window)
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
 	//Shader ourShader("shaders/shader.vs", "shaders/shader.fs");
 	Shader ourShader("shaders/shader.vs", "shaders/_1_6_shader_sol4.fs");
@@ -222,86 +309,66 @@ int main()
 	// load and create a texture
 	// -------------------------
 
-	unsigned int texture;
-	glGenTextures(1, &texture); // generates texture names
-
-	glBindTexture(GL_TEXTURE_2D, texture); // bind a named texture to a texturing target
-
-	// set the texture wrapping parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	
-	int width, height, nrChannels;
-	stbi_set_flip_vertically_on_load(true); // flips the loaded image vertically since OpenGL expects the 0.0 coordinate on the y-axis to be on the bottom side of the image
-	unsigned char* data = stbi_load("resources/container.jpg", // path
-		&width, // width
-		&height, // height
-		&nrChannels, // number of channels
-		0 // desired channels
-	); // loads an image from the file system into a buffer
-
-	if (data)
-	{
-		glTexImage2D(GL_TEXTURE_2D, // target
-			0, // level
-			GL_RGB, // internal format
-			width, // width
-			height, // height
-			0, // border
-			GL_RGB, // format
-			GL_UNSIGNED_BYTE, // type
-			data // data
-		); // creates a texture image
-		glGenerateMipmap(GL_TEXTURE_2D); // generates mipmaps for the currently bound texture object
-	}
-	else
-	{
-		std::cout << "Failed to load texture" << std::endl;
-	}
+	// decoded textures are kept in cache/textures, so later runs upload them without decoding
+	PROFILE_BEGIN(loadTextures, "load textures");
+	TextureCache textureCache("cache/textures", 256 * 1024 * 1024);
+	Texture::useCache(&textureCache);
 
-	stbi_image_free(data); // frees image memory
-
-	unsigned int texture2;
-	glGenTextures(1, &texture2); // generates texture names
-	glBindTexture(GL_TEXTURE_2D, texture2); // bind a named texture to a texturing target
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	unsigned char* data2 = stbi_load("resources/awesomeface.png", &width, &height, &nrChannels, 0);
-	if (data2)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data2);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else
+	Texture texture1("resources/container.jpg"); // decodes straight into a pixel buffer object, flipped vertically for OpenGL
+	Texture texture2("resources/awesomeface.png");
+	PROFILE_END(loadTextures);
+
+	// read back on a ring of pixel buffers and written by worker threads, so the loop doesn't wait for the disk
+	FrameCapture* capture = NULL;
+	if (capturePath != NULL)
 	{
-		std::cout << "Failed to load texture" << std::endl;
+		capture = new FrameCapture(capturePath, FrameCapture::formatOf(capturePath), width, height);
+		if (!capture->valid())
+		{
+			delete capture;
+			capture = NULL;
+		}
 	}
-	stbi_image_free(data2); // frees image memory
+
+	GLStateCache::enableShadowing(SHADOW_GL_STATE);
+	GLStateCache::endFrame(); // start counting at the first frame
+	// what each part of the frame costs the GPU, read back a few frames later so the loop never waits for it
+	GpuTimer gpuTimer;
+	const int clearPass = gpuTimer.pass("clear"), drawPass = gpuTimer.pass("draw"), swapPass = gpuTimer.pass("swap");
+#ifdef GLAD_INSTRUMENT
+	gladInstrumentEndFrame(NULL); // leave the setup calls out of the first frame
+#endif
+	PROFILE_END(startup);
+	double start = elapsedSeconds();
+	double nextReport = start;
+	long long frame = 0;
 
 	// render loop
-	while (!glfwWindowShouldClose(window))
+	while ((window == NULL || !glfwWindowShouldClose(window)) && (frames < 0 || frame < frames))
 	{
+		PROFILE_ZONE("frame");
 		// input
-		processInput(window); // check if the user has pressed the escape key
+		if (window)
+			processInput(window); // check if the user has pressed the escape key
 
 		// rendering commands here
+		PROFILE_BEGIN(clearZone, "clear");
+		gpuTimer.begin(clearPass);
 		glClearColor(0.2f, 0.3f, 0.3f, 1.0f); // state-setting function, Clear 색상 지정
 		glClear(GL_COLOR_BUFFER_BIT); // state-using function, 지정된 Clear 색으로 특정 Buffer 를 Clear
+		gpuTimer.end(clearPass);
+		PROFILE_END(clearZone);
 
 		//glPolygonMode(
 		//	GL_FRONT_AND_BACK,	// face
 		//	GL_LINE				// mode
 		//); // sets the polygon rasterization mode of the active polygon primitive
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL); // default
+		PROFILE_BEGIN(drawZone, "draw");
+		gpuTimer.begin(drawPass);
+		GLStateCache::polygonMode(GL_FRONT_AND_BACK, GL_FILL); // default
 
-		glActiveTexture(GL_TEXTURE0); // activates the texture unit
-		glBindTexture(GL_TEXTURE_2D, texture); // bind a named texture to a texturing target
-		glActiveTexture(GL_TEXTURE1); // activates the texture unit
-		glBindTexture(GL_TEXTURE_2D, texture2); // bind a named texture to a texturing target
+		texture1.bind(0); // glActiveTexture(GL_TEXTURE0) + glBindTexture(GL_TEXTURE_2D, ...)
+		texture2.bind(1);
 
 		// be sure to activate the shader
 		ourShader.use(); // glUseProgram(shaderProgram);
@@ -318,33 +385,109 @@ int main()
 		//	1.0f // value, alphaValue
 		//); // specifies the value of a uniform variable for the current program object
 
-		glUniform1i(glGetUniformLocation(ourShader.ID, "texture1"), 0); // set it manually
+		GLStateCache::uniform1i(GLStateCache::getUniformLocation(ourShader.ID, "texture1"), 0); // set it manually
 		ourShader.setInt("texture2", 1); // or with shader class
 		ourShader.setFloat("mixValue", mixValue);
 
-		glBindVertexArray(VAO);
+		GLStateCache::bindVertexArray(VAO);
 		glDrawElements(
 			GL_TRIANGLES,		// mode
 			6,					// count, the number of elements to be rendered
 			GL_UNSIGNED_INT,	// type
 			0					// indices, element array buffer offset
 		); // draws primitives from array data
-		glBindVertexArray(0); // unbind the VAO
+		GLStateCache::bindVertexArray(0); // unbind the VAO
+		gpuTimer.end(drawPass);
+		PROFILE_END(drawZone);
+
+		// how many state calls reached GL, once a second
+		GLStateCache::Counts calls = GLStateCache::endFrame();
+#ifdef GLAD_INSTRUMENT
+		const gladInstrumentCall* glCalls; // every GL call of this frame, slowest first
+		int glCallCount = gladInstrumentEndFrame(&glCalls);
+#endif
+		if (elapsedSeconds() >= nextReport)
+		{
+			std::cout << "GL state calls per frame: " << calls.issued << " issued, " << calls.skipped << " skipped" << std::endl;
+#ifdef GLAD_INSTRUMENT
+			for (int i = 0; i < glCallCount && i < 3; i++)
+				std::cout << "  " << glCalls[i].name << ": " << glCalls[i].calls << " calls, " << glCalls[i].ms << " ms" << std::endl;
+#endif
+			std::cout << "GPU per frame: " << gpuTimer.summary() << std::endl;
+			if (window)
+				glfwSetWindowTitle(window, ("LearnOpenGL - GPU " + gpuTimer.summary()).c_str());
+			nextReport = elapsedSeconds() + 1.0;
+		}
+
+		if (capture)
+			capture->capture(); // before the swap, while the frame is still in the back buffer
 
 		// check and call events and swap the buffers
-		glfwSwapBuffers(window); // swap the color buffer
-		glfwPollEvents(); // check if any events are triggered
+		PROFILE_BEGIN(swapZone, "swap");
+		gpuTimer.begin(swapPass);
+		if (window)
+			glfwSwapBuffers(window); // swap the color buffer
+		else
+			offscreen->swapBuffers(); // the frame stays in the FBO
+		gpuTimer.end(swapPass);
+		PROFILE_END(swapZone);
+		gpuTimer.endFrame();
+#ifdef GLAD_TRACE
+		gladTraceFrame();
+#endif
+		if (window)
+		{
+			PROFILE_ZONE("poll events");
+			glfwPollEvents(); // check if any events are triggered
+		}
+		frame++;
 	}
 
-	glBindVertexArray(0); // unbind the VAO
-	glBindBuffer(GL_VERTEX_ARRAY, 0); // unbind the VBO
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // unbind the EBO
+	double seconds = elapsedSeconds() - start;
+	std::cout << frame << " frames of " << width << "x" << height << " in " << seconds << " s, "
+		<< (seconds > 0.0 ? frame / seconds : 0.0) << " frames per second" << std::endl;
+	if (capture)
+	{
+		std::cout << "captured " << capture->frames() << " frames to " << capturePath << ", "
+			<< (capture->frames() ? capture->captureMs() / capture->frames() : 0.0) << " ms per frame in the render loop, "
+			<< capture->stalls() << " waits for the writers" << std::endl;
+		delete capture; // writes the frames still in flight
+	}
+	if (gpuTimesPath != NULL && !gpuTimer.writeCsv(gpuTimesPath))
+		std::cout << "ERROR::GPU_TIMER::CSV_WRITE_FAILED " << gpuTimesPath << std::endl;
+	if (profilePath != NULL)
+	{
+		if (Profiler::writeChromeTrace(profilePath))
+		{
+			std::cout << "wrote " << Profiler::zoneCount() << " profiling zones to " << profilePath << std::endl;
+			if (Profiler::droppedZones() > 0)
+				std::cout << Profiler::droppedZones() << " zones were dropped: a thread records at most "
+					<< Profiler::maxZonesPerThread << std::endl;
+		}
+		else
+			std::cout << "ERROR::PROFILER::WRITE_FAILED " << profilePath << std::endl;
+	}
 
-	glDeleteVertexArrays(1, &VAO); // delete the VAO
-	glDeleteBuffers(1, &VBO); // delete the VBO
-	glDeleteBuffers(1, &EBO); // delete the EBO
+	GLStateCache::bindVertexArray(0); // unbind the VAO
+	GLStateCache::bindBuffer(GL_ARRAY_BUFFER, 0); // unbind the VBO
+	GLStateCache::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // unbind the EBO
 
-	glfwTerminate(); // clean up all GLFW resources
+	GLStateCache::deleteVertexArrays(1, &VAO); // delete the VAO
+	GLStateCache::deleteBuffers(1, &VBO); // delete the VBO
+	GLStateCache::deleteBuffers(1, &EBO); // delete the EBO
+
+#ifdef GLAD_TRACE
+	if (!gladTraceEnd())
+		std::cout << "ERROR::GLAD::TRACE_WRITE_FAILED" << std::endl;
+#endif
+#ifdef GLAD_INSTRUMENT
+	if (!gladInstrumentDump("gl_calls.csv")) // totals of every GL function called over the run
+		std::cout << "ERROR::GLAD::INSTRUMENT_DUMP_FAILED" << std::endl;
+#endif
+
+	if (window)
+		glfwTerminate(); // clean up all GLFW resources
+	delete offscreen; // destroys the FBO and the context
 	return 0;
 }
 
@@ -355,6 +498,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 
 void processInput(GLFWwindow* window)
 {
+	PROFILE_ZONE("processInput");
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 	{
 		// close the window
@@ -378,3 +522,10 @@ void processInput(GLFWwindow* window)
 		}
 	}
 }
+
+double elapsedSeconds()
+{
+	// glfwGetTime needs glfwInit, which the headless mode never calls
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,485 @@
+#!/usr/bin/env python3
+"""Re-applies this project's additions to a glad 0.1.34 C loader.
+
+glad.c and glad.h are glad's output (see the command line in their header
+comments) with these additions, which glad knows nothing about:
+
+    the extension lookup through perfect hash tables instead of a linear strstr
+    GLAD_LAZY        gladLoadGLLoaderLazy and its trampolines
+    GLAD_INSTRUMENT  call counting and timing wrappers
+    GLAD_TRACE       capture and replay of the core GL calls
+
+The hand-written parts are in templates/; this script generates the per-function
+and per-extension parts from the loader itself and splices everything in. After
+regenerating the loader with glad, run it on the new files:
+
+    python tools/extend_glad.py src/glad.c include/glad/glad.h
+
+Only the standard library is needed. The files are rewritten in place, and a
+file that already has the additions is refused.
+"""
+import os
+import re
+import sys
+
+TEMPLATES = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'templates')
+
+NOTE = '''    Extended:
+        tools/extend_glad.py (extension hash tables, GLAD_LAZY, GLAD_INSTRUMENT,
+        GLAD_TRACE); run it again on both files after regenerating them.
+'''
+
+
+def template(name, **fields):
+    text = open(os.path.join(TEMPLATES, name)).read().rstrip('\n')
+    for key, value in fields.items():
+        text = text.replace('@%s@' % key, value)
+    assert '@' not in re.sub(r'@elmindreda', '', text), name
+    return text.split('\n')
+
+
+def find(lines, predicate, start=0):
+    return next(i for i in range(start, len(lines)) if predicate(lines[i]))
+
+
+def add_note(lines):
+    end = lines.index('*/')
+    if any(l.strip() == 'Extended:' for l in lines[:end]):
+        sys.exit('already extended')
+    lines[end:end] = NOTE.rstrip('\n').split('\n')
+
+
+def signatures(header):
+    return {m.group(2): (m.group(1).strip(), m.group(3).strip())
+            for m in re.finditer(r'typedef (.+?) \(APIENTRYP (PFN\w+PROC)\)\((.*?)\);', header)}
+
+
+def argnames(params):
+    if params in ('void', ''):
+        return '()'
+    return '(' + ', '.join(re.search(r'(\w+)$', re.sub(r'\[.*\]$', '', a.strip())).group(1)
+                           for a in params.split(',')) + ')'
+
+
+def trampoline(prefix, name, pfn, sig, index=None):
+    ret, params = sig[pfn]
+    fields = [name, pfn, '(%s)' % params, argnames(params)]
+    if index is not None:
+        fields.insert(0, str(index))
+    if ret == 'void':
+        return '%s_VOID(%s)' % (prefix, ', '.join(fields))
+    return '%s_RETURN(%s)' % (prefix, ', '.join([ret] + fields))
+
+
+# extension lookup ----------------------------------------------------------
+
+M64 = (1 << 64) - 1
+
+
+def fnv(name):
+    h = 0xcbf29ce484222325
+    for b in name.encode():
+        h = ((h ^ b) * 0x100000001b3) & M64
+    return h
+
+
+def is_prime(n):
+    return n > 1 and all(n % k for k in range(2, int(n ** 0.5) + 1))
+
+
+def perfect_hash(names):
+    """the bucket count, slot count, displacements and slots find_exts looks names up in"""
+    m = int(len(names) * 1.25) + 2
+    while not is_prime(m):
+        m += 1
+    nb = max(1, (len(names) + 3) // 4)
+    hashes = [fnv(n) for n in names]
+    buckets = [[] for _ in range(nb)]
+    for i, h in enumerate(hashes):
+        buckets[h % nb].append(i)
+    displace = [0] * nb
+    slots = [-1] * m
+    for b in sorted(range(nb), key=lambda b: -len(buckets[b])):
+        items = buckets[b]
+        if not items:
+            continue
+        for d in range(65536):
+            pos = [((hashes[i] >> 20) % m + d * ((hashes[i] >> 40) % (m - 1) + 1)) % m for i in items]
+            if len(set(pos)) == len(pos) and all(slots[p] == -1 for p in pos):
+                break
+        else:
+            sys.exit('no displacement for bucket %d' % b)
+        displace[b] = d
+        for i, p in zip(items, pos):
+            slots[p] = i
+    for i, h in enumerate(hashes):
+        assert slots[((h >> 20) % m + displace[h % nb] * ((h >> 40) % (m - 1) + 1)) % m] == i
+    return nb, m, displace, slots
+
+
+def rows(values, per=16):
+    out = ['\t' + ', '.join(str(v) for v in values[i:i + per]) + ',' for i in range(0, len(values), per)]
+    out[-1] = out[-1][:-1]
+    return out
+
+
+def extend_ext_lookup(c):
+    a = find(c, lambda l: l == 'static const char *exts = NULL;')
+    b = find(c, lambda l: l == 'int GLAD_GL_VERSION_1_0 = 0;', a)
+    c[a:b] = template('ext_lookup.c')
+    for api in ('GL', 'GLES1', 'GLES2', 'GLSC2'):
+        s = c.index('static int find_extensions%s(void) {' % api)
+        e = find(c, lambda l: l == '}', s)
+        names = []
+        for l in c[s + 1:e]:
+            m = re.match(r'\tGLAD_(\w+) = has_ext\("(\w+)"\);$', l)
+            if m and m.group(1) == m.group(2):
+                names.append(m.group(2))
+            elif l not in ('\tif (!get_exts()) return 0;', '\tfree_exts();', '\treturn 1;'):
+                sys.exit('unexpected line in find_extensions%s: %s' % (api, l))
+        nb, m, displace, slots = perfect_hash(names)
+        out = ['static const char *const ext_names_%s[] = {' % api] + ['\t"%s",' % n for n in names]
+        out[-1] = out[-1][:-1]
+        out += ['};', 'static int *const ext_flags_%s[] = {' % api] + ['\t&GLAD_%s,' % n for n in names]
+        out[-1] = out[-1][:-1]
+        out += ['};', 'static const unsigned short ext_displace_%s[] = {' % api] + rows(displace)
+        out += ['};', 'static const short ext_slots_%s[] = {' % api] + rows(slots)
+        out += ['};',
+                'static const struct glad_ext_table ext_table_%s = {' % api,
+                '\t%d, %d, %d, ext_names_%s, ext_flags_%s, ext_displace_%s, ext_slots_%s'
+                % (len(names), nb, m, api, api, api, api),
+                '};',
+                'static int find_extensions%s(void) {' % api,
+                '\treturn find_exts(&ext_table_%s);' % api]
+        c[s:e] = out
+
+
+# GLAD_TRACE ------------------------------------------------------------------
+
+def core_functions(c):
+    """(name, PFN type) of the desktop GL 1.0 to 4.6 functions, in load order"""
+    names, seen = [], set()
+    text = '\n'.join(c)
+    for m in re.finditer(r'static void load_GL_VERSION_(\d)_(\d)\(GLADloadproc load\) \{(.*?)\n\}', text, re.S):
+        for n in re.findall(r'glad_(gl\w+) = \((PFN\w+PROC)\)load', m.group(3)):
+            if n[0] not in seen:
+                seen.add(n[0])
+                names.append(n)
+    return names
+
+
+def split_params(params):
+    if params in ('void', ''):
+        return []
+    out = []
+    for a in params.split(','):
+        a = a.strip()
+        n = re.search(r'(\w+)$', a).group(1)
+        out.append((a[:len(a) - len(n)].strip(), n))
+    return out
+
+
+COUNTS = ['drawcount', 'n', 'count', 'numAttachments', 'propCount', 'uniformCount', 'numSpecializationConstants']
+PACK = re.compile(r'^gl(Readn?Pixels|Getn?(Compressed)?Tex(ture)?(Sub)?Image)$')
+UPLOAD = re.compile(r'^gl(Tex|Texture)(Sub)?Image([123])D$')
+COMPRESSED = re.compile(r'^glCompressedTex(ture)?(Sub)?Image[123]D$')
+CLEARDATA = re.compile(r'^glClear(Named)?Buffer(Sub)?Data$|^glClearTex(Sub)?Image$')
+MAPS = {
+    'glMapBuffer': (0, 'target', '0', 'trace_map_access(access)'),
+    'glMapBufferRange': (0, 'target', '(size_t)length', 'access'),
+    'glMapNamedBuffer': (1, 'buffer', '0', 'trace_map_access(access)'),
+    'glMapNamedBufferRange': (1, 'buffer', '(size_t)length', 'access'),
+}
+UNMAPS = {'glUnmapBuffer': (0, 'target'), 'glUnmapNamedBuffer': (1, 'buffer')}
+CREATES = ('glCreateProgram', 'glCreateShader', 'glCreateShaderProgramv')
+
+
+class Unsupported(Exception):
+    pass
+
+
+def declare(t, n):
+    return t + n if t.endswith('*') else t + ' ' + n
+
+
+def components(f):
+    m = re.search(r'Matrix(\d)x(\d)', f)
+    if m:
+        return int(m.group(1)) * int(m.group(2))
+    m = re.search(r'Matrix(\d)', f)
+    if m:
+        return int(m.group(1)) ** 2
+    return int(re.search(r'Uniform(\d)', f).group(1))
+
+
+def sink_size(f, ps):
+    pn = [n for t, n in ps if '*' not in t]
+    if f in ('glGetBufferSubData', 'glGetNamedBufferSubData'):
+        return '(size_t)size'
+    if f == 'glReadPixels':
+        return '((size_t)width * 16 + 8) * (size_t)height'
+    if f in ('glGetTexImage', 'glGetCompressedTexImage'):
+        return 'TRACE_LARGE_SINK'
+    if f == 'glGetDebugMessageLog':
+        return '(size_t)count * sizeof(GLenum) + (size_t)bufSize'
+    if 'bufSize' in pn:
+        return '(size_t)bufSize'
+    for c in ('count', 'uniformCount', 'maxCount'):
+        if c in pn:
+            return '(size_t)%s * 8' % c
+    return '0'
+
+
+def classify(f, ps, i):
+    """(trace statement, replay statement) for parameter i; the replay statement assigns the local"""
+    t, n = ps[i]
+    pn = [x for _, x in ps]
+    if t == 'GLDEBUGPROC':
+        raise Unsupported
+    if t == 'GLsync':
+        return 'trace_sync(%s);' % n, '%s = replay_sync(replay);' % n
+    if '*' not in t:
+        return 'TRACE_VALUE(%s);' % n, 'REPLAY_VALUE(%s);' % n
+    const = t.startswith('const')
+    base = t.replace('const', '').replace('*', '').strip()
+
+    def data(size='0'):
+        return '%s = (%s)replay_data(replay, %s);' % (n, t, size)
+    if not const:
+        if re.match(r'^gl(Gen|Create)\w+s$', f) and base == 'GLuint':
+            c = 'n' if 'n' in pn else 'count'
+            return ('trace_array(%s, %s, sizeof(GLuint));' % (n, c),
+                    '%s_recorded = replay_data(replay, 0); %s = (GLuint *)replay_sink(replay, (size_t)%s * sizeof(GLuint));'
+                    % (n, n, c))
+        if PACK.match(f) and base == 'void':
+            return 'trace_pack(%s);' % n, data(sink_size(f, ps))
+        return 'trace_sink(%s);' % n, data(sink_size(f, ps))
+    if t == 'const GLchar *const*':
+        c = pn[pn.index(n) - 1]
+        lengths = 'length' if 'length' in pn and pn.index('length') > i else 'NULL'
+        return 'trace_strings(%s, %s, %s);' % (c, n, lengths), '%s = replay_strings(replay, %s);' % (n, c)
+    if f == 'glShaderSource' and n == 'length':
+        return None, '%s = NULL; /* the strings are replayed NUL terminated */' % n
+    if t == 'const void *const*':
+        return 'trace_offsets(%s, drawcount);' % n, '%s = replay_offsets(replay);' % n
+    if f in ('glObjectPtrLabel', 'glGetObjectPtrLabel') and n == 'ptr':
+        return 'trace_sync(%s);' % n, '%s = (const void *)replay_sync(replay);' % n
+    if base == 'GLchar':
+        if 'length' in pn:
+            return 'trace_string_length(%s, length);' % n, data()
+        return 'trace_string(%s);' % n, data()
+    if base == 'void':
+        if n in ('indices', 'pointer', 'indirect'):
+            return 'trace_pointer_offset(%s);' % n, data()
+        m = UPLOAD.match(f)
+        if m:
+            d = int(m.group(3))
+            size = 'trace_image_size(width, %s, %s, format, type)' % ('height' if d > 1 else '0', 'depth' if d > 2 else '0')
+            return 'trace_unpack(%s, %s);' % (n, size), data()
+        if COMPRESSED.match(f):
+            return 'trace_unpack(%s, (size_t)imageSize);' % n, data()
+        if CLEARDATA.match(f):
+            return 'trace_bytes(%s, trace_pixel_size(format, type));' % n, data()
+        if 'size' in pn:
+            return 'trace_bytes(%s, (size_t)size);' % n, data()
+        if f in ('glShaderBinary', 'glProgramBinary'):
+            return 'trace_bytes(%s, (size_t)length);' % n, data()
+        raise Unsupported
+    # arrays of values
+    size = 'sizeof(%s)' % base
+    if re.match(r'^gl(Program)?Uniform', f) and n == 'value':
+        return 'trace_array(%s, count, %d * %s);' % (n, components(f), size), data()
+    m = re.match(r'^glVertexAttrib[IL]?(\d)N?\w*v$', f)
+    if m and 'P' not in f:
+        return 'trace_array(%s, %s, %s);' % (n, m.group(1), size), data()
+    if re.match(r'^gl(VertexAttrib|Vertex|TexCoord|MultiTexCoord|Normal|Color|SecondaryColor)P\duiv$', f):
+        return 'trace_array(%s, 1, %s);' % (n, size), data()
+    fixed = {'glViewportIndexedfv': '4', 'glScissorIndexedv': '4', 'glViewportArrayv': 'count * 4',
+             'glScissorArrayv': 'count * 4', 'glDepthRangeArrayv': 'count * 2',
+             'glPointParameterfv': '1', 'glPointParameteriv': '1',
+             'glPatchParameterfv': '(pname == GL_PATCH_DEFAULT_OUTER_LEVEL ? 4 : 2)'}
+    if f in fixed:
+        return 'trace_array(%s, %s, %s);' % (n, fixed[f], size), data()
+    if re.match(r'^gl(Tex|Texture|Sampler)Parameter\w*v$', f):
+        return 'trace_array(%s, trace_parameter_count(pname), %s);' % (n, size), data()
+    if re.match(r'^glClear(Buffer|NamedFramebuffer)(i|ui|f)v$', f):
+        return 'trace_array(%s, buffer == GL_COLOR ? 4 : 1, %s);' % (n, size), data()
+    for c in COUNTS:
+        if c in pn and (c == 'drawcount' or pn.index(c) < i):
+            return 'trace_array(%s, %s, %s);' % (n, c, size), data()
+    raise Unsupported
+
+
+def traced(number, f, pfn, sig):
+    """the wrapper that records the call, and the replay case that decodes and repeats it"""
+    ret, params = sig[pfn]
+    ps = split_params(params)
+    args = ', '.join(n for t, n in ps)
+    try:
+        kinds = [classify(f, ps, i) for i in range(len(ps))]
+    except Unsupported:
+        kinds = None
+    call = 'glad_real_%s(%s)' % (f, args)
+
+    record = []
+    if kinds is not None:
+        record = [k[0] for k in kinds if k[0]]
+        if f in UNMAPS:
+            named, key = UNMAPS[f]
+            record.append('trace_unmap(%d, %s);' % (named, key))
+        elif ret != 'void':
+            if ret == 'GLsync':
+                record.append('trace_sync(glad_result);')
+            elif '*' not in ret:
+                record.append('TRACE_VALUE(glad_result);')
+        if f in MAPS:
+            named, key, length, access = MAPS[f]
+            record.append('track_mapping(trace_mappings, %d, %s, glad_result, %s, %s);' % (named, key, length, access))
+    body = 'if(trace_call(%d)) {%s}' % (number, ' ' + ' '.join(record) + ' ' if record else ' /* arguments not recorded */ ')
+    w = ['static %s APIENTRY glad_traced_%s(%s) {' % (ret, f, params)]
+    if f in UNMAPS:
+        w += ['    ' + body, '    return %s;' % call]
+    elif ret == 'void':
+        w += ['    %s;' % call, '    ' + body]
+    else:
+        w += ['    %s = %s;' % (declare(ret, 'glad_result'), call), '    ' + body, '    return glad_result;']
+    w.append('}')
+
+    c = ['    case %d: { /* %s */' % (number, f)]
+    if kinds is None:
+        return w, c + ['        replay->info.skipped++;', '        break;', '    }']
+    locals_ = []
+    for (t, n), k in zip(ps, kinds):
+        if k[1].startswith(n + '_recorded'):
+            locals_.append('GLuint *%s; const void *%s_recorded;' % (n, n))
+        else:
+            locals_.append(declare(t, n) + ';')
+    need_result = ret == 'GLsync' or f in CREATES or f in MAPS
+    recorded = ret != 'void' and '*' not in ret and f not in UNMAPS
+    if need_result:
+        locals_.append(declare(ret, 'glad_result') + ';')
+    if recorded:
+        locals_.append('%s glad_recorded;' % ('khronos_uint64_t' if ret == 'GLsync' else ret))
+    if f in UNMAPS:
+        locals_.append('const void *glad_mapped;')
+    if locals_:
+        c.append('        ' + ' '.join(locals_))
+    decode = [k[1] for k in kinds]
+    if f in UNMAPS:
+        decode.append('glad_mapped = replay_data(replay, 0);')
+    elif recorded:
+        decode.append('REPLAY_VALUE(glad_recorded);')
+    c += ['        ' + d for d in decode]
+    c.append('        if(!REPLAY_READY(glad_real_%s)) break;' % f)
+    if f in UNMAPS:
+        named, key = UNMAPS[f]
+        c.append('        replay_unmap(replay, %d, %s, glad_mapped);' % (named, key))
+    c.append('        %s%s;' % ('glad_result = ' if need_result else '', call))
+    for (t, n), k in zip(ps, kinds):
+        if k[1].startswith(n + '_recorded'):
+            c.append('        replay_names(replay, %s, %s_recorded, %s);' % (n, n, 'n' if 'n' in [x for _, x in ps] else 'count'))
+    if f in MAPS:
+        named, key, length, access = MAPS[f]
+        c.append('        track_mapping(replay->mappings, %d, %s, glad_result, %s, %s);' % (named, key, length, access))
+    if ret == 'GLsync':
+        c.append('        replay_add_sync(replay, glad_recorded, glad_result);')
+    elif f in CREATES:
+        c.append('        if(glad_result != glad_recorded) replay->info.mismatches++;')
+    return w, c + ['        break;', '    }']
+
+
+# the additions -------------------------------------------------------------
+
+def extend_source(c, sig):
+    add_note(c)
+    core = core_functions(c)
+
+    # GLAD_LAZY, ahead of the extension tables that take find_extensionsGL's place
+    start = find(c, lambda l: l.startswith('static void load_GL_VERSION_1_0('))
+    end = c.index('static int find_extensionsGL(void) {')
+    lazy, seen = [], set()
+    for l in c[start:end]:
+        m = re.match(r'\tglad_(\w+) = \((PFN\w+PROC)\)load\("(\w+)"\);', l)
+        if m and m.group(1) not in seen:
+            seen.add(m.group(1))
+            lazy.append((m.group(1), m.group(2)))
+    core_names = set(n for n, _ in core)
+    c[end:end] = template('lazy.c',
+        TRAMPOLINES='\n'.join(trampoline('GLAD_LAZY_CORE' if n in core_names else 'GLAD_LAZY', n, pfn, sig) for n, pfn in lazy),
+        INSTALL='\n'.join('\tglad_%s = glad_lazy_%s;' % (n, n) for n, _ in lazy)) + ['']
+
+    extend_ext_lookup(c)
+
+    # GLAD_INSTRUMENT and GLAD_TRACE, after the function pointers
+    pointers = [(m.group(2), m.group(1)) for m in (re.match(r'(PFN\w+PROC) glad_(\w+) = NULL;$', l) for l in c) if m]
+    last = max(i for i, l in enumerate(c) if re.match(r'PFN\w+PROC glad_\w+ = NULL;$', l))
+    block = template('instrument.c', COUNT=str(len(pointers)),
+        WRAPPERS='\n'.join(trampoline('GLAD_INSTRUMENT', n, pfn, sig, i) for i, (n, pfn) in enumerate(pointers)),
+        INSTALL='\n'.join('\tGLAD_INSTRUMENT_INSTALL(%d, %s)' % (i, n) for i, (n, _) in enumerate(pointers)))
+    wrappers, cases = [], []
+    for number, (f, pfn) in enumerate(core):
+        w, r = traced(number, f, pfn, sig)
+        wrappers += w
+        cases += r
+    block += template('trace.c', COUNT=str(len(core)),
+        REALS='\n'.join('static %s glad_real_%s = NULL;' % (pfn, f) for f, pfn in core),
+        NAMES='\n'.join('    "%s",' % f for f, _ in core).rstrip(','),
+        WRAPPERS='\n'.join(wrappers),
+        INSTALL='\n'.join('    GLAD_TRACE_INSTALL(%s)' % f for f, _ in core),
+        CASES='\n'.join(cases))
+    c[last + 1:last + 1] = block
+
+    # the loaders swap in the wrappers once they are done; only desktop GL is traced or lazy
+    installs = {'GL': ['#ifdef GLAD_INSTRUMENT', '\tinstall_instrument();', '#endif',
+                       '#ifdef GLAD_TRACE', '\tinstall_trace();', '#endif']}
+    for api in ('GL', 'GLES1', 'GLES2', 'GLSC2'):
+        s = c.index('int glad%sLoader(GLADloadproc load) {' % ('LoadGL' if api == 'GL' else 'Load' + api))
+        e = find(c, lambda l: l == '}', s)
+        assert c[e - 1] == '\treturn GLVersion.major != 0 || GLVersion.minor != 0;'
+        c[e - 1:e - 1] = installs.get(api, installs['GL'][:3])
+        if api == 'GL':
+            e = find(c, lambda l: l == '}', s)
+            c[e + 1:e + 1] = [
+                '',
+                '#ifdef GLAD_LAZY',
+                'int gladLoadGLLoaderLazy(GLADloadproc load) {',
+                '\tGLVersion.major = 0; GLVersion.minor = 0;',
+                '\tglad_lazy_loader = load;',
+                '\tinstall_lazy_GL();',
+                '\tglGetString = (PFNGLGETSTRINGPROC)load("glGetString");',
+                '\tif(glGetString == NULL) return 0;',
+                '\tif(glGetString(GL_VERSION) == NULL) return 0;',
+                '\tfind_coreGL();',
+                '\tif (!find_extensionsGL()) return 0;'] + installs['GL'] + [
+                '\treturn GLVersion.major != 0 || GLVersion.minor != 0;',
+                '}',
+                '#endif']
+
+
+def extend_header(h):
+    add_note(h)
+    at = h.index('GLAPI int gladLoadGLLoader(GLADloadproc);') + 2
+    h[at:at] = template('glad_lazy.h') + ['']
+    at = max(i for i, l in enumerate(h) if l == '#ifdef __cplusplus')
+    h[at:at] = template('glad_wrappers.h') + ['']
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    source_path, header_path = sys.argv[1], sys.argv[2]
+    with open(header_path, newline='') as f:
+        h = f.read().split('\n')
+    with open(source_path, newline='') as f:
+        c = f.read().split('\n')
+    sig = signatures('\n'.join(h))
+    extend_source(c, sig)
+    extend_header(h)
+    with open(source_path, 'w', newline='') as f:
+        f.write('\n'.join(c))
+    with open(header_path, 'w', newline='') as f:
+        f.write('\n'.join(h))
+
+
+if __name__ == '__main__':
+    main()
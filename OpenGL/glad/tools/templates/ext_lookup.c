@@ -0,0 +1,79 @@
+/* Extension lookup: each API's known extensions are laid out in a perfect hash
+ * table, generated with the rest of this file. A name is hashed once (64-bit
+ * FNV-1a); the low bits pick a bucket, and the bucket's displacement turns the
+ * rest of the hash into the one slot the name can be in. So each extension the
+ * driver reports costs one pass over its name and at most one string compare,
+ * and the driver's strings are read in place. */
+struct glad_ext_table {
+    unsigned int count;                 /* known extensions */
+    unsigned int buckets;
+    unsigned int slots;                 /* a prime */
+    const char *const *names;           /* [count] */
+    int *const *flags;                  /* [count], the GLAD_GL_* variables */
+    const unsigned short *displace;     /* [buckets] */
+    const short *slot;                  /* [slots], index into names or -1 */
+};
+
+/* hashes the name up to the next space or the end of the string, and stores its length */
+static khronos_uint64_t hash_ext(const char *name, size_t *length) {
+    const khronos_uint64_t prime = ((khronos_uint64_t)1 << 40) | 0x1b3;
+    khronos_uint64_t hash = ((khronos_uint64_t)0xcbf29ce4 << 32) | 0x84222325;
+    const char *end = name;
+    while(*end != '\0' && *end != ' ') {
+        hash = (hash ^ (unsigned char)*end) * prime;
+        end++;
+    }
+    *length = (size_t)(end - name);
+    return hash;
+}
+
+/* sets the flag of the extension named at name, if it is a known one, and returns the name's length */
+static size_t mark_ext(const struct glad_ext_table *table, const char *name) {
+    size_t length;
+    khronos_uint64_t hash = hash_ext(name, &length);
+    unsigned int bucket = (unsigned int)(hash % table->buckets);
+    khronos_uint64_t first = (hash >> 20) % table->slots;
+    khronos_uint64_t step = (hash >> 40) % (table->slots - 1) + 1;
+    int index = table->slot[(first + table->displace[bucket] * step) % table->slots];
+    if(index >= 0 && strncmp(table->names[index], name, length) == 0 && table->names[index][length] == '\0') {
+        *table->flags[index] = 1;
+    }
+    return length;
+}
+
+static int find_exts(const struct glad_ext_table *table) {
+    unsigned int index;
+    for(index = 0; index < table->count; index++) {
+        *table->flags[index] = 0;
+    }
+#ifdef _GLAD_IS_SOME_NEW_VERSION
+    if(max_loaded_major < 3) {
+#endif
+        const char *exts = (const char *)glGetString(GL_EXTENSIONS);
+        if(exts == NULL) {
+            return 1;
+        }
+        while(*exts != '\0') {
+            if(*exts == ' ') {
+                exts++;
+            } else {
+                exts += mark_ext(table, exts);
+            }
+        }
+#ifdef _GLAD_IS_SOME_NEW_VERSION
+    } else {
+        int num_exts_i = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &num_exts_i);
+        if(num_exts_i <= 0) {
+            return 0;
+        }
+        for(index = 0; index < (unsigned)num_exts_i; index++) {
+            const char *name = (const char *)glGetStringi(GL_EXTENSIONS, index);
+            if(name != NULL) {
+                mark_ext(table, name);
+            }
+        }
+    }
+#endif
+    return 1;
+}
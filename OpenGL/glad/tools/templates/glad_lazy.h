@@ -0,0 +1,7 @@
+#ifdef GLAD_LAZY
+/* Like gladLoadGLLoader, but resolves each function on its first call instead
+ * of all of them up front. The loader is kept and must stay usable for as long
+ * as GL is called. Test GLAD_GL_VERSION_x_y and the extension flags rather than
+ * the function pointers, which are non-NULL until their first call. */
+GLAPI int gladLoadGLLoaderLazy(GLADloadproc);
+#endif
@@ -0,0 +1,51 @@
+#ifdef GLAD_INSTRUMENT
+/* Instrumentation, for builds of glad.c with GLAD_INSTRUMENT: every function a
+ * loader finds is wrapped to count its calls and time them. Without the define
+ * none of this is compiled and calls go straight to the driver. */
+struct gladInstrumentCall {
+    const char *name;
+    khronos_uint64_t calls;
+    double ms; /* spent inside the calls, hooks not included */
+};
+typedef void (* GLADinstrumenthook)(const char *name);
+/* run before and after every GL call (e.g. to check glGetError); NULL for none */
+GLAPI void gladSetInstrumentHooks(GLADinstrumenthook pre, GLADinstrumenthook post);
+/* ends a frame; *calls is set to the functions called since the last frame
+ * ended, most time first, and stays valid until the next call. returns how
+ * many there are. call it from one thread */
+GLAPI int gladInstrumentEndFrame(const struct gladInstrumentCall **calls);
+/* writes a CSV of every function called so far, with its totals and per-frame
+ * averages, most time first; returns 0 if the file can't be written */
+GLAPI int gladInstrumentDump(const char *path);
+#endif
+
+#ifdef GLAD_TRACE
+/* Capture and replay, for builds of glad.c with GLAD_TRACE: the core GL functions
+ * a desktop loader finds are wrapped so a session's calls, with the data they
+ * pass, can be written to a file and replayed on another context. */
+struct gladTraceReplay;
+struct gladTraceInfo {
+    int width, height; /* viewport when the trace began */
+    khronos_uint64_t frames; /* replayed so far */
+    khronos_uint64_t calls;
+    khronos_uint64_t skipped; /* not made: not captured, or missing in this context */
+    khronos_uint64_t mismatches; /* object names that came back different from the trace's */
+};
+/* starts writing every call to path; call it right after loading, so the
+ * trace creates every object it uses. returns 0 if the file can't be opened */
+GLAPI int gladTraceBegin(const char *path);
+/* marks the end of a frame, e.g. next to the buffer swap */
+GLAPI void gladTraceFrame(void);
+/* stops and closes the file; returns 0 if any of it couldn't be written */
+GLAPI int gladTraceEnd(void);
+/* reads a whole trace; NULL if it can't be read or isn't one. the viewport is
+ * known from here on, so the context to replay on can be made to match */
+GLAPI struct gladTraceReplay *gladTraceReplayOpen(const char *path);
+/* makes the calls of the next frame on the current context, which must have been
+ * loaded by this build; returns 1 for a frame, 0 at the end, -1 if the trace is
+ * damaged */
+GLAPI int gladTraceReplayFrame(struct gladTraceReplay *replay);
+GLAPI const struct gladTraceInfo *gladTraceReplayInfo(const struct gladTraceReplay *replay);
+GLAPI void gladTraceReplayClose(struct gladTraceReplay *replay);
+#endif
+
@@ -0,0 +1,179 @@
+#ifdef GLAD_INSTRUMENT
+/* Instrumentation: when a loader finishes, every function pointer it found is
+ * swapped for a wrapper that runs the pre hook, times the call through the real
+ * pointer with the CPU's time stamp counter, counts it, and runs the post hook.
+ * The per-function totals are only ever added to, with atomic adds, so calls
+ * from any thread are counted without a lock; gladInstrumentEndFrame turns them
+ * into per-frame numbers by subtracting the totals it saw the frame before. */
+#define GLAD_INSTRUMENT_COUNT @COUNT@
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define instrument_now() ((khronos_uint64_t)__rdtsc())
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define instrument_now() ((khronos_uint64_t)__rdtsc())
+#else
+/* no time stamp counter: ticks are nanoseconds of the monotonic clock */
+static double instrument_seconds(void);
+#define instrument_now() ((khronos_uint64_t)(instrument_seconds() * 1e9))
+#endif
+
+#ifdef _MSC_VER
+#define instrument_add(counter, value) InterlockedExchangeAdd64((volatile LONG64 *)(counter), (LONG64)(value))
+#define instrument_load(counter) ((khronos_uint64_t)InterlockedCompareExchange64((volatile LONG64 *)(counter), 0, 0))
+#else
+#define instrument_add(counter, value) __atomic_fetch_add((counter), (value), __ATOMIC_RELAXED)
+#define instrument_load(counter) __atomic_load_n((counter), __ATOMIC_RELAXED)
+#endif
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+static double instrument_seconds(void) {
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (double)count.QuadPart / (double)frequency.QuadPart;
+}
+#else
+#include <time.h>
+static double instrument_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+#endif
+
+static const char *instrument_names[GLAD_INSTRUMENT_COUNT];
+static khronos_uint64_t instrument_calls[GLAD_INSTRUMENT_COUNT];
+static khronos_uint64_t instrument_ticks[GLAD_INSTRUMENT_COUNT];
+/* owned by the thread that ends frames */
+static khronos_uint64_t instrument_seen_calls[GLAD_INSTRUMENT_COUNT];
+static khronos_uint64_t instrument_seen_ticks[GLAD_INSTRUMENT_COUNT];
+static struct gladInstrumentCall instrument_frame[GLAD_INSTRUMENT_COUNT];
+static khronos_uint64_t instrument_frames = 0;
+/* the tick rate is measured against the monotonic clock over the whole run */
+static khronos_uint64_t instrument_start_ticks = 0;
+static double instrument_start_seconds = 0.0;
+
+static GLADinstrumenthook instrument_pre_hook = NULL;
+static GLADinstrumenthook instrument_post_hook = NULL;
+
+static khronos_uint64_t instrument_pre(int index) {
+    if(instrument_pre_hook != NULL) instrument_pre_hook(instrument_names[index]);
+    return instrument_now();
+}
+
+static void instrument_post(int index, khronos_uint64_t start) {
+    khronos_uint64_t ticks = instrument_now() - start;
+    instrument_add(&instrument_calls[index], 1);
+    instrument_add(&instrument_ticks[index], ticks);
+    if(instrument_post_hook != NULL) instrument_post_hook(instrument_names[index]);
+}
+
+#define GLAD_INSTRUMENT_VOID(index, name, type, params, args) \
+    static type glad_real_##name = NULL; \
+    static void APIENTRY glad_instrumented_##name params { \
+        khronos_uint64_t glad_start = instrument_pre(index); \
+        glad_real_##name args; \
+        instrument_post(index, glad_start); \
+    }
+#define GLAD_INSTRUMENT_RETURN(ret, index, name, type, params, args) \
+    static type glad_real_##name = NULL; \
+    static ret APIENTRY glad_instrumented_##name params { \
+        khronos_uint64_t glad_start = instrument_pre(index); \
+        ret glad_result = glad_real_##name args; \
+        instrument_post(index, glad_start); \
+        return glad_result; \
+    }
+/* a pointer that already holds its wrapper was not reloaded, and keeps its real function */
+#define GLAD_INSTRUMENT_INSTALL(index, name) \
+    instrument_names[index] = #name; \
+    if(glad_##name != glad_instrumented_##name) { \
+        glad_real_##name = glad_##name; \
+        if(glad_##name != NULL) glad_##name = glad_instrumented_##name; \
+    }
+
+@WRAPPERS@
+
+static void install_instrument(void) {
+    if(instrument_start_ticks == 0) {
+        instrument_start_ticks = instrument_now();
+        instrument_start_seconds = instrument_seconds();
+    }
+@INSTALL@
+}
+
+#undef GLAD_INSTRUMENT_VOID
+#undef GLAD_INSTRUMENT_RETURN
+#undef GLAD_INSTRUMENT_INSTALL
+
+static double instrument_ticks_per_ms(void) {
+    double seconds = instrument_seconds() - instrument_start_seconds;
+    khronos_uint64_t ticks = instrument_now() - instrument_start_ticks;
+    return seconds > 0.0 && ticks > 0 ? (double)ticks / (seconds * 1e3) : 1e6;
+}
+
+static int instrument_compare(const void *a, const void *b) {
+    double ms_a = ((const struct gladInstrumentCall *)a)->ms;
+    double ms_b = ((const struct gladInstrumentCall *)b)->ms;
+    return ms_a < ms_b ? 1 : ms_a > ms_b ? -1 : 0;
+}
+
+void gladSetInstrumentHooks(GLADinstrumenthook pre, GLADinstrumenthook post) {
+    instrument_pre_hook = pre;
+    instrument_post_hook = post;
+}
+
+int gladInstrumentEndFrame(const struct gladInstrumentCall **calls) {
+    double ticks_per_ms = instrument_ticks_per_ms();
+    int index, count = 0;
+    for(index = 0; index < GLAD_INSTRUMENT_COUNT; index++) {
+        khronos_uint64_t total_calls = instrument_load(&instrument_calls[index]);
+        khronos_uint64_t total_ticks = instrument_load(&instrument_ticks[index]);
+        if(total_calls != instrument_seen_calls[index]) {
+            instrument_frame[count].name = instrument_names[index];
+            instrument_frame[count].calls = total_calls - instrument_seen_calls[index];
+            instrument_frame[count].ms = (double)(total_ticks - instrument_seen_ticks[index]) / ticks_per_ms;
+            count++;
+        }
+        instrument_seen_calls[index] = total_calls;
+        instrument_seen_ticks[index] = total_ticks;
+    }
+    instrument_frames++;
+    qsort(instrument_frame, (size_t)count, sizeof(instrument_frame[0]), instrument_compare);
+    if(calls != NULL) *calls = instrument_frame;
+    return count;
+}
+
+int gladInstrumentDump(const char *path) {
+    static struct gladInstrumentCall totals[GLAD_INSTRUMENT_COUNT];
+    double ticks_per_ms = instrument_ticks_per_ms();
+    double frames = instrument_frames > 0 ? (double)instrument_frames : 1.0;
+    int index, count = 0;
+    FILE *file = NULL;
+#ifdef _MSC_VER
+    if(fopen_s(&file, path, "w") != 0) file = NULL;
+#else
+    file = fopen(path, "w");
+#endif
+    if(file == NULL) return 0;
+
+    for(index = 0; index < GLAD_INSTRUMENT_COUNT; index++) {
+        khronos_uint64_t calls = instrument_load(&instrument_calls[index]);
+        if(calls == 0) continue;
+        totals[count].name = instrument_names[index];
+        totals[count].calls = calls;
+        totals[count].ms = (double)instrument_load(&instrument_ticks[index]) / ticks_per_ms;
+        count++;
+    }
+    qsort(totals, (size_t)count, sizeof(totals[0]), instrument_compare);
+
+    fprintf(file, "function,calls,calls_per_frame,total_ms,ms_per_frame,ns_per_call\n");
+    for(index = 0; index < count; index++) {
+        fprintf(file, "%s,%.0f,%.2f,%.4f,%.4f,%.1f\n", totals[index].name, (double)totals[index].calls,
+            (double)totals[index].calls / frames, totals[index].ms, totals[index].ms / frames,
+            totals[index].ms * 1e6 / (double)totals[index].calls);
+    }
+    return fclose(file) == 0;
+}
+#endif
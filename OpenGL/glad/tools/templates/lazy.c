@@ -0,0 +1,56 @@
+#ifdef GLAD_LAZY
+/* Lazy loading: gladLoadGLLoaderLazy points every desktop GL entry point at a
+ * trampoline instead of resolving it up front. The first call through a
+ * trampoline resolves the real function with the loader, patches the pointer so
+ * later calls go straight to the driver, and forwards the call. An entry point
+ * the driver does not have resolves to NULL; that first call does nothing and
+ * returns 0, and the pointer stays NULL, as eager loading would have left it. */
+static GLADloadproc glad_lazy_loader = NULL;
+
+/* with instrumentation, the trampoline sits behind the wrapper and patches the pointer the wrapper calls;
+ * tracing wraps only the core functions, whose trampolines are the _CORE_ ones.
+ * the slot is named by its suffix (_glX), because glX itself is a macro */
+#ifdef GLAD_INSTRUMENT
+#define GLAD_LAZY_SLOT(suffix) glad_real##suffix
+#else
+#define GLAD_LAZY_SLOT(suffix) glad##suffix
+#endif
+#if defined(GLAD_INSTRUMENT) || defined(GLAD_TRACE)
+#define GLAD_LAZY_CORE_SLOT(suffix) glad_real##suffix
+#else
+#define GLAD_LAZY_CORE_SLOT(suffix) glad##suffix
+#endif
+#define GLAD_LAZY_VOID(name, type, params, args) \
+    static void APIENTRY glad_lazy_##name params { \
+        GLAD_LAZY_SLOT(_##name) = (type)glad_lazy_loader(#name); \
+        if(GLAD_LAZY_SLOT(_##name) != NULL) GLAD_LAZY_SLOT(_##name) args; \
+    }
+#define GLAD_LAZY_RETURN(ret, name, type, params, args) \
+    static ret APIENTRY glad_lazy_##name params { \
+        GLAD_LAZY_SLOT(_##name) = (type)glad_lazy_loader(#name); \
+        return GLAD_LAZY_SLOT(_##name) != NULL ? GLAD_LAZY_SLOT(_##name) args : (ret)0; \
+    }
+#define GLAD_LAZY_CORE_VOID(name, type, params, args) \
+    static void APIENTRY glad_lazy_##name params { \
+        GLAD_LAZY_CORE_SLOT(_##name) = (type)glad_lazy_loader(#name); \
+        if(GLAD_LAZY_CORE_SLOT(_##name) != NULL) GLAD_LAZY_CORE_SLOT(_##name) args; \
+    }
+#define GLAD_LAZY_CORE_RETURN(ret, name, type, params, args) \
+    static ret APIENTRY glad_lazy_##name params { \
+        GLAD_LAZY_CORE_SLOT(_##name) = (type)glad_lazy_loader(#name); \
+        return GLAD_LAZY_CORE_SLOT(_##name) != NULL ? GLAD_LAZY_CORE_SLOT(_##name) args : (ret)0; \
+    }
+
+@TRAMPOLINES@
+
+#undef GLAD_LAZY_SLOT
+#undef GLAD_LAZY_CORE_SLOT
+#undef GLAD_LAZY_VOID
+#undef GLAD_LAZY_RETURN
+#undef GLAD_LAZY_CORE_VOID
+#undef GLAD_LAZY_CORE_RETURN
+
+static void install_lazy_GL(void) {
+@INSTALL@
+}
+#endif
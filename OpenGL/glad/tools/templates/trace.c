@@ -0,0 +1,578 @@
+#ifdef GLAD_TRACE
+#ifdef GLAD_INSTRUMENT
+#error GLAD_TRACE and GLAD_INSTRUMENT both wrap the loaded functions, build with one of them
+#endif
+/* Capture: like GLAD_INSTRUMENT, the desktop GL loaders end by swapping every core
+ * function they found (GL 1.0 to 4.6) for a wrapper. Between gladTraceBegin and
+ * gladTraceEnd the wrapper makes the call, then appends it to the trace file: the
+ * function's number, the arguments as they are in memory, and what the pointer
+ * arguments point at - buffer and texture data, shader sources, uniform arrays -
+ * with the object names the driver handed back. Extension functions are not
+ * wrapped. One context on one thread.
+ *
+ * The file starts with "GLADTRC1", the viewport when the trace began (4 int32) and
+ * the function names (uint32 count, then uint16 length + characters each), which
+ * give the functions their numbers. A call is a uint16 number and its arguments;
+ * TRACE_FRAME ends a frame. What a pointer points at is a uint32 byte count and the
+ * bytes, starting 8-aligned in the file, or one of the markers below. */
+#define GLAD_TRACE_COUNT @COUNT@
+#define TRACE_FRAME 0xffffu
+#define TRACE_NULL 0xffffffffu   /* a NULL pointer */
+#define TRACE_OFFSET 0xfffffffeu /* an offset into a bound buffer, a uint64 follows */
+#define TRACE_SINK 0xfffffffdu   /* memory GL writes results to */
+#define TRACE_MAPPINGS 16
+#define TRACE_LARGE_SINK ((size_t)64 << 20) /* for reads whose size the call doesn't say */
+
+@REALS@
+
+static const char *const trace_names[GLAD_TRACE_COUNT] = {
+@NAMES@
+};
+
+static FILE *trace_file = NULL;
+static unsigned char trace_buffer[1 << 16];
+static size_t trace_used = 0;
+static khronos_uint64_t trace_written = 0; /* bytes since the start of the file */
+static int trace_failed = 0;
+
+static void trace_flush(void) {
+    if(trace_used > 0 && fwrite(trace_buffer, 1, trace_used, trace_file) != trace_used) trace_failed = 1;
+    trace_used = 0;
+}
+
+static void trace_write(const void *data, size_t size) {
+    trace_written += size;
+    if(trace_used + size > sizeof(trace_buffer)) {
+        trace_flush();
+        if(size > sizeof(trace_buffer)) {
+            if(fwrite(data, 1, size, trace_file) != size) trace_failed = 1;
+            return;
+        }
+    }
+    memcpy(trace_buffer + trace_used, data, size);
+    trace_used += size;
+}
+#define TRACE_VALUE(value) trace_write(&(value), sizeof(value))
+
+static int trace_call(khronos_uint16_t number) {
+    if(trace_file == NULL) return 0;
+    TRACE_VALUE(number);
+    return 1;
+}
+
+static void trace_marker(khronos_uint32_t marker) {
+    TRACE_VALUE(marker);
+}
+
+/* the byte count, then padding so the bytes start 8-aligned */
+static void trace_length(size_t size) {
+    static const unsigned char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    khronos_uint32_t length = (khronos_uint32_t)size;
+    TRACE_VALUE(length);
+    trace_write(zeros, (size_t)((8 - trace_written % 8) % 8));
+}
+
+static void trace_bytes(const void *data, size_t size) {
+    if(data == NULL) {
+        trace_marker(TRACE_NULL);
+        return;
+    }
+    trace_length(size);
+    trace_write(data, size);
+}
+
+static void trace_array(const void *data, GLsizei count, size_t size) {
+    trace_bytes(data, count > 0 ? (size_t)count * size : 0);
+}
+
+static void trace_pointer_offset(const void *pointer) {
+    khronos_uint64_t offset = (khronos_uint64_t)(khronos_uintptr_t)pointer;
+    trace_marker(TRACE_OFFSET);
+    TRACE_VALUE(offset);
+}
+
+static void trace_sink(const void *pointer) {
+    trace_marker(pointer != NULL ? TRACE_SINK : TRACE_NULL);
+}
+
+static void trace_sync(const void *sync) {
+    khronos_uint64_t handle = (khronos_uint64_t)(khronos_uintptr_t)sync;
+    TRACE_VALUE(handle);
+}
+
+static void trace_string(const GLchar *string) {
+    trace_bytes(string, string != NULL ? strlen(string) + 1 : 0);
+}
+
+/* a string of length characters, or up to its NUL where length is negative */
+static void trace_string_length(const GLchar *string, GLsizei length) {
+    trace_bytes(string, string == NULL ? 0 : length < 0 ? strlen(string) + 1 : (size_t)length);
+}
+
+/* count strings, each written with a NUL after it */
+static void trace_strings(GLsizei count, const GLchar *const *strings, const GLint *lengths) {
+    size_t total = 0;
+    GLsizei index;
+    if(strings == NULL) {
+        trace_marker(TRACE_NULL);
+        return;
+    }
+    for(index = 0; index < count; index++)
+        total += (lengths != NULL && lengths[index] >= 0 ? (size_t)lengths[index] : strlen(strings[index])) + 1;
+    trace_length(total);
+    for(index = 0; index < count; index++) {
+        trace_write(strings[index], lengths != NULL && lengths[index] >= 0 ? (size_t)lengths[index] : strlen(strings[index]));
+        trace_write("", 1);
+    }
+}
+
+/* offsets into the element array buffer, one per draw */
+static void trace_offsets(const void *const *pointers, GLsizei count) {
+    GLsizei index;
+    if(pointers == NULL) {
+        trace_marker(TRACE_NULL);
+        return;
+    }
+    trace_length(count > 0 ? (size_t)count * sizeof(khronos_uint64_t) : 0);
+    for(index = 0; index < count; index++) {
+        khronos_uint64_t offset = (khronos_uint64_t)(khronos_uintptr_t)pointers[index];
+        TRACE_VALUE(offset);
+    }
+}
+
+static GLint trace_get(GLenum pname) {
+    GLint value = 0;
+    glad_real_glGetIntegerv(pname, &value);
+    return value;
+}
+
+/* bytes per pixel; the packed types hold a whole pixel */
+static size_t trace_pixel_size(GLenum format, GLenum type) {
+    size_t components, size;
+    switch(type) {
+    case GL_UNSIGNED_BYTE_3_3_2: case GL_UNSIGNED_BYTE_2_3_3_REV:
+        return 1;
+    case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_5_6_5_REV:
+    case GL_UNSIGNED_SHORT_4_4_4_4: case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+    case GL_UNSIGNED_SHORT_5_5_5_1: case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+        return 2;
+    case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV:
+    case GL_UNSIGNED_INT_10_10_10_2: case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_10F_11F_11F_REV: case GL_UNSIGNED_INT_5_9_9_9_REV:
+        return 4;
+    case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+        return 8;
+    case GL_UNSIGNED_BYTE: case GL_BYTE:
+        size = 1; break;
+    case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT:
+        size = 2; break;
+    case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT:
+        size = 4; break;
+    default:
+        return 0;
+    }
+    switch(format) {
+    case GL_RG: case GL_RG_INTEGER: case GL_DEPTH_STENCIL:
+        components = 2; break;
+    case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: case GL_BGR_INTEGER:
+        components = 3; break;
+    case GL_RGBA: case GL_BGRA: case GL_RGBA_INTEGER: case GL_BGRA_INTEGER:
+        components = 4; break;
+    default:
+        components = 1; break;
+    }
+    return components * size;
+}
+
+/* bytes GL reads for an upload of width pixels, by height rows (0 for 1D), by depth
+ * images (0 for 1D and 2D), under the unpack state set now */
+static size_t trace_image_size(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type) {
+    size_t pixel = trace_pixel_size(format, type), row, image;
+    GLint alignment = trace_get(GL_UNPACK_ALIGNMENT), row_length = trace_get(GL_UNPACK_ROW_LENGTH);
+    GLint image_height = trace_get(GL_UNPACK_IMAGE_HEIGHT), skip_pixels = trace_get(GL_UNPACK_SKIP_PIXELS);
+    GLint skip_rows = height > 0 ? trace_get(GL_UNPACK_SKIP_ROWS) : 0;
+    GLint skip_images = depth > 0 ? trace_get(GL_UNPACK_SKIP_IMAGES) : 0;
+    if(width <= 0 || height < 0 || depth < 0 || pixel == 0) return 0;
+    if(alignment < 1) alignment = 1;
+    row = pixel * (size_t)(row_length > 0 ? row_length : width);
+    row = (row + (size_t)alignment - 1) / (size_t)alignment * (size_t)alignment;
+    image = row * (size_t)(image_height > 0 ? image_height : height > 0 ? height : 1);
+    return image * (size_t)(depth > 0 ? skip_images + depth - 1 : 0)
+        + row * (size_t)(height > 0 ? skip_rows + height - 1 : 0)
+        + pixel * (size_t)(skip_pixels + width);
+}
+
+/* pixels an upload reads: an offset when a pixel unpack buffer is bound */
+static void trace_unpack(const void *pixels, size_t size) {
+    if(trace_get(GL_PIXEL_UNPACK_BUFFER_BINDING) != 0) trace_pointer_offset(pixels);
+    else trace_bytes(pixels, size);
+}
+
+/* where a read writes its pixels: an offset when a pixel pack buffer is bound */
+static void trace_pack(const void *pixels) {
+    if(trace_get(GL_PIXEL_PACK_BUFFER_BINDING) != 0) trace_pointer_offset(pixels);
+    else trace_sink(pixels);
+}
+
+/* values in a glTexParameter*v / glSamplerParameter*v array */
+static GLsizei trace_parameter_count(GLenum pname) {
+    return pname == GL_TEXTURE_BORDER_COLOR || pname == GL_TEXTURE_SWIZZLE_RGBA ? 4 : 1;
+}
+
+/* mapped buffers, so what was written through the pointer can go into the trace
+ * when the buffer is unmapped; the replay keeps the same table for its own maps */
+struct trace_mapping {
+    int named; /* key is a buffer name rather than a target */
+    GLuint key;
+    void *pointer;
+    size_t length;
+    GLbitfield access;
+};
+static struct trace_mapping trace_mappings[TRACE_MAPPINGS];
+
+static GLbitfield trace_map_access(GLenum access) {
+    return access == GL_READ_ONLY ? GL_MAP_READ_BIT : access == GL_WRITE_ONLY ? GL_MAP_WRITE_BIT : GL_MAP_READ_BIT | GL_MAP_WRITE_BIT;
+}
+
+static void track_mapping(struct trace_mapping *mappings, int named, GLuint key, void *pointer, size_t length, GLbitfield access) {
+    int index, slot = -1;
+    if(pointer == NULL) return;
+    for(index = 0; index < TRACE_MAPPINGS; index++) {
+        if(mappings[index].pointer != NULL && mappings[index].named == named && mappings[index].key == key) slot = index;
+        else if(slot < 0 && mappings[index].pointer == NULL) slot = index;
+    }
+    if(slot < 0) return;
+    if(length == 0) { /* glMapBuffer maps it all */
+        GLint size = 0;
+        if(named) glad_real_glGetNamedBufferParameteriv(key, GL_BUFFER_SIZE, &size);
+        else glad_real_glGetBufferParameteriv(key, GL_BUFFER_SIZE, &size);
+        length = size > 0 ? (size_t)size : 0;
+    }
+    mappings[slot].named = named;
+    mappings[slot].key = key;
+    mappings[slot].pointer = pointer;
+    mappings[slot].length = length;
+    mappings[slot].access = access;
+}
+
+static struct trace_mapping take_mapping(struct trace_mapping *mappings, int named, GLuint key) {
+    struct trace_mapping mapping = {0, 0, NULL, 0, 0};
+    int index;
+    for(index = 0; index < TRACE_MAPPINGS; index++) {
+        if(mappings[index].pointer != NULL && mappings[index].named == named && mappings[index].key == key) {
+            mapping = mappings[index];
+            mappings[index].pointer = NULL;
+        }
+    }
+    return mapping;
+}
+
+/* recorded before the unmap: what the mapped range holds now, if it could be written */
+static void trace_unmap(int named, GLuint key) {
+    struct trace_mapping mapping = take_mapping(trace_mappings, named, key);
+    if(mapping.pointer != NULL && (mapping.access & GL_MAP_WRITE_BIT)) trace_bytes(mapping.pointer, mapping.length);
+    else trace_marker(TRACE_NULL);
+}
+
+@WRAPPERS@
+
+/* a pointer that already holds its wrapper was not reloaded, and keeps its real function */
+#define GLAD_TRACE_INSTALL(name) \
+    if(glad_##name != glad_traced_##name) { \
+        glad_real_##name = glad_##name; \
+        if(glad_##name != NULL) glad_##name = glad_traced_##name; \
+    }
+static void install_trace(void) {
+@INSTALL@
+}
+#undef GLAD_TRACE_INSTALL
+
+int gladTraceBegin(const char *path) {
+    static const char magic[8] = {'G', 'L', 'A', 'D', 'T', 'R', 'C', '1'};
+    GLint viewport[4] = {0, 0, 0, 0};
+    khronos_uint32_t count = GLAD_TRACE_COUNT;
+    int index;
+    if(trace_file != NULL || glad_real_glGetIntegerv == NULL) return 0;
+#ifdef _MSC_VER
+    if(fopen_s(&trace_file, path, "wb") != 0) trace_file = NULL;
+#else
+    trace_file = fopen(path, "wb");
+#endif
+    if(trace_file == NULL) return 0;
+
+    trace_used = 0;
+    trace_written = 0;
+    trace_failed = 0;
+    glad_real_glGetIntegerv(GL_VIEWPORT, viewport);
+    trace_write(magic, sizeof(magic));
+    trace_write(viewport, sizeof(viewport));
+    TRACE_VALUE(count);
+    for(index = 0; index < GLAD_TRACE_COUNT; index++) {
+        khronos_uint16_t length = (khronos_uint16_t)strlen(trace_names[index]);
+        TRACE_VALUE(length);
+        trace_write(trace_names[index], length);
+    }
+    return !trace_failed;
+}
+
+void gladTraceFrame(void) {
+    trace_call(TRACE_FRAME);
+}
+
+int gladTraceEnd(void) {
+    int ok;
+    if(trace_file == NULL) return 0;
+    trace_flush();
+    ok = !trace_failed;
+    if(fclose(trace_file) != 0) ok = 0;
+    trace_file = NULL;
+    memset(trace_mappings, 0, sizeof(trace_mappings));
+    return ok;
+}
+
+/* Replay: the whole file is read into memory first, so a frame costs only the
+ * decoding and the GL calls. Calls go through the real function pointers, not the
+ * wrappers; the trace's function numbers are mapped to ours by name. */
+struct gladTraceReplay {
+    unsigned char *data;
+    size_t size, position;
+    size_t length; /* of the bytes replay_data last returned */
+    int failed;
+    khronos_uint32_t functions; /* in the trace */
+    int *function; /* trace function number -> ours, -1 if we don't have it */
+    unsigned char *sink, *temp;
+    size_t sink_size, temp_size;
+    struct { khronos_uint64_t recorded; GLsync sync; } syncs[64];
+    int next_sync;
+    struct trace_mapping mappings[TRACE_MAPPINGS];
+    struct gladTraceInfo info;
+};
+
+static void replay_read(struct gladTraceReplay *replay, void *value, size_t size) {
+    if(replay->position + size > replay->size) {
+        replay->failed = 1;
+        memset(value, 0, size);
+        return;
+    }
+    memcpy(value, replay->data + replay->position, size);
+    replay->position += size;
+}
+#define REPLAY_VALUE(value) replay_read(replay, &(value), sizeof(value))
+
+static void *replay_buffer(struct gladTraceReplay *replay, unsigned char **buffer, size_t *capacity, size_t size) {
+    if(size < ((size_t)1 << 16)) size = (size_t)1 << 16;
+    if(size > *capacity) {
+        unsigned char *grown = (unsigned char *)realloc(*buffer, size);
+        if(grown == NULL) {
+            replay->failed = 1;
+            return NULL;
+        }
+        *buffer = grown;
+        *capacity = size;
+    }
+    return *buffer;
+}
+
+static void *replay_sink(struct gladTraceReplay *replay, size_t size) {
+    return replay_buffer(replay, &replay->sink, &replay->sink_size, size);
+}
+
+/* a pointer argument: into the trace's bytes, an offset, the sink, or NULL */
+static void *replay_data(struct gladTraceReplay *replay, size_t sink_size) {
+    khronos_uint32_t length;
+    khronos_uint64_t offset;
+    REPLAY_VALUE(length);
+    if(length == TRACE_NULL) return NULL;
+    if(length == TRACE_OFFSET) {
+        REPLAY_VALUE(offset);
+        return (void *)(khronos_uintptr_t)offset;
+    }
+    if(length == TRACE_SINK) return replay_sink(replay, sink_size);
+    replay->position += (8 - replay->position % 8) % 8;
+    if(replay->failed || replay->position + length > replay->size) {
+        replay->failed = 1;
+        return NULL;
+    }
+    replay->position += length;
+    replay->length = length;
+    return replay->data + replay->position - length;
+}
+
+static const GLchar *const *replay_strings(struct gladTraceReplay *replay, GLsizei count) {
+    const GLchar *string = (const GLchar *)replay_data(replay, 0);
+    const GLchar *end;
+    const GLchar **strings;
+    GLsizei index;
+    if(string == NULL || count <= 0) return NULL;
+    end = string + replay->length;
+    strings = (const GLchar **)replay_buffer(replay, &replay->temp, &replay->temp_size, (size_t)count * sizeof(*strings));
+    if(strings == NULL) return NULL;
+    for(index = 0; index < count; index++) {
+        /* every string's terminator must be in the recorded bytes, or the file is damaged */
+        const GLchar *terminator = (const GLchar *)memchr(string, '\0', (size_t)(end - string));
+        if(terminator == NULL) {
+            replay->failed = 1;
+            return NULL;
+        }
+        strings[index] = string;
+        string = terminator + 1;
+    }
+    return strings;
+}
+
+static const void *const *replay_offsets(struct gladTraceReplay *replay) {
+    const unsigned char *offset = (const unsigned char *)replay_data(replay, 0);
+    size_t count = replay->length / sizeof(khronos_uint64_t), index;
+    const void **pointers;
+    if(offset == NULL || count == 0) return NULL;
+    pointers = (const void **)replay_buffer(replay, &replay->temp, &replay->temp_size, count * sizeof(*pointers));
+    if(pointers == NULL) return NULL;
+    for(index = 0; index < count; index++) {
+        khronos_uint64_t value;
+        memcpy(&value, offset + index * sizeof(value), sizeof(value));
+        pointers[index] = (const void *)(khronos_uintptr_t)value;
+    }
+    return pointers;
+}
+
+static GLsync replay_sync(struct gladTraceReplay *replay) {
+    khronos_uint64_t recorded;
+    int index;
+    REPLAY_VALUE(recorded);
+    for(index = 0; index < 64; index++)
+        if(replay->syncs[index].sync != NULL && replay->syncs[index].recorded == recorded) return replay->syncs[index].sync;
+    return NULL;
+}
+
+/* a deleted sync's handle can come back for a new one, which then takes its place */
+static void replay_add_sync(struct gladTraceReplay *replay, khronos_uint64_t recorded, GLsync sync) {
+    int index, slot = replay->next_sync;
+    for(index = 0; index < 64; index++)
+        if(replay->syncs[index].sync != NULL && replay->syncs[index].recorded == recorded) slot = index;
+    if(slot == replay->next_sync) replay->next_sync = (replay->next_sync + 1) % 64;
+    replay->syncs[slot].recorded = recorded;
+    replay->syncs[slot].sync = sync;
+}
+
+/* object names: a fresh context hands out the same ones for the same calls, which
+ * the replay counts on; if not, the calls after this one use the wrong objects */
+static void replay_names(struct gladTraceReplay *replay, const GLuint *names, const void *recorded, GLsizei count) {
+    if(names != NULL && recorded != NULL && count > 0 && memcmp(names, recorded, (size_t)count * sizeof(GLuint)) != 0)
+        replay->info.mismatches++;
+}
+
+static void replay_unmap(struct gladTraceReplay *replay, int named, GLuint key, const void *data) {
+    struct trace_mapping mapping = take_mapping(replay->mappings, named, key);
+    if(mapping.pointer == NULL || data == NULL) return;
+    memcpy(mapping.pointer, data, mapping.length);
+    if(!(mapping.access & GL_MAP_FLUSH_EXPLICIT_BIT)) return;
+    if(named) glad_real_glFlushMappedNamedBufferRange(key, 0, (GLsizeiptr)mapping.length);
+    else glad_real_glFlushMappedBufferRange(key, 0, (GLsizeiptr)mapping.length);
+}
+
+/* decoded without running off the end, and the function exists here */
+#define REPLAY_READY(function) (!replay->failed && ((function) != NULL || (replay->info.skipped++, 0)))
+
+static void replay_call(struct gladTraceReplay *replay, int number) {
+    switch(number) {
+@CASES@
+    }
+}
+
+struct gladTraceReplay *gladTraceReplayOpen(const char *path) {
+    struct gladTraceReplay *replay;
+    FILE *file = NULL;
+    char magic[8];
+    GLint viewport[4];
+    long size;
+    khronos_uint32_t index;
+#ifdef _MSC_VER
+    if(fopen_s(&file, path, "rb") != 0) file = NULL;
+#else
+    file = fopen(path, "rb");
+#endif
+    if(file == NULL) return NULL;
+    replay = (struct gladTraceReplay *)calloc(1, sizeof(*replay));
+    if(replay == NULL || fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0) {
+        fclose(file);
+        free(replay);
+        return NULL;
+    }
+    replay->size = (size_t)size;
+    replay->data = (unsigned char *)malloc(replay->size > 0 ? replay->size : 1);
+    if(replay->data == NULL || fread(replay->data, 1, replay->size, file) != replay->size) replay->failed = 1;
+    fclose(file);
+
+    REPLAY_VALUE(magic);
+    REPLAY_VALUE(viewport);
+    REPLAY_VALUE(replay->functions);
+    if(replay->failed || memcmp(magic, "GLADTRC1", sizeof(magic)) != 0 || replay->functions > TRACE_FRAME) {
+        gladTraceReplayClose(replay);
+        return NULL;
+    }
+    replay->info.width = viewport[2];
+    replay->info.height = viewport[3];
+    replay->function = (int *)malloc((replay->functions > 0 ? replay->functions : 1) * sizeof(int));
+    if(replay->function == NULL) {
+        gladTraceReplayClose(replay);
+        return NULL;
+    }
+    for(index = 0; index < replay->functions; index++) {
+        khronos_uint16_t length;
+        int ours;
+        REPLAY_VALUE(length);
+        replay->function[index] = -1;
+        if(replay->failed || replay->position + length > replay->size) break;
+        for(ours = 0; ours < GLAD_TRACE_COUNT; ours++) {
+            if(strlen(trace_names[ours]) == length && memcmp(trace_names[ours], replay->data + replay->position, length) == 0) {
+                replay->function[index] = ours;
+                break;
+            }
+        }
+        replay->position += length;
+    }
+    if(replay->failed || index < replay->functions) {
+        gladTraceReplayClose(replay);
+        return NULL;
+    }
+    return replay;
+}
+
+int gladTraceReplayFrame(struct gladTraceReplay *replay) {
+    int called = 0;
+    while(!replay->failed && replay->position < replay->size) {
+        khronos_uint16_t number;
+        REPLAY_VALUE(number);
+        if(number == TRACE_FRAME) {
+            called = 1;
+            break;
+        }
+        if(number >= replay->functions || replay->function[number] < 0) {
+            replay->failed = 1;
+            break;
+        }
+        replay->info.calls++;
+        replay_call(replay, replay->function[number]);
+        called = 1;
+    }
+    if(replay->failed) return -1;
+    if(called) replay->info.frames++; /* the last frame may have no marker */
+    return called;
+}
+
+const struct gladTraceInfo *gladTraceReplayInfo(const struct gladTraceReplay *replay) {
+    return &replay->info;
+}
+
+void gladTraceReplayClose(struct gladTraceReplay *replay) {
+    if(replay == NULL) return;
+    free(replay->data);
+    free(replay->function);
+    free(replay->sink);
+    free(replay->temp);
+    free(replay);
+}
+#undef TRACE_VALUE
+#undef REPLAY_VALUE
+#undef REPLAY_READY
+#endif
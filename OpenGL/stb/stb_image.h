@@ -253,6 +253,20 @@ RECENT REVISION HISTORY:
 //
 // ===========================================================================
 //
+// File input
+//
+// stbi_load, stbi_load_from_file and the other FILE-based functions do not
+// read through the I/O callback buffer when they can avoid it. A file of up
+// to STBI_FILE_BLOCK_SIZE bytes (default 64KB) is read with a single fread,
+// and a larger regular file is memory-mapped (mmap on POSIX, MapViewOfFile
+// on Windows); both are then decoded exactly like stbi_load_from_memory.
+// Streams that cannot be mapped, such as pipes, are read in
+// STBI_FILE_BLOCK_SIZE blocks. Define STBI_NO_MMAP to never map files.
+//
+// As before, the FILE is left positioned just past the image data.
+//
+// ===========================================================================
+//
 // SIMD support
 //
 // The JPEG decoder will try to automatically use SIMD kernels on x86 when
@@ -268,6 +282,12 @@ RECENT REVISION HISTORY:
 // (at least this is true for iOS and Android). Therefore, the NEON support is
 // toggled by a build flag: define STBI_NEON to get NEON loops.
 //
+// Changing the channel count (desired_channels != channels in file) uses SSSE3
+// shuffles when the compiler targets SSSE3 (-mssse3 on GCC/Clang; checked at
+// run time on MSVC). PNG and PNM convert each row as it is decoded, so no
+// second full-size image is allocated; JPEG always writes the requested
+// channel count directly from its color conversion.
+//
 // If for some reason you do not want to use any of SIMD code, or if
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
@@ -307,6 +327,20 @@ RECENT REVISION HISTORY:
 //
 //     stbi_is_hdr(char *filename);
 //
+// For textures there are two more compact outputs. stbi_loadf16 returns IEEE
+// half floats for glTexImage2D with GL_HALF_FLOAT, e.g. into GL_RGB16F or
+// GL_R11F_G11F_B10F storage. stbi_load_rgb9e5 returns one packed 32-bit
+// texel per pixel for GL_RGB9_E5 with GL_UNSIGNED_INT_5_9_9_9_REV; it is
+// always RGB. Radiance pixels go to either form without an intermediate
+// float image, and RGBE maps onto RGB9E5 with integer shifts only. Halves
+// are rounded to nearest even, and values above 65504 clamp to 65504
+// instead of becoming infinity. Other file types are loaded as with
+// stbi_loadf and then converted.
+//
+// The half conversion uses F16C when the compiler targets it (-mf16c or
+// -march with F16C on GCC/Clang; checked at runtime on MSVC), otherwise
+// SSE2, with identical results.
+//
 // ===========================================================================
 //
 // iPhone PNG support:
@@ -323,6 +357,209 @@ RECENT REVISION HISTORY:
 //
 // ===========================================================================
 //
+// Arena allocation   (disable by defining STBI_NO_ARENA)
+//
+// A single load makes many short-lived allocations: the zlib output buffer,
+// JPEG component planes, format conversion buffers and so on. When loading
+// lots of images on a worker thread, you can have all of those served from
+// a bump-pointer arena instead:
+//
+//     stbi_arena *arena = stbi_arena_create(8 << 20);
+//     stbi_set_arena_thread(arena);
+//     ... any number of stbi_load* calls on this thread ...
+//     stbi_set_arena_thread(NULL);
+//     stbi_arena_destroy(arena);
+//
+// The arena is reset after every load, and the final image is copied out
+// into a single STBI_MALLOC block (vertical flipping is folded into that
+// copy), so the result is still released with stbi_image_free(). When a
+// load outgrows the arena, it chains extra blocks and merges them into one
+// on the next reset; in steady state each load then costs exactly one heap
+// allocation. stbi_arena_stats() reports the capacity and the number of
+// heap blocks the arena has allocated so far.
+//
+// The arena is per-thread if the compiler supports thread-local variables
+// and process-wide otherwise. Animated GIF loading and the zlib client API
+// always use STBI_MALLOC.
+//
+// ===========================================================================
+//
+// Reusable decoders
+//
+// Every ordinary load starts from nothing: the decoder state, the zlib
+// output and JPEG component buffers are allocated, and every Huffman table
+// in the file is rebuilt. For bulk loading of many small images, give each
+// worker thread a stbi_decoder and load through it instead:
+//
+//     stbi_decoder *decoder = stbi_decoder_create();
+//     for (each file)
+//        pixels = stbi_decoder_load_from_memory(decoder, buffer, len,
+//                                               &x, &y, &n, STBI_rgb_alpha);
+//     stbi_decoder_destroy(decoder);
+//
+// A decoder owns an arena (see above, the thread's own arena is not used
+// while loading through a decoder) whose single block stays sized for the
+// largest image loaded so far. It also keeps the JPEG Huffman tables it has
+// built: a DHT segment identical to one seen before, as in nearly every file
+// from the same camera or encoder, is copied instead of rebuilt. PNG's fixed
+// deflate tables are likewise built once per decoder. stbi_decoder_stats()
+// reports the arena capacity and how many tables were reused.
+//
+// Results are ordinary images released with stbi_image_free(), except that
+// stbi_decoder_load_into_from_memory writes into your memory as described
+// under "Decoding into your own memory". A decoder may move between threads
+// but must only be used by one at a time. It is independent of STBI_NO_ARENA;
+// without the arena it only caches tables.
+//
+// ===========================================================================
+//
+// Per-call load settings
+//
+// stbi_set_flip_vertically_on_load, stbi_set_unpremultiply_on_load and
+// stbi_convert_iphone_png_to_rgb change process-wide state, and their
+// _thread variants only exist when the compiler has thread-local storage.
+// To give each load its own settings instead, fill in a stbi_load_params
+// (zero-initialize it; all-zero means 8-bit, the file's channels, no flip,
+// packed rows) and call stbi_load_with_params*:
+//
+//     stbi_load_params params = {0};
+//     params.desired_channels = STBI_rgb_alpha;
+//     params.flip_vertically = 1;
+//     pixels = (stbi_uc *) stbi_load_with_params(filename, &params, &x, &y, &n);
+//
+// The result holds stbi_us pixels when bits_per_channel is 16, and its rows
+// are stride_in_bytes apart when that is nonzero (the padding is left
+// uninitialized); free it with stbi_image_free(). The _into variants write to
+// your buffer instead, like stbi_load_into*. Setting params.decoder loads
+// through that decoder, so a worker can combine both.
+//
+// Loads with params never look at the stbi_set_* settings. Ordinary loads
+// read them once when they start, so no decoder reads global state per row
+// or per pixel either way.
+//
+// Row streaming, scaled JPEG decoding, float loads and GIF iterators take
+// the struct too, through stbi_load_rows_with_params*,
+// stbi_load_jpeg_scaled_with_params*, stbi_loadf_with_params*,
+// stbi_loadf16_with_params* and stbi_gif_open_with_params*. They honor desired_channels, flip_vertically,
+// convert_iphone_png and unpremultiply; every other field must be zero, or
+// the load fails with "unsupported params".
+//
+// Two settings exist only here. premultiply_alpha multiplies the color
+// channels of 2- and 4-channel images by alpha, so blending can use
+// GL_ONE, GL_ONE_MINUS_SRC_ALPHA and filtering doesn't bleed the color of
+// transparent texels. srgb_to_linear converts color from sRGB to linear
+// through a table, which needs 16 bits per channel to keep the dark end
+// (bits_per_channel 0 becomes 16; 8 is an error); with both set, color is
+// premultiplied after linearizing. They run as the last step of producing
+// each row: while an 8-bit image is widened to 16 bits or copied into the
+// stbi_load_with_params_into buffer, or in one pass over the result
+// otherwise. With AVX2 (-mavx2; detected at run time on MSVC) the 8-bit
+// premultiply and the RGBA linearize run 8 and 2 pixels per step.
+//
+// ===========================================================================
+//
+// Decoding into your own memory
+//
+// stbi_load_into* decodes straight into a buffer you provide, e.g. a mapped
+// pixel buffer object or a preallocated staging slab, with a row pitch of
+// your choosing. Query the layout first, then decode:
+//
+//     stbi_layout layout;
+//     if (stbi_info_layout_from_memory(buffer, len, STBI_rgba, 1, &layout)) {
+//        stbi_uc *dest = map_or_allocate(layout.size);
+//        stbi_load_into_from_memory(buffer, len, dest, layout.size, 0,
+//                                   &x, &y, &n, STBI_rgba);
+//     }
+//
+// A stride of 0 means tightly packed rows (layout.row_bytes); otherwise the
+// buffer must hold stride*(h-1) + row_bytes bytes, and the load fails with
+// "buffer too small" if out_size is less than that. Nothing is written to
+// the destination unless the image decodes successfully, except for JPEG
+// which writes rows as it color-converts them. Vertical flipping is applied
+// while writing, so it costs nothing extra.
+//
+// Baseline and progressive JPEG emit pixels directly into the destination.
+// Other formats decode into a scratch image and copy rows out of it; install
+// an arena (see above) so that scratch image never touches the heap.
+//
+// ===========================================================================
+//
+// Scaled and region JPEG decoding
+//
+// For thumbnails and low mip levels, stbi_load_jpeg_scaled* decodes a JPEG at
+// 1/2, 1/4 or 1/8 size directly: each 8x8 block goes through a reduced 4x4 or
+// 2x2 IDCT, or is just its DC term, so the full-size image never exists.
+// The result is (w+d-1)/d x (h+d-1)/d for scale_denom d, like libjpeg.
+//
+// stbi_load_jpeg_region* additionally returns only a rectangle of the scaled
+// image, with rx/ry/rw/rh measured in scaled pixels, top-down regardless of
+// stbi_set_flip_vertically_on_load. A rectangle hanging off the right or
+// bottom edge is clipped; *x and *y report the size actually returned.
+// Blocks outside the rectangle are still entropy-decoded (that's unavoidable)
+// but skip the IDCT, upsampling and color conversion, and baseline images
+// stop decoding once they're past the bottom of the rectangle.
+//
+// Both return NULL with "not JPEG" for any other format.
+//
+// ===========================================================================
+//
+// Streaming rows
+//
+// stbi_load_rows* never builds the whole image: finished rows are handed to
+// your callback in strips, top to bottom, as the decoder produces them.
+//
+//     void on_rows(void *user, int y0, int count, const stbi_uc *rows, int stride)
+//     {
+//        // rows y0 .. y0+count-1 of the image, stride bytes apart; the
+//        // memory is reused as soon as you return
+//     }
+//
+//     stbi_load_rows_from_memory(buffer, len, on_rows, user, &x, &y, &n, STBI_rgba);
+//
+// Call stbi_info_layout* first if you need the size before the first strip,
+// e.g. to allocate a texture and stream glTexSubImage2D uploads into it.
+// With stbi_set_flip_vertically_on_load, strips arrive bottom to top, each
+// already flipped and with y0 counted in the flipped image, so every strip
+// still covers rows y0 .. y0+count-1 of the image you asked for.
+//
+// Baseline JPEG and non-interlaced PNG decode incrementally. A baseline JPEG
+// keeps two MCU rows of each component (e.g. 32 lines of luma for 4:2:0);
+// a PNG keeps a 32KB inflate window plus a few scanlines, although its
+// compressed data is still read into memory first. Progressive JPEG has to
+// hold every coefficient until the last scan, but its pixels are still
+// produced and delivered a strip at a time. Interlaced PNG and all other
+// formats decode the whole image and hand it over as a single strip.
+// If decoding fails part way, some rows may already have been delivered.
+//
+// ===========================================================================
+//
+// GIF animation, one frame at a time
+//
+// stbi_load_gif_from_memory returns every frame in one buffer, so its size
+// grows with the length of the animation. stbi_gif_open* instead returns an
+// iterator that decodes the next frame on request, with memory that does not
+// depend on the frame count (about 17 bytes per pixel):
+//
+//     int w, h, delay_ms;
+//     stbi_gif_frames *frames = stbi_gif_open("anim.gif", &w, &h);
+//     stbi_uc *rgba = malloc(w * h * 4);
+//     while (stbi_gif_next_frame(frames, rgba, 0, &delay_ms) > 0) {
+//        // show rgba for delay_ms milliseconds
+//     }
+//     stbi_gif_close(frames);
+//
+// stbi_gif_next_frame writes the fully composited frame as RGBA, rows
+// stride_in_bytes apart (0 means w * 4), and returns 1. It returns 0 after
+// the last frame and -1 if the file is corrupt. stbi_gif_rewind restarts at
+// the first frame, for looping; a file source must be seekable. The
+// stbi_set_flip_vertically_on_load setting in effect when the iterator is
+// opened (or params.flip_vertically, for stbi_gif_open_with_params*)
+// applies to all its frames, so an iterator can be opened on one
+// thread and decoded on another. One iterator must not be used by two
+// threads at once.
+//
+// ===========================================================================
+//
 // ADDITIONAL CONFIGURATION
 //
 //  - You can suppress implementation of any of the decoders to reduce
@@ -429,6 +666,32 @@ STBIDEF stbi_uc *stbi_load_from_file  (FILE *f, int *x, int *y, int *channels_in
 
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp);
+
+// incremental GIF decoding; see "GIF animation, one frame at a time" above.
+// buffer must stay valid until stbi_gif_close
+typedef struct stbi__gif_frames stbi_gif_frames;
+STBIDEF stbi_gif_frames *stbi_gif_open_from_memory(stbi_uc const *buffer, int len, int *x, int *y);
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_gif_frames *stbi_gif_open(char const *filename, int *x, int *y);
+#endif
+STBIDEF int  stbi_gif_next_frame(stbi_gif_frames *frames, stbi_uc *out, int stride_in_bytes, int *delay_ms);
+STBIDEF int  stbi_gif_rewind    (stbi_gif_frames *frames);
+STBIDEF void stbi_gif_close     (stbi_gif_frames *frames);
+#endif
+
+#ifndef STBI_NO_JPEG
+// JPEG only: decode at 1/scale_denom of full size (scale_denom is 1, 2, 4 or
+// 8), and for the _region variants only the rw x rh rectangle at (rx,ry) of
+// that scaled image. see "Scaled and region JPEG decoding" above.
+STBIDEF stbi_uc *stbi_load_jpeg_scaled_from_memory   (stbi_uc const *buffer, int len, int scale_denom, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF stbi_uc *stbi_load_jpeg_scaled_from_callbacks(stbi_io_callbacks const *clbk, void *user, int scale_denom, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF stbi_uc *stbi_load_jpeg_region_from_memory   (stbi_uc const *buffer, int len, int scale_denom, int rx, int ry, int rw, int rh, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF stbi_uc *stbi_load_jpeg_region_from_callbacks(stbi_io_callbacks const *clbk, void *user, int scale_denom, int rx, int ry, int rw, int rh, int *x, int *y, int *channels_in_file, int desired_channels);
+
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_uc *stbi_load_jpeg_scaled(char const *filename, int scale_denom, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF stbi_uc *stbi_load_jpeg_region(char const *filename, int scale_denom, int rx, int ry, int rw, int rh, int *x, int *y, int *channels_in_file, int desired_channels);
+#endif
 #endif
 
 #ifdef STBI_WINDOWS_UTF8
@@ -448,6 +711,51 @@ STBIDEF stbi_us *stbi_load_16          (char const *filename, int *x, int *y, in
 STBIDEF stbi_us *stbi_load_from_file_16(FILE *f, int *x, int *y, int *channels_in_file, int desired_channels);
 #endif
 
+////////////////////////////////////
+//
+// decode into caller-provided memory
+//
+
+typedef struct
+{
+   int    w, h;                // image dimensions
+   int    channels_in_file;    // same as stbi_info's comp
+   int    channels;            // channels written: desired_channels, or channels_in_file if 0
+   int    bytes_per_channel;   // 1 for stbi_load_into*, 2 for stbi_load_16_into*
+   size_t row_bytes;           // w * channels * bytes_per_channel, the smallest legal stride
+   size_t size;                // row_bytes * h, the bytes needed for tightly packed rows
+} stbi_layout;
+
+STBIDEF int stbi_info_layout_from_memory   (stbi_uc const *buffer, int len, int desired_channels, int bytes_per_channel, stbi_layout *layout);
+STBIDEF int stbi_info_layout_from_callbacks(stbi_io_callbacks const *clbk, void *user, int desired_channels, int bytes_per_channel, stbi_layout *layout);
+
+STBIDEF int stbi_load_into_from_memory      (stbi_uc const *buffer, int len, stbi_uc *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_into_from_callbacks   (stbi_io_callbacks const *clbk, void *user, stbi_uc *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_16_into_from_memory   (stbi_uc const *buffer, int len, stbi_us *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_16_into_from_callbacks(stbi_io_callbacks const *clbk, void *user, stbi_us *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *channels_in_file, int desired_channels);
+
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_info_layout          (char const *filename, int desired_channels, int bytes_per_channel, stbi_layout *layout);
+STBIDEF int stbi_info_layout_from_file(FILE *f,              int desired_channels, int bytes_per_channel, stbi_layout *layout);
+
+STBIDEF int stbi_load_into            (char const *filename, stbi_uc *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_into_from_file  (FILE *f,              stbi_uc *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_16_into         (char const *filename, stbi_us *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_16_into_from_file(FILE *f,             stbi_us *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *channels_in_file, int desired_channels);
+// for stbi_load_into_from_file, file pointer is left pointing immediately after image
+#endif
+
+// row streaming, see "Streaming rows" above
+typedef void stbi_rows_callback(void *user, int y0, int count, const stbi_uc *rows, int stride_in_bytes);
+
+STBIDEF int stbi_load_rows_from_memory   (stbi_uc const *buffer, int len, stbi_rows_callback *on_rows, void *user, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_rows_from_callbacks(stbi_io_callbacks const *clbk, void *user, stbi_rows_callback *on_rows, void *rows_user, int *x, int *y, int *channels_in_file, int desired_channels);
+
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_rows               (char const *filename, stbi_rows_callback *on_rows, void *user, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_rows_from_file     (FILE *f,              stbi_rows_callback *on_rows, void *user, int *x, int *y, int *channels_in_file, int desired_channels);
+#endif
+
 ////////////////////////////////////
 //
 // float-per-channel interface
@@ -460,6 +768,19 @@ STBIDEF stbi_us *stbi_load_from_file_16(FILE *f, int *x, int *y, int *channels_i
    STBIDEF float *stbi_loadf            (char const *filename, int *x, int *y, int *channels_in_file, int desired_channels);
    STBIDEF float *stbi_loadf_from_file  (FILE *f, int *x, int *y, int *channels_in_file, int desired_channels);
    #endif
+
+   // texture-ready HDR data, see "HDR image support" above
+   STBIDEF stbi_us      *stbi_loadf16_from_memory       (stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels);
+   STBIDEF stbi_us      *stbi_loadf16_from_callbacks    (stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *channels_in_file, int desired_channels);
+   STBIDEF unsigned int *stbi_load_rgb9e5_from_memory   (stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file);
+   STBIDEF unsigned int *stbi_load_rgb9e5_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *channels_in_file);
+
+   #ifndef STBI_NO_STDIO
+   STBIDEF stbi_us      *stbi_loadf16              (char const *filename, int *x, int *y, int *channels_in_file, int desired_channels);
+   STBIDEF stbi_us      *stbi_loadf16_from_file    (FILE *f, int *x, int *y, int *channels_in_file, int desired_channels);
+   STBIDEF unsigned int *stbi_load_rgb9e5          (char const *filename, int *x, int *y, int *channels_in_file);
+   STBIDEF unsigned int *stbi_load_rgb9e5_from_file(FILE *f, int *x, int *y, int *channels_in_file);
+   #endif
 #endif
 
 #ifndef STBI_NO_HDR
@@ -488,6 +809,84 @@ STBIDEF const char *stbi_failure_reason  (void);
 // free the loaded image -- this is just free()
 STBIDEF void     stbi_image_free      (void *retval_from_stbi_load);
 
+#ifndef STBI_NO_ARENA
+// arena for decode temporaries; see "Arena allocation" in the documentation
+typedef struct stbi_arena stbi_arena;
+
+STBIDEF stbi_arena *stbi_arena_create    (size_t initial_capacity);
+STBIDEF void        stbi_arena_destroy   (stbi_arena *arena);
+STBIDEF void        stbi_arena_reset     (stbi_arena *arena);
+STBIDEF void        stbi_arena_stats     (stbi_arena const *arena, size_t *capacity, int *heap_allocs);
+
+// route the temporaries of every load made on the calling thread through
+// 'arena'; pass NULL to go back to STBI_MALLOC/STBI_FREE
+STBIDEF void        stbi_set_arena_thread(stbi_arena *arena);
+#endif
+
+// decoder state kept across loads; see "Reusable decoders" in the documentation
+typedef struct stbi_decoder stbi_decoder;
+
+STBIDEF stbi_decoder *stbi_decoder_create (void);
+STBIDEF void          stbi_decoder_destroy(stbi_decoder *decoder);
+STBIDEF void          stbi_decoder_stats  (stbi_decoder const *decoder, size_t *capacity, int *tables_reused);
+
+STBIDEF stbi_uc *stbi_decoder_load_from_memory     (stbi_decoder *decoder, stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF stbi_uc *stbi_decoder_load_from_callbacks  (stbi_decoder *decoder, stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int      stbi_decoder_load_into_from_memory(stbi_decoder *decoder, stbi_uc const *buffer, int len, stbi_uc *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *channels_in_file, int desired_channels);
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_uc *stbi_decoder_load                 (stbi_decoder *decoder, char const *filename, int *x, int *y, int *channels_in_file, int desired_channels);
+#endif
+
+// per-call load settings; see "Per-call load settings" in the documentation
+typedef struct
+{
+   int desired_channels;    // 0 keeps the file's channel count
+   int bits_per_channel;    // 8 (or 0) for stbi_uc pixels, 16 for stbi_us pixels
+   int flip_vertically;     // as stbi_set_flip_vertically_on_load
+   int convert_iphone_png;  // as stbi_convert_iphone_png_to_rgb
+   int unpremultiply;       // as stbi_set_unpremultiply_on_load
+   int stride_in_bytes;     // row pitch of the output; 0 for tightly packed rows
+   stbi_decoder *decoder;   // optional: load through this decoder
+   int premultiply_alpha;   // multiply color by alpha (images with 2 or 4 channels)
+   int srgb_to_linear;      // convert color from sRGB to linear; needs 16 bits per channel
+} stbi_load_params;
+
+STBIDEF void *stbi_load_with_params_from_memory        (stbi_uc const *buffer, int len, stbi_load_params const *params, int *x, int *y, int *channels_in_file);
+STBIDEF void *stbi_load_with_params_from_callbacks     (stbi_io_callbacks const *clbk, void *user, stbi_load_params const *params, int *x, int *y, int *channels_in_file);
+STBIDEF int   stbi_load_with_params_into_from_memory   (stbi_uc const *buffer, int len, stbi_load_params const *params, void *out, size_t out_size, int *x, int *y, int *channels_in_file);
+STBIDEF int   stbi_load_with_params_into_from_callbacks(stbi_io_callbacks const *clbk, void *user, stbi_load_params const *params, void *out, size_t out_size, int *x, int *y, int *channels_in_file);
+#ifndef STBI_NO_STDIO
+STBIDEF void *stbi_load_with_params                    (char const *filename, stbi_load_params const *params, int *x, int *y, int *channels_in_file);
+STBIDEF int   stbi_load_with_params_into               (char const *filename, stbi_load_params const *params, void *out, size_t out_size, int *x, int *y, int *channels_in_file);
+#endif
+
+// the other loads with per-call settings; only some fields apply, see "Per-call load settings"
+STBIDEF int stbi_load_rows_with_params_from_memory(stbi_uc const *buffer, int len, stbi_load_params const *params, stbi_rows_callback *on_rows, void *user, int *x, int *y, int *channels_in_file);
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_rows_with_params            (char const *filename, stbi_load_params const *params, stbi_rows_callback *on_rows, void *user, int *x, int *y, int *channels_in_file);
+#endif
+#ifndef STBI_NO_JPEG
+STBIDEF stbi_uc *stbi_load_jpeg_scaled_with_params_from_memory(stbi_uc const *buffer, int len, stbi_load_params const *params, int scale_denom, int *x, int *y, int *channels_in_file);
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_uc *stbi_load_jpeg_scaled_with_params            (char const *filename, stbi_load_params const *params, int scale_denom, int *x, int *y, int *channels_in_file);
+#endif
+#endif
+#ifndef STBI_NO_GIF
+// frames are always RGBA, so desired_channels doesn't apply
+STBIDEF stbi_gif_frames *stbi_gif_open_with_params_from_memory(stbi_uc const *buffer, int len, stbi_load_params const *params, int *x, int *y);
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_gif_frames *stbi_gif_open_with_params            (char const *filename, stbi_load_params const *params, int *x, int *y);
+#endif
+#endif
+#ifndef STBI_NO_LINEAR
+STBIDEF float   *stbi_loadf_with_params_from_memory  (stbi_uc const *buffer, int len, stbi_load_params const *params, int *x, int *y, int *channels_in_file);
+STBIDEF stbi_us *stbi_loadf16_with_params_from_memory(stbi_uc const *buffer, int len, stbi_load_params const *params, int *x, int *y, int *channels_in_file);
+#ifndef STBI_NO_STDIO
+STBIDEF float   *stbi_loadf_with_params              (char const *filename, stbi_load_params const *params, int *x, int *y, int *channels_in_file);
+STBIDEF stbi_us *stbi_loadf16_with_params            (char const *filename, stbi_load_params const *params, int *x, int *y, int *channels_in_file);
+#endif
+#endif
+
 // get image dimensions & components without fully decoding
 STBIDEF int      stbi_info_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp);
 STBIDEF int      stbi_info_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp);
@@ -596,6 +995,19 @@ STBIDEF int   stbi_zlib_decode_noheader_buffer(char *obuffer, int olen, const ch
 #include <stdio.h>
 #endif
 
+#if !defined(STBI_NO_STDIO) && !defined(STBI_NO_MMAP)
+   #if defined(_WIN32)
+      #include <io.h>         // _get_osfhandle
+      #include <sys/stat.h>
+   #elif (defined(__unix__) || defined(__APPLE__)) && !(defined(__STRICT_ANSI__) && !defined(_POSIX_C_SOURCE))
+      // strict ISO C modes hide fileno and posix_madvise unless POSIX is requested
+      #include <sys/mman.h>
+      #include <sys/stat.h>
+   #else
+      #define STBI_NO_MMAP
+   #endif
+#endif
+
 #ifndef STBI_ASSERT
 #include <assert.h>
 #define STBI_ASSERT(x) assert(x)
@@ -649,6 +1061,14 @@ typedef uint32_t stbi__uint32;
 typedef int32_t  stbi__int32;
 #endif
 
+#if !defined(STBI_NO_STDIO) && !defined(STBI_NO_MMAP)
+#ifdef _MSC_VER
+typedef __int64 stbi__int64;
+#else
+typedef long long stbi__int64;
+#endif
+#endif
+
 // should produce compiler error if size is wrong
 typedef unsigned char validate_uint32[sizeof(stbi__uint32)==4 ? 1 : -1];
 
@@ -748,7 +1168,7 @@ static int stbi__cpuid3(void)
 
 #define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if !(defined(STBI_NO_JPEG) && defined(STBI_NO_PNG) && defined(STBI_NO_HDR) && defined(STBI_NO_LINEAR)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    int info3 = stbi__cpuid3();
@@ -759,7 +1179,7 @@ static int stbi__sse2_available(void)
 #else // assume GCC-style if not VC++
 #define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if !(defined(STBI_NO_JPEG) && defined(STBI_NO_PNG) && defined(STBI_NO_HDR) && defined(STBI_NO_LINEAR)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    // If we're even attempting to compile this on GCC/Clang, that means
@@ -772,6 +1192,82 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// F16C half-float conversion, for stbi_loadf16. GCC/Clang follow the SSE2
+// rule above and only use it when it is enabled for the whole build (-mf16c);
+// VC++ accepts the intrinsics anywhere, so there it is checked at runtime.
+#if defined(STBI_SSE2) && !(defined(STBI_NO_HDR) && defined(STBI_NO_LINEAR))
+#if defined(__F16C__) || (defined(_MSC_VER) && _MSC_VER >= 1700)
+#define STBI__F16C
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+static int stbi__f16c_available(void)
+{
+   int info[4];
+   __cpuid(info,1);
+   // F16C is VEX-encoded, so the OS must also save the AVX registers (OSXSAVE + XCR0)
+   if (((info[2] >> 29) & 1) == 0 || ((info[2] >> 27) & 1) == 0) return 0;
+   return (_xgetbv(0) & 6) == 6;
+}
+#else
+static int stbi__f16c_available(void)
+{
+   return 1;
+}
+#endif
+#endif
+#endif
+
+// SSSE3 byte shuffles, for the channel-count conversion in stbi__convert_format;
+// enabled and detected the same way as F16C (-mssse3 on GCC/Clang).
+#if defined(STBI_SSE2) && !(defined(STBI_NO_PNG) && defined(STBI_NO_BMP) && defined(STBI_NO_PSD) && defined(STBI_NO_TGA) && defined(STBI_NO_GIF) && defined(STBI_NO_PIC) && defined(STBI_NO_PNM))
+#if defined(__SSSE3__) || (defined(_MSC_VER) && _MSC_VER >= 1500)
+#define STBI__SSSE3
+#include <tmmintrin.h>
+
+#ifdef _MSC_VER
+static int stbi__ssse3_available(void)
+{
+   int info[4];
+   __cpuid(info,1);
+   return (info[2] >> 9) & 1;
+}
+#else
+static int stbi__ssse3_available(void)
+{
+   return 1;
+}
+#endif
+#endif
+#endif
+
+// AVX2, for the premultiply and sRGB-to-linear output stage of
+// stbi_load_params; enabled and detected the same way as F16C (-mavx2).
+#if defined(STBI_SSE2)
+#if defined(__AVX2__) || (defined(_MSC_VER) && _MSC_VER >= 1700)
+#define STBI__AVX2
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+static int stbi__avx2_available(void)
+{
+   int info[4];
+   __cpuid(info,1);
+   // OSXSAVE + AVX, and the OS saves the YMM registers
+   if (((info[2] >> 27) & 1) == 0 || ((info[2] >> 28) & 1) == 0) return 0;
+   if ((_xgetbv(0) & 6) != 6) return 0;
+   __cpuidex(info,7,0);
+   return (info[1] >> 5) & 1;
+}
+#else
+static int stbi__avx2_available(void)
+{
+   return 1;
+}
+#endif
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -811,14 +1307,64 @@ typedef struct
    int read_from_callbacks;
    int buflen;
    stbi_uc buffer_start[128];
+   stbi_uc *io_buffer;    // buffer_start, or a larger block for FILE reads
    int callback_already_read;
 
    stbi_uc *img_buffer, *img_buffer_end;
    stbi_uc *img_buffer_original, *img_buffer_original_end;
+
+   // destination of stbi_load_into*; dest is NULL for ordinary loads
+   stbi_uc *dest;
+   size_t dest_size, dest_stride;
+   int dest_bytes_per_channel;
+   int dest_written;      // set by decoders that wrote straight into dest or on_rows
+
+   // stbi_load_jpeg_*: decode at 1/(1 << jpeg_scale_shift) size, and only the
+   // region roi_* of that (roi_w == roi_h == 0 for the whole image)
+   int jpeg_scale_shift;
+   int roi_x, roi_y, roi_w, roi_h;
+
+   // stbi_loadf16*, stbi_load_rgb9e5*: the STBI__HDR_* layout stbi__hdr_load produces
+   int hdr_format;
+
+   // stbi_load_rows*: rows go to on_rows instead of an image buffer
+   stbi_rows_callback *on_rows;
+   void *on_rows_user;
+
+   // stbi_decoder_load*: the decoder whose table caches this load uses
+   stbi_decoder *decoder;
+
+   // per-load settings, from stbi_load_params or else captured from the
+   // stbi_set_* calls when the load starts; decoders only ever read these
+   int flip, unpremultiply, de_iphone;
+   int premultiply, linear;  // output stage, only set by stbi_load_params
+
+#ifndef STBI_NO_STDIO
+   // set by stbi__start_file: the file offset the image starts at, and the
+   // mapping or read block that stbi__stop_file releases
+   long file_start;
+   void *file_block;
+   size_t file_block_size;
+   int file_mapped;
+#endif
 } stbi__context;
 
 
 static void stbi__refill_buffer(stbi__context *s);
+static void stbi__start_flags(stbi__context *s);
+
+// per-load options default to an ordinary full-image load into new memory
+static void stbi__start_options(stbi__context *s)
+{
+   stbi__start_flags(s);
+   s->dest = NULL;
+   s->on_rows = NULL;
+   s->decoder = NULL;
+   s->dest_written = 0;
+   s->jpeg_scale_shift = 0;
+   s->roi_x = s->roi_y = s->roi_w = s->roi_h = 0;
+   s->hdr_format = 0; // STBI__HDR_float
+}
 
 // initialize a memory-decode context
 static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
@@ -828,19 +1374,28 @@ static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
    s->callback_already_read = 0;
    s->img_buffer = s->img_buffer_original = (stbi_uc *) buffer;
    s->img_buffer_end = s->img_buffer_original_end = (stbi_uc *) buffer+len;
+   stbi__start_options(s);
 }
 
-// initialize a callback-based context
-static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *user)
+// initialize a callback-based context that reads through buffer[0..len)
+static void stbi__start_callbacks_buffer(stbi__context *s, stbi_io_callbacks *c, void *user, stbi_uc *buffer, int len)
 {
    s->io = *c;
    s->io_user_data = user;
-   s->buflen = sizeof(s->buffer_start);
+   s->io_buffer = buffer;
+   s->buflen = len;
    s->read_from_callbacks = 1;
    s->callback_already_read = 0;
-   s->img_buffer = s->img_buffer_original = s->buffer_start;
+   s->img_buffer = s->img_buffer_original = buffer;
    stbi__refill_buffer(s);
    s->img_buffer_original_end = s->img_buffer_end;
+   stbi__start_options(s);
+}
+
+// initialize a callback-based context
+static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *user)
+{
+   stbi__start_callbacks_buffer(s, c, user, s->buffer_start, (int) sizeof(s->buffer_start));
 }
 
 #ifndef STBI_NO_STDIO
@@ -872,12 +1427,127 @@ static stbi_io_callbacks stbi__stdio_callbacks =
    stbi__stdio_eof,
 };
 
+#if defined(_WIN32) && !defined(STBI_NO_MMAP)
+#ifdef _WIN64
+typedef unsigned __int64 stbi__win_size_t;
+#else
+typedef unsigned long stbi__win_size_t;
+#endif
+STBI_EXTERN __declspec(dllimport) void * __stdcall CreateFileMappingA(void *hFile, struct _SECURITY_ATTRIBUTES *attributes, unsigned long protect, unsigned long max_size_high, unsigned long max_size_low, const char *name);
+STBI_EXTERN __declspec(dllimport) void * __stdcall MapViewOfFile(void *mapping, unsigned long access, unsigned long offset_high, unsigned long offset_low, stbi__win_size_t bytes);
+STBI_EXTERN __declspec(dllimport) int __stdcall UnmapViewOfFile(const void *base);
+STBI_EXTERN __declspec(dllimport) int __stdcall CloseHandle(void *handle);
+#endif
+
+#ifndef STBI_FILE_BLOCK_SIZE
+#define STBI_FILE_BLOCK_SIZE  (64*1024)
+#endif
+
+// Files are decoded through the memory path whenever possible: files up to
+// STBI_FILE_BLOCK_SIZE are read with a single fread, larger regular files are
+// memory-mapped, and anything else (pipes, failed mappings) is streamed
+// through a STBI_FILE_BLOCK_SIZE buffer instead of the 128-byte one.
+#ifndef STBI_NO_MMAP
+static void *stbi__map_file(FILE *f, size_t size)
+{
+#if defined(_WIN32)
+   void *view = NULL;
+   void *mapping = CreateFileMappingA((void *) _get_osfhandle(_fileno(f)), NULL, 0x02 /* PAGE_READONLY */, 0, 0, NULL);
+   if (mapping) {
+      view = MapViewOfFile(mapping, 0x0004 /* FILE_MAP_READ */, 0, 0, 0);
+      CloseHandle(mapping);   // the view keeps the mapping alive
+   }
+   STBI_NOTUSED(size);
+   return view;
+#else
+   void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+   if (p == MAP_FAILED) return NULL;
+   posix_madvise(p, size, POSIX_MADV_SEQUENTIAL);
+   return p;
+#endif
+}
+
+static void stbi__unmap_file(void *p, size_t size)
+{
+#if defined(_WIN32)
+   STBI_NOTUSED(size);
+   UnmapViewOfFile(p);
+#else
+   munmap(p, size);
+#endif
+}
+
+// size of the file behind f, or -1 if it is not a regular file
+static stbi__int64 stbi__file_size(FILE *f)
+{
+#if defined(_WIN32)
+   struct __stat64 st;
+   if (_fstat64(_fileno(f), &st) != 0 || !(st.st_mode & _S_IFREG)) return -1;
+#else
+   struct stat st;
+   if (fstat(fileno(f), &st) != 0 || !S_ISREG(st.st_mode)) return -1;
+#endif
+   return (stbi__int64) st.st_size;
+}
+#endif // !STBI_NO_MMAP
+
 static void stbi__start_file(stbi__context *s, FILE *f)
 {
-   stbi__start_callbacks(s, &stbi__stdio_callbacks, (void *) f);
+   s->file_start = ftell(f);
+   s->file_block = NULL;
+   s->file_mapped = 0;
+#ifndef STBI_NO_MMAP
+   if (s->file_start >= 0) {
+      stbi__int64 size = stbi__file_size(f);
+      stbi__int64 len = size - s->file_start;
+      if (len > 0 && len <= STBI_FILE_BLOCK_SIZE) {
+         // small file: one read, then decode from memory
+         s->file_block = STBI_MALLOC((size_t) len);
+         if (s->file_block && fread(s->file_block, 1, (size_t) len, f) == (size_t) len) {
+            s->file_block_size = (size_t) len;
+            stbi__start_mem(s, (stbi_uc *) s->file_block, (int) len);
+            return;
+         }
+         STBI_FREE(s->file_block);
+         s->file_block = NULL;
+         fseek(f, s->file_start, SEEK_SET);
+      } else if (len > 0 && len <= INT_MAX) {
+         s->file_block = stbi__map_file(f, (size_t) size);
+         if (s->file_block) {
+            s->file_block_size = (size_t) size;
+            s->file_mapped = 1;
+            stbi__start_mem(s, (stbi_uc *) s->file_block + s->file_start, (int) len);
+            return;
+         }
+      }
+   }
+#endif
+   s->file_block = STBI_MALLOC(STBI_FILE_BLOCK_SIZE);
+   if (s->file_block)
+      stbi__start_callbacks_buffer(s, &stbi__stdio_callbacks, (void *) f, (stbi_uc *) s->file_block, STBI_FILE_BLOCK_SIZE);
+   else
+      stbi__start_callbacks(s, &stbi__stdio_callbacks, (void *) f);
 }
 
-//static void stop_file(stbi__context *s) { }
+// release what stbi__start_file acquired and leave f positioned just past
+// the bytes the decoder consumed
+static void stbi__stop_file(stbi__context *s, FILE *f)
+{
+   if (s->io.read == NULL) {
+      // decoded from memory; f has not moved unless the whole file was read
+      fseek(f, s->file_start + (long) (s->img_buffer - s->img_buffer_original), SEEK_SET);
+   } else {
+      // need to 'unget' all the characters in the IO buffer
+      fseek(f, - (int) (s->img_buffer_end - s->img_buffer), SEEK_CUR);
+   }
+#ifndef STBI_NO_MMAP
+   if (s->file_mapped)
+      stbi__unmap_file(s->file_block, s->file_block_size);
+   else
+#endif
+      STBI_FREE(s->file_block);
+   s->file_block = NULL;
+}
 
 #endif // !STBI_NO_STDIO
 
@@ -911,7 +1581,7 @@ static int      stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp);
 
 #ifndef STBI_NO_PNG
 static int      stbi__png_test(stbi__context *s);
-static void    *stbi__png_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri);
+static void    *stbi__png_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc);
 static int      stbi__png_info(stbi__context *s, int *x, int *y, int *comp);
 static int      stbi__png_is16(stbi__context *s);
 #endif
@@ -937,7 +1607,7 @@ static int      stbi__psd_is16(stbi__context *s);
 
 #ifndef STBI_NO_HDR
 static int      stbi__hdr_test(stbi__context *s);
-static float   *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri);
+static void    *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri);
 static int      stbi__hdr_info(stbi__context *s, int *x, int *y, int *comp);
 #endif
 
@@ -980,44 +1650,294 @@ static int stbi__err(const char *str)
 }
 #endif
 
-static void *stbi__malloc(size_t size)
-{
-    return STBI_MALLOC(size);
-}
-
-// stb_image uses ints pervasively, including for offset calculations.
-// therefore the largest decoded image size we can support with the
-// current code, even on 64-bit targets, is INT_MAX. this is not a
-// significant limitation for the intended use case.
+//////////////////////////////////////////////////////////////////////////////
 //
-// we do, however, need to make sure our size calculations don't
-// overflow. hence a few helper functions for size calculations that
-// multiply integers together, making sure that they're non-negative
-// and no overflow occurs.
+//  arena allocator
+//
+//  bump-pointer blocks; only the most recent allocation can be freed or grown
+//  in place, everything else is released at once by stbi_arena_reset.
+//  decoders never see the arena directly, they go through stbi__malloc,
+//  stbi__realloc_sized and stbi__free, which use it while a load is active.
 
-// return 1 if the sum is valid, 0 on overflow.
-// negative terms are considered invalid.
-static int stbi__addsizes_valid(int a, int b)
-{
-   if (b < 0) return 0;
-   // now 0 <= b <= INT_MAX, hence also
-   // 0 <= INT_MAX - b <= INTMAX.
-   // And "a + b <= INT_MAX" (which might overflow) is the
-   // same as a <= INT_MAX - b (no overflow)
-   return a <= INT_MAX - b;
-}
+#ifndef STBI_NO_ARENA
+#define STBI__ARENA_ALIGN(n)  (((n) + 15) & ~(size_t) 15)
 
-// returns 1 if the product is valid, 0 on overflow.
-// negative factors are considered invalid.
-static int stbi__mul2sizes_valid(int a, int b)
+typedef struct stbi__arena_block
 {
-   if (a < 0 || b < 0) return 0;
-   if (b == 0) return 1; // mul-by-0 is always safe
-   // portable way to check for no overflows in a*b
-   return a <= INT_MAX/b;
-}
+   struct stbi__arena_block *next;
+   size_t capacity;
+   size_t used;
+} stbi__arena_block;
 
-#if !defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG) || !defined(STBI_NO_TGA) || !defined(STBI_NO_HDR)
+#define STBI__ARENA_HEADER  STBI__ARENA_ALIGN(sizeof(stbi__arena_block))
+
+struct stbi_arena
+{
+   stbi__arena_block *head;  // block currently being bumped; older blocks follow
+   size_t capacity;          // sum of all block capacities
+   int heap_allocs;
+   stbi_uc *last;            // most recent allocation, can be freed/grown in place
+};
+
+static
+#ifdef STBI_THREAD_LOCAL
+STBI_THREAD_LOCAL
+#endif
+stbi_arena *stbi__arena_current;
+
+static
+#ifdef STBI_THREAD_LOCAL
+STBI_THREAD_LOCAL
+#endif
+int stbi__arena_depth;
+
+static stbi_uc *stbi__arena_block_data(stbi__arena_block *b)
+{
+   return (stbi_uc *) b + STBI__ARENA_HEADER;
+}
+
+static int stbi__arena_add_block(stbi_arena *a, size_t capacity)
+{
+   stbi__arena_block *b = (stbi__arena_block *) STBI_MALLOC(STBI__ARENA_HEADER + capacity);
+   if (b == NULL) return 0;
+   b->next = a->head;
+   b->capacity = capacity;
+   b->used = 0;
+   a->head = b;
+   a->capacity += capacity;
+   ++a->heap_allocs;
+   return 1;
+}
+
+STBIDEF stbi_arena *stbi_arena_create(size_t initial_capacity)
+{
+   stbi_arena *a = (stbi_arena *) STBI_MALLOC(sizeof(stbi_arena));
+   if (a == NULL) return NULL;
+   memset(a, 0, sizeof(*a));
+   if (initial_capacity && !stbi__arena_add_block(a, STBI__ARENA_ALIGN(initial_capacity))) {
+      STBI_FREE(a);
+      return NULL;
+   }
+   return a;
+}
+
+static void stbi__arena_free_blocks(stbi_arena *a)
+{
+   stbi__arena_block *b = a->head;
+   while (b) {
+      stbi__arena_block *next = b->next;
+      STBI_FREE(b);
+      b = next;
+   }
+   a->head = NULL;
+   a->capacity = 0;
+}
+
+STBIDEF void stbi_arena_destroy(stbi_arena *a)
+{
+   if (a == NULL) return;
+   if (stbi__arena_current == a) stbi__arena_current = NULL;
+   stbi__arena_free_blocks(a);
+   STBI_FREE(a);
+}
+
+STBIDEF void stbi_arena_reset(stbi_arena *a)
+{
+   a->last = NULL;
+   if (a->head && a->head->next) {
+      // the last load needed more than one block; replace the chain with one
+      // block big enough for all of it, so the next load of that size fits
+      size_t total = a->capacity;
+      stbi__arena_free_blocks(a);
+      stbi__arena_add_block(a, total);
+   } else if (a->head) {
+      a->head->used = 0;
+   }
+}
+
+STBIDEF void stbi_arena_stats(stbi_arena const *a, size_t *capacity, int *heap_allocs)
+{
+   if (capacity) *capacity = a->capacity;
+   if (heap_allocs) *heap_allocs = a->heap_allocs;
+}
+
+STBIDEF void stbi_set_arena_thread(stbi_arena *a)
+{
+   stbi__arena_current = a;
+}
+
+static void *stbi__arena_alloc(stbi_arena *a, size_t size)
+{
+   stbi__arena_block *b = a->head;
+   size = STBI__ARENA_ALIGN(size);
+   if (b == NULL || b->capacity - b->used < size) {
+      size_t capacity = b ? b->capacity * 2 : 65536;
+      if (capacity < size) capacity = size;
+      if (!stbi__arena_add_block(a, capacity)) return NULL;
+      b = a->head;
+   }
+   a->last = stbi__arena_block_data(b) + b->used;
+   b->used += size;
+   return a->last;
+}
+
+static int stbi__arena_owns(stbi_arena *a, void *p)
+{
+   stbi__arena_block *b;
+   for (b = a->head; b; b = b->next) {
+      stbi_uc *data = stbi__arena_block_data(b);
+      if ((stbi_uc *) p >= data && (stbi_uc *) p < data + b->capacity)
+         return 1;
+   }
+   return 0;
+}
+
+static void *stbi__arena_realloc(stbi_arena *a, void *p, size_t oldsz, size_t newsz)
+{
+   void *q;
+   if (p == NULL) return stbi__arena_alloc(a, newsz);
+   if ((stbi_uc *) p == a->last) {
+      stbi__arena_block *b = a->head;
+      size_t offset = a->last - stbi__arena_block_data(b);
+      if (b->capacity - offset >= STBI__ARENA_ALIGN(newsz)) {
+         b->used = offset + STBI__ARENA_ALIGN(newsz);
+         return p;
+      }
+   }
+   q = stbi__arena_alloc(a, newsz);
+   if (q) memcpy(q, p, oldsz < newsz ? oldsz : newsz);
+   return q;
+}
+
+static void stbi__arena_free(stbi_arena *a, void *p)
+{
+   if ((stbi_uc *) p == a->last) {
+      a->head->used = a->last - stbi__arena_block_data(a->head);
+      a->last = NULL;
+   }
+}
+#endif // STBI_NO_ARENA
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  reusable decoders
+//
+//  the arena is installed as the thread's arena for the duration of each
+//  stbi_decoder_load* call. the table caches are filled lazily by the JPEG
+//  (stbi__jpeg_reuse_huffman) and zlib (stbi__zbuild_fixed) decoders, which
+//  find the decoder through stbi__context.
+
+struct stbi__dht_cache;
+struct stbi__zfixed;
+
+struct stbi_decoder
+{
+#ifndef STBI_NO_ARENA
+   stbi_arena *arena;
+#endif
+   struct stbi__dht_cache *dht;  // JPEG Huffman tables built so far
+   struct stbi__zfixed *zfixed;  // deflate's fixed-code tables, once built
+   int tables_reused;
+};
+
+STBIDEF stbi_decoder *stbi_decoder_create(void)
+{
+   stbi_decoder *d = (stbi_decoder *) STBI_MALLOC(sizeof(stbi_decoder));
+   if (d == NULL) return NULL;
+   memset(d, 0, sizeof(*d));
+   #ifndef STBI_NO_ARENA
+   d->arena = stbi_arena_create(0); // the first load sizes it
+   if (d->arena == NULL) {
+      STBI_FREE(d);
+      return NULL;
+   }
+   #endif
+   return d;
+}
+
+STBIDEF void stbi_decoder_destroy(stbi_decoder *d)
+{
+   if (d == NULL) return;
+   #ifndef STBI_NO_ARENA
+   stbi_arena_destroy(d->arena);
+   #endif
+   STBI_FREE(d->dht);
+   STBI_FREE(d->zfixed);
+   STBI_FREE(d);
+}
+
+STBIDEF void stbi_decoder_stats(stbi_decoder const *d, size_t *capacity, int *tables_reused)
+{
+   #ifndef STBI_NO_ARENA
+   if (capacity) stbi_arena_stats(d->arena, capacity, NULL);
+   #else
+   if (capacity) *capacity = 0;
+   #endif
+   if (tables_reused) *tables_reused = d->tables_reused;
+}
+
+static void *stbi__malloc(size_t size)
+{
+   #ifndef STBI_NO_ARENA
+   if (stbi__arena_depth) return stbi__arena_alloc(stbi__arena_current, size);
+   #endif
+   return STBI_MALLOC(size);
+}
+
+static void *stbi__realloc_sized(void *p, size_t oldsz, size_t newsz)
+{
+   #ifndef STBI_NO_ARENA
+   if (stbi__arena_depth && (p == NULL || stbi__arena_owns(stbi__arena_current, p)))
+      return stbi__arena_realloc(stbi__arena_current, p, oldsz, newsz);
+   #endif
+   STBI_NOTUSED(oldsz);
+   return STBI_REALLOC_SIZED(p, oldsz, newsz);
+}
+
+static void stbi__free(void *p)
+{
+   #ifndef STBI_NO_ARENA
+   if (stbi__arena_depth && p && stbi__arena_owns(stbi__arena_current, p)) {
+      stbi__arena_free(stbi__arena_current, p);
+      return;
+   }
+   #endif
+   STBI_FREE(p);
+}
+
+// stb_image uses ints pervasively, including for offset calculations.
+// therefore the largest decoded image size we can support with the
+// current code, even on 64-bit targets, is INT_MAX. this is not a
+// significant limitation for the intended use case.
+//
+// we do, however, need to make sure our size calculations don't
+// overflow. hence a few helper functions for size calculations that
+// multiply integers together, making sure that they're non-negative
+// and no overflow occurs.
+
+// return 1 if the sum is valid, 0 on overflow.
+// negative terms are considered invalid.
+static int stbi__addsizes_valid(int a, int b)
+{
+   if (b < 0) return 0;
+   // now 0 <= b <= INT_MAX, hence also
+   // 0 <= INT_MAX - b <= INTMAX.
+   // And "a + b <= INT_MAX" (which might overflow) is the
+   // same as a <= INT_MAX - b (no overflow)
+   return a <= INT_MAX - b;
+}
+
+// returns 1 if the product is valid, 0 on overflow.
+// negative factors are considered invalid.
+static int stbi__mul2sizes_valid(int a, int b)
+{
+   if (a < 0 || b < 0) return 0;
+   if (b == 0) return 1; // mul-by-0 is always safe
+   // portable way to check for no overflows in a*b
+   return a <= INT_MAX/b;
+}
+
+#if !defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG) || !defined(STBI_NO_TGA) || !defined(STBI_NO_HDR) || !defined(STBI_NO_LINEAR) || !defined(STBI_NO_PNM)
 // returns 1 if "a*b + add" has no negative terms/factors and doesn't overflow
 static int stbi__mad2sizes_valid(int a, int b, int add)
 {
@@ -1041,7 +1961,7 @@ static int stbi__mad4sizes_valid(int a, int b, int c, int d, int add)
 }
 #endif
 
-#if !defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG) || !defined(STBI_NO_TGA) || !defined(STBI_NO_HDR)
+#if !defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG) || !defined(STBI_NO_TGA) || !defined(STBI_NO_HDR) || !defined(STBI_NO_LINEAR) || !defined(STBI_NO_PNM)
 // mallocs with size overflow checking
 static void *stbi__malloc_mad2(int a, int b, int add)
 {
@@ -1105,6 +2025,21 @@ STBIDEF void stbi_image_free(void *retval_from_stbi_load)
 static float   *stbi__ldr_to_hdr(stbi_uc *data, int x, int y, int comp);
 #endif
 
+#if !defined(STBI_NO_LINEAR) || !defined(STBI_NO_HDR)
+// pixel layouts the float interfaces can return
+enum
+{
+   STBI__HDR_float,     // comp floats
+   STBI__HDR_half,      // comp IEEE half floats
+   STBI__HDR_rgb9e5     // one GL_RGB9_E5 texel, always RGB
+};
+
+static int stbi__hdr_pixel_bytes(int format, int comp);
+#endif
+#ifndef STBI_NO_LINEAR
+static void *stbi__hdr_from_float(float *data, int pixels, int comp, int format);
+#endif
+
 #ifndef STBI_NO_HDR
 static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp);
 #endif
@@ -1142,7 +2077,7 @@ static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int re
    // test the formats with a very explicit header first (at least a FOURCC
    // or distinctive magic number first)
    #ifndef STBI_NO_PNG
-   if (stbi__png_test(s))  return stbi__png_load(s,x,y,comp,req_comp, ri);
+   if (stbi__png_test(s))  return stbi__png_load(s,x,y,comp,req_comp, ri, bpc);
    #endif
    #ifndef STBI_NO_BMP
    if (stbi__bmp_test(s))  return stbi__bmp_load(s,x,y,comp,req_comp, ri);
@@ -1171,7 +2106,7 @@ static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int re
 
    #ifndef STBI_NO_HDR
    if (stbi__hdr_test(s)) {
-      float *hdr = stbi__hdr_load(s, x,y,comp,req_comp, ri);
+      float *hdr = (float *) stbi__hdr_load(s, x,y,comp,req_comp, ri);
       return stbi__hdr_to_ldr(hdr, *x, *y, req_comp ? req_comp : *comp);
    }
    #endif
@@ -1197,26 +2132,221 @@ static stbi_uc *stbi__convert_16_to_8(stbi__uint16 *orig, int w, int h, int chan
    for (i = 0; i < img_len; ++i)
       reduced[i] = (stbi_uc)((orig[i] >> 8) & 0xFF); // top half of each byte is sufficient approx of 16->8 bit scaling
 
-   STBI_FREE(orig);
+   stbi__free(orig);
    return reduced;
 }
 
-static stbi__uint16 *stbi__convert_8_to_16(stbi_uc *orig, int w, int h, int channels)
+static void stbi__widen_row(stbi__context *s, stbi__uint16 *out, stbi_uc const *in, stbi__uint32 x, int n, int simd);
+static int stbi__output_simd(void);
+
+// widening replicates each byte to the high and low byte (0->0, 255->0xffff),
+// or goes through the sRGB-to-linear table with stbi_load_params
+static stbi__uint16 *stbi__convert_8_to_16(stbi__context *s, stbi_uc *orig, int w, int h, int channels)
 {
-   int i;
-   int img_len = w * h * channels;
+   int j, simd = stbi__output_simd();
+   size_t row_len = (size_t) w * channels;
    stbi__uint16 *enlarged;
 
-   enlarged = (stbi__uint16 *) stbi__malloc(img_len*2);
+   enlarged = (stbi__uint16 *) stbi__malloc(row_len*h*2);
    if (enlarged == NULL) return (stbi__uint16 *) stbi__errpuc("outofmem", "Out of memory");
 
-   for (i = 0; i < img_len; ++i)
-      enlarged[i] = (stbi__uint16)((orig[i] << 8) + orig[i]); // replicate to high and low byte, maps 0->0, 255->0xffff
+   for (j = 0; j < h; ++j)
+      stbi__widen_row(s, enlarged + row_len*j, orig + row_len*j, (stbi__uint32) w, channels, simd);
 
-   STBI_FREE(orig);
+   stbi__free(orig);
    return enlarged;
 }
 
+// the output stage of stbi_load_params: sRGB-to-linear conversion (to 16 bits)
+// and premultiplied alpha, applied a row at a time where the row is produced
+// or copied anyway. with 2 or 4 channels the last one is alpha, which is
+// neither linearized nor premultiplied.
+
+// linear value of each 8-bit sRGB value, scaled to 0..65535; the extra entry
+// lets a 32-bit gather read the last one and lets 16-bit input interpolate
+static const stbi__uint16 stbi__srgb_linear16[257] =
+{
+       0,   20,   40,   60,   80,   99,  119,  139,  159,  179,  199,  219,
+     241,  264,  288,  313,  340,  367,  396,  427,  458,  491,  526,  562,
+     599,  637,  677,  718,  761,  805,  851,  898,  947,  997, 1048, 1101,
+    1156, 1212, 1270, 1330, 1391, 1453, 1517, 1583, 1651, 1720, 1790, 1863,
+    1937, 2013, 2090, 2170, 2250, 2333, 2418, 2504, 2592, 2681, 2773, 2866,
+    2961, 3058, 3157, 3258, 3360, 3464, 3570, 3678, 3788, 3900, 4014, 4129,
+    4247, 4366, 4488, 4611, 4736, 4864, 4993, 5124, 5257, 5392, 5530, 5669,
+    5810, 5953, 6099, 6246, 6395, 6547, 6700, 6856, 7014, 7174, 7335, 7500,
+    7666, 7834, 8004, 8177, 8352, 8528, 8708, 8889, 9072, 9258, 9445, 9635,
+    9828,10022,10219,10417,10619,10822,11028,11235,11446,11658,11873,12090,
+   12309,12530,12754,12980,13209,13440,13673,13909,14146,14387,14629,14874,
+   15122,15371,15623,15878,16135,16394,16656,16920,17187,17456,17727,18001,
+   18277,18556,18837,19121,19407,19696,19987,20281,20577,20876,21177,21481,
+   21787,22096,22407,22721,23038,23357,23678,24002,24329,24658,24990,25325,
+   25662,26001,26344,26688,27036,27386,27739,28094,28452,28813,29176,29542,
+   29911,30282,30656,31033,31412,31794,32179,32567,32957,33350,33745,34143,
+   34544,34948,35355,35764,36176,36591,37008,37429,37852,38278,38706,39138,
+   39572,40009,40449,40891,41337,41785,42236,42690,43147,43606,44069,44534,
+   45002,45473,45947,46423,46903,47385,47871,48359,48850,49344,49841,50341,
+   50844,51349,51858,52369,52884,53401,53921,54445,54971,55500,56032,56567,
+   57105,57646,58190,58737,59287,59840,60396,60955,61517,62082,62650,63221,
+   63795,64372,64952,65535,65535
+};
+
+static int stbi__output_simd(void)
+{
+   #ifdef STBI__AVX2
+   return stbi__avx2_available();
+   #else
+   return 0;
+   #endif
+}
+
+// c * a / 255 and c * a / 65535, rounded
+#define STBI__MUL255(c,a)    ((((c)*(a) + 128) + (((c)*(a) + 128) >> 8)) >> 8)
+#define STBI__MUL65535(c,a)  ((((c)*(a) + 32768u) + (((c)*(a) + 32768u) >> 16)) >> 16)
+
+static void stbi__premultiply_row(stbi_uc *p, stbi__uint32 x, int n, int simd)
+{
+   stbi__uint32 i = 0;
+   int k;
+   if (n != 2 && n != 4) return;
+   #ifdef STBI__AVX2
+   if (simd) {
+      // 8 RGBA or 16 grey/alpha pixels per step, in 16-bit lanes: c*a fits, and
+      // so does the rounding divide by 255. alpha is broadcast over its pixel
+      // with word shuffles and put back with a word blend
+      __m256i zero = _mm256_setzero_si256(), round = _mm256_set1_epi16(128);
+      for (; i + 32 <= x * n; i += 32) {
+         __m256i v  = _mm256_loadu_si256((__m256i const *) (p + i));
+         __m256i lo = _mm256_unpacklo_epi8(v, zero), hi = _mm256_unpackhi_epi8(v, zero);
+         __m256i alo, ahi, tlo, thi;
+         if (n == 4) {
+            alo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo, 0xff), 0xff);
+            ahi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi, 0xff), 0xff);
+         } else {
+            alo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo, 0xf5), 0xf5);
+            ahi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi, 0xf5), 0xf5);
+         }
+         tlo = _mm256_add_epi16(_mm256_mullo_epi16(lo, alo), round);
+         thi = _mm256_add_epi16(_mm256_mullo_epi16(hi, ahi), round);
+         tlo = _mm256_srli_epi16(_mm256_add_epi16(tlo, _mm256_srli_epi16(tlo, 8)), 8);
+         thi = _mm256_srli_epi16(_mm256_add_epi16(thi, _mm256_srli_epi16(thi, 8)), 8);
+         if (n == 4) {
+            tlo = _mm256_blend_epi16(tlo, lo, 0x88);
+            thi = _mm256_blend_epi16(thi, hi, 0x88);
+         } else {
+            tlo = _mm256_blend_epi16(tlo, lo, 0xaa);
+            thi = _mm256_blend_epi16(thi, hi, 0xaa);
+         }
+         _mm256_storeu_si256((__m256i *) (p + i), _mm256_packus_epi16(tlo, thi));
+      }
+   }
+   #else
+   STBI_NOTUSED(simd);
+   #endif
+   for (; i < x * n; i += n) {
+      unsigned int a = p[i+n-1];
+      for (k=0; k < n-1; ++k)
+         p[i+k] = (stbi_uc) STBI__MUL255(p[i+k], a);
+   }
+}
+
+static void stbi__premultiply_row16(stbi__uint16 *p, stbi__uint32 x, int n)
+{
+   stbi__uint32 i;
+   int k;
+   if (n != 2 && n != 4) return;
+   for (i=0; i < x * n; i += n) {
+      stbi__uint32 a = p[i+n-1];
+      for (k=0; k < n-1; ++k)
+         p[i+k] = (stbi__uint16) STBI__MUL65535(p[i+k], a);
+   }
+}
+
+// 8-bit sRGB in, 16-bit linear out (premultiplied if asked), in one pass
+static void stbi__linearize_row(stbi__uint16 *out, stbi_uc const *in, stbi__uint32 x, int n, int premultiply, int simd)
+{
+   stbi__uint32 i = 0;
+   int k, colors = (n == 2 || n == 4) ? n-1 : n;
+   #ifdef STBI__AVX2
+   if (simd && n == 4) {
+      // 2 pixels per step in 32-bit lanes: gather the table entries of the color
+      // bytes, widen the alpha bytes, then c*a/65535 still fits 32 bits unsigned
+      __m256i low16 = _mm256_set1_epi32(0xffff), round = _mm256_set1_epi32(32768);
+      for (; i + 8 <= x * 4; i += 8) {
+         __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const *) (in + i)));
+         __m256i lin = _mm256_and_si256(_mm256_i32gather_epi32((int const *) stbi__srgb_linear16, idx, 2), low16);
+         __m256i a = _mm256_mullo_epi32(idx, _mm256_set1_epi32(257));
+         lin = _mm256_blend_epi32(lin, a, 0x88);
+         if (premultiply) {
+            __m256i t = _mm256_add_epi32(_mm256_mullo_epi32(lin, _mm256_shuffle_epi32(a, 0xff)), round);
+            t = _mm256_srli_epi32(_mm256_add_epi32(t, _mm256_srli_epi32(t, 16)), 16);
+            lin = _mm256_blend_epi32(t, a, 0x88);
+         }
+         lin = _mm256_permute4x64_epi64(_mm256_packus_epi32(lin, lin), 0x08);
+         _mm_storeu_si128((__m128i *) (out + i), _mm256_castsi256_si128(lin));
+      }
+   }
+   #else
+   STBI_NOTUSED(simd);
+   #endif
+   for (; i < x * n; i += n) {
+      stbi__uint32 a = colors < n ? in[i+n-1] * 257u : 65535u;
+      for (k=0; k < colors; ++k) {
+         stbi__uint32 c = stbi__srgb_linear16[in[i+k]];
+         out[i+k] = (stbi__uint16) (premultiply ? STBI__MUL65535(c, a) : c);
+      }
+      if (colors < n) out[i+n-1] = (stbi__uint16) a;
+   }
+}
+
+// in-place, for 16-bit sRGB: interpolate between the 8-bit table entries
+static void stbi__linearize_row16(stbi__uint16 *p, stbi__uint32 x, int n)
+{
+   stbi__uint32 i;
+   int k, colors = (n == 2 || n == 4) ? n-1 : n;
+   for (i=0; i < x * n; i += n) {
+      for (k=0; k < colors; ++k) {
+         stbi__uint32 v = p[i+k], j = v / 257, f = v % 257;
+         stbi__uint32 lo = stbi__srgb_linear16[j], hi = stbi__srgb_linear16[j+1];
+         p[i+k] = (stbi__uint16) (lo + ((hi - lo) * f + 128) / 257);
+      }
+   }
+}
+
+// apply the output stage to a finished row in place
+static void stbi__output_row(stbi__context *s, void *row, stbi__uint32 x, int n, int bytes_per_channel, int simd)
+{
+   if (bytes_per_channel == 2) {
+      if (s->linear) stbi__linearize_row16((stbi__uint16 *) row, x, n);
+      if (s->premultiply) stbi__premultiply_row16((stbi__uint16 *) row, x, n);
+   } else if (s->premultiply) {
+      stbi__premultiply_row((stbi_uc *) row, x, n, simd);
+   }
+}
+
+// widen an 8-bit row to 16 bits, applying the output stage on the way
+static void stbi__widen_row(stbi__context *s, stbi__uint16 *out, stbi_uc const *in, stbi__uint32 x, int n, int simd)
+{
+   stbi__uint32 i;
+   if (s->linear) {
+      stbi__linearize_row(out, in, x, n, s->premultiply, simd);
+      return;
+   }
+   for (i=0; i < x * n; ++i)
+      out[i] = (stbi__uint16) ((in[i] << 8) + in[i]);
+   if (s->premultiply) stbi__premultiply_row16(out, x, n);
+}
+
+// run the output stage over a whole image, for the paths with no row pass to
+// fold it into
+static void stbi__output_image(stbi__context *s, void *image, int w, int h, int n, int bytes_per_channel)
+{
+   int j, simd = stbi__output_simd();
+   size_t row_bytes = (size_t) w * n * bytes_per_channel;
+   if (!s->linear && !s->premultiply) return;
+   for (j=0; j < h; ++j)
+      stbi__output_row(s, (stbi_uc *) image + row_bytes * j, (stbi__uint32) w, n, bytes_per_channel, simd);
+}
+
 static void stbi__vertical_flip(void *image, int w, int h, int bytes_per_pixel)
 {
    int row;
@@ -1255,68 +2385,274 @@ static void stbi__vertical_flip_slices(void *image, int w, int h, int z, int byt
 }
 #endif
 
+// every top-level load runs between stbi__begin_load and stbi__end_load.
+// with an arena installed, the outermost pair makes the arena serve all of
+// the decoder's allocations; pairs nest (e.g. loadf on an LDR image goes
+// through the 8-bit path), and only the outermost one releases the arena.
+static void stbi__begin_load(void)
+{
+   #ifndef STBI_NO_ARENA
+   if (stbi__arena_current) ++stbi__arena_depth;
+   #endif
+}
+
+// apply the vertical flip and, when closing the outermost arena scope, move
+// the image into its own heap block (flipping during the copy) and reset
+static void *stbi__end_load(void *result, int w, int h, int bytes_per_pixel, int flip)
+{
+   #ifndef STBI_NO_ARENA
+   if (stbi__arena_depth && --stbi__arena_depth == 0) {
+      stbi_arena *a = stbi__arena_current;
+      if (result && stbi__arena_owns(a, result)) {
+         size_t row, bytes_per_row = (size_t) w * bytes_per_pixel;
+         stbi_uc *out = (stbi_uc *) STBI_MALLOC(bytes_per_row * h);
+         if (out) {
+            for (row = 0; row < (size_t) h; ++row) {
+               size_t src = flip ? (size_t) h - 1 - row : row;
+               memcpy(out + row*bytes_per_row, (stbi_uc *) result + src*bytes_per_row, bytes_per_row);
+            }
+         } else {
+            stbi__err("outofmem", "Out of memory");
+         }
+         stbi_arena_reset(a);
+         return out;
+      }
+      stbi_arena_reset(a);
+   }
+   #endif
+   if (result && flip)
+      stbi__vertical_flip(result, w, h, bytes_per_pixel);
+   return result;
+}
+
+// check that the stbi_load_into destination holds an h-row image with the
+// given pixel size; a zero stride becomes tightly packed rows
+static int stbi__dest_fits(stbi__context *s, int w, int h, int bytes_per_pixel)
+{
+   size_t row_bytes = (size_t) w * bytes_per_pixel;
+   if (s->dest_stride == 0) s->dest_stride = row_bytes;
+   if (s->dest_stride < row_bytes) return stbi__err("bad stride", "Row stride is smaller than a row of pixels");
+   if (h > 0 && s->dest_stride * (h-1) + row_bytes > s->dest_size) return stbi__err("buffer too small", "Destination buffer is too small for the image");
+   return 1;
+}
+
+// where output row y of an h-row image goes in the stbi_load_into destination
+static stbi_uc *stbi__dest_row(stbi__context *s, int h, int y)
+{
+   if (s->flip) y = h - 1 - y;
+   return s->dest + s->dest_stride * y;
+}
+
+#if defined(STBI_NO_JPEG) && defined(STBI_NO_PNG)
+// nothing
+#else
+// stbi_load_rows*: finished rows collect in a strip that is handed to the
+// callback when it fills up or the decoder flushes it. with vertical flip the
+// strip fills from the bottom, so each delivered strip is already flipped.
+typedef struct
+{
+   stbi__context *s;
+   stbi_uc *strip;
+   int row_bytes, rows;   // strip capacity
+   int h, flip;
+   int y, count;          // first image row in the strip, and rows in it
+} stbi__row_sink;
+
+// non-NULL result for decoders that delivered every row through the sink
+static stbi_uc stbi__rows_delivered;
+
+static int stbi__row_sink_init(stbi__row_sink *k, stbi__context *s, int w, int h, int bytes_per_pixel, int rows)
+{
+   if (rows > h) rows = h;
+   if (rows < 1) rows = 1;
+   k->s = s;
+   k->row_bytes = w * bytes_per_pixel;
+   k->rows = rows;
+   k->h = h;
+   k->flip = s->flip;
+   k->y = k->count = 0;
+   k->strip = (stbi_uc *) stbi__malloc_mad2(k->row_bytes, rows, 0);
+   if (!k->strip) return stbi__err("outofmem", "Out of memory");
+   return 1;
+}
+
+static void stbi__row_sink_flush(stbi__row_sink *k)
+{
+   if (k->count == 0) return;
+   if (k->flip)
+      k->s->on_rows(k->s->on_rows_user, k->h - k->y - k->count, k->count, k->strip + (size_t) (k->rows - k->count) * k->row_bytes, k->row_bytes);
+   else
+      k->s->on_rows(k->s->on_rows_user, k->y, k->count, k->strip, k->row_bytes);
+   k->y += k->count;
+   k->count = 0;
+}
+
+// where the next image row (in top-down order) goes
+static stbi_uc *stbi__row_sink_next(stbi__row_sink *k)
+{
+   int slot;
+   if (k->count == k->rows) stbi__row_sink_flush(k);
+   slot = k->flip ? k->rows - 1 - k->count : k->count;
+   ++k->count;
+   return k->strip + (size_t) slot * k->row_bytes;
+}
+#endif
+
 static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
    stbi__result_info ri;
-   void *result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
+   void *result;
+   int channels;
+
+   stbi__begin_load();
+   result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
 
    if (result == NULL)
-      return NULL;
+      return (unsigned char *) stbi__end_load(NULL, 0, 0, 0, 0);
 
    // it is the responsibility of the loaders to make sure we get either 8 or 16 bit.
    STBI_ASSERT(ri.bits_per_channel == 8 || ri.bits_per_channel == 16);
 
+   channels = req_comp ? req_comp : *comp;
    if (ri.bits_per_channel != 8) {
-      result = stbi__convert_16_to_8((stbi__uint16 *) result, *x, *y, req_comp == 0 ? *comp : req_comp);
+      result = stbi__convert_16_to_8((stbi__uint16 *) result, *x, *y, channels);
       ri.bits_per_channel = 8;
    }
+   if (result) stbi__output_image(s, result, *x, *y, channels, 1);
 
    // @TODO: move stbi__convert_format to here
 
-   if (stbi__vertically_flip_on_load) {
-      int channels = req_comp ? req_comp : *comp;
-      stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi_uc));
-   }
-
-   return (unsigned char *) result;
+   return (unsigned char *) stbi__end_load(result, *x, *y, channels * sizeof(stbi_uc), s->flip);
 }
 
 static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
    stbi__result_info ri;
-   void *result = stbi__load_main(s, x, y, comp, req_comp, &ri, 16);
+   void *result;
+   int channels;
+
+   stbi__begin_load();
+   result = stbi__load_main(s, x, y, comp, req_comp, &ri, 16);
 
    if (result == NULL)
-      return NULL;
+      return (stbi__uint16 *) stbi__end_load(NULL, 0, 0, 0, 0);
 
    // it is the responsibility of the loaders to make sure we get either 8 or 16 bit.
    STBI_ASSERT(ri.bits_per_channel == 8 || ri.bits_per_channel == 16);
 
+   channels = req_comp ? req_comp : *comp;
    if (ri.bits_per_channel != 16) {
-      result = stbi__convert_8_to_16((stbi_uc *) result, *x, *y, req_comp == 0 ? *comp : req_comp);
+      result = stbi__convert_8_to_16(s, (stbi_uc *) result, *x, *y, channels);
       ri.bits_per_channel = 16;
+   } else {
+      stbi__output_image(s, result, *x, *y, channels, 2);
    }
 
    // @TODO: move stbi__convert_format16 to here
    // @TODO: special case RGB-to-Y (and RGBA-to-YA) for 8-bit-to-16-bit case to keep more precision
 
-   if (stbi__vertically_flip_on_load) {
-      int channels = req_comp ? req_comp : *comp;
-      stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi__uint16));
+   return (stbi__uint16 *) stbi__end_load(result, *x, *y, channels * sizeof(stbi__uint16), s->flip);
+}
+
+// decode into the caller's buffer. decoders that can write final pixels
+// directly (currently JPEG) set dest_written; everything else is decoded
+// into a scratch image whose rows are then copied to the destination.
+// (JPEG has no alpha and only writes 8-bit rows directly, so it never has
+// an output stage to run.)
+static int stbi__load_into_main(stbi__context *s, void *out, size_t out_size, int stride, int *x, int *y, int *comp, int req_comp, int bytes_per_channel)
+{
+   stbi__result_info ri;
+   void *result;
+   int j, channels, ok, widen, simd;
+   size_t row_bytes;
+
+   if (out == NULL) return stbi__err("bad dest", "Destination buffer is NULL");
+   if (stride < 0) return stbi__err("bad stride", "Row stride is negative");
+   s->dest = (stbi_uc *) out;
+   s->dest_size = out_size;
+   s->dest_stride = (size_t) stride;
+   s->dest_bytes_per_channel = bytes_per_channel;
+   s->dest_written = 0;
+
+   stbi__begin_load();
+   result = stbi__load_main(s, x, y, comp, req_comp, &ri, bytes_per_channel * 8);
+   if (result == NULL || s->dest_written) {
+      stbi__end_load(NULL, 0, 0, 0, 0);
+      return result != NULL;
+   }
+
+   // it is the responsibility of the loaders to make sure we get either 8 or 16 bit.
+   STBI_ASSERT(ri.bits_per_channel == 8 || ri.bits_per_channel == 16);
+
+   channels = req_comp ? req_comp : *comp;
+   widen = ri.bits_per_channel == 8 && bytes_per_channel == 2;
+   if (ri.bits_per_channel == 16 && bytes_per_channel == 1) {
+      result = stbi__convert_16_to_8((stbi__uint16 *) result, *x, *y, channels);
+      if (result == NULL) {
+         stbi__end_load(NULL, 0, 0, 0, 0);
+         return 0;
+      }
    }
 
-   return (stbi__uint16 *) result;
+   // the output stage runs on each row as it is copied (or widened) into place
+   row_bytes = (size_t) *x * channels * bytes_per_channel;
+   ok = stbi__dest_fits(s, *x, *y, channels * bytes_per_channel);
+   simd = stbi__output_simd();
+   if (ok) {
+      for (j=0; j < *y; ++j) {
+         stbi_uc *row = stbi__dest_row(s, *y, j);
+         if (widen) {
+            stbi__widen_row(s, (stbi__uint16 *) row, (stbi_uc *) result + row_bytes/2 * j, (stbi__uint32) *x, channels, simd);
+         } else {
+            memcpy(row, (stbi_uc *) result + row_bytes * j, row_bytes);
+            if (s->linear || s->premultiply)
+               stbi__output_row(s, row, (stbi__uint32) *x, channels, bytes_per_channel, simd);
+         }
+      }
+   }
+   stbi__free(result);
+   stbi__end_load(NULL, 0, 0, 0, 0);
+   return ok;
 }
 
-#if !defined(STBI_NO_HDR) && !defined(STBI_NO_LINEAR)
-static void stbi__float_postprocess(float *result, int *x, int *y, int *comp, int req_comp)
+// stream rows to the caller. JPEG and PNG feed the callback themselves and
+// set dest_written; any other image is decoded whole and sent as one strip.
+static int stbi__load_rows_main(stbi__context *s, stbi_rows_callback *on_rows, void *user, int *x, int *y, int *comp, int req_comp)
 {
-   if (stbi__vertically_flip_on_load && result != NULL) {
-      int channels = req_comp ? req_comp : *comp;
-      stbi__vertical_flip(result, *x, *y, channels * sizeof(float));
+   stbi__result_info ri;
+   void *result;
+   int channels;
+
+   if (on_rows == NULL) return stbi__err("bad callback", "Row callback is NULL");
+   s->on_rows = on_rows;
+   s->on_rows_user = user;
+   s->dest_written = 0;
+
+   stbi__begin_load();
+   result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
+   if (result == NULL || s->dest_written) {
+      stbi__end_load(NULL, 0, 0, 0, 0);
+      return result != NULL;
    }
+
+   // it is the responsibility of the loaders to make sure we get either 8 or 16 bit.
+   STBI_ASSERT(ri.bits_per_channel == 8 || ri.bits_per_channel == 16);
+
+   channels = req_comp ? req_comp : *comp;
+   if (ri.bits_per_channel != 8) {
+      result = stbi__convert_16_to_8((stbi__uint16 *) result, *x, *y, channels);
+      if (result == NULL) {
+         stbi__end_load(NULL, 0, 0, 0, 0);
+         return 0;
+      }
+   }
+   if (s->flip)
+      stbi__vertical_flip(result, *x, *y, channels);
+   on_rows(user, 0, *y, (stbi_uc *) result, *x * channels);
+   stbi__free(result);
+   stbi__end_load(NULL, 0, 0, 0, 0);
+   return 1;
 }
-#endif
 
 #ifndef STBI_NO_STDIO
 
@@ -1361,82 +2697,481 @@ static FILE *stbi__fopen(char const *filename, char const *mode)
 }
 
 
-STBIDEF stbi_uc *stbi_load(char const *filename, int *x, int *y, int *comp, int req_comp)
+STBIDEF stbi_uc *stbi_load(char const *filename, int *x, int *y, int *comp, int req_comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   unsigned char *result;
+   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+   result = stbi_load_from_file(f,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+
+STBIDEF stbi_uc *stbi_load_from_file(FILE *f, int *x, int *y, int *comp, int req_comp)
+{
+   unsigned char *result;
+   stbi__context s;
+   stbi__start_file(&s,f);
+   result = stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+   stbi__stop_file(&s,f);
+   return result;
+}
+
+STBIDEF stbi__uint16 *stbi_load_from_file_16(FILE *f, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__uint16 *result;
+   stbi__context s;
+   stbi__start_file(&s,f);
+   result = stbi__load_and_postprocess_16bit(&s,x,y,comp,req_comp);
+   stbi__stop_file(&s,f);
+   return result;
+}
+
+STBIDEF stbi_us *stbi_load_16(char const *filename, int *x, int *y, int *comp, int req_comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   stbi__uint16 *result;
+   if (!f) return (stbi_us *) stbi__errpuc("can't fopen", "Unable to open file");
+   result = stbi_load_from_file_16(f,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+
+
+#endif //!STBI_NO_STDIO
+
+STBIDEF stbi_us *stbi_load_16_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_and_postprocess_16bit(&s,x,y,channels_in_file,desired_channels);
+}
+
+STBIDEF stbi_us *stbi_load_16_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *channels_in_file, int desired_channels)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *)clbk, user);
+   return stbi__load_and_postprocess_16bit(&s,x,y,channels_in_file,desired_channels);
+}
+
+STBIDEF stbi_uc *stbi_load_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+}
+
+STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+}
+
+// the *_with_params loads other than stbi_load_with_params*: the settings replace
+// the flags stbi__start_flags took from the stbi_set_* state
+static int stbi__start_flag_params(stbi__context *s, stbi_load_params const *p)
+{
+   if (p == NULL) {
+      s->flip = s->de_iphone = s->unpremultiply = 0;
+      return 1;
+   }
+   if (p->desired_channels < 0 || p->desired_channels > 4)
+      return stbi__err("bad req_comp", "Internal error");
+   if (p->bits_per_channel || p->stride_in_bytes || p->decoder || p->premultiply_alpha || p->srgb_to_linear)
+      return stbi__err("unsupported params", "Only desired_channels and the flags apply to this load");
+   s->flip = p->flip_vertically != 0;
+   s->de_iphone = p->convert_iphone_png != 0;
+   s->unpremultiply = p->unpremultiply != 0;
+   return 1;
+}
+
+#ifndef STBI_NO_JPEG
+static stbi_uc *stbi__load_jpeg_region_main(stbi__context *s, int scale_denom, int rx, int ry, int rw, int rh, int *x, int *y, int *comp, int req_comp)
+{
+   int shift = 0;
+   while (shift < 4 && (1 << shift) != scale_denom) ++shift;
+   if (shift == 4) return stbi__errpuc("bad scale", "JPEG scale_denom must be 1, 2, 4 or 8");
+   if (!stbi__jpeg_test(s)) return stbi__errpuc("not JPEG", "Scaled and region decoding only support JPEG");
+   s->jpeg_scale_shift = shift;
+   s->roi_x = rx;
+   s->roi_y = ry;
+   s->roi_w = rw;
+   s->roi_h = rh;
+   return stbi__load_and_postprocess_8bit(s,x,y,comp,req_comp);
+}
+
+STBIDEF stbi_uc *stbi_load_jpeg_region_from_memory(stbi_uc const *buffer, int len, int scale_denom, int rx, int ry, int rw, int rh, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_jpeg_region_main(&s,scale_denom,rx,ry,rw,rh,x,y,comp,req_comp);
+}
+
+STBIDEF stbi_uc *stbi_load_jpeg_region_from_callbacks(stbi_io_callbacks const *clbk, void *user, int scale_denom, int rx, int ry, int rw, int rh, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return stbi__load_jpeg_region_main(&s,scale_denom,rx,ry,rw,rh,x,y,comp,req_comp);
+}
+
+STBIDEF stbi_uc *stbi_load_jpeg_scaled_from_memory(stbi_uc const *buffer, int len, int scale_denom, int *x, int *y, int *comp, int req_comp)
+{
+   return stbi_load_jpeg_region_from_memory(buffer,len,scale_denom,0,0,0,0,x,y,comp,req_comp);
+}
+
+STBIDEF stbi_uc *stbi_load_jpeg_scaled_from_callbacks(stbi_io_callbacks const *clbk, void *user, int scale_denom, int *x, int *y, int *comp, int req_comp)
+{
+   return stbi_load_jpeg_region_from_callbacks(clbk,user,scale_denom,0,0,0,0,x,y,comp,req_comp);
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_uc *stbi_load_jpeg_region(char const *filename, int scale_denom, int rx, int ry, int rw, int rh, int *x, int *y, int *comp, int req_comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   unsigned char *result;
+   stbi__context s;
+   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   result = stbi__load_jpeg_region_main(&s,scale_denom,rx,ry,rw,rh,x,y,comp,req_comp);
+   stbi__stop_file(&s,f);
+   fclose(f);
+   return result;
+}
+
+STBIDEF stbi_uc *stbi_load_jpeg_scaled(char const *filename, int scale_denom, int *x, int *y, int *comp, int req_comp)
+{
+   return stbi_load_jpeg_region(filename,scale_denom,0,0,0,0,x,y,comp,req_comp);
+}
+#endif // !STBI_NO_STDIO
+
+STBIDEF stbi_uc *stbi_load_jpeg_scaled_with_params_from_memory(stbi_uc const *buffer, int len, stbi_load_params const *params, int scale_denom, int *x, int *y, int *comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   if (!stbi__start_flag_params(&s, params)) return NULL;
+   return stbi__load_jpeg_region_main(&s,scale_denom,0,0,0,0,x,y,comp,params ? params->desired_channels : 0);
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_uc *stbi_load_jpeg_scaled_with_params(char const *filename, stbi_load_params const *params, int scale_denom, int *x, int *y, int *comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   unsigned char *result = NULL;
+   stbi__context s;
+   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   if (stbi__start_flag_params(&s, params))
+      result = stbi__load_jpeg_region_main(&s,scale_denom,0,0,0,0,x,y,comp,params ? params->desired_channels : 0);
+   stbi__stop_file(&s,f);
+   fclose(f);
+   return result;
+}
+#endif // !STBI_NO_STDIO
+#endif // !STBI_NO_JPEG
+
+STBIDEF int stbi_load_into_from_memory(stbi_uc const *buffer, int len, stbi_uc *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_into_main(&s,out,out_size,stride_in_bytes,x,y,comp,req_comp,1);
+}
+
+STBIDEF int stbi_load_into_from_callbacks(stbi_io_callbacks const *clbk, void *user, stbi_uc *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return stbi__load_into_main(&s,out,out_size,stride_in_bytes,x,y,comp,req_comp,1);
+}
+
+STBIDEF int stbi_load_16_into_from_memory(stbi_uc const *buffer, int len, stbi_us *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_into_main(&s,out,out_size,stride_in_bytes,x,y,comp,req_comp,2);
+}
+
+STBIDEF int stbi_load_16_into_from_callbacks(stbi_io_callbacks const *clbk, void *user, stbi_us *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return stbi__load_into_main(&s,out,out_size,stride_in_bytes,x,y,comp,req_comp,2);
+}
+
+#ifndef STBI_NO_STDIO
+static int stbi__load_into_file(FILE *f, void *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *comp, int req_comp, int bytes_per_channel)
+{
+   int result;
+   stbi__context s;
+   stbi__start_file(&s,f);
+   result = stbi__load_into_main(&s,out,out_size,stride_in_bytes,x,y,comp,req_comp,bytes_per_channel);
+   stbi__stop_file(&s,f);
+   return result;
+}
+
+STBIDEF int stbi_load_into_from_file(FILE *f, stbi_uc *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *comp, int req_comp)
+{
+   return stbi__load_into_file(f,out,out_size,stride_in_bytes,x,y,comp,req_comp,1);
+}
+
+STBIDEF int stbi_load_16_into_from_file(FILE *f, stbi_us *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *comp, int req_comp)
+{
+   return stbi__load_into_file(f,out,out_size,stride_in_bytes,x,y,comp,req_comp,2);
+}
+
+STBIDEF int stbi_load_into(char const *filename, stbi_uc *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *comp, int req_comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   int result;
+   if (!f) return stbi__err("can't fopen", "Unable to open file");
+   result = stbi__load_into_file(f,out,out_size,stride_in_bytes,x,y,comp,req_comp,1);
+   fclose(f);
+   return result;
+}
+
+STBIDEF int stbi_load_16_into(char const *filename, stbi_us *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *comp, int req_comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   int result;
+   if (!f) return stbi__err("can't fopen", "Unable to open file");
+   result = stbi__load_into_file(f,out,out_size,stride_in_bytes,x,y,comp,req_comp,2);
+   fclose(f);
+   return result;
+}
+#endif // !STBI_NO_STDIO
+
+STBIDEF int stbi_load_rows_from_memory(stbi_uc const *buffer, int len, stbi_rows_callback *on_rows, void *user, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_rows_main(&s,on_rows,user,x,y,comp,req_comp);
+}
+
+STBIDEF int stbi_load_rows_from_callbacks(stbi_io_callbacks const *clbk, void *user, stbi_rows_callback *on_rows, void *rows_user, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return stbi__load_rows_main(&s,on_rows,rows_user,x,y,comp,req_comp);
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_rows_from_file(FILE *f, stbi_rows_callback *on_rows, void *user, int *x, int *y, int *comp, int req_comp)
+{
+   int result;
+   stbi__context s;
+   stbi__start_file(&s,f);
+   result = stbi__load_rows_main(&s,on_rows,user,x,y,comp,req_comp);
+   stbi__stop_file(&s,f);
+   return result;
+}
+
+STBIDEF int stbi_load_rows(char const *filename, stbi_rows_callback *on_rows, void *user, int *x, int *y, int *comp, int req_comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   int result;
+   if (!f) return stbi__err("can't fopen", "Unable to open file");
+   result = stbi_load_rows_from_file(f,on_rows,user,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+#endif // !STBI_NO_STDIO
+
+STBIDEF int stbi_load_rows_with_params_from_memory(stbi_uc const *buffer, int len, stbi_load_params const *params, stbi_rows_callback *on_rows, void *user, int *x, int *y, int *comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   if (!stbi__start_flag_params(&s, params)) return 0;
+   return stbi__load_rows_main(&s,on_rows,user,x,y,comp,params ? params->desired_channels : 0);
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_rows_with_params(char const *filename, stbi_load_params const *params, stbi_rows_callback *on_rows, void *user, int *x, int *y, int *comp)
 {
    FILE *f = stbi__fopen(filename, "rb");
-   unsigned char *result;
-   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
-   result = stbi_load_from_file(f,x,y,comp,req_comp);
+   int result = 0;
+   stbi__context s;
+   if (!f) return stbi__err("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   if (stbi__start_flag_params(&s, params))
+      result = stbi__load_rows_main(&s,on_rows,user,x,y,comp,params ? params->desired_channels : 0);
+   stbi__stop_file(&s,f);
    fclose(f);
    return result;
 }
+#endif // !STBI_NO_STDIO
 
-STBIDEF stbi_uc *stbi_load_from_file(FILE *f, int *x, int *y, int *comp, int req_comp)
+// load through a decoder (if d is set): its arena stands in for the thread's
+// for the whole load, and its table caches are reached through s->decoder.
+// with 'out' the image goes to the caller's buffer as in stbi_load_into*
+static void *stbi__decoder_load_main(stbi_decoder *d, stbi__context *s, void *out, size_t out_size, int stride, int *x, int *y, int *comp, int req_comp, int bytes_per_channel)
 {
-   unsigned char *result;
-   stbi__context s;
-   stbi__start_file(&s,f);
-   result = stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
-   if (result) {
-      // need to 'unget' all the characters in the IO buffer
-      fseek(f, - (int) (s.img_buffer_end - s.img_buffer), SEEK_CUR);
-   }
+   void *result;
+   #ifndef STBI_NO_ARENA
+   stbi_arena *saved = stbi__arena_current;
+   if (d) stbi__arena_current = d->arena;
+   #endif
+   s->decoder = d;
+   if (out)
+      result = stbi__load_into_main(s, out, out_size, stride, x, y, comp, req_comp, bytes_per_channel) ? out : NULL;
+   else if (bytes_per_channel == 2)
+      result = stbi__load_and_postprocess_16bit(s, x, y, comp, req_comp);
+   else
+      result = stbi__load_and_postprocess_8bit(s, x, y, comp, req_comp);
+   #ifndef STBI_NO_ARENA
+   stbi__arena_current = saved;
+   #endif
    return result;
 }
 
-STBIDEF stbi__uint16 *stbi_load_from_file_16(FILE *f, int *x, int *y, int *comp, int req_comp)
+STBIDEF stbi_uc *stbi_decoder_load_from_memory(stbi_decoder *decoder, stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp)
 {
-   stbi__uint16 *result;
    stbi__context s;
-   stbi__start_file(&s,f);
-   result = stbi__load_and_postprocess_16bit(&s,x,y,comp,req_comp);
-   if (result) {
-      // need to 'unget' all the characters in the IO buffer
-      fseek(f, - (int) (s.img_buffer_end - s.img_buffer), SEEK_CUR);
-   }
-   return result;
+   stbi__start_mem(&s,buffer,len);
+   return (stbi_uc *) stbi__decoder_load_main(decoder, &s, NULL, 0, 0, x, y, comp, req_comp, 1);
 }
 
-STBIDEF stbi_us *stbi_load_16(char const *filename, int *x, int *y, int *comp, int req_comp)
+STBIDEF stbi_uc *stbi_decoder_load_from_callbacks(stbi_decoder *decoder, stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return (stbi_uc *) stbi__decoder_load_main(decoder, &s, NULL, 0, 0, x, y, comp, req_comp, 1);
+}
+
+STBIDEF int stbi_decoder_load_into_from_memory(stbi_decoder *decoder, stbi_uc const *buffer, int len, stbi_uc *out, size_t out_size, int stride_in_bytes, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   if (out == NULL) return stbi__err("bad dest", "Destination buffer is NULL");
+   stbi__start_mem(&s,buffer,len);
+   return stbi__decoder_load_main(decoder, &s, out, out_size, stride_in_bytes, x, y, comp, req_comp, 1) != NULL;
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_uc *stbi_decoder_load(stbi_decoder *decoder, char const *filename, int *x, int *y, int *comp, int req_comp)
 {
    FILE *f = stbi__fopen(filename, "rb");
-   stbi__uint16 *result;
-   if (!f) return (stbi_us *) stbi__errpuc("can't fopen", "Unable to open file");
-   result = stbi_load_from_file_16(f,x,y,comp,req_comp);
+   stbi__context s;
+   unsigned char *result;
+   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   result = (stbi_uc *) stbi__decoder_load_main(decoder, &s, NULL, 0, 0, x, y, comp, req_comp, 1);
+   stbi__stop_file(&s,f);
    fclose(f);
    return result;
 }
+#endif
 
+// copy an image with packed rows into a new block whose rows are 'stride'
+// bytes apart, freeing the original
+static void *stbi__pad_rows(void *image, int w, int h, int bytes_per_pixel, int stride)
+{
+   size_t row_bytes = (size_t) w * bytes_per_pixel;
+   stbi_uc *out;
+   int j;
+   if ((size_t) stride == row_bytes) return image;
+   if ((size_t) stride < row_bytes) {
+      STBI_FREE(image);
+      return stbi__errpuc("bad stride", "Row stride is smaller than a row of pixels");
+   }
+   out = (stbi_uc *) STBI_MALLOC((size_t) stride * h);
+   if (out)
+      for (j=0; j < h; ++j)
+         memcpy(out + (size_t) stride * j, (stbi_uc *) image + row_bytes * j, row_bytes);
+   else
+      stbi__err("outofmem", "Out of memory");
+   STBI_FREE(image);
+   return out;
+}
 
-#endif //!STBI_NO_STDIO
+// stbi_load_with_params*: the settings replace what stbi__start_flags took
+// from the stbi_set_* state, then the load goes through the usual paths
+static void *stbi__load_params_main(stbi__context *s, stbi_load_params const *p, void *out, size_t out_size, int *x, int *y, int *comp)
+{
+   static const stbi_load_params defaults = { 0, 0, 0, 0, 0, 0, NULL, 0, 0 };
+   int bytes;
+   void *result;
+   if (p == NULL) p = &defaults;
+   if (p->bits_per_channel != 0 && p->bits_per_channel != 8 && p->bits_per_channel != 16)
+      return stbi__errpuc("bad bits_per_channel", "Only 8 and 16 bits per channel are supported");
+   if (p->desired_channels < 0 || p->desired_channels > 4)
+      return stbi__errpuc("bad req_comp", "Internal error");
+   if (p->stride_in_bytes < 0)
+      return stbi__errpuc("bad stride", "Row stride is negative");
+   if (p->srgb_to_linear && p->bits_per_channel == 8)
+      return stbi__errpuc("bad bits_per_channel", "Linear output needs 16 bits per channel");
+   bytes = (p->bits_per_channel == 16 || p->srgb_to_linear) ? 2 : 1;
+   s->flip = p->flip_vertically != 0;
+   s->de_iphone = p->convert_iphone_png != 0;
+   s->unpremultiply = p->unpremultiply != 0;
+   s->premultiply = p->premultiply_alpha != 0;
+   s->linear = p->srgb_to_linear != 0;
+
+   result = stbi__decoder_load_main(p->decoder, s, out, out_size, p->stride_in_bytes, x, y, comp, p->desired_channels, bytes);
+   if (result && !out && p->stride_in_bytes)
+      result = stbi__pad_rows(result, *x, *y, (p->desired_channels ? p->desired_channels : *comp) * bytes, p->stride_in_bytes);
+   return result;
+}
 
-STBIDEF stbi_us *stbi_load_16_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels)
+STBIDEF void *stbi_load_with_params_from_memory(stbi_uc const *buffer, int len, stbi_load_params const *params, int *x, int *y, int *comp)
 {
    stbi__context s;
    stbi__start_mem(&s,buffer,len);
-   return stbi__load_and_postprocess_16bit(&s,x,y,channels_in_file,desired_channels);
+   return stbi__load_params_main(&s, params, NULL, 0, x, y, comp);
 }
 
-STBIDEF stbi_us *stbi_load_16_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *channels_in_file, int desired_channels)
+STBIDEF void *stbi_load_with_params_from_callbacks(stbi_io_callbacks const *clbk, void *user, stbi_load_params const *params, int *x, int *y, int *comp)
 {
    stbi__context s;
-   stbi__start_callbacks(&s, (stbi_io_callbacks *)clbk, user);
-   return stbi__load_and_postprocess_16bit(&s,x,y,channels_in_file,desired_channels);
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return stbi__load_params_main(&s, params, NULL, 0, x, y, comp);
 }
 
-STBIDEF stbi_uc *stbi_load_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp)
+STBIDEF int stbi_load_with_params_into_from_memory(stbi_uc const *buffer, int len, stbi_load_params const *params, void *out, size_t out_size, int *x, int *y, int *comp)
 {
    stbi__context s;
+   if (out == NULL) return stbi__err("bad dest", "Destination buffer is NULL");
    stbi__start_mem(&s,buffer,len);
-   return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+   return stbi__load_params_main(&s, params, out, out_size, x, y, comp) != NULL;
 }
 
-STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp)
+STBIDEF int stbi_load_with_params_into_from_callbacks(stbi_io_callbacks const *clbk, void *user, stbi_load_params const *params, void *out, size_t out_size, int *x, int *y, int *comp)
 {
    stbi__context s;
+   if (out == NULL) return stbi__err("bad dest", "Destination buffer is NULL");
    stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
-   return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+   return stbi__load_params_main(&s, params, out, out_size, x, y, comp) != NULL;
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF void *stbi_load_with_params(char const *filename, stbi_load_params const *params, int *x, int *y, int *comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   stbi__context s;
+   void *result;
+   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   result = stbi__load_params_main(&s, params, NULL, 0, x, y, comp);
+   stbi__stop_file(&s,f);
+   fclose(f);
+   return result;
+}
+
+STBIDEF int stbi_load_with_params_into(char const *filename, stbi_load_params const *params, void *out, size_t out_size, int *x, int *y, int *comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   stbi__context s;
+   int result;
+   if (!f) return stbi__err("can't fopen", "Unable to open file");
+   if (out == NULL) {
+      fclose(f);
+      return stbi__err("bad dest", "Destination buffer is NULL");
+   }
+   stbi__start_file(&s,f);
+   result = stbi__load_params_main(&s, params, out, out_size, x, y, comp) != NULL;
+   stbi__stop_file(&s,f);
+   fclose(f);
+   return result;
 }
+#endif
 
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp)
@@ -1446,7 +3181,7 @@ STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int *
    stbi__start_mem(&s,buffer,len);
 
    result = (unsigned char*) stbi__load_gif_main(&s, delays, x, y, z, comp, req_comp);
-   if (stbi__vertically_flip_on_load) {
+   if (s.flip) {
       stbi__vertical_flip_slices( result, *x, *y, *z, *comp );
    }
 
@@ -1455,22 +3190,43 @@ STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int *
 #endif
 
 #ifndef STBI_NO_LINEAR
-static float *stbi__loadf_main(stbi__context *s, int *x, int *y, int *comp, int req_comp)
+// stbi_loadf, stbi_loadf16 and stbi_load_rgb9e5: Radiance files are converted
+// straight from their RGBE pixels, anything else goes through floats first
+static void *stbi__loadf_main_as(stbi__context *s, int *x, int *y, int *comp, int req_comp, int format)
 {
    unsigned char *data;
+   float *result;
+   void *out;
+   int n;
+   if (format == STBI__HDR_rgb9e5) req_comp = 3;
+   stbi__begin_load();
    #ifndef STBI_NO_HDR
    if (stbi__hdr_test(s)) {
       stbi__result_info ri;
-      float *hdr_data = stbi__hdr_load(s,x,y,comp,req_comp, &ri);
-      if (hdr_data)
-         stbi__float_postprocess(hdr_data,x,y,comp,req_comp);
-      return hdr_data;
+      void *hdr_data;
+      s->hdr_format = format;
+      hdr_data = stbi__hdr_load(s,x,y,comp,req_comp, &ri);
+      if (hdr_data == NULL)
+         return stbi__end_load(NULL, 0, 0, 0, 0);
+      return stbi__end_load(hdr_data, *x, *y, stbi__hdr_pixel_bytes(format, req_comp ? req_comp : *comp), s->flip);
    }
    #endif
    data = stbi__load_and_postprocess_8bit(s, x, y, comp, req_comp);
-   if (data)
-      return stbi__ldr_to_hdr(data, *x, *y, req_comp ? req_comp : *comp);
-   return stbi__errpf("unknown image type", "Image not of any known type, or corrupt");
+   if (data == NULL) {
+      stbi__end_load(NULL, 0, 0, 0, 0);
+      return stbi__errpf("unknown image type", "Image not of any known type, or corrupt");
+   }
+   n = req_comp ? req_comp : *comp;
+   result = stbi__ldr_to_hdr(data, *x, *y, n);
+   out = format == STBI__HDR_float ? result : stbi__hdr_from_float(result, *x * *y, n, format);
+   if (out == NULL)
+      return stbi__end_load(NULL, 0, 0, 0, 0);
+   return stbi__end_load(out, *x, *y, stbi__hdr_pixel_bytes(format, n), 0);
+}
+
+static float *stbi__loadf_main(stbi__context *s, int *x, int *y, int *comp, int req_comp)
+{
+   return (float *) stbi__loadf_main_as(s, x, y, comp, req_comp, STBI__HDR_float);
 }
 
 STBIDEF float *stbi_loadf_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp)
@@ -1500,9 +3256,126 @@ STBIDEF float *stbi_loadf(char const *filename, int *x, int *y, int *comp, int r
 
 STBIDEF float *stbi_loadf_from_file(FILE *f, int *x, int *y, int *comp, int req_comp)
 {
+   float *result;
    stbi__context s;
    stbi__start_file(&s,f);
-   return stbi__loadf_main(&s,x,y,comp,req_comp);
+   result = stbi__loadf_main(&s,x,y,comp,req_comp);
+   stbi__stop_file(&s,f);
+   return result;
+}
+#endif // !STBI_NO_STDIO
+
+STBIDEF float *stbi_loadf_with_params_from_memory(stbi_uc const *buffer, int len, stbi_load_params const *params, int *x, int *y, int *comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   if (!stbi__start_flag_params(&s, params)) return NULL;
+   return stbi__loadf_main(&s,x,y,comp,params ? params->desired_channels : 0);
+}
+
+STBIDEF stbi_us *stbi_loadf16_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return (stbi_us *) stbi__loadf_main_as(&s,x,y,comp,req_comp,STBI__HDR_half);
+}
+
+STBIDEF stbi_us *stbi_loadf16_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return (stbi_us *) stbi__loadf_main_as(&s,x,y,comp,req_comp,STBI__HDR_half);
+}
+
+STBIDEF stbi_us *stbi_loadf16_with_params_from_memory(stbi_uc const *buffer, int len, stbi_load_params const *params, int *x, int *y, int *comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   if (!stbi__start_flag_params(&s, params)) return NULL;
+   return (stbi_us *) stbi__loadf_main_as(&s,x,y,comp,params ? params->desired_channels : 0,STBI__HDR_half);
+}
+
+STBIDEF unsigned int *stbi_load_rgb9e5_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return (unsigned int *) stbi__loadf_main_as(&s,x,y,comp,3,STBI__HDR_rgb9e5);
+}
+
+STBIDEF unsigned int *stbi_load_rgb9e5_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return (unsigned int *) stbi__loadf_main_as(&s,x,y,comp,3,STBI__HDR_rgb9e5);
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_us *stbi_loadf16(char const *filename, int *x, int *y, int *comp, int req_comp)
+{
+   stbi_us *result;
+   FILE *f = stbi__fopen(filename, "rb");
+   if (!f) return (stbi_us *) stbi__errpuc("can't fopen", "Unable to open file");
+   result = stbi_loadf16_from_file(f,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+
+STBIDEF stbi_us *stbi_loadf16_from_file(FILE *f, int *x, int *y, int *comp, int req_comp)
+{
+   stbi_us *result;
+   stbi__context s;
+   stbi__start_file(&s,f);
+   result = (stbi_us *) stbi__loadf_main_as(&s,x,y,comp,req_comp,STBI__HDR_half);
+   stbi__stop_file(&s,f);
+   return result;
+}
+
+STBIDEF float *stbi_loadf_with_params(char const *filename, stbi_load_params const *params, int *x, int *y, int *comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   float *result = NULL;
+   stbi__context s;
+   if (!f) return stbi__errpf("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   if (stbi__start_flag_params(&s, params))
+      result = stbi__loadf_main(&s,x,y,comp,params ? params->desired_channels : 0);
+   stbi__stop_file(&s,f);
+   fclose(f);
+   return result;
+}
+
+STBIDEF stbi_us *stbi_loadf16_with_params(char const *filename, stbi_load_params const *params, int *x, int *y, int *comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   stbi_us *result = NULL;
+   stbi__context s;
+   if (!f) return (stbi_us *) stbi__errpuc("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   if (stbi__start_flag_params(&s, params))
+      result = (stbi_us *) stbi__loadf_main_as(&s,x,y,comp,params ? params->desired_channels : 0,STBI__HDR_half);
+   stbi__stop_file(&s,f);
+   fclose(f);
+   return result;
+}
+
+STBIDEF unsigned int *stbi_load_rgb9e5(char const *filename, int *x, int *y, int *comp)
+{
+   unsigned int *result;
+   FILE *f = stbi__fopen(filename, "rb");
+   if (!f) return (unsigned int *) stbi__errpuc("can't fopen", "Unable to open file");
+   result = stbi_load_rgb9e5_from_file(f,x,y,comp);
+   fclose(f);
+   return result;
+}
+
+STBIDEF unsigned int *stbi_load_rgb9e5_from_file(FILE *f, int *x, int *y, int *comp)
+{
+   unsigned int *result;
+   stbi__context s;
+   stbi__start_file(&s,f);
+   result = (unsigned int *) stbi__loadf_main_as(&s,x,y,comp,3,STBI__HDR_rgb9e5);
+   stbi__stop_file(&s,f);
+   return result;
 }
 #endif // !STBI_NO_STDIO
 
@@ -1545,6 +3418,7 @@ STBIDEF int stbi_is_hdr_from_file(FILE *f)
    stbi__context s;
    stbi__start_file(&s,f);
    res = stbi__hdr_test(&s);
+   stbi__stop_file(&s,f);
    fseek(f, pos, SEEK_SET);
    return res;
    #else
@@ -1594,18 +3468,18 @@ enum
 
 static void stbi__refill_buffer(stbi__context *s)
 {
-   int n = (s->io.read)(s->io_user_data,(char*)s->buffer_start,s->buflen);
+   int n = (s->io.read)(s->io_user_data,(char*)s->io_buffer,s->buflen);
    s->callback_already_read += (int) (s->img_buffer - s->img_buffer_original);
    if (n == 0) {
       // at end of file, treat same as if from memory, but need to handle case
       // where s->img_buffer isn't pointing to safe memory, e.g. 0-byte file
       s->read_from_callbacks = 0;
-      s->img_buffer = s->buffer_start;
-      s->img_buffer_end = s->buffer_start+1;
+      s->img_buffer = s->io_buffer;
+      s->img_buffer_end = s->io_buffer+1;
       *s->img_buffer = 0;
    } else {
-      s->img_buffer = s->buffer_start;
-      s->img_buffer_end = s->buffer_start + n;
+      s->img_buffer = s->io_buffer;
+      s->img_buffer_end = s->io_buffer + n;
    }
 }
 
@@ -1750,47 +3624,140 @@ static stbi_uc stbi__compute_y(int r, int g, int b)
 #if defined(STBI_NO_PNG) && defined(STBI_NO_BMP) && defined(STBI_NO_PSD) && defined(STBI_NO_TGA) && defined(STBI_NO_GIF) && defined(STBI_NO_PIC) && defined(STBI_NO_PNM)
 // nothing
 #else
+#ifdef STBI__SSSE3
+// converts the first pixels of a row, as many as whole 16-byte loads and stores
+// allow, and returns how many it did. Combinations that only move bytes around
+// are a single pshufb per step; the ones down to grey compute stbi__compute_y
+// for 8 pixels at a time in 16-bit lanes, which cannot overflow.
+static unsigned int stbi__convert_format_row_ssse3(stbi_uc const *src, stbi_uc *dest, int img_n, int req_comp, unsigned int x)
+{
+   unsigned int a = (unsigned int) img_n, b = (unsigned int) req_comp, i = 0, o;
+   STBI_SIMD_ALIGN(stbi_uc, shuf[16]);
+   STBI_SIMD_ALIGN(stbi_uc, fill[16]);
+
+   if (a >= 3 && b <= 2) {
+      __m128i mr, mg, mb, ma, opaque = _mm_set1_epi8((char) 255);
+      for (o=0; o < 16; ++o) shuf[o] = 0x80;
+      for (o=0; o < 4; ++o) shuf[o*2] = (stbi_uc) (o*a);
+      mr = _mm_load_si128((__m128i *) shuf);
+      mg = _mm_add_epi16(mr, _mm_set_epi32(0,0,0x00010001,0x00010001));
+      mb = _mm_add_epi16(mg, _mm_set_epi32(0,0,0x00010001,0x00010001));
+      ma = _mm_add_epi16(mb, _mm_set_epi32(0,0,0x00010001,0x00010001));
+      for (; i*a + 4*a + 16 <= x*a && i*b + 8*b <= x*b; i += 8) {
+         __m128i v0 = _mm_loadu_si128((__m128i const *) (src + i*a));
+         __m128i v1 = _mm_loadu_si128((__m128i const *) (src + i*a + 4*a));
+         __m128i r = _mm_unpacklo_epi64(_mm_shuffle_epi8(v0, mr), _mm_shuffle_epi8(v1, mr));
+         __m128i g = _mm_unpacklo_epi64(_mm_shuffle_epi8(v0, mg), _mm_shuffle_epi8(v1, mg));
+         __m128i bl = _mm_unpacklo_epi64(_mm_shuffle_epi8(v0, mb), _mm_shuffle_epi8(v1, mb));
+         __m128i y = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(77)),
+                                                 _mm_mullo_epi16(g, _mm_set1_epi16(150))),
+                                                 _mm_mullo_epi16(bl, _mm_set1_epi16(29)));
+         y = _mm_packus_epi16(_mm_srli_epi16(y, 8), y);
+         if (b == 1) {
+            _mm_storel_epi64((__m128i *) (dest + i), y);
+         } else {
+            __m128i al = opaque;
+            if (a == 4) {
+               al = _mm_unpacklo_epi64(_mm_shuffle_epi8(v0, ma), _mm_shuffle_epi8(v1, ma));
+               al = _mm_packus_epi16(al, al);
+            }
+            _mm_storeu_si128((__m128i *) (dest + i*2), _mm_unpacklo_epi8(y, al));
+         }
+      }
+   } else {
+      // p pixels per step; each output byte takes a source byte, a zero or (alpha) 255
+      unsigned int p = 16 / (a > b ? a : b);
+      __m128i m, f;
+      for (o=0; o < 16; ++o) {
+         unsigned int k = o / b, c = o % b;
+         shuf[o] = 0x80;
+         fill[o] = 0;
+         if (k >= p) continue;
+         if ((b == 2 || b == 4) && c == b-1) {
+            if (a == 2 || a == 4) shuf[o] = (stbi_uc) (k*a + a-1);
+            else fill[o] = 255;
+         } else {
+            shuf[o] = (stbi_uc) (k*a + (a <= 2 ? 0 : c));
+         }
+      }
+      m = _mm_load_si128((__m128i *) shuf);
+      f = _mm_load_si128((__m128i *) fill);
+      for (; i*a + 16 <= x*a && i*b + 16 <= x*b; i += p) {
+         __m128i v = _mm_loadu_si128((__m128i const *) (src + i*a));
+         _mm_storeu_si128((__m128i *) (dest + i*b), _mm_or_si128(_mm_shuffle_epi8(v, m), f));
+      }
+   }
+   return i;
+}
+#endif
+
+// convert one row of x pixels; src and dest must not overlap
+static int stbi__convert_format_row(unsigned char *src, unsigned char *dest, int img_n, int req_comp, unsigned int x, int simd)
+{
+   int i;
+
+   #ifdef STBI__SSSE3
+   if (simd) {
+      unsigned int done = stbi__convert_format_row_ssse3(src, dest, img_n, req_comp, x);
+      src += done * img_n;
+      dest += done * req_comp;
+      x -= done;
+   }
+   #else
+   STBI_NOTUSED(simd);
+   #endif
+
+   #define STBI__COMBO(a,b)  ((a)*8+(b))
+   #define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
+   // convert source image with img_n components to one with req_comp components;
+   // avoid switch per pixel, so use switch per scanline and massive macros
+   switch (STBI__COMBO(img_n, req_comp)) {
+      STBI__CASE(1,2) { dest[0]=src[0]; dest[1]=255;                                     } break;
+      STBI__CASE(1,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
+      STBI__CASE(1,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=255;                     } break;
+      STBI__CASE(2,1) { dest[0]=src[0];                                                  } break;
+      STBI__CASE(2,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
+      STBI__CASE(2,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=src[1];                  } break;
+      STBI__CASE(3,4) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];dest[3]=255;        } break;
+      STBI__CASE(3,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
+      STBI__CASE(3,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = 255;    } break;
+      STBI__CASE(4,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
+      STBI__CASE(4,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = src[3]; } break;
+      STBI__CASE(4,3) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];                    } break;
+      default: STBI_ASSERT(0); return stbi__err("unsupported", "Unsupported format conversion");
+   }
+   #undef STBI__CASE
+   return 1;
+}
+
 static unsigned char *stbi__convert_format(unsigned char *data, int img_n, int req_comp, unsigned int x, unsigned int y)
 {
-   int i,j;
+   int j, simd = 0;
    unsigned char *good;
 
    if (req_comp == img_n) return data;
    STBI_ASSERT(req_comp >= 1 && req_comp <= 4);
+   #ifdef STBI__SSSE3
+   simd = stbi__ssse3_available();
+   #endif
 
    good = (unsigned char *) stbi__malloc_mad3(req_comp, x, y, 0);
    if (good == NULL) {
-      STBI_FREE(data);
+      stbi__free(data);
       return stbi__errpuc("outofmem", "Out of memory");
    }
 
    for (j=0; j < (int) y; ++j) {
       unsigned char *src  = data + j * x * img_n   ;
       unsigned char *dest = good + j * x * req_comp;
-
-      #define STBI__COMBO(a,b)  ((a)*8+(b))
-      #define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
-      // convert source image with img_n components to one with req_comp components;
-      // avoid switch per pixel, so use switch per scanline and massive macros
-      switch (STBI__COMBO(img_n, req_comp)) {
-         STBI__CASE(1,2) { dest[0]=src[0]; dest[1]=255;                                     } break;
-         STBI__CASE(1,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
-         STBI__CASE(1,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=255;                     } break;
-         STBI__CASE(2,1) { dest[0]=src[0];                                                  } break;
-         STBI__CASE(2,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
-         STBI__CASE(2,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=src[1];                  } break;
-         STBI__CASE(3,4) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];dest[3]=255;        } break;
-         STBI__CASE(3,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
-         STBI__CASE(3,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = 255;    } break;
-         STBI__CASE(4,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
-         STBI__CASE(4,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = src[3]; } break;
-         STBI__CASE(4,3) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];                    } break;
-         default: STBI_ASSERT(0); STBI_FREE(data); STBI_FREE(good); return stbi__errpuc("unsupported", "Unsupported format conversion");
+      if (!stbi__convert_format_row(src, dest, img_n, req_comp, x, simd)) {
+         stbi__free(data);
+         stbi__free(good);
+         return NULL;
       }
-      #undef STBI__CASE
    }
 
-   STBI_FREE(data);
+   stbi__free(data);
    return good;
 }
 #endif
@@ -1807,9 +3774,37 @@ static stbi__uint16 stbi__compute_y_16(int r, int g, int b)
 #if defined(STBI_NO_PNG) && defined(STBI_NO_PSD)
 // nothing
 #else
+// convert one row of x pixels; src and dest must not overlap
+static int stbi__convert_format16_row(stbi__uint16 *src, stbi__uint16 *dest, int img_n, int req_comp, unsigned int x)
+{
+   int i;
+
+   #define STBI__COMBO(a,b)  ((a)*8+(b))
+   #define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
+   // convert source image with img_n components to one with req_comp components;
+   // avoid switch per pixel, so use switch per scanline and massive macros
+   switch (STBI__COMBO(img_n, req_comp)) {
+      STBI__CASE(1,2) { dest[0]=src[0]; dest[1]=0xffff;                                     } break;
+      STBI__CASE(1,3) { dest[0]=dest[1]=dest[2]=src[0];                                     } break;
+      STBI__CASE(1,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=0xffff;                     } break;
+      STBI__CASE(2,1) { dest[0]=src[0];                                                     } break;
+      STBI__CASE(2,3) { dest[0]=dest[1]=dest[2]=src[0];                                     } break;
+      STBI__CASE(2,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=src[1];                     } break;
+      STBI__CASE(3,4) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];dest[3]=0xffff;        } break;
+      STBI__CASE(3,1) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]);                   } break;
+      STBI__CASE(3,2) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]); dest[1] = 0xffff; } break;
+      STBI__CASE(4,1) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]);                   } break;
+      STBI__CASE(4,2) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]); dest[1] = src[3]; } break;
+      STBI__CASE(4,3) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];                       } break;
+      default: STBI_ASSERT(0); return stbi__err("unsupported", "Unsupported format conversion");
+   }
+   #undef STBI__CASE
+   return 1;
+}
+
 static stbi__uint16 *stbi__convert_format16(stbi__uint16 *data, int img_n, int req_comp, unsigned int x, unsigned int y)
 {
-   int i,j;
+   int j;
    stbi__uint16 *good;
 
    if (req_comp == img_n) return data;
@@ -1817,37 +3812,21 @@ static stbi__uint16 *stbi__convert_format16(stbi__uint16 *data, int img_n, int r
 
    good = (stbi__uint16 *) stbi__malloc(req_comp * x * y * 2);
    if (good == NULL) {
-      STBI_FREE(data);
+      stbi__free(data);
       return (stbi__uint16 *) stbi__errpuc("outofmem", "Out of memory");
    }
 
    for (j=0; j < (int) y; ++j) {
       stbi__uint16 *src  = data + j * x * img_n   ;
       stbi__uint16 *dest = good + j * x * req_comp;
-
-      #define STBI__COMBO(a,b)  ((a)*8+(b))
-      #define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
-      // convert source image with img_n components to one with req_comp components;
-      // avoid switch per pixel, so use switch per scanline and massive macros
-      switch (STBI__COMBO(img_n, req_comp)) {
-         STBI__CASE(1,2) { dest[0]=src[0]; dest[1]=0xffff;                                     } break;
-         STBI__CASE(1,3) { dest[0]=dest[1]=dest[2]=src[0];                                     } break;
-         STBI__CASE(1,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=0xffff;                     } break;
-         STBI__CASE(2,1) { dest[0]=src[0];                                                     } break;
-         STBI__CASE(2,3) { dest[0]=dest[1]=dest[2]=src[0];                                     } break;
-         STBI__CASE(2,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=src[1];                     } break;
-         STBI__CASE(3,4) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];dest[3]=0xffff;        } break;
-         STBI__CASE(3,1) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]);                   } break;
-         STBI__CASE(3,2) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]); dest[1] = 0xffff; } break;
-         STBI__CASE(4,1) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]);                   } break;
-         STBI__CASE(4,2) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]); dest[1] = src[3]; } break;
-         STBI__CASE(4,3) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];                       } break;
-         default: STBI_ASSERT(0); STBI_FREE(data); STBI_FREE(good); return (stbi__uint16*) stbi__errpuc("unsupported", "Unsupported format conversion");
+      if (!stbi__convert_format16_row(src, dest, img_n, req_comp, x)) {
+         stbi__free(data);
+         stbi__free(good);
+         return NULL;
       }
-      #undef STBI__CASE
    }
 
-   STBI_FREE(data);
+   stbi__free(data);
    return good;
 }
 #endif
@@ -1859,7 +3838,7 @@ static float   *stbi__ldr_to_hdr(stbi_uc *data, int x, int y, int comp)
    float *output;
    if (!data) return NULL;
    output = (float *) stbi__malloc_mad4(x, y, comp, sizeof(float), 0);
-   if (output == NULL) { STBI_FREE(data); return stbi__errpf("outofmem", "Out of memory"); }
+   if (output == NULL) { stbi__free(data); return stbi__errpf("outofmem", "Out of memory"); }
    // compute number of non-alpha components
    if (comp & 1) n = comp; else n = comp-1;
    for (i=0; i < x*y; ++i) {
@@ -1872,7 +3851,7 @@ static float   *stbi__ldr_to_hdr(stbi_uc *data, int x, int y, int comp)
          output[i*comp + n] = data[i*comp + n]/255.0f;
       }
    }
-   STBI_FREE(data);
+   stbi__free(data);
    return output;
 }
 #endif
@@ -1885,7 +3864,7 @@ static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp)
    stbi_uc *output;
    if (!data) return NULL;
    output = (stbi_uc *) stbi__malloc_mad3(x, y, comp, 0);
-   if (output == NULL) { STBI_FREE(data); return stbi__errpuc("outofmem", "Out of memory"); }
+   if (output == NULL) { stbi__free(data); return stbi__errpuc("outofmem", "Out of memory"); }
    // compute number of non-alpha components
    if (comp & 1) n = comp; else n = comp-1;
    for (i=0; i < x*y; ++i) {
@@ -1902,11 +3881,143 @@ static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp)
          output[i*comp + k] = (stbi_uc) stbi__float2int(z);
       }
    }
-   STBI_FREE(data);
+   stbi__free(data);
    return output;
 }
 #endif
 
+#if !defined(STBI_NO_LINEAR) || !defined(STBI_NO_HDR)
+static int stbi__hdr_pixel_bytes(int format, int comp)
+{
+   switch (format) {
+      case STBI__HDR_half:   return comp * 2;
+      case STBI__HDR_rgb9e5: return 4;
+      default:               return comp * (int) sizeof(float);
+   }
+}
+
+// 0: scalar, 1: SSE2, 2: F16C available for the half conversion
+static int stbi__hdr_simd(void)
+{
+   #ifdef STBI__F16C
+   if (stbi__f16c_available()) return 2;
+   #endif
+   #ifdef STBI_SSE2
+   if (stbi__sse2_available()) return 1;
+   #endif
+   return 0;
+}
+
+// float to IEEE half, rounded to nearest even. Negative values and NaN give
+// 0, and anything past the largest half clamps to it (65504), so textures
+// never pick up infinities. The SSE2 version below is the same computation.
+static stbi__uint16 stbi__float_to_half(float f)
+{
+   stbi__uint32 u;
+   if (!(f > 0.0f)) return 0;
+   if (f > 65504.0f) f = 65504.0f;
+   if (f < 6.103515625e-05f) {
+      // subnormal half: adding 0.5 lines the half's mantissa up with the
+      // float's low bits, and the float add does the rounding
+      f += 0.5f;
+      memcpy(&u, &f, sizeof(u));
+      return (stbi__uint16) (u - 0x3f000000);
+   }
+   memcpy(&u, &f, sizeof(u));
+   // rebias the exponent from 127 to 15, then round the 13 dropped bits to nearest even
+   u += 0xc8000fff + ((u >> 13) & 1);
+   return (stbi__uint16) (u >> 13);
+}
+
+#ifdef STBI_SSE2
+// four halves, one in the low 16 bits of each lane
+static __m128i stbi__float_to_half4(__m128 f)
+{
+   __m128 c = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(65504.0f)); // max_ps turns NaN into 0
+   __m128i u = _mm_castps_si128(c);
+   __m128i sub = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(c, _mm_set1_ps(0.5f))), _mm_set1_epi32(0x3f000000));
+   __m128i odd = _mm_and_si128(_mm_srli_epi32(u, 13), _mm_set1_epi32(1));
+   __m128i norm = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(u, _mm_set1_epi32((int) 0xc8000fff)), odd), 13);
+   __m128i is_sub = _mm_castps_si128(_mm_cmplt_ps(c, _mm_set1_ps(6.103515625e-05f)));
+   return _mm_or_si128(_mm_and_si128(is_sub, sub), _mm_andnot_si128(is_sub, norm));
+}
+#endif
+
+static void stbi__float_to_half_row(stbi__uint16 *out, const float *in, int n, int simd)
+{
+   int i = 0;
+   #ifdef STBI__F16C
+   if (simd == 2) {
+      const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(65504.0f);
+      for (; i + 8 <= n; i += 8) {
+         // clamp first so overflow saturates (and NaN becomes 0) like the other paths
+         __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i    ), lo), hi);
+         __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), lo), hi);
+         __m128i h = _mm_unpacklo_epi64(_mm_cvtps_ph(a, 0), _mm_cvtps_ph(b, 0)); // 0 = round to nearest even
+         _mm_storeu_si128((__m128i *) (out + i), h);
+      }
+   }
+   #endif
+   #ifdef STBI_SSE2
+   if (simd) {
+      for (; i + 8 <= n; i += 8) {
+         __m128i a = stbi__float_to_half4(_mm_loadu_ps(in + i    ));
+         __m128i b = stbi__float_to_half4(_mm_loadu_ps(in + i + 4));
+         _mm_storeu_si128((__m128i *) (out + i), _mm_packs_epi32(a, b)); // halves are below 0x7c00, so signed packing is exact
+      }
+   }
+   #else
+   STBI_NOTUSED(simd);
+   #endif
+   for (; i < n; ++i)
+      out[i] = stbi__float_to_half(in[i]);
+}
+
+// float RGB to GL_RGB9_E5 as EXT_texture_shared_exponent specifies it
+// (9-bit mantissas, exponent bias 15); negative values and NaN become 0
+static stbi__uint32 stbi__float_to_rgb9e5(float r, float g, float b)
+{
+   const float max9e5 = 65408.0f; // 511/512 * 2^16, the largest representable value
+   float m;
+   int e, maxs;
+   r = r > 0 ? (r < max9e5 ? r : max9e5) : 0;
+   g = g > 0 ? (g < max9e5 ? g : max9e5) : 0;
+   b = b > 0 ? (b < max9e5 ? b : max9e5) : 0;
+   m = r > g ? (r > b ? r : b) : (g > b ? g : b);
+   if (m == 0) return 0;
+   frexp(m, &e);                  // m = f * 2^e with 0.5 <= f < 1, so floor(log2(m)) = e-1
+   e = (e - 1 < -16 ? -16 : e - 1) + 16;
+   maxs = (int) floor(ldexp(m, 24 - e) + 0.5);
+   if (maxs == 512) ++e;
+   return (stbi__uint32) floor(ldexp(r, 24 - e) + 0.5)
+        | (stbi__uint32) floor(ldexp(g, 24 - e) + 0.5) << 9
+        | (stbi__uint32) floor(ldexp(b, 24 - e) + 0.5) << 18
+        | (stbi__uint32) e << 27;
+}
+#endif
+
+#ifndef STBI_NO_LINEAR
+// convert a float image from stbi__ldr_to_hdr to half or RGB9E5 (comp is 3
+// for the latter); frees data
+static void *stbi__hdr_from_float(float *data, int pixels, int comp, int format)
+{
+   void *out;
+   int i;
+   if (!data) return NULL;
+   out = stbi__malloc_mad2(pixels, stbi__hdr_pixel_bytes(format, comp), 0);
+   if (out == NULL) { stbi__free(data); return stbi__errpuc("outofmem", "Out of memory"); }
+   if (format == STBI__HDR_half) {
+      stbi__float_to_half_row((stbi__uint16 *) out, data, pixels * comp, stbi__hdr_simd());
+   } else {
+      STBI_ASSERT(format == STBI__HDR_rgb9e5 && comp == 3);
+      for (i=0; i < pixels; ++i)
+         ((stbi__uint32 *) out)[i] = stbi__float_to_rgb9e5(data[i*3], data[i*3+1], data[i*3+2]);
+   }
+   stbi__free(data);
+   return out;
+}
+#endif
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  "baseline" JPEG/JFIF decoder
@@ -1972,6 +4083,9 @@ typedef struct
       stbi_uc *linebuf;
       short   *coeff;   // progressive only
       int      coeff_w, coeff_h; // number of 8x8 coefficient blocks
+      int      scale;            // IDCT output is (8 >> scale) pixels square
+      int      bx0,by0,bx1,by1;  // blocks the requested output region needs
+      int      ready;            // plane rows reconstructed so far, while streaming
    } img_comp[4];
 
    stbi__uint32   code_buffer; // jpeg entropy-coded buffer
@@ -1992,6 +4106,17 @@ typedef struct
    int scan_n, order[4];
    int restart_interval, todo;
 
+// scaled and region decoding (stbi_load_jpeg_*)
+   int scale_shift;        // output is 1/(1 << scale_shift) of full size
+   int roi_x0, roi_y0, roi_x1, roi_y1; // output region, in scaled pixels
+   int roi_mcu_y1;         // interleaved MCU rows needed to cover the region
+   int roi_done;           // entropy decoding stopped below the region
+
+// row streaming (stbi_load_rows*): a baseline image keeps only two MCU rows of
+// each component, as a ring of h2 rows, and converts rows as they complete
+   int ring;
+   void *output;           // stbi__jpeg_output while converting
+
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
    void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
@@ -2070,6 +4195,81 @@ static void stbi__build_fast_ac(stbi__int16 *fast_ac, stbi__huffman *h)
    }
 }
 
+// stbi_decoder: the last few DHT tables built, keyed by class, code counts
+// and symbol values. camera and encoder JPEGs almost always repeat the same
+// tables, so most DHT segments become a copy instead of a rebuild
+#define STBI__DHT_CACHE_SIZE  8
+
+typedef struct
+{
+   int tc, n;
+   stbi_uc counts[16];
+   stbi__huffman h;                      // includes the n symbol values
+   stbi__int16 fast_ac[1 << FAST_BITS];  // AC tables only
+} stbi__dht_entry;
+
+struct stbi__dht_cache
+{
+   stbi__dht_entry entry[STBI__DHT_CACHE_SIZE];
+   int used, next;  // next is the entry to replace once all are used
+};
+
+static stbi__dht_entry *stbi__jpeg_find_huffman(struct stbi__dht_cache *c, int tc, int *counts, stbi__huffman *h, int n)
+{
+   int i,k;
+   for (i=0; i < c->used; ++i) {
+      stbi__dht_entry *e = &c->entry[i];
+      if (e->tc != tc || e->n != n) continue;
+      for (k=0; k < 16; ++k)
+         if (e->counts[k] != counts[k]) break;
+      if (k == 16 && memcmp(e->h.values, h->values, n) == 0)
+         return e;
+   }
+   return NULL;
+}
+
+// fill table th of class tc from the decoder's cache if it was seen before,
+// otherwise build it (h->values already holds the symbols) and remember it
+static int stbi__jpeg_reuse_huffman(stbi__jpeg *z, int tc, int th, int *counts, int n)
+{
+   stbi__huffman *h = tc == 0 ? z->huff_dc + th : z->huff_ac + th;
+   stbi_decoder *d = z->s->decoder;
+   stbi__dht_entry *e;
+   int k;
+
+   if (d && d->dht && (e = stbi__jpeg_find_huffman(d->dht, tc, counts, h, n)) != NULL) {
+      memcpy(h, &e->h, sizeof(*h));
+      if (tc != 0) memcpy(z->fast_ac[th], e->fast_ac, sizeof(e->fast_ac));
+      ++d->tables_reused;
+      return 1;
+   }
+
+   if (!stbi__build_huffman(h, counts)) return 0;
+   if (tc != 0)
+      stbi__build_fast_ac(z->fast_ac[th], h);
+
+   if (d) {
+      if (d->dht == NULL) {
+         d->dht = (struct stbi__dht_cache *) STBI_MALLOC(sizeof(struct stbi__dht_cache));
+         if (d->dht == NULL) return 1; // no cache, just slower
+         d->dht->used = d->dht->next = 0;
+      }
+      if (d->dht->used < STBI__DHT_CACHE_SIZE) {
+         e = &d->dht->entry[d->dht->used++];
+      } else {
+         e = &d->dht->entry[d->dht->next];
+         d->dht->next = (d->dht->next + 1) % STBI__DHT_CACHE_SIZE;
+      }
+      e->tc = tc;
+      e->n = n;
+      for (k=0; k < 16; ++k)
+         e->counts[k] = (stbi_uc) counts[k];
+      memcpy(&e->h, h, sizeof(*h));
+      if (tc != 0) memcpy(e->fast_ac, z->fast_ac[th], sizeof(e->fast_ac));
+   }
+   return 1;
+}
+
 static void stbi__grow_buffer_unsafe(stbi__jpeg *j)
 {
    do {
@@ -2521,6 +4721,73 @@ static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
    }
 }
 
+// reduced-size IDCTs for scaled decoding. each output pixel is the average
+// of the 2x2 or 4x4 pixels the full 8x8 IDCT would have produced, computed
+// directly from the coefficients: per axis, row m of the table holds
+// C(u)/2 * mean over that pixel group of cos((2x+1)u*pi/16), in 4.12 fixed
+// point. that's exactly a box filter of the full-size block.
+static const int stbi__idct_4x4_k[4][8] = {
+   { stbi__f2f( 0.353553391f), stbi__f2f( 0.453063723f), stbi__f2f( 0.326640741f), stbi__f2f( 0.159094823f), 0, stbi__f2f(-0.106303762f), stbi__f2f(-0.135299025f), stbi__f2f(-0.090119978f) },
+   { stbi__f2f( 0.353553391f), stbi__f2f( 0.187665139f), stbi__f2f(-0.326640741f), stbi__f2f(-0.384088878f), 0, stbi__f2f( 0.256639984f), stbi__f2f( 0.135299025f), stbi__f2f(-0.037328917f) },
+   { stbi__f2f( 0.353553391f), stbi__f2f(-0.187665139f), stbi__f2f(-0.326640741f), stbi__f2f( 0.384088878f), 0, stbi__f2f(-0.256639984f), stbi__f2f( 0.135299025f), stbi__f2f( 0.037328917f) },
+   { stbi__f2f( 0.353553391f), stbi__f2f(-0.453063723f), stbi__f2f( 0.326640741f), stbi__f2f(-0.159094823f), 0, stbi__f2f( 0.106303762f), stbi__f2f(-0.135299025f), stbi__f2f( 0.090119978f) },
+};
+static const int stbi__idct_2x2_k[2][8] = {
+   { stbi__f2f( 0.353553391f), stbi__f2f( 0.320364431f), 0, stbi__f2f(-0.112497028f), 0, stbi__f2f( 0.075168111f), 0, stbi__f2f(-0.063724447f) },
+   { stbi__f2f( 0.353553391f), stbi__f2f(-0.320364431f), 0, stbi__f2f( 0.112497028f), 0, stbi__f2f(-0.075168111f), 0, stbi__f2f( 0.063724447f) },
+};
+
+static void stbi__idct_reduced(stbi_uc *out, int out_stride, short data[64], const int (*k)[8], int n)
+{
+   int i,j,u,val[4*8];
+   short *d = data;
+
+   // columns: n outputs each, keeping 2 extra bits of precision like stbi__idct_block
+   for (u=0; u < 8; ++u, ++d) {
+      if (d[ 8]==0 && d[16]==0 && d[24]==0 && d[32]==0
+           && d[40]==0 && d[48]==0 && d[56]==0) {
+         // DC-only column, flat; k[j][0] is the same for every j
+         int dcterm = (k[0][0] * d[0] + 512) >> 10;
+         for (j=0; j < n; ++j) val[j*8+u] = dcterm;
+      } else {
+         for (j=0; j < n; ++j) {
+            int t = 0;
+            for (i=0; i < 8; ++i) t += k[j][i] * d[i*8];
+            val[j*8+u] = (t + 512) >> 10;
+         }
+      }
+   }
+
+   // rows: remove 12+2 bits with rounding, and re-bias to 0..255
+   for (j=0; j < n; ++j, out += out_stride)
+      for (i=0; i < n; ++i) {
+         int t = 0;
+         for (u=0; u < 8; ++u) t += k[i][u] * val[j*8+u];
+         out[i] = stbi__clamp((t + 8192 + (128 << 14)) >> 14);
+      }
+}
+
+static void stbi__idct_block_4x4(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, stbi__idct_4x4_k, 4);
+}
+
+static void stbi__idct_block_2x2(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, stbi__idct_2x2_k, 2);
+}
+
+static void stbi__idct_block_1x1(stbi_uc *out, int out_stride, short data[64])
+{
+   // the DC term alone is 8x the block average
+   STBI_NOTUSED(out_stride);
+   out[0] = stbi__clamp(((data[0] + 4) >> 3) + 128);
+}
+
+static void (* const stbi__idct_reduced_kernel[4])(stbi_uc *out, int out_stride, short data[64]) = {
+   NULL, stbi__idct_block_4x4, stbi__idct_block_2x2, stbi__idct_block_1x1
+};
+
 #ifdef STBI_SSE2
 // sse2 integer IDCT. not the fastest possible implementation but it
 // produces bit-identical results to the generic C version so it's
@@ -2944,6 +5211,23 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// reconstruct block (bx,by) of component n into its plane, unless the
+// requested output region doesn't need it
+static void stbi__jpeg_idct(stbi__jpeg *z, int n, int bx, int by, short data[64])
+{
+   int bs = 8 >> z->img_comp[n].scale;
+   int row = z->ring ? by*bs % z->img_comp[n].h2 : by*bs;
+   stbi_uc *out = z->img_comp[n].data+z->img_comp[n].w2*row+bx*bs;
+   if (bx < z->img_comp[n].bx0 || bx >= z->img_comp[n].bx1 || by < z->img_comp[n].by0 || by >= z->img_comp[n].by1)
+      return;
+   if (z->img_comp[n].scale)
+      stbi__idct_reduced_kernel[z->img_comp[n].scale](out, z->img_comp[n].w2, data);
+   else
+      z->idct_block_kernel(out, z->img_comp[n].w2, data);
+}
+
+static void stbi__jpeg_emit_rows(stbi__jpeg *z, int all);
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
@@ -2959,10 +5243,15 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
          int w = (z->img_comp[n].x+7) >> 3;
          int h = (z->img_comp[n].y+7) >> 3;
          for (j=0; j < h; ++j) {
+            // a single-component image is done once we're below the region
+            if (z->s->img_n == 1 && j >= z->img_comp[n].by1) {
+               z->roi_done = 1;
+               return 1;
+            }
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               stbi__jpeg_idct(z, n, i, j, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2972,12 +5261,22 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   stbi__jpeg_reset(z);
                }
             }
+            if (z->ring) {
+               z->img_comp[n].ready = (j+1) * (8 >> z->img_comp[n].scale);
+               stbi__jpeg_emit_rows(z, 0);
+            }
          }
          return 1;
       } else { // interleaved
          int i,j,k,x,y;
          STBI_SIMD_ALIGN(short, data[64]);
          for (j=0; j < z->img_mcu_y; ++j) {
+            // once every component has been decoded past the region there's
+            // nothing left in this (only) scan that we need
+            if (j >= z->roi_mcu_y1 && z->scan_n == z->s->img_n) {
+               z->roi_done = 1;
+               return 1;
+            }
             for (i=0; i < z->img_mcu_x; ++i) {
                // scan an interleaved mcu... process scan_n components in order
                for (k=0; k < z->scan_n; ++k) {
@@ -2986,11 +5285,11 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   // by the basic H and V specified for the component
                   for (y=0; y < z->img_comp[n].v; ++y) {
                      for (x=0; x < z->img_comp[n].h; ++x) {
-                        int x2 = (i*z->img_comp[n].h + x)*8;
-                        int y2 = (j*z->img_comp[n].v + y)*8;
+                        int x2 = i*z->img_comp[n].h + x;
+                        int y2 = j*z->img_comp[n].v + y;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        stbi__jpeg_idct(z, n, x2, y2, data);
                      }
                   }
                }
@@ -3002,6 +5301,13 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   stbi__jpeg_reset(z);
                }
             }
+            if (z->ring) {
+               for (k=0; k < z->scan_n; ++k) {
+                  int n = z->order[k];
+                  z->img_comp[n].ready = (j+1) * z->img_comp[n].v * (8 >> z->img_comp[n].scale);
+               }
+               stbi__jpeg_emit_rows(z, 0);
+            }
          }
          return 1;
       }
@@ -3083,11 +5389,14 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
       for (n=0; n < z->s->img_n; ++n) {
          int w = (z->img_comp[n].x+7) >> 3;
          int h = (z->img_comp[n].y+7) >> 3;
-         for (j=0; j < h; ++j) {
-            for (i=0; i < w; ++i) {
+         // only the blocks the output region needs
+         if (w > z->img_comp[n].bx1) w = z->img_comp[n].bx1;
+         if (h > z->img_comp[n].by1) h = z->img_comp[n].by1;
+         for (j=z->img_comp[n].by0; j < h; ++j) {
+            for (i=z->img_comp[n].bx0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               stbi__jpeg_idct(z, n, i, j, data);
             }
          }
       }
@@ -3136,17 +5445,11 @@ static int stbi__process_marker(stbi__jpeg *z, int m)
             }
             if(n > 256) return stbi__err("bad DHT header","Corrupt JPEG"); // Loop over i < n would write past end of values!
             L -= 17;
-            if (tc == 0) {
-               if (!stbi__build_huffman(z->huff_dc+th, sizes)) return 0;
-               v = z->huff_dc[th].values;
-            } else {
-               if (!stbi__build_huffman(z->huff_ac+th, sizes)) return 0;
-               v = z->huff_ac[th].values;
-            }
+            // the symbols are read first so a decoder can match the whole table
+            v = tc == 0 ? z->huff_dc[th].values : z->huff_ac[th].values;
             for (i=0; i < n; ++i)
                v[i] = stbi__get8(z->s);
-            if (tc != 0)
-               stbi__build_fast_ac(z->fast_ac[th], z->huff_ac + th);
+            if (!stbi__jpeg_reuse_huffman(z, tc, th, sizes, n)) return 0;
             L -= n;
          }
          return L==0;
@@ -3242,23 +5545,74 @@ static int stbi__free_jpeg_components(stbi__jpeg *z, int ncomp, int why)
    int i;
    for (i=0; i < ncomp; ++i) {
       if (z->img_comp[i].raw_data) {
-         STBI_FREE(z->img_comp[i].raw_data);
+         stbi__free(z->img_comp[i].raw_data);
          z->img_comp[i].raw_data = NULL;
          z->img_comp[i].data = NULL;
       }
       if (z->img_comp[i].raw_coeff) {
-         STBI_FREE(z->img_comp[i].raw_coeff);
+         stbi__free(z->img_comp[i].raw_coeff);
          z->img_comp[i].raw_coeff = 0;
          z->img_comp[i].coeff = 0;
       }
       if (z->img_comp[i].linebuf) {
-         STBI_FREE(z->img_comp[i].linebuf);
+         stbi__free(z->img_comp[i].linebuf);
          z->img_comp[i].linebuf = NULL;
       }
    }
    return why;
 }
 
+// clip the requested region to the (scaled) image and work out which blocks
+// of each component it needs. one extra block on each side feeds the
+// upsampling filters, which look at neighbouring chroma samples.
+// upsampling factors for component i that remain after scaled decoding
+static int stbi__jpeg_hs(stbi__jpeg *z, int i) { return (z->img_h_max / z->img_comp[i].h) >> (z->scale_shift - z->img_comp[i].scale); }
+static int stbi__jpeg_vs(stbi__jpeg *z, int i) { return (z->img_v_max / z->img_comp[i].v) >> (z->scale_shift - z->img_comp[i].scale); }
+
+static int stbi__jpeg_setup_region(stbi__jpeg *z)
+{
+   stbi__context *s = z->s;
+   int i;
+   int w = (int) ((s->img_x + (1u << z->scale_shift) - 1) >> z->scale_shift);
+   int h = (int) ((s->img_y + (1u << z->scale_shift) - 1) >> z->scale_shift);
+
+   if (s->roi_w == 0 && s->roi_h == 0) {
+      z->roi_x0 = z->roi_y0 = 0;
+      z->roi_x1 = w;
+      z->roi_y1 = h;
+      z->roi_mcu_y1 = z->img_mcu_y;
+      for (i=0; i < s->img_n; ++i) {
+         z->img_comp[i].bx0 = z->img_comp[i].by0 = 0;
+         z->img_comp[i].bx1 = z->img_comp[i].by1 = 1 << 30;
+      }
+      return 1;
+   }
+
+   if (s->roi_w <= 0 || s->roi_h <= 0 || s->roi_x < 0 || s->roi_y < 0 || s->roi_x >= w || s->roi_y >= h)
+      return stbi__err("bad region", "Region is empty or lies outside the image");
+   z->roi_x0 = s->roi_x;
+   z->roi_y0 = s->roi_y;
+   z->roi_x1 = s->roi_w > w - s->roi_x ? w : s->roi_x + s->roi_w;
+   z->roi_y1 = s->roi_h > h - s->roi_y ? h : s->roi_y + s->roi_h;
+
+   z->roi_mcu_y1 = 0;
+   for (i=0; i < s->img_n; ++i) {
+      int hs = stbi__jpeg_hs(z, i);
+      int vs = stbi__jpeg_vs(z, i);
+      int bs = 8 >> z->img_comp[i].scale;
+      int mcu_rows;
+      z->img_comp[i].bx0 = z->roi_x0 / hs / bs - 1;
+      z->img_comp[i].by0 = z->roi_y0 / vs / bs - 1;
+      z->img_comp[i].bx1 = ((z->roi_x1 + hs-1) / hs + bs-1) / bs + 1;
+      z->img_comp[i].by1 = ((z->roi_y1 + vs-1) / vs + bs-1) / bs + 1;
+      if (z->img_comp[i].bx0 < 0) z->img_comp[i].bx0 = 0;
+      if (z->img_comp[i].by0 < 0) z->img_comp[i].by0 = 0;
+      mcu_rows = (z->img_comp[i].by1 + z->img_comp[i].v-1) / z->img_comp[i].v;
+      if (mcu_rows > z->roi_mcu_y1) z->roi_mcu_y1 = mcu_rows;
+   }
+   return 1;
+}
+
 static int stbi__process_frame_header(stbi__jpeg *z, int scan)
 {
    stbi__context *s = z->s;
@@ -3295,6 +5649,8 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
 
    if (!stbi__mad3sizes_valid(s->img_x, s->img_y, s->img_n, 0)) return stbi__err("too large", "Image too large to decode");
 
+   z->ring = s->on_rows != NULL && !z->progressive;
+
    for (i=0; i < s->img_n; ++i) {
       if (z->img_comp[i].h > h_max) h_max = z->img_comp[i].h;
       if (z->img_comp[i].v > v_max) v_max = z->img_comp[i].v;
@@ -3317,6 +5673,18 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
    z->img_mcu_y = (s->img_y + z->img_mcu_h-1) / z->img_mcu_h;
 
    for (i=0; i < s->img_n; ++i) {
+      int bs, hs = h_max / z->img_comp[i].h, vs = v_max / z->img_comp[i].v;
+      // when decoding scaled, a subsampled component gets a less-reduced IDCT
+      // instead of being upsampled as much later (as libjpeg does); e.g. at
+      // 1/8, 4:2:0 chroma blocks come out 2x2 and need no upsampling at all
+      z->img_comp[i].scale = z->scale_shift;
+      while (z->img_comp[i].scale > 0 && hs % 2 == 0 && vs % 2 == 0) {
+         --z->img_comp[i].scale;
+         hs >>= 1;
+         vs >>= 1;
+      }
+      bs = 8 >> z->img_comp[i].scale;
+
       // number of effective pixels (e.g. for non-interleaved MCU)
       z->img_comp[i].x = (s->img_x * z->img_comp[i].h + h_max-1) / h_max;
       z->img_comp[i].y = (s->img_y * z->img_comp[i].v + v_max-1) / v_max;
@@ -3327,8 +5695,13 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       //
       // img_mcu_x, img_mcu_y: <=17 bits; comp[i].h and .v are <=4 (checked earlier)
       // so these muls can't overflow with 32-bit ints (which we require)
-      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
-      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
+      //
+      // when decoding scaled, each block only occupies bs x bs pixels
+      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * bs;
+      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * bs;
+      // a baseline image being streamed only needs two MCU rows at a time
+      if (z->ring && z->img_mcu_y > 2)
+         z->img_comp[i].h2 = 2 * z->img_comp[i].v * bs;
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
@@ -3338,17 +5711,17 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       // align blocks for idct using mmx/sse
       z->img_comp[i].data = (stbi_uc*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
       if (z->progressive) {
-         // w2, h2 are multiples of 8 (see above)
-         z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
-         z->img_comp[i].coeff_h = z->img_comp[i].h2 / 8;
-         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].w2, z->img_comp[i].h2, sizeof(short), 15);
+         // w2, h2 are multiples of bs (see above)
+         z->img_comp[i].coeff_w = z->img_comp[i].w2 / bs;
+         z->img_comp[i].coeff_h = z->img_comp[i].h2 / bs;
+         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].coeff_w * 64, z->img_comp[i].coeff_h, sizeof(short), 15);
          if (z->img_comp[i].raw_coeff == NULL)
             return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
          z->img_comp[i].coeff = (short*) (((size_t) z->img_comp[i].raw_coeff + 15) & ~15);
       }
    }
 
-   return 1;
+   return stbi__jpeg_setup_region(z);
 }
 
 // use comparisons since in some cases we handle more than one case (e.g. SOF)
@@ -3406,6 +5779,28 @@ static int stbi__skip_jpeg_junk_at_end(stbi__jpeg *j)
    return STBI__MARKER_none;
 }
 
+static int stbi__jpeg_begin_output(stbi__jpeg *z);
+
+// called at every scan while the planes are rings. the first scan must carry
+// all components for MCU rows to complete one at a time; if it doesn't, go
+// back to whole planes and convert after decoding like any other image
+static int stbi__jpeg_start_streaming(stbi__jpeg *z)
+{
+   int i;
+   if (z->scan_n == z->s->img_n)
+      return stbi__jpeg_begin_output(z);
+   z->ring = 0;
+   for (i=0; i < z->s->img_n; ++i) {
+      int bs = 8 >> z->img_comp[i].scale;
+      stbi__free(z->img_comp[i].raw_data);
+      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * bs;
+      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, z->img_comp[i].h2, 15);
+      z->img_comp[i].data = (stbi_uc*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
+      if (z->img_comp[i].raw_data == NULL) return stbi__err("outofmem", "Out of memory");
+   }
+   return 1;
+}
+
 // decode image to YCbCr format
 static int stbi__decode_jpeg_image(stbi__jpeg *j)
 {
@@ -3420,7 +5815,9 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
    while (!stbi__EOI(m)) {
       if (stbi__SOS(m)) {
          if (!stbi__process_scan_header(j)) return 0;
+         if (j->ring && !stbi__jpeg_start_streaming(j)) return 0;
          if (!stbi__parse_entropy_coded_data(j)) return 0;
+         if (j->roi_done) return 1; // the rest of the image is below the region
          if (j->marker == STBI__MARKER_none ) {
          j->marker = stbi__skip_jpeg_junk_at_end(j);
             // if we reach eof without hitting a marker, stbi__get_marker() below will fail and we'll eventually return 0
@@ -3847,8 +6244,10 @@ typedef struct
 {
    resample_row_func resample;
    stbi_uc *line0,*line1;
+   stbi_uc *plane_end; // line1 wraps around to the start of a ring plane here
    int hs,vs;   // expansion factor in each axis
    int w_lores; // horizontal pixels pre-expansion
+   int h_lores; // vertical pixels pre-expansion
    int ystep;   // how far through vertical expansion we are
    int ypos;    // which pre-expansion row we're on
 } stbi__resample;
@@ -3860,167 +6259,261 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
    return (stbi_uc) ((t + (t >>8)) >> 8);
 }
 
-static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
+// resampling and color conversion state; rows are converted after decoding,
+// or while decoding when the image is streamed
+typedef struct
 {
-   int n, decode_n, is_rgb;
-   z->s->img_n = 0; // make stbi__cleanup_jpeg safe
+   stbi__resample res_comp[4];
+   int req_comp, n, decode_n, is_rgb;
+   unsigned int out_w, out_h;
+   unsigned int j;           // next row to produce, counted from the top of the scaled image
+   stbi_uc *output, *rowbuf;
+   stbi__row_sink sink;
+   int started;
+} stbi__jpeg_output;
 
-   // validate req_comp
-   if (req_comp < 0 || req_comp > 4) return stbi__errpuc("bad req_comp", "Internal error");
+static int stbi__jpeg_begin_output(stbi__jpeg *z)
+{
+   stbi__jpeg_output *o = (stbi__jpeg_output *) z->output;
+   int k, n, round = (1 << z->scale_shift) - 1;
+   int img_w = (int) ((z->s->img_x + round) >> z->scale_shift);
+   int img_h = (int) ((z->s->img_y + round) >> z->scale_shift);
 
-   // load a jpeg image from whichever source, but leave in YCbCr format
-   if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
+   if (o->started) return 1;
+   o->started = 1;
 
    // determine actual number of components to generate
-   n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
+   n = o->n = o->req_comp ? o->req_comp : z->s->img_n >= 3 ? 3 : 1;
 
-   is_rgb = z->s->img_n == 3 && (z->rgb == 3 || (z->app14_color_transform == 0 && !z->jfif));
+   o->is_rgb = z->s->img_n == 3 && (z->rgb == 3 || (z->app14_color_transform == 0 && !z->jfif));
 
-   if (z->s->img_n == 3 && n < 3 && !is_rgb)
-      decode_n = 1;
+   if (z->s->img_n == 3 && n < 3 && !o->is_rgb)
+      o->decode_n = 1;
    else
-      decode_n = z->s->img_n;
+      o->decode_n = z->s->img_n;
 
    // nothing to do if no components requested; check this now to avoid
    // accessing uninitialized coutput[0] later
-   if (decode_n <= 0) { stbi__cleanup_jpeg(z); return NULL; }
-
-   // resample and color-convert
-   {
-      int k;
-      unsigned int i,j;
-      stbi_uc *output;
-      stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
-
-      stbi__resample res_comp[4];
-
-      for (k=0; k < decode_n; ++k) {
-         stbi__resample *r = &res_comp[k];
+   if (o->decode_n <= 0) return 0;
+
+   o->out_w = z->roi_x1 - z->roi_x0;
+   o->out_h = z->roi_y1 - z->roi_y0;
+   o->j = 0;
+
+   for (k=0; k < o->decode_n; ++k) {
+      stbi__resample *r = &o->res_comp[k];
+
+      // allocate line buffer big enough for upsampling off the edges
+      // with upsample factor of 4
+      z->img_comp[k].linebuf = (stbi_uc *) stbi__malloc(img_w + 3);
+      if (!z->img_comp[k].linebuf) return stbi__err("outofmem", "Out of memory");
+
+      r->hs      = stbi__jpeg_hs(z, k);
+      r->vs      = stbi__jpeg_vs(z, k);
+      r->ystep   = r->vs >> 1;
+      r->w_lores = (img_w + r->hs-1) / r->hs;
+      r->h_lores = (img_h + r->vs-1) / r->vs;
+      r->ypos    = 0;
+      r->line0   = r->line1 = z->img_comp[k].data;
+      r->plane_end = z->img_comp[k].data + z->img_comp[k].w2 * z->img_comp[k].h2;
+
+      if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
+      else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
+      else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
+      else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
+      else                               r->resample = stbi__resample_row_generic;
+   }
+
+   // the 3-channel converters store a 4th byte per pixel, which would run past
+   // the end of a row in someone else's memory, so those go through a one-row
+   // bounce buffer
+   if (z->s->on_rows) {
+      // a strip holds what one MCU row can release (plus the filter lag)
+      int strip = ((z->img_mcu_h >> z->scale_shift) + 2) * (z->ring ? 1 : 2);
+      if (!stbi__row_sink_init(&o->sink, z->s, o->out_w, o->out_h, n, strip)) return 0;
+   } else if (z->s->dest && z->s->dest_bytes_per_channel == 1) {
+      // stbi_load_into: color-convert straight into the caller's rows
+      if (!stbi__dest_fits(z->s, o->out_w, o->out_h, n)) return 0;
+   } else {
+      o->output = (stbi_uc *) stbi__malloc_mad3(n, o->out_w, o->out_h, 1);
+      if (!o->output) return stbi__err("outofmem", "Out of memory");
+   }
+   if (!o->output && n == 3) {
+      o->rowbuf = (stbi_uc *) stbi__malloc_mad2(n, o->out_w, 1);
+      if (!o->rowbuf) return stbi__err("outofmem", "Out of memory");
+   }
+   return 1;
+}
 
-         // allocate line buffer big enough for upsampling off the edges
-         // with upsample factor of 4
-         z->img_comp[k].linebuf = (stbi_uc *) stbi__malloc(z->s->img_x + 3);
-         if (!z->img_comp[k].linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+static void stbi__jpeg_convert_row(stbi__jpeg *z, stbi_uc *out, stbi_uc *coutput[4], unsigned int out_w, int n, int is_rgb)
+{
+   unsigned int i;
+   if (n >= 3) {
+      stbi_uc *y = coutput[0];
+      if (z->s->img_n == 3) {
+         if (is_rgb) {
+            for (i=0; i < out_w; ++i) {
+               out[0] = y[i];
+               out[1] = coutput[1][i];
+               out[2] = coutput[2][i];
+               out[3] = 255;
+               out += n;
+            }
+         } else {
+            z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], out_w, n);
+         }
+      } else if (z->s->img_n == 4) {
+         if (z->app14_color_transform == 0) { // CMYK
+            for (i=0; i < out_w; ++i) {
+               stbi_uc m = coutput[3][i];
+               out[0] = stbi__blinn_8x8(coutput[0][i], m);
+               out[1] = stbi__blinn_8x8(coutput[1][i], m);
+               out[2] = stbi__blinn_8x8(coutput[2][i], m);
+               out[3] = 255;
+               out += n;
+            }
+         } else if (z->app14_color_transform == 2) { // YCCK
+            z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], out_w, n);
+            for (i=0; i < out_w; ++i) {
+               stbi_uc m = coutput[3][i];
+               out[0] = stbi__blinn_8x8(255 - out[0], m);
+               out[1] = stbi__blinn_8x8(255 - out[1], m);
+               out[2] = stbi__blinn_8x8(255 - out[2], m);
+               out += n;
+            }
+         } else { // YCbCr + alpha?  Ignore the fourth channel for now
+            z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], out_w, n);
+         }
+      } else
+         for (i=0; i < out_w; ++i) {
+            out[0] = out[1] = out[2] = y[i];
+            out[3] = 255; // not used if n==3
+            out += n;
+         }
+   } else {
+      if (is_rgb) {
+         if (n == 1)
+            for (i=0; i < out_w; ++i)
+               *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+         else {
+            for (i=0; i < out_w; ++i, out += 2) {
+               out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+               out[1] = 255;
+            }
+         }
+      } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
+         for (i=0; i < out_w; ++i) {
+            stbi_uc m = coutput[3][i];
+            stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
+            stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
+            stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
+            out[0] = stbi__compute_y(r, g, b);
+            if (n == 2) out[1] = 255;
+            out += n;
+         }
+      } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
+         for (i=0; i < out_w; ++i) {
+            out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
+            if (n == 2) out[1] = 255;
+            out += n;
+         }
+      } else {
+         stbi_uc *y = coutput[0];
+         if (n == 1)
+            for (i=0; i < out_w; ++i) out[i] = y[i];
+         else
+            for (i=0; i < out_w; ++i) { *out++ = y[i]; *out++ = 255; }
+      }
+   }
+}
 
-         r->hs      = z->img_h_max / z->img_comp[k].h;
-         r->vs      = z->img_v_max / z->img_comp[k].v;
-         r->ystep   = r->vs >> 1;
-         r->w_lores = (z->s->img_x + r->hs-1) / r->hs;
-         r->ypos    = 0;
-         r->line0   = r->line1 = z->img_comp[k].data;
+// resample and color-convert every row whose source lines have been
+// reconstructed (all of them once decoding is done). rows above the region
+// only advance the resamplers; rows below it are never produced
+static void stbi__jpeg_emit_rows(stbi__jpeg *z, int all)
+{
+   stbi__jpeg_output *o = (stbi__jpeg_output *) z->output;
+   stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
+   int k;
 
-         if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
-         else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
-         else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
-         else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
-         else                               r->resample = stbi__resample_row_generic;
+   for (; o->j < (unsigned int) z->roi_y1; ++o->j) {
+      int emit = o->j >= (unsigned int) z->roi_y0;
+      unsigned int oy = o->j - z->roi_y0;
+      stbi_uc *row = NULL;
+      if (!all) {
+         // the lower of the two lines a resampler reads must be complete
+         for (k=0; k < o->decode_n; ++k) {
+            stbi__resample *r = &o->res_comp[k];
+            int line1 = r->ypos < r->h_lores ? r->ypos : r->h_lores-1;
+            if (line1 >= z->img_comp[k].ready) break;
+         }
+         if (k < o->decode_n) break;
       }
-
-      // can't error after this so, this is safe
-      output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
-      if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
-
-      // now go ahead and resample
-      for (j=0; j < z->s->img_y; ++j) {
-         stbi_uc *out = output + n * z->s->img_x * j;
-         for (k=0; k < decode_n; ++k) {
-            stbi__resample *r = &res_comp[k];
-            int y_bot = r->ystep >= (r->vs >> 1);
+      if (emit)
+         row = o->output ? o->output + o->n * o->out_w * oy
+             : z->s->on_rows ? stbi__row_sink_next(&o->sink)
+             : stbi__dest_row(z->s, o->out_h, oy);
+      for (k=0; k < o->decode_n; ++k) {
+         stbi__resample *r = &o->res_comp[k];
+         int y_bot = r->ystep >= (r->vs >> 1);
+         if (emit)
             coutput[k] = r->resample(z->img_comp[k].linebuf,
                                      y_bot ? r->line1 : r->line0,
                                      y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
-            if (++r->ystep >= r->vs) {
-               r->ystep = 0;
-               r->line0 = r->line1;
-               if (++r->ypos < z->img_comp[k].y)
-                  r->line1 += z->img_comp[k].w2;
-            }
-         }
-         if (n >= 3) {
-            stbi_uc *y = coutput[0];
-            if (z->s->img_n == 3) {
-               if (is_rgb) {
-                  for (i=0; i < z->s->img_x; ++i) {
-                     out[0] = y[i];
-                     out[1] = coutput[1][i];
-                     out[2] = coutput[2][i];
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else {
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else if (z->s->img_n == 4) {
-               if (z->app14_color_transform == 0) { // CMYK
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(coutput[0][i], m);
-                     out[1] = stbi__blinn_8x8(coutput[1][i], m);
-                     out[2] = stbi__blinn_8x8(coutput[2][i], m);
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else if (z->app14_color_transform == 2) { // YCCK
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(255 - out[0], m);
-                     out[1] = stbi__blinn_8x8(255 - out[1], m);
-                     out[2] = stbi__blinn_8x8(255 - out[2], m);
-                     out += n;
-                  }
-               } else { // YCbCr + alpha?  Ignore the fourth channel for now
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = out[1] = out[2] = y[i];
-                  out[3] = 255; // not used if n==3
-                  out += n;
-               }
-         } else {
-            if (is_rgb) {
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i)
-                     *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-               else {
-                  for (i=0; i < z->s->img_x; ++i, out += 2) {
-                     out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                     out[1] = 255;
-                  }
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  stbi_uc m = coutput[3][i];
-                  stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
-                  stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
-                  stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
-                  out[0] = stbi__compute_y(r, g, b);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else {
-               stbi_uc *y = coutput[0];
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
-               else
-                  for (i=0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
+                                     r->w_lores, r->hs) + z->roi_x0;
+         if (++r->ystep >= r->vs) {
+            r->ystep = 0;
+            r->line0 = r->line1;
+            if (++r->ypos < r->h_lores) {
+               r->line1 += z->img_comp[k].w2;
+               if (r->line1 == r->plane_end) r->line1 = z->img_comp[k].data;
             }
          }
       }
-      stbi__cleanup_jpeg(z);
-      *out_x = z->s->img_x;
-      *out_y = z->s->img_y;
+      if (!emit) continue;
+      stbi__jpeg_convert_row(z, o->rowbuf ? o->rowbuf : row, coutput, o->out_w, o->n, o->is_rgb);
+      if (o->rowbuf)
+         memcpy(row, o->rowbuf, o->n * o->out_w);
+   }
+   if (z->s->on_rows)
+      stbi__row_sink_flush(&o->sink);
+}
+
+static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
+{
+   stbi__jpeg_output o;
+   stbi_uc *result = NULL;
+   z->s->img_n = 0; // make stbi__cleanup_jpeg safe
+
+   // validate req_comp
+   if (req_comp < 0 || req_comp > 4) return stbi__errpuc("bad req_comp", "Internal error");
+
+   memset(&o, 0, sizeof(o));
+   o.req_comp = req_comp;
+   z->output = &o;
+
+   // load a jpeg image from whichever source, but leave in YCbCr format;
+   // a streamed image is converted as it goes
+   if (stbi__decode_jpeg_image(z) && stbi__jpeg_begin_output(z)) {
+      // can't error after this so, this is safe
+      stbi__jpeg_emit_rows(z, 1);
+      *out_x = o.out_w;
+      *out_y = o.out_h;
       if (comp) *comp = z->s->img_n >= 3 ? 3 : 1; // report original components, not output
-      return output;
+      if (o.output) {
+         result = o.output;
+      } else {
+         z->s->dest_written = 1;
+         result = z->s->on_rows ? &stbi__rows_delivered : z->s->dest;
+      }
+   } else {
+      stbi__free(o.output);
    }
+   stbi__cleanup_jpeg(z);
+   stbi__free(o.rowbuf);
+   stbi__free(o.sink.strip);
+   z->output = NULL;
+   return result;
 }
 
 static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri)
@@ -4032,8 +6525,9 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
    STBI_NOTUSED(ri);
    j->s = s;
    stbi__setup_jpeg(j);
+   j->scale_shift = s->jpeg_scale_shift;
    result = load_jpeg_image(j, x,y,comp,req_comp);
-   STBI_FREE(j);
+   stbi__free(j);
    return result;
 }
 
@@ -4047,7 +6541,7 @@ static int stbi__jpeg_test(stbi__context *s)
    stbi__setup_jpeg(j);
    r = stbi__decode_jpeg_header(j, STBI__SCAN_type);
    stbi__rewind(s);
-   STBI_FREE(j);
+   stbi__free(j);
    return r;
 }
 
@@ -4071,7 +6565,7 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
    memset(j, 0, sizeof(stbi__jpeg));
    j->s = s;
    result = stbi__jpeg_info_raw(j, x, y, comp);
-   STBI_FREE(j);
+   stbi__free(j);
    return result;
 }
 #endif
@@ -4183,6 +6677,15 @@ typedef struct
    char *zout_end;
    int   z_expandable;
 
+   // when set, a full output buffer is first handed to zdrain, which consumes
+   // bytes from zread on; everything before zread that is also outside the
+   // 32KB window is then dropped instead of growing the buffer
+   int (*zdrain)(void *user, char *zread, char *zout, char **consumed);
+   void *zdrain_user;
+   char *zread;
+
+   stbi_decoder *decoder; // fixed-code tables are kept here, if set
+
    stbi__zhuffman z_length, z_distance;
 } stbi__zbuf;
 
@@ -4262,6 +6765,20 @@ static int stbi__zexpand(stbi__zbuf *z, char *zout, int n)  // need to make room
    unsigned int cur, limit, old_limit;
    z->zout = zout;
    if (!z->z_expandable) return stbi__err("output buffer limit","Corrupt PNG");
+   if (z->zdrain) {
+      unsigned int drop, stale;
+      if (!z->zdrain(z->zdrain_user, z->zread, z->zout, &z->zread)) return 0;
+      cur   = (unsigned int) (z->zout - z->zout_start);
+      stale = cur > 32768 ? cur - 32768 : 0; // bytes a back-reference can no longer reach
+      drop  = (unsigned int) (z->zread - z->zout_start);
+      if (drop > stale) drop = stale;
+      if (drop) {
+         memmove(z->zout_start, z->zout_start + drop, cur - drop);
+         z->zout  -= drop;
+         z->zread -= drop;
+      }
+      if (z->zout + n <= z->zout_end) return 1;
+   }
    cur   = (unsigned int) (z->zout - z->zout_start);
    limit = old_limit = (unsigned) (z->zout_end - z->zout_start);
    if (UINT_MAX - cur < (unsigned) n) return stbi__err("outofmem", "Out of memory");
@@ -4269,7 +6786,7 @@ static int stbi__zexpand(stbi__zbuf *z, char *zout, int n)  // need to make room
       if(limit > UINT_MAX / 2) return stbi__err("outofmem", "Out of memory");
       limit *= 2;
    }
-   q = (char *) STBI_REALLOC_SIZED(z->zout_start, old_limit, limit);
+   q = (char *) stbi__realloc_sized(z->zout_start, old_limit, limit);
    STBI_NOTUSED(old_limit);
    if (q == NULL) return stbi__err("outofmem", "Out of memory");
    z->zout_start = q;
@@ -4457,6 +6974,34 @@ Init algorithm:
 }
 */
 
+// stbi_decoder: the fixed-code tables, built on the first fixed block
+struct stbi__zfixed
+{
+   stbi__zhuffman length, distance;
+};
+
+static int stbi__zbuild_fixed(stbi__zbuf *a)
+{
+   stbi_decoder *d = a->decoder;
+   if (d && d->zfixed) {
+      a->z_length = d->zfixed->length;
+      a->z_distance = d->zfixed->distance;
+      ++d->tables_reused;
+      return 1;
+   }
+   // use fixed code lengths
+   if (!stbi__zbuild_huffman(&a->z_length  , stbi__zdefault_length  , STBI__ZNSYMS)) return 0;
+   if (!stbi__zbuild_huffman(&a->z_distance, stbi__zdefault_distance,  32)) return 0;
+   if (d) {
+      d->zfixed = (struct stbi__zfixed *) STBI_MALLOC(sizeof(struct stbi__zfixed));
+      if (d->zfixed) {
+         d->zfixed->length = a->z_length;
+         d->zfixed->distance = a->z_distance;
+      }
+   }
+   return 1;
+}
+
 static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
 {
    int final, type;
@@ -4473,9 +7018,7 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
          return 0;
       } else {
          if (type == 1) {
-            // use fixed code lengths
-            if (!stbi__zbuild_huffman(&a->z_length  , stbi__zdefault_length  , STBI__ZNSYMS)) return 0;
-            if (!stbi__zbuild_huffman(&a->z_distance, stbi__zdefault_distance,  32)) return 0;
+            if (!stbi__zbuild_fixed(a)) return 0;
          } else {
             if (!stbi__compute_huffman_codes(a)) return 0;
          }
@@ -4485,12 +7028,14 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
    return 1;
 }
 
-static int stbi__do_zlib(stbi__zbuf *a, char *obuf, int olen, int exp, int parse_header)
+static int stbi__do_zlib(stbi__zbuf *a, char *obuf, int olen, int exp, int parse_header, stbi_decoder *decoder)
 {
+   a->decoder    = decoder;
    a->zout_start = obuf;
    a->zout       = obuf;
    a->zout_end   = obuf + olen;
    a->z_expandable = exp;
+   a->zdrain     = NULL;
 
    return stbi__parse_zlib(a, parse_header);
 }
@@ -4502,11 +7047,11 @@ STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int
    if (p == NULL) return NULL;
    a.zbuffer = (stbi_uc *) buffer;
    a.zbuffer_end = (stbi_uc *) buffer + len;
-   if (stbi__do_zlib(&a, p, initial_size, 1, 1)) {
+   if (stbi__do_zlib(&a, p, initial_size, 1, 1, NULL)) {
       if (outlen) *outlen = (int) (a.zout - a.zout_start);
       return a.zout_start;
    } else {
-      STBI_FREE(a.zout_start);
+      stbi__free(a.zout_start);
       return NULL;
    }
 }
@@ -4516,28 +7061,34 @@ STBIDEF char *stbi_zlib_decode_malloc(char const *buffer, int len, int *outlen)
    return stbi_zlib_decode_malloc_guesssize(buffer, len, 16384, outlen);
 }
 
-STBIDEF char *stbi_zlib_decode_malloc_guesssize_headerflag(const char *buffer, int len, int initial_size, int *outlen, int parse_header)
+// PNG decodes through here so that an stbi_decoder's fixed tables are used
+static char *stbi__zlib_decode_malloc_headerflag(const char *buffer, int len, int initial_size, int *outlen, int parse_header, stbi_decoder *decoder)
 {
    stbi__zbuf a;
    char *p = (char *) stbi__malloc(initial_size);
    if (p == NULL) return NULL;
    a.zbuffer = (stbi_uc *) buffer;
    a.zbuffer_end = (stbi_uc *) buffer + len;
-   if (stbi__do_zlib(&a, p, initial_size, 1, parse_header)) {
+   if (stbi__do_zlib(&a, p, initial_size, 1, parse_header, decoder)) {
       if (outlen) *outlen = (int) (a.zout - a.zout_start);
       return a.zout_start;
    } else {
-      STBI_FREE(a.zout_start);
+      stbi__free(a.zout_start);
       return NULL;
    }
 }
 
+STBIDEF char *stbi_zlib_decode_malloc_guesssize_headerflag(const char *buffer, int len, int initial_size, int *outlen, int parse_header)
+{
+   return stbi__zlib_decode_malloc_headerflag(buffer, len, initial_size, outlen, parse_header, NULL);
+}
+
 STBIDEF int stbi_zlib_decode_buffer(char *obuffer, int olen, char const *ibuffer, int ilen)
 {
    stbi__zbuf a;
    a.zbuffer = (stbi_uc *) ibuffer;
    a.zbuffer_end = (stbi_uc *) ibuffer + ilen;
-   if (stbi__do_zlib(&a, obuffer, olen, 0, 1))
+   if (stbi__do_zlib(&a, obuffer, olen, 0, 1, NULL))
       return (int) (a.zout - a.zout_start);
    else
       return -1;
@@ -4550,11 +7101,11 @@ STBIDEF char *stbi_zlib_decode_noheader_malloc(char const *buffer, int len, int
    if (p == NULL) return NULL;
    a.zbuffer = (stbi_uc *) buffer;
    a.zbuffer_end = (stbi_uc *) buffer+len;
-   if (stbi__do_zlib(&a, p, 16384, 1, 0)) {
+   if (stbi__do_zlib(&a, p, 16384, 1, 0, NULL)) {
       if (outlen) *outlen = (int) (a.zout - a.zout_start);
       return a.zout_start;
    } else {
-      STBI_FREE(a.zout_start);
+      stbi__free(a.zout_start);
       return NULL;
    }
 }
@@ -4564,7 +7115,7 @@ STBIDEF int stbi_zlib_decode_noheader_buffer(char *obuffer, int olen, const char
    stbi__zbuf a;
    a.zbuffer = (stbi_uc *) ibuffer;
    a.zbuffer_end = (stbi_uc *) ibuffer + ilen;
-   if (stbi__do_zlib(&a, obuffer, olen, 0, 0))
+   if (stbi__do_zlib(&a, obuffer, olen, 0, 0, NULL))
       return (int) (a.zout - a.zout_start);
    else
       return -1;
@@ -4610,6 +7161,8 @@ typedef struct
    stbi__context *s;
    stbi_uc *idata, *expanded, *out;
    int depth;
+   int bpc;       // bits per channel the caller wants, 8 or 16
+   int by_rows;   // decoded row by row straight into the final 8-bit layout
 } stbi__png;
 
 
@@ -4646,203 +7199,224 @@ static int stbi__paeth(int a, int b, int c)
 
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
-// create the png data from post-deflated data
-static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
+// unfilter one scanline. cur and prior are the starts of this row and the
+// previous one in the output layout (prior is not read for the first row);
+// raw starts at the row's filter byte
+static int stbi__png_unfilter_row(stbi_uc *cur, stbi_uc *prior, stbi_uc *raw, int first, int img_n, int out_n, stbi__uint32 x, int depth, stbi__uint32 img_width_bytes)
 {
    int bytes = (depth == 16? 2 : 1);
-   stbi__context *s = a->s;
-   stbi__uint32 i,j,stride = x*out_n*bytes;
-   stbi__uint32 img_len, img_width_bytes;
+   stbi__uint32 i;
    int k;
-   int img_n = s->img_n; // copy it into a local for later
+   stbi_uc *row = cur;
 
    int output_bytes = out_n*bytes;
    int filter_bytes = img_n*bytes;
    int width = x;
+   int filter = *raw++;
 
-   STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
-   a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
-   if (!a->out) return stbi__err("outofmem", "Out of memory");
-
-   if (!stbi__mad3sizes_valid(img_n, x, depth, 7)) return stbi__err("too large", "Corrupt PNG");
-   img_width_bytes = (((img_n * x * depth) + 7) >> 3);
-   img_len = (img_width_bytes + 1) * y;
-
-   // we used to check for exact match between raw_len and img_len on non-interlaced PNGs,
-   // but issue #276 reported a PNG in the wild that had extra data at the end (all zeros),
-   // so just check for raw_len < img_len always.
-   if (raw_len < img_len) return stbi__err("not enough pixels","Corrupt PNG");
+   if (filter > 4)
+      return stbi__err("invalid filter","Corrupt PNG");
 
-   for (j=0; j < y; ++j) {
-      stbi_uc *cur = a->out + stride*j;
-      stbi_uc *prior;
-      int filter = *raw++;
+   if (depth < 8) {
+      if (img_width_bytes > x) return stbi__err("invalid width","Corrupt PNG");
+      cur += x*out_n - img_width_bytes; // store output to the rightmost img_len bytes, so we can decode in place
+      prior += x*out_n - img_width_bytes;
+      filter_bytes = 1;
+      width = img_width_bytes;
+   }
+
+   // if first row, use special filter that doesn't sample previous row
+   if (first) filter = first_row_filter[filter];
+
+   // handle first byte explicitly
+   for (k=0; k < filter_bytes; ++k) {
+      switch (filter) {
+         case STBI__F_none       : cur[k] = raw[k]; break;
+         case STBI__F_sub        : cur[k] = raw[k]; break;
+         case STBI__F_up         : cur[k] = STBI__BYTECAST(raw[k] + prior[k]); break;
+         case STBI__F_avg        : cur[k] = STBI__BYTECAST(raw[k] + (prior[k]>>1)); break;
+         case STBI__F_paeth      : cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(0,prior[k],0)); break;
+         case STBI__F_avg_first  : cur[k] = raw[k]; break;
+         case STBI__F_paeth_first: cur[k] = raw[k]; break;
+      }
+   }
 
-      if (filter > 4)
-         return stbi__err("invalid filter","Corrupt PNG");
+   if (depth == 8) {
+      if (img_n != out_n)
+         cur[img_n] = 255; // first pixel
+      raw += img_n;
+      cur += out_n;
+      prior += out_n;
+   } else if (depth == 16) {
+      if (img_n != out_n) {
+         cur[filter_bytes]   = 255; // first pixel top byte
+         cur[filter_bytes+1] = 255; // first pixel bottom byte
+      }
+      raw += filter_bytes;
+      cur += output_bytes;
+      prior += output_bytes;
+   } else {
+      raw += 1;
+      cur += 1;
+      prior += 1;
+   }
+
+   // this is a little gross, so that we don't switch per-pixel or per-component
+   if (depth < 8 || img_n == out_n) {
+      int nk = (width - 1)*filter_bytes;
+      #define STBI__CASE(f) \
+          case f:     \
+             for (k=0; k < nk; ++k)
+      switch (filter) {
+         // "none" filter turns into a memcpy here; make that explicit.
+         case STBI__F_none:         memcpy(cur, raw, nk); break;
+         STBI__CASE(STBI__F_sub)          { cur[k] = STBI__BYTECAST(raw[k] + cur[k-filter_bytes]); } break;
+         STBI__CASE(STBI__F_up)           { cur[k] = STBI__BYTECAST(raw[k] + prior[k]); } break;
+         STBI__CASE(STBI__F_avg)          { cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k-filter_bytes])>>1)); } break;
+         STBI__CASE(STBI__F_paeth)        { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k-filter_bytes],prior[k],prior[k-filter_bytes])); } break;
+         STBI__CASE(STBI__F_avg_first)    { cur[k] = STBI__BYTECAST(raw[k] + (cur[k-filter_bytes] >> 1)); } break;
+         STBI__CASE(STBI__F_paeth_first)  { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k-filter_bytes],0,0)); } break;
+      }
+      #undef STBI__CASE
+   } else {
+      STBI_ASSERT(img_n+1 == out_n);
+      #define STBI__CASE(f) \
+          case f:     \
+             for (i=x-1; i >= 1; --i, cur[filter_bytes]=255,raw+=filter_bytes,cur+=output_bytes,prior+=output_bytes) \
+                for (k=0; k < filter_bytes; ++k)
+      switch (filter) {
+         STBI__CASE(STBI__F_none)         { cur[k] = raw[k]; } break;
+         STBI__CASE(STBI__F_sub)          { cur[k] = STBI__BYTECAST(raw[k] + cur[k- output_bytes]); } break;
+         STBI__CASE(STBI__F_up)           { cur[k] = STBI__BYTECAST(raw[k] + prior[k]); } break;
+         STBI__CASE(STBI__F_avg)          { cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k- output_bytes])>>1)); } break;
+         STBI__CASE(STBI__F_paeth)        { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k- output_bytes],prior[k],prior[k- output_bytes])); } break;
+         STBI__CASE(STBI__F_avg_first)    { cur[k] = STBI__BYTECAST(raw[k] + (cur[k- output_bytes] >> 1)); } break;
+         STBI__CASE(STBI__F_paeth_first)  { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k- output_bytes],0,0)); } break;
+      }
+      #undef STBI__CASE
 
-      if (depth < 8) {
-         if (img_width_bytes > x) return stbi__err("invalid width","Corrupt PNG");
-         cur += x*out_n - img_width_bytes; // store output to the rightmost img_len bytes, so we can decode in place
-         filter_bytes = 1;
-         width = img_width_bytes;
-      }
-      prior = cur - stride; // bugfix: need to compute this after 'cur +=' computation above
-
-      // if first row, use special filter that doesn't sample previous row
-      if (j == 0) filter = first_row_filter[filter];
-
-      // handle first byte explicitly
-      for (k=0; k < filter_bytes; ++k) {
-         switch (filter) {
-            case STBI__F_none       : cur[k] = raw[k]; break;
-            case STBI__F_sub        : cur[k] = raw[k]; break;
-            case STBI__F_up         : cur[k] = STBI__BYTECAST(raw[k] + prior[k]); break;
-            case STBI__F_avg        : cur[k] = STBI__BYTECAST(raw[k] + (prior[k]>>1)); break;
-            case STBI__F_paeth      : cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(0,prior[k],0)); break;
-            case STBI__F_avg_first  : cur[k] = raw[k]; break;
-            case STBI__F_paeth_first: cur[k] = raw[k]; break;
+      // the loop above sets the high byte of the pixels' alpha, but for
+      // 16 bit png files we also need the low byte set. we'll do that here.
+      if (depth == 16) {
+         cur = row; // start at the beginning of the row again
+         for (i=0; i < x; ++i,cur+=output_bytes) {
+            cur[filter_bytes+1] = 255;
          }
       }
+   }
+   return 1;
+}
 
-      if (depth == 8) {
-         if (img_n != out_n)
-            cur[img_n] = 255; // first pixel
-         raw += img_n;
-         cur += out_n;
-         prior += out_n;
-      } else if (depth == 16) {
-         if (img_n != out_n) {
-            cur[filter_bytes]   = 255; // first pixel top byte
-            cur[filter_bytes+1] = 255; // first pixel bottom byte
-         }
-         raw += filter_bytes;
-         cur += output_bytes;
-         prior += output_bytes;
-      } else {
-         raw += 1;
-         cur += 1;
-         prior += 1;
-      }
-
-      // this is a little gross, so that we don't switch per-pixel or per-component
-      if (depth < 8 || img_n == out_n) {
-         int nk = (width - 1)*filter_bytes;
-         #define STBI__CASE(f) \
-             case f:     \
-                for (k=0; k < nk; ++k)
-         switch (filter) {
-            // "none" filter turns into a memcpy here; make that explicit.
-            case STBI__F_none:         memcpy(cur, raw, nk); break;
-            STBI__CASE(STBI__F_sub)          { cur[k] = STBI__BYTECAST(raw[k] + cur[k-filter_bytes]); } break;
-            STBI__CASE(STBI__F_up)           { cur[k] = STBI__BYTECAST(raw[k] + prior[k]); } break;
-            STBI__CASE(STBI__F_avg)          { cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k-filter_bytes])>>1)); } break;
-            STBI__CASE(STBI__F_paeth)        { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k-filter_bytes],prior[k],prior[k-filter_bytes])); } break;
-            STBI__CASE(STBI__F_avg_first)    { cur[k] = STBI__BYTECAST(raw[k] + (cur[k-filter_bytes] >> 1)); } break;
-            STBI__CASE(STBI__F_paeth_first)  { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k-filter_bytes],0,0)); } break;
+// expand the 1/2/4-bit samples that stbi__png_unfilter_row left at the right
+// end of the row into bytes, and insert alpha if out_n asks for it
+static void stbi__png_expand_row(stbi_uc *row, int img_n, int out_n, stbi__uint32 x, int depth, int color, stbi__uint32 img_width_bytes)
+{
+   stbi_uc *cur = row;
+   stbi_uc *in  = row + x*out_n - img_width_bytes;
+   int k;
+   // unpack 1/2/4-bit into a 8-bit buffer. allows us to keep the common 8-bit path optimal at minimal cost for 1/2/4-bit
+   // png guarante byte alignment, if width is not multiple of 8/4/2 we'll decode dummy trailing data that will be skipped in the later loop
+   stbi_uc scale = (color == 0) ? stbi__depth_scale_table[depth] : 1; // scale grayscale values to 0..255 range
+
+   // note that the final byte might overshoot and write more data than desired.
+   // we can allocate enough data that this never writes out of memory, but it
+   // could also overwrite the next scanline. can it overwrite non-empty data
+   // on the next scanline? yes, consider 1-pixel-wide scanlines with 1-bit-per-pixel.
+   // so we need to explicitly clamp the final ones
+
+   if (depth == 4) {
+      for (k=x*img_n; k >= 2; k-=2, ++in) {
+         *cur++ = scale * ((*in >> 4)       );
+         *cur++ = scale * ((*in     ) & 0x0f);
+      }
+      if (k > 0) *cur++ = scale * ((*in >> 4)       );
+   } else if (depth == 2) {
+      for (k=x*img_n; k >= 4; k-=4, ++in) {
+         *cur++ = scale * ((*in >> 6)       );
+         *cur++ = scale * ((*in >> 4) & 0x03);
+         *cur++ = scale * ((*in >> 2) & 0x03);
+         *cur++ = scale * ((*in     ) & 0x03);
+      }
+      if (k > 0) *cur++ = scale * ((*in >> 6)       );
+      if (k > 1) *cur++ = scale * ((*in >> 4) & 0x03);
+      if (k > 2) *cur++ = scale * ((*in >> 2) & 0x03);
+   } else if (depth == 1) {
+      for (k=x*img_n; k >= 8; k-=8, ++in) {
+         *cur++ = scale * ((*in >> 7)       );
+         *cur++ = scale * ((*in >> 6) & 0x01);
+         *cur++ = scale * ((*in >> 5) & 0x01);
+         *cur++ = scale * ((*in >> 4) & 0x01);
+         *cur++ = scale * ((*in >> 3) & 0x01);
+         *cur++ = scale * ((*in >> 2) & 0x01);
+         *cur++ = scale * ((*in >> 1) & 0x01);
+         *cur++ = scale * ((*in     ) & 0x01);
+      }
+      if (k > 0) *cur++ = scale * ((*in >> 7)       );
+      if (k > 1) *cur++ = scale * ((*in >> 6) & 0x01);
+      if (k > 2) *cur++ = scale * ((*in >> 5) & 0x01);
+      if (k > 3) *cur++ = scale * ((*in >> 4) & 0x01);
+      if (k > 4) *cur++ = scale * ((*in >> 3) & 0x01);
+      if (k > 5) *cur++ = scale * ((*in >> 2) & 0x01);
+      if (k > 6) *cur++ = scale * ((*in >> 1) & 0x01);
+   }
+   if (img_n != out_n) {
+      int q;
+      // insert alpha = 255
+      cur = row;
+      if (img_n == 1) {
+         for (q=x-1; q >= 0; --q) {
+            cur[q*2+1] = 255;
+            cur[q*2+0] = cur[q];
          }
-         #undef STBI__CASE
-         raw += nk;
       } else {
-         STBI_ASSERT(img_n+1 == out_n);
-         #define STBI__CASE(f) \
-             case f:     \
-                for (i=x-1; i >= 1; --i, cur[filter_bytes]=255,raw+=filter_bytes,cur+=output_bytes,prior+=output_bytes) \
-                   for (k=0; k < filter_bytes; ++k)
-         switch (filter) {
-            STBI__CASE(STBI__F_none)         { cur[k] = raw[k]; } break;
-            STBI__CASE(STBI__F_sub)          { cur[k] = STBI__BYTECAST(raw[k] + cur[k- output_bytes]); } break;
-            STBI__CASE(STBI__F_up)           { cur[k] = STBI__BYTECAST(raw[k] + prior[k]); } break;
-            STBI__CASE(STBI__F_avg)          { cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k- output_bytes])>>1)); } break;
-            STBI__CASE(STBI__F_paeth)        { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k- output_bytes],prior[k],prior[k- output_bytes])); } break;
-            STBI__CASE(STBI__F_avg_first)    { cur[k] = STBI__BYTECAST(raw[k] + (cur[k- output_bytes] >> 1)); } break;
-            STBI__CASE(STBI__F_paeth_first)  { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k- output_bytes],0,0)); } break;
+         STBI_ASSERT(img_n == 3);
+         for (q=x-1; q >= 0; --q) {
+            cur[q*4+3] = 255;
+            cur[q*4+2] = cur[q*3+2];
+            cur[q*4+1] = cur[q*3+1];
+            cur[q*4+0] = cur[q*3+0];
          }
-         #undef STBI__CASE
+      }
+   }
+}
+
+// create the png data from post-deflated data
+static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
+{
+   int bytes = (depth == 16? 2 : 1);
+   stbi__context *s = a->s;
+   stbi__uint32 i,j,stride = x*out_n*bytes;
+   stbi__uint32 img_len, img_width_bytes;
+   int img_n = s->img_n; // copy it into a local for later
+
+   int output_bytes = out_n*bytes;
+
+   STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
+   a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
+   if (!a->out) return stbi__err("outofmem", "Out of memory");
+
+   if (!stbi__mad3sizes_valid(img_n, x, depth, 7)) return stbi__err("too large", "Corrupt PNG");
+   img_width_bytes = (((img_n * x * depth) + 7) >> 3);
+   img_len = (img_width_bytes + 1) * y;
 
-         // the loop above sets the high byte of the pixels' alpha, but for
-         // 16 bit png files we also need the low byte set. we'll do that here.
-         if (depth == 16) {
-            cur = a->out + stride*j; // start at the beginning of the row again
-            for (i=0; i < x; ++i,cur+=output_bytes) {
-               cur[filter_bytes+1] = 255;
-            }
-         }
-      }
+   // we used to check for exact match between raw_len and img_len on non-interlaced PNGs,
+   // but issue #276 reported a PNG in the wild that had extra data at the end (all zeros),
+   // so just check for raw_len < img_len always.
+   if (raw_len < img_len) return stbi__err("not enough pixels","Corrupt PNG");
+
+   for (j=0; j < y; ++j) {
+      stbi_uc *cur = a->out + stride*j;
+      if (!stbi__png_unfilter_row(cur, j ? cur - stride : cur, raw, j == 0, img_n, out_n, x, depth, img_width_bytes))
+         return 0;
+      raw += img_width_bytes + 1;
    }
 
    // we make a separate pass to expand bits to pixels; for performance,
    // this could run two scanlines behind the above code, so it won't
    // intefere with filtering but will still be in the cache.
    if (depth < 8) {
-      for (j=0; j < y; ++j) {
-         stbi_uc *cur = a->out + stride*j;
-         stbi_uc *in  = a->out + stride*j + x*out_n - img_width_bytes;
-         // unpack 1/2/4-bit into a 8-bit buffer. allows us to keep the common 8-bit path optimal at minimal cost for 1/2/4-bit
-         // png guarante byte alignment, if width is not multiple of 8/4/2 we'll decode dummy trailing data that will be skipped in the later loop
-         stbi_uc scale = (color == 0) ? stbi__depth_scale_table[depth] : 1; // scale grayscale values to 0..255 range
-
-         // note that the final byte might overshoot and write more data than desired.
-         // we can allocate enough data that this never writes out of memory, but it
-         // could also overwrite the next scanline. can it overwrite non-empty data
-         // on the next scanline? yes, consider 1-pixel-wide scanlines with 1-bit-per-pixel.
-         // so we need to explicitly clamp the final ones
-
-         if (depth == 4) {
-            for (k=x*img_n; k >= 2; k-=2, ++in) {
-               *cur++ = scale * ((*in >> 4)       );
-               *cur++ = scale * ((*in     ) & 0x0f);
-            }
-            if (k > 0) *cur++ = scale * ((*in >> 4)       );
-         } else if (depth == 2) {
-            for (k=x*img_n; k >= 4; k-=4, ++in) {
-               *cur++ = scale * ((*in >> 6)       );
-               *cur++ = scale * ((*in >> 4) & 0x03);
-               *cur++ = scale * ((*in >> 2) & 0x03);
-               *cur++ = scale * ((*in     ) & 0x03);
-            }
-            if (k > 0) *cur++ = scale * ((*in >> 6)       );
-            if (k > 1) *cur++ = scale * ((*in >> 4) & 0x03);
-            if (k > 2) *cur++ = scale * ((*in >> 2) & 0x03);
-         } else if (depth == 1) {
-            for (k=x*img_n; k >= 8; k-=8, ++in) {
-               *cur++ = scale * ((*in >> 7)       );
-               *cur++ = scale * ((*in >> 6) & 0x01);
-               *cur++ = scale * ((*in >> 5) & 0x01);
-               *cur++ = scale * ((*in >> 4) & 0x01);
-               *cur++ = scale * ((*in >> 3) & 0x01);
-               *cur++ = scale * ((*in >> 2) & 0x01);
-               *cur++ = scale * ((*in >> 1) & 0x01);
-               *cur++ = scale * ((*in     ) & 0x01);
-            }
-            if (k > 0) *cur++ = scale * ((*in >> 7)       );
-            if (k > 1) *cur++ = scale * ((*in >> 6) & 0x01);
-            if (k > 2) *cur++ = scale * ((*in >> 5) & 0x01);
-            if (k > 3) *cur++ = scale * ((*in >> 4) & 0x01);
-            if (k > 4) *cur++ = scale * ((*in >> 3) & 0x01);
-            if (k > 5) *cur++ = scale * ((*in >> 2) & 0x01);
-            if (k > 6) *cur++ = scale * ((*in >> 1) & 0x01);
-         }
-         if (img_n != out_n) {
-            int q;
-            // insert alpha = 255
-            cur = a->out + stride*j;
-            if (img_n == 1) {
-               for (q=x-1; q >= 0; --q) {
-                  cur[q*2+1] = 255;
-                  cur[q*2+0] = cur[q];
-               }
-            } else {
-               STBI_ASSERT(img_n == 3);
-               for (q=x-1; q >= 0; --q) {
-                  cur[q*4+3] = 255;
-                  cur[q*4+2] = cur[q*3+2];
-                  cur[q*4+1] = cur[q*3+1];
-                  cur[q*4+0] = cur[q*3+0];
-               }
-            }
-         }
-      }
+      for (j=0; j < y; ++j)
+         stbi__png_expand_row(a->out + stride*j, img_n, out_n, x, depth, color, img_width_bytes);
    } else if (depth == 16) {
       // force the image data from big-endian to platform-native.
       // this is done in a separate pass due to the decoding relying
@@ -4883,7 +7457,7 @@ static int stbi__create_png_image(stbi__png *a, stbi_uc *image_data, stbi__uint3
       if (x && y) {
          stbi__uint32 img_len = ((((a->s->img_n * x * depth) + 7) >> 3) + 1) * y;
          if (!stbi__create_png_image_raw(a, image_data, image_data_len, out_n, x, y, depth, color)) {
-            STBI_FREE(final);
+            stbi__free(final);
             return 0;
          }
          for (j=0; j < y; ++j) {
@@ -4894,7 +7468,7 @@ static int stbi__create_png_image(stbi__png *a, stbi_uc *image_data, stbi__uint3
                       a->out + (j*x+i)*out_bytes, out_bytes);
             }
          }
-         STBI_FREE(a->out);
+         stbi__free(a->out);
          image_data += img_len;
          image_data_len -= img_len;
       }
@@ -4904,11 +7478,9 @@ static int stbi__create_png_image(stbi__png *a, stbi_uc *image_data, stbi__uint3
    return 1;
 }
 
-static int stbi__compute_transparency(stbi__png *z, stbi_uc tc[3], int out_n)
+static int stbi__compute_transparency(stbi_uc *p, stbi__uint32 pixel_count, stbi_uc tc[3], int out_n)
 {
-   stbi__context *s = z->s;
-   stbi__uint32 i, pixel_count = s->img_x * s->img_y;
-   stbi_uc *p = z->out;
+   stbi__uint32 i;
 
    // compute color-based transparency, assuming we've
    // already got 255 as the alpha value in the output
@@ -4929,11 +7501,9 @@ static int stbi__compute_transparency(stbi__png *z, stbi_uc tc[3], int out_n)
    return 1;
 }
 
-static int stbi__compute_transparency16(stbi__png *z, stbi__uint16 tc[3], int out_n)
+static int stbi__compute_transparency16(stbi__uint16 *p, stbi__uint32 pixel_count, stbi__uint16 tc[3], int out_n)
 {
-   stbi__context *s = z->s;
-   stbi__uint32 i, pixel_count = s->img_x * s->img_y;
-   stbi__uint16 *p = (stbi__uint16*) z->out;
+   stbi__uint32 i;
 
    // compute color-based transparency, assuming we've
    // already got 65535 as the alpha value in the output
@@ -4954,17 +7524,9 @@ static int stbi__compute_transparency16(stbi__png *z, stbi__uint16 tc[3], int ou
    return 1;
 }
 
-static int stbi__expand_png_palette(stbi__png *a, stbi_uc *palette, int len, int pal_img_n)
+static void stbi__png_palette_pixels(stbi_uc *p, stbi_uc *orig, stbi__uint32 pixel_count, stbi_uc *palette, int pal_img_n)
 {
-   stbi__uint32 i, pixel_count = a->s->img_x * a->s->img_y;
-   stbi_uc *p, *temp_out, *orig = a->out;
-
-   p = (stbi_uc *) stbi__malloc_mad2(pixel_count, pal_img_n, 0);
-   if (p == NULL) return stbi__err("outofmem", "Out of memory");
-
-   // between here and free(out) below, exitting would leak
-   temp_out = p;
-
+   stbi__uint32 i;
    if (pal_img_n == 3) {
       for (i=0; i < pixel_count; ++i) {
          int n = orig[i]*4;
@@ -4983,7 +7545,18 @@ static int stbi__expand_png_palette(stbi__png *a, stbi_uc *palette, int len, int
          p += 4;
       }
    }
-   STBI_FREE(a->out);
+}
+
+static int stbi__expand_png_palette(stbi__png *a, stbi_uc *palette, int len, int pal_img_n)
+{
+   stbi__uint32 pixel_count = a->s->img_x * a->s->img_y;
+   stbi_uc *temp_out;
+
+   temp_out = (stbi_uc *) stbi__malloc_mad2(pixel_count, pal_img_n, 0);
+   if (temp_out == NULL) return stbi__err("outofmem", "Out of memory");
+
+   stbi__png_palette_pixels(temp_out, a->out, pixel_count, palette, pal_img_n);
+   stbi__free(a->out);
    a->out = temp_out;
 
    STBI_NOTUSED(len);
@@ -5031,13 +7604,11 @@ STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_conve
                                 : stbi__de_iphone_flag_global)
 #endif // STBI_THREAD_LOCAL
 
-static void stbi__de_iphone(stbi__png *z)
+static void stbi__de_iphone(stbi_uc *p, stbi__uint32 pixel_count, int out_n, int unpremultiply)
 {
-   stbi__context *s = z->s;
-   stbi__uint32 i, pixel_count = s->img_x * s->img_y;
-   stbi_uc *p = z->out;
+   stbi__uint32 i;
 
-   if (s->img_out_n == 3) {  // convert bgr to rgb
+   if (out_n == 3) {  // convert bgr to rgb
       for (i=0; i < pixel_count; ++i) {
          stbi_uc t = p[0];
          p[0] = p[2];
@@ -5045,8 +7616,8 @@ static void stbi__de_iphone(stbi__png *z)
          p += 3;
       }
    } else {
-      STBI_ASSERT(s->img_out_n == 4);
-      if (stbi__unpremultiply_on_load) {
+      STBI_ASSERT(out_n == 4);
+      if (unpremultiply) {
          // convert bgr to rgb and unpremultiply
          for (i=0; i < pixel_count; ++i) {
             stbi_uc a = p[3];
@@ -5074,6 +7645,195 @@ static void stbi__de_iphone(stbi__png *z)
    }
 }
 
+// stbi_load_rows on a non-interlaced PNG: inflate into a sliding window and
+// take each scanline through unfiltering and post-processing as soon as its
+// bytes are out, so neither the inflated stream nor the image is held in full
+typedef struct
+{
+   stbi__png *z;
+   stbi__row_sink sink;
+   stbi_uc *cur, *prior;     // unfiltered scanlines, laid out as in stbi__create_png_image_raw
+   stbi_uc *pix, *tmp;       // post-processing scratch, wide enough for 4 16-bit channels
+   stbi__uint32 j, width_bytes;
+   int out_n, color, req_comp, is_iphone, has_trans;
+   int pal_img_n, pal_out_n;
+   stbi_uc *palette, *tc;
+   stbi__uint16 *tc16;
+   int image;                // write rows into z->out instead of the row sink
+   int simd, ssse3;
+} stbi__png_rows;
+
+// keep the high byte of each big-endian 16-bit sample; the same result as
+// swapping to native order and shifting right by 8, without the swap
+static void stbi__png_narrow_row(stbi_uc *out, stbi_uc const *in, stbi__uint32 count, int simd)
+{
+   stbi__uint32 i = 0;
+#ifdef STBI_SSE2
+   if (simd) {
+      __m128i lo = _mm_set1_epi16(0xff);
+      for (; i + 16 <= count; i += 16) {
+         // on little-endian x86 the high byte of each sample lands in the low byte of a 16-bit lane
+         __m128i a = _mm_and_si128(_mm_loadu_si128((__m128i const *) (in + i*2)), lo);
+         __m128i b = _mm_and_si128(_mm_loadu_si128((__m128i const *) (in + i*2 + 16)), lo);
+         _mm_storeu_si128((__m128i *) (out + i), _mm_packus_epi16(a, b));
+      }
+   }
+#elif defined(STBI_NEON)
+   for (; i + 16 <= count; i += 16)
+      vst1q_u8(out + i, vld2q_u8(in + i*2).val[0]);
+   STBI_NOTUSED(simd);
+#else
+   STBI_NOTUSED(simd);
+#endif
+   for (; i < count; ++i)
+      out[i] = in[i*2];
+}
+
+static int stbi__png_rows_drain(void *user, char *zread, char *zout, char **consumed)
+{
+   stbi__png_rows *r = (stbi__png_rows *) user;
+   stbi__context *s = r->z->s;
+   stbi__uint32 i, x = s->img_x;
+   int depth = r->z->depth;
+
+   while (r->j < s->img_y && (stbi__uint32) (zout - zread) > r->width_bytes) {
+      stbi_uc *a = r->pix, *b = r->tmp, *t, *dest;
+      int n = r->out_n;
+
+      if (!stbi__png_unfilter_row(r->cur, r->prior, (stbi_uc *) zread, r->j == 0, s->img_n, n, x, depth, r->width_bytes))
+         return 0;
+      zread += r->width_bytes + 1;
+      if (r->image)
+         dest = r->z->out + (size_t) r->j * x * s->img_out_n;
+      else
+         dest = stbi__row_sink_next(&r->sink);
+      if (depth == 16 && !r->has_trans && !(r->req_comp && r->req_comp != n)) {
+         // nothing below needs the low bytes, so narrow straight out of the unfiltered row
+         stbi__png_narrow_row(dest, r->cur, x * n, r->simd);
+         t = r->prior; r->prior = r->cur; r->cur = t;
+         ++r->j;
+         continue;
+      }
+      // the next row is unfiltered against the raw samples, so post-process a copy
+      memcpy(a, r->cur, (size_t) x * n * (depth == 16 ? 2 : 1));
+      t = r->prior; r->prior = r->cur; r->cur = t;
+
+      if (depth < 8) {
+         stbi__png_expand_row(a, s->img_n, n, x, depth, r->color, r->width_bytes);
+      } else if (depth == 16) {
+         stbi__uint16 *a16 = (stbi__uint16 *) a;
+         for (i=0; i < x*n; ++i)
+            a16[i] = (a[i*2] << 8) | a[i*2+1];
+      }
+      if (r->has_trans) {
+         if (depth == 16)
+            stbi__compute_transparency16((stbi__uint16 *) a, x, r->tc16, n);
+         else
+            stbi__compute_transparency(a, x, r->tc, n);
+      }
+      if (r->is_iphone && r->z->s->de_iphone && n > 2)
+         stbi__de_iphone(a, x, n, r->z->s->unpremultiply);
+      if (r->pal_img_n) {
+         stbi__png_palette_pixels(b, a, x, r->palette, r->pal_out_n);
+         t = a; a = b; b = t;
+         n = r->pal_out_n;
+      }
+      if (r->req_comp && r->req_comp != n) {
+         if (depth == 16) {
+            if (!stbi__convert_format16_row((stbi__uint16 *) a, (stbi__uint16 *) b, n, r->req_comp, x)) return 0;
+         } else {
+            if (!stbi__convert_format_row(a, b, n, r->req_comp, x, r->ssse3)) return 0;
+         }
+         t = a; a = b; b = t;
+         n = r->req_comp;
+      }
+
+      if (depth == 16) {
+         for (i=0; i < x*n; ++i)
+            dest[i] = (stbi_uc) (((stbi__uint16 *) a)[i] >> 8);
+      } else {
+         memcpy(dest, a, (size_t) x * n);
+      }
+      ++r->j;
+   }
+   if (!r->image)
+      stbi__row_sink_flush(&r->sink);
+   *consumed = zread;
+   return 1;
+}
+
+static int stbi__png_stream_rows(stbi__png_rows *r, stbi__uint32 idata_len, int parse_header)
+{
+   stbi__png *z = r->z;
+   stbi__context *s = z->s;
+   stbi__uint32 x = s->img_x;
+   int bytes = (z->depth == 16 ? 2 : 1);
+   int final_n = r->req_comp ? r->req_comp : (r->pal_img_n ? r->pal_out_n : r->out_n);
+   size_t row = (size_t) x * r->out_n * bytes, window;
+   stbi_uc *rows;
+   stbi__zbuf a;
+   int ok;
+
+   if (!stbi__mad3sizes_valid(s->img_n, x, z->depth, 7)) return stbi__err("too large", "Corrupt PNG");
+   if (!stbi__mad2sizes_valid(x, 2*r->out_n*bytes + 16, 0)) return stbi__err("too large", "Corrupt PNG");
+   r->width_bytes = (((s->img_n * x * z->depth) + 7) >> 3);
+   r->j = 0;
+
+   rows = (stbi_uc *) stbi__malloc(row * 2 + (size_t) x * 16);
+   if (!rows) return stbi__err("outofmem", "Out of memory");
+   r->cur   = rows;
+   r->prior = rows + row;
+   r->pix   = rows + row * 2;
+   r->tmp   = r->pix + (size_t) x * 8;
+   r->sink.strip = NULL;
+   s->img_out_n = final_n;
+   if (r->image) {
+      z->out = (stbi_uc *) stbi__malloc_mad3(x, s->img_y, final_n, 0);
+      if (!z->out) {
+         stbi__free(rows);
+         return stbi__err("outofmem", "Out of memory");
+      }
+   } else if (!stbi__row_sink_init(&r->sink, s, x, s->img_y, final_n, 16)) {
+      stbi__free(rows);
+      return 0;
+   }
+#ifdef STBI_SSE2
+   r->simd = stbi__sse2_available();
+#else
+   r->simd = 0;
+#endif
+#ifdef STBI__SSSE3
+   r->ssse3 = stbi__ssse3_available();
+#else
+   r->ssse3 = 0;
+#endif
+
+   // room for the match window, a stored block and a scanline, so the window
+   // normally slides instead of growing
+   window = 32768 + 65536 + (size_t) r->width_bytes + 1;
+   a.zbuffer = z->idata;
+   a.zbuffer_end = z->idata + idata_len;
+   a.zout_start = (char *) stbi__malloc(window);
+   ok = a.zout_start != NULL;
+   if (!ok) {
+      stbi__err("outofmem", "Out of memory");
+   } else {
+      a.zout = a.zread = a.zout_start;
+      a.zout_end = a.zout_start + window;
+      a.z_expandable = 1;
+      a.zdrain = stbi__png_rows_drain;
+      a.zdrain_user = r;
+      a.decoder = s->decoder;
+      ok = stbi__parse_zlib(&a, parse_header)
+        && stbi__png_rows_drain(r, a.zread, a.zout, &a.zread);
+      if (ok && r->j < s->img_y) ok = stbi__err("not enough pixels","Corrupt PNG");
+   }
+   stbi__free(a.zout_start);
+   stbi__free(r->sink.strip);
+   stbi__free(rows);
+   return ok;
+}
+
 #define STBI__PNG_TYPE(a,b,c,d)  (((unsigned) (a) << 24) + ((unsigned) (b) << 16) + ((unsigned) (c) << 8) + (unsigned) (d))
 
 static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
@@ -5187,7 +7947,7 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
                while (ioff + c.length > idata_limit)
                   idata_limit *= 2;
                STBI_NOTUSED(idata_limit_old);
-               p = (stbi_uc *) STBI_REALLOC_SIZED(z->idata, idata_limit_old, idata_limit); if (p == NULL) return stbi__err("outofmem", "Out of memory");
+               p = (stbi_uc *) stbi__realloc_sized(z->idata, idata_limit_old, idata_limit); if (p == NULL) return stbi__err("outofmem", "Out of memory");
                z->idata = p;
             }
             if (!stbi__getn(s, z->idata+ioff,c.length)) return stbi__err("outofdata","Corrupt PNG");
@@ -5197,29 +7957,60 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
 
          case STBI__PNG_TYPE('I','E','N','D'): {
             stbi__uint32 raw_len, bpl;
+            int out_n, converts;
             if (first) return stbi__err("first not IHDR", "Corrupt PNG");
             if (scan != STBI__SCAN_load) return 1;
             if (z->idata == NULL) return stbi__err("no IDAT","Corrupt PNG");
+            out_n = ((req_comp == s->img_n+1 && req_comp != 3 && !pal_img_n) || has_trans) ? s->img_n+1 : s->img_n;
+            converts = req_comp && req_comp != (pal_img_n ? (req_comp >= 3 ? req_comp : pal_img_n) : out_n);
+            if (!interlace && (s->on_rows || (z->depth == 16 ? z->bpc == 8 : converts))) {
+               // rows go to the stbi_load_rows callback, or are finished one at a time
+               // into the final 8-bit image: 16-bit rows are narrowed as they are
+               // unfiltered, and channel conversion happens per row instead of as a
+               // second pass over a second image
+               stbi__png_rows r;
+               r.z = z;
+               r.image = !s->on_rows;
+               r.out_n = out_n;
+               r.color = color;
+               r.req_comp = req_comp;
+               r.is_iphone = is_iphone;
+               r.has_trans = has_trans;
+               r.pal_img_n = pal_img_n;
+               r.pal_out_n = req_comp >= 3 ? req_comp : pal_img_n;
+               r.palette = palette;
+               r.tc = tc;
+               r.tc16 = tc16;
+               if (!stbi__png_stream_rows(&r, ioff, !is_iphone)) return 0;
+               stbi__free(z->idata); z->idata = NULL;
+               if (pal_img_n)
+                  s->img_n = pal_img_n;
+               else if (has_trans)
+                  ++s->img_n;
+               if (r.image)
+                  z->by_rows = 1;
+               else
+                  s->dest_written = 1;
+               stbi__get32be(s);
+               return 1;
+            }
             // initial guess for decoded data size to avoid unnecessary reallocs
             bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
             raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
-            z->expanded = (stbi_uc *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone);
+            z->expanded = (stbi_uc *) stbi__zlib_decode_malloc_headerflag((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone, s->decoder);
             if (z->expanded == NULL) return 0; // zlib should set error
-            STBI_FREE(z->idata); z->idata = NULL;
-            if ((req_comp == s->img_n+1 && req_comp != 3 && !pal_img_n) || has_trans)
-               s->img_out_n = s->img_n+1;
-            else
-               s->img_out_n = s->img_n;
+            stbi__free(z->idata); z->idata = NULL;
+            s->img_out_n = out_n;
             if (!stbi__create_png_image(z, z->expanded, raw_len, s->img_out_n, z->depth, color, interlace)) return 0;
             if (has_trans) {
                if (z->depth == 16) {
-                  if (!stbi__compute_transparency16(z, tc16, s->img_out_n)) return 0;
+                  if (!stbi__compute_transparency16((stbi__uint16 *) z->out, s->img_x * s->img_y, tc16, s->img_out_n)) return 0;
                } else {
-                  if (!stbi__compute_transparency(z, tc, s->img_out_n)) return 0;
+                  if (!stbi__compute_transparency(z->out, s->img_x * s->img_y, tc, s->img_out_n)) return 0;
                }
             }
-            if (is_iphone && stbi__de_iphone_flag && s->img_out_n > 2)
-               stbi__de_iphone(z);
+            if (is_iphone && s->de_iphone && s->img_out_n > 2)
+               stbi__de_iphone(z->out, s->img_x * s->img_y, s->img_out_n, s->unpremultiply);
             if (pal_img_n) {
                // pal_img_n == 3 or 4
                s->img_n = pal_img_n; // record the actual colors we had
@@ -5231,7 +8022,7 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
                // non-paletted image with tRNS -> source image has (constant) alpha
                ++s->img_n;
             }
-            STBI_FREE(z->expanded); z->expanded = NULL;
+            stbi__free(z->expanded); z->expanded = NULL;
             // end of PNG chunk, read and skip CRC
             stbi__get32be(s);
             return 1;
@@ -5264,7 +8055,15 @@ static void *stbi__do_png(stbi__png *p, int *x, int *y, int *n, int req_comp, st
    void *result=NULL;
    if (req_comp < 0 || req_comp > 4) return stbi__errpuc("bad req_comp", "Internal error");
    if (stbi__parse_png_file(p, STBI__SCAN_load, req_comp)) {
-      if (p->depth <= 8)
+      if (p->s->dest_written) {
+         // stbi_load_rows: every row already went to the callback as 8-bit
+         ri->bits_per_channel = 8;
+         *x = p->s->img_x;
+         *y = p->s->img_y;
+         if (n) *n = p->s->img_n;
+         return &stbi__rows_delivered;
+      }
+      if (p->depth <= 8 || p->by_rows)
          ri->bits_per_channel = 8;
       else if (p->depth == 16)
          ri->bits_per_channel = 16;
@@ -5284,17 +8083,19 @@ static void *stbi__do_png(stbi__png *p, int *x, int *y, int *n, int req_comp, st
       *y = p->s->img_y;
       if (n) *n = p->s->img_n;
    }
-   STBI_FREE(p->out);      p->out      = NULL;
-   STBI_FREE(p->expanded); p->expanded = NULL;
-   STBI_FREE(p->idata);    p->idata    = NULL;
+   stbi__free(p->out);      p->out      = NULL;
+   stbi__free(p->expanded); p->expanded = NULL;
+   stbi__free(p->idata);    p->idata    = NULL;
 
    return result;
 }
 
-static void *stbi__png_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri)
+static void *stbi__png_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
    stbi__png p;
    p.s = s;
+   p.bpc = bpc;
+   p.by_rows = 0;
    return stbi__do_png(&p, x,y,comp,req_comp, ri);
 }
 
@@ -5339,6 +8140,20 @@ static int stbi__png_is16(stbi__context *s)
 }
 #endif
 
+// take the stbi_set_* settings (per-thread ones first) for a load that was
+// not given stbi_load_params
+static void stbi__start_flags(stbi__context *s)
+{
+   s->flip = stbi__vertically_flip_on_load;
+   s->premultiply = s->linear = 0;
+#ifndef STBI_NO_PNG
+   s->unpremultiply = stbi__unpremultiply_on_load;
+   s->de_iphone = stbi__de_iphone_flag;
+#else
+   s->unpremultiply = s->de_iphone = 0;
+#endif
+}
+
 // Microsoft/Windows BMP image
 
 #ifndef STBI_NO_BMP
@@ -5597,7 +8412,7 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
    if (!out) return stbi__errpuc("outofmem", "Out of memory");
    if (info.bpp < 16) {
       int z=0;
-      if (psize == 0 || psize > 256) { STBI_FREE(out); return stbi__errpuc("invalid", "Corrupt BMP"); }
+      if (psize == 0 || psize > 256) { stbi__free(out); return stbi__errpuc("invalid", "Corrupt BMP"); }
       for (i=0; i < psize; ++i) {
          pal[i][2] = stbi__get8(s);
          pal[i][1] = stbi__get8(s);
@@ -5609,7 +8424,7 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
       if (info.bpp == 1) width = (s->img_x + 7) >> 3;
       else if (info.bpp == 4) width = (s->img_x + 1) >> 1;
       else if (info.bpp == 8) width = s->img_x;
-      else { STBI_FREE(out); return stbi__errpuc("bad bpp", "Corrupt BMP"); }
+      else { stbi__free(out); return stbi__errpuc("bad bpp", "Corrupt BMP"); }
       pad = (-width)&3;
       if (info.bpp == 1) {
          for (j=0; j < (int) s->img_y; ++j) {
@@ -5666,13 +8481,13 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
             easy = 2;
       }
       if (!easy) {
-         if (!mr || !mg || !mb) { STBI_FREE(out); return stbi__errpuc("bad masks", "Corrupt BMP"); }
+         if (!mr || !mg || !mb) { stbi__free(out); return stbi__errpuc("bad masks", "Corrupt BMP"); }
          // right shift amt to put high bit in position #7
          rshift = stbi__high_bit(mr)-7; rcount = stbi__bitcount(mr);
          gshift = stbi__high_bit(mg)-7; gcount = stbi__bitcount(mg);
          bshift = stbi__high_bit(mb)-7; bcount = stbi__bitcount(mb);
          ashift = stbi__high_bit(ma)-7; acount = stbi__bitcount(ma);
-         if (rcount > 8 || gcount > 8 || bcount > 8 || acount > 8) { STBI_FREE(out); return stbi__errpuc("bad masks", "Corrupt BMP"); }
+         if (rcount > 8 || gcount > 8 || bcount > 8 || acount > 8) { stbi__free(out); return stbi__errpuc("bad masks", "Corrupt BMP"); }
       }
       for (j=0; j < (int) s->img_y; ++j) {
          if (easy) {
@@ -5940,7 +8755,7 @@ static void *stbi__tga_load(stbi__context *s, int *x, int *y, int *comp, int req
       if ( tga_indexed)
       {
          if (tga_palette_len == 0) {  /* you have to have at least one entry! */
-            STBI_FREE(tga_data);
+            stbi__free(tga_data);
             return stbi__errpuc("bad palette", "Corrupt TGA");
          }
 
@@ -5949,7 +8764,7 @@ static void *stbi__tga_load(stbi__context *s, int *x, int *y, int *comp, int req
          //   load the palette
          tga_palette = (unsigned char*)stbi__malloc_mad2(tga_palette_len, tga_comp, 0);
          if (!tga_palette) {
-            STBI_FREE(tga_data);
+            stbi__free(tga_data);
             return stbi__errpuc("outofmem", "Out of memory");
          }
          if (tga_rgb16) {
@@ -5960,8 +8775,8 @@ static void *stbi__tga_load(stbi__context *s, int *x, int *y, int *comp, int req
                pal_entry += tga_comp;
             }
          } else if (!stbi__getn(s, tga_palette, tga_palette_len * tga_comp)) {
-               STBI_FREE(tga_data);
-               STBI_FREE(tga_palette);
+               stbi__free(tga_data);
+               stbi__free(tga_palette);
                return stbi__errpuc("bad palette", "Corrupt TGA");
          }
       }
@@ -6042,7 +8857,7 @@ static void *stbi__tga_load(stbi__context *s, int *x, int *y, int *comp, int req
       //   clear my palette, if I had one
       if ( tga_palette != NULL )
       {
-         STBI_FREE( tga_palette );
+         stbi__free( tga_palette );
       }
    }
 
@@ -6234,7 +9049,7 @@ static void *stbi__psd_load(stbi__context *s, int *x, int *y, int *comp, int req
          } else {
             // Read the RLE data.
             if (!stbi__psd_decode_rle(s, p, pixelCount)) {
-               STBI_FREE(out);
+               stbi__free(out);
                return stbi__errpuc("corrupt", "bad RLE data");
             }
          }
@@ -6526,7 +9341,7 @@ static void *stbi__pic_load(stbi__context *s,int *px,int *py,int *comp,int req_c
    memset(result, 0xff, x*y*4);
 
    if (!stbi__pic_load_core(s,x,y,comp, result)) {
-      STBI_FREE(result);
+      stbi__free(result);
       result=0;
    }
    *px = x;
@@ -6640,13 +9455,13 @@ static int stbi__gif_info_raw(stbi__context *s, int *x, int *y, int *comp)
    stbi__gif* g = (stbi__gif*) stbi__malloc(sizeof(stbi__gif));
    if (!g) return stbi__err("outofmem", "Out of memory");
    if (!stbi__gif_header(s, g, comp, 1)) {
-      STBI_FREE(g);
+      stbi__free(g);
       stbi__rewind( s );
       return 0;
    }
    if (x) *x = g->w;
    if (y) *y = g->h;
-   STBI_FREE(g);
+   stbi__free(g);
    return 1;
 }
 
@@ -6950,12 +9765,12 @@ static stbi_uc *stbi__gif_load_next(stbi__context *s, stbi__gif *g, int *comp, i
 
 static void *stbi__load_gif_main_outofmem(stbi__gif *g, stbi_uc *out, int **delays)
 {
-   STBI_FREE(g->out);
-   STBI_FREE(g->history);
-   STBI_FREE(g->background);
+   stbi__free(g->out);
+   stbi__free(g->history);
+   stbi__free(g->background);
 
-   if (out) STBI_FREE(out);
-   if (delays && *delays) STBI_FREE(*delays);
+   if (out) stbi__free(out);
+   if (delays && *delays) stbi__free(*delays);
    return stbi__errpuc("outofmem", "Out of memory");
 }
 
@@ -6990,7 +9805,7 @@ static void *stbi__load_gif_main(stbi__context *s, int **delays, int *x, int *y,
             stride = g.w * g.h * 4;
 
             if (out) {
-               void *tmp = (stbi_uc*) STBI_REALLOC_SIZED( out, out_size, layers * stride );
+               void *tmp = (stbi_uc*) stbi__realloc_sized( out, out_size, layers * stride );
                if (!tmp)
                   return stbi__load_gif_main_outofmem(&g, out, delays);
                else {
@@ -6999,7 +9814,7 @@ static void *stbi__load_gif_main(stbi__context *s, int **delays, int *x, int *y,
                }
 
                if (delays) {
-                  int *new_delays = (int*) STBI_REALLOC_SIZED( *delays, delays_size, sizeof(int) * layers );
+                  int *new_delays = (int*) stbi__realloc_sized( *delays, delays_size, sizeof(int) * layers );
                   if (!new_delays)
                      return stbi__load_gif_main_outofmem(&g, out, delays);
                   *delays = new_delays;
@@ -7019,7 +9834,7 @@ static void *stbi__load_gif_main(stbi__context *s, int **delays, int *x, int *y,
             }
             memcpy( out + ((layers - 1) * stride), u, stride );
             if (layers >= 2) {
-               two_back = out - 2 * stride;
+               two_back = out + (layers - 2) * stride;
             }
 
             if (delays) {
@@ -7029,9 +9844,9 @@ static void *stbi__load_gif_main(stbi__context *s, int **delays, int *x, int *y,
       } while (u != 0);
 
       // free temp buffer;
-      STBI_FREE(g.out);
-      STBI_FREE(g.history);
-      STBI_FREE(g.background);
+      stbi__free(g.out);
+      stbi__free(g.history);
+      stbi__free(g.background);
 
       // do the final conversion after loading everything;
       if (req_comp && req_comp != 4)
@@ -7044,6 +9859,177 @@ static void *stbi__load_gif_main(stbi__context *s, int **delays, int *x, int *y,
    }
 }
 
+struct stbi__gif_frames
+{
+   stbi__context s;
+   stbi__gif g;
+   stbi_uc const *buffer;     // memory source
+   int len;
+#ifndef STBI_NO_STDIO
+   FILE *f;                   // file source, owned by the iterator
+#endif
+   // the last two frames returned, for "restore to previous" disposal
+   stbi_uc *one_back, *two_back;
+   int frames, flip, done;
+};
+
+static void stbi__gif_frames_reset(stbi_gif_frames *it)
+{
+   stbi__free(it->g.out);
+   stbi__free(it->g.history);
+   stbi__free(it->g.background);
+   memset(&it->g, 0, sizeof(it->g));
+   it->frames = 0;
+   it->done = 0;
+}
+
+static stbi_gif_frames *stbi__gif_frames_start(stbi_gif_frames *it, int *x, int *y)
+{
+   if (!stbi__gif_test(&it->s) || !stbi__gif_info_raw(&it->s, x, y, NULL)) {
+      stbi__err("not GIF", "Image was not as a gif type.");
+      return NULL;
+   }
+   stbi__rewind(&it->s);
+   if (!stbi__mad3sizes_valid(4, *x, *y, 0)) {
+      stbi__err("too large", "GIF image is too large");
+      return NULL;
+   }
+   it->one_back = (stbi_uc *) stbi__malloc_mad3(4, *x, *y, 0);
+   it->two_back = (stbi_uc *) stbi__malloc_mad3(4, *x, *y, 0);
+   if (!it->one_back || !it->two_back) {
+      stbi__free(it->one_back);
+      stbi__free(it->two_back);
+      stbi__err("outofmem", "Out of memory");
+      return NULL;
+   }
+   it->flip = it->s.flip;
+   return it;
+}
+
+// with_params: the flags come from params instead of the stbi_set_* state
+static stbi_gif_frames *stbi__gif_open_mem(stbi_uc const *buffer, int len, int with_params, stbi_load_params const *params, int *x, int *y)
+{
+   stbi_gif_frames *it = (stbi_gif_frames *) STBI_MALLOC(sizeof(*it));
+   if (!it) return (stbi_gif_frames *) stbi__errpuc("outofmem", "Out of memory");
+   memset(it, 0, sizeof(*it));
+   it->buffer = buffer;
+   it->len = len;
+   stbi__start_mem(&it->s, buffer, len);
+   if ((with_params && !stbi__start_flag_params(&it->s, params)) || !stbi__gif_frames_start(it, x, y)) {
+      STBI_FREE(it);
+      return NULL;
+   }
+   return it;
+}
+
+STBIDEF stbi_gif_frames *stbi_gif_open_from_memory(stbi_uc const *buffer, int len, int *x, int *y)
+{
+   return stbi__gif_open_mem(buffer, len, 0, NULL, x, y);
+}
+
+STBIDEF stbi_gif_frames *stbi_gif_open_with_params_from_memory(stbi_uc const *buffer, int len, stbi_load_params const *params, int *x, int *y)
+{
+   return stbi__gif_open_mem(buffer, len, 1, params, x, y);
+}
+
+#ifndef STBI_NO_STDIO
+static stbi_gif_frames *stbi__gif_open_file(char const *filename, int with_params, stbi_load_params const *params, int *x, int *y)
+{
+   stbi_gif_frames *it;
+   FILE *f = stbi__fopen(filename, "rb");
+   if (!f) return (stbi_gif_frames *) stbi__errpuc("can't fopen", "Unable to open file");
+   it = (stbi_gif_frames *) STBI_MALLOC(sizeof(*it));
+   if (!it) {
+      fclose(f);
+      return (stbi_gif_frames *) stbi__errpuc("outofmem", "Out of memory");
+   }
+   memset(it, 0, sizeof(*it));
+   it->f = f;
+   stbi__start_file(&it->s, f);
+   if ((with_params && !stbi__start_flag_params(&it->s, params)) || !stbi__gif_frames_start(it, x, y)) {
+      stbi__stop_file(&it->s, f);
+      fclose(f);
+      STBI_FREE(it);
+      return NULL;
+   }
+   return it;
+}
+
+STBIDEF stbi_gif_frames *stbi_gif_open(char const *filename, int *x, int *y)
+{
+   return stbi__gif_open_file(filename, 0, NULL, x, y);
+}
+
+STBIDEF stbi_gif_frames *stbi_gif_open_with_params(char const *filename, stbi_load_params const *params, int *x, int *y)
+{
+   return stbi__gif_open_file(filename, 1, params, x, y);
+}
+#endif
+
+STBIDEF int stbi_gif_next_frame(stbi_gif_frames *it, stbi_uc *out, int stride_in_bytes, int *delay_ms)
+{
+   stbi_uc *u, *t;
+   int j, row;
+
+   if (it->done) return 0;
+   u = stbi__gif_load_next(&it->s, &it->g, NULL, 4, it->frames >= 2 ? it->two_back : NULL);
+   if (u == (stbi_uc *) &it->s) {
+      it->done = 1;
+      return 0;
+   }
+   if (!u) {
+      it->done = 1;
+      return -1;
+   }
+
+   row = it->g.w * 4;
+   if (stride_in_bytes == 0) stride_in_bytes = row;
+   for (j=0; j < it->g.h; ++j)
+      memcpy(out + (size_t) stride_in_bytes * j, u + (size_t) row * (it->flip ? it->g.h - 1 - j : j), row);
+   if (delay_ms) *delay_ms = it->g.delay;
+
+   t = it->two_back; it->two_back = it->one_back; it->one_back = t;
+   memcpy(it->one_back, u, (size_t) row * it->g.h);
+   ++it->frames;
+   return 1;
+}
+
+STBIDEF int stbi_gif_rewind(stbi_gif_frames *it)
+{
+   stbi__gif_frames_reset(it);
+#ifndef STBI_NO_STDIO
+   if (it->f) {
+      long start = it->s.file_start;
+      stbi__stop_file(&it->s, it->f);
+      if (fseek(it->f, start, SEEK_SET) != 0) {
+         // leave the iterator at its end rather than decoding from the wrong place
+         it->done = 1;
+         stbi__start_file(&it->s, it->f);
+         return stbi__err("can't seek", "GIF file is not seekable");
+      }
+      stbi__start_file(&it->s, it->f);
+      return 1;
+   }
+#endif
+   stbi__start_mem(&it->s, it->buffer, it->len);
+   return 1;
+}
+
+STBIDEF void stbi_gif_close(stbi_gif_frames *it)
+{
+   if (!it) return;
+   stbi__gif_frames_reset(it);
+   stbi__free(it->one_back);
+   stbi__free(it->two_back);
+#ifndef STBI_NO_STDIO
+   if (it->f) {
+      stbi__stop_file(&it->s, it->f);
+      fclose(it->f);
+   }
+#endif
+   STBI_FREE(it);
+}
+
 static void *stbi__gif_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri)
 {
    stbi_uc *u = 0;
@@ -7063,12 +10049,12 @@ static void *stbi__gif_load(stbi__context *s, int *x, int *y, int *comp, int req
          u = stbi__convert_format(u, 4, req_comp, g.w, g.h);
    } else if (g.out) {
       // if there was an error and we allocated an image buffer, free it!
-      STBI_FREE(g.out);
+      stbi__free(g.out);
    }
 
    // free buffers needed for multiple frame loading;
-   STBI_FREE(g.history);
-   STBI_FREE(g.background);
+   stbi__free(g.history);
+   stbi__free(g.background);
 
    return u;
 }
@@ -7131,8 +10117,13 @@ static void stbi__hdr_convert(float *output, stbi_uc *input, int req_comp)
 {
    if ( input[3] != 0 ) {
       float f1;
-      // Exponent
-      f1 = (float) ldexp(1.0f, input[3] - (int)(128 + 8));
+      // Exponent: 2^(e-136), built directly unless it would be a denormal float
+      if (input[3] >= 10) {
+         stbi__uint32 bits = (stbi__uint32) (input[3] - 9) << 23;
+         memcpy(&f1, &bits, sizeof(f1));
+      } else {
+         f1 = (float) ldexp(1.0f, input[3] - (int)(128 + 8));
+      }
       if (req_comp <= 2)
          output[0] = (input[0] + input[1] + input[2]) * f1 / 3;
       else {
@@ -7154,17 +10145,90 @@ static void stbi__hdr_convert(float *output, stbi_uc *input, int req_comp)
    }
 }
 
-static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri)
+static void stbi__hdr_convert_row(float *output, stbi_uc *input, int width, int req_comp, int simd)
+{
+   int i = 0;
+   #ifdef STBI_SSE2
+   if (simd && req_comp >= 3) {
+      // one pixel per vector: r,g,b,e widened to ints, times 2^(e-136). the
+      // fourth lane becomes 1.0 for RGBA; for RGB the next pixel overwrites
+      // it, so the last pixel is left to the scalar loop
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i rgb = _mm_setr_epi32(-1, -1, -1, 0);
+      const __m128i alpha = _mm_setr_epi32(0, 0, 0, 0x3f800000);
+      int n = req_comp == 4 ? width : width - 1;
+      for (; i < n; ++i) {
+         stbi_uc *p = input + i*4;
+         stbi__uint32 scale = p[3] >= 10 ? (stbi__uint32) (p[3] - 9) << 23 : 0;
+         int packed;
+         __m128i v;
+         __m128 f;
+         if (p[3] != 0 && p[3] < 10) { // denormal scale, leave it to ldexp
+            stbi__hdr_convert(output + i*req_comp, p, req_comp);
+            continue;
+         }
+         memcpy(&packed, p, 4);
+         v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+         f = _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_castsi128_ps(_mm_set1_epi32((int) scale)));
+         if (req_comp == 4)
+            f = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(_mm_castps_si128(f), rgb), alpha));
+         _mm_storeu_ps(output + i*req_comp, f);
+      }
+   }
+   #else
+   STBI_NOTUSED(simd);
+   #endif
+   for (; i < width; ++i)
+      stbi__hdr_convert(output + i*req_comp, input + i*4, req_comp);
+}
+
+// m * 2^s rounded to nearest (halves up), for the RGB9E5 mantissas
+static int stbi__rgb9e5_mantissa(int m, int s)
+{
+   if (s >= 0) return m << s;
+   if (s < -9) return 0; // m < 256, so this always rounds to 0
+   return (m + (1 << (-s-1))) >> -s;
+}
+
+// RGBE to GL_RGB9_E5. both are shared-exponent formats, so this is the
+// stbi__float_to_rgb9e5 computation done exactly on the integer mantissas
+static stbi__uint32 stbi__rgbe_to_rgb9e5(stbi_uc *p)
+{
+   int m = p[0] > p[1] ? (p[0] > p[2] ? p[0] : p[2]) : (p[1] > p[2] ? p[1] : p[2]);
+   int l = 7, e, s;
+   if (p[3] == 0 || m == 0) return 0;
+   while (!(m >> l)) --l;              // floor(log2(max mantissa)), 7 unless denormalized
+   e = l + p[3] - 136;                 // floor(log2(max channel))
+   e = (e < -16 ? -16 : e) + 16;
+   s = p[3] - 112 - e;                 // channel / 2^(e-24) = mantissa * 2^s
+   if (s >= 0 && e <= 31) {
+      // exact: the largest mantissa ends up with at most 9 bits, so no rounding
+      return (stbi__uint32) (p[0] << s) | (stbi__uint32) (p[1] << s) << 9 | (stbi__uint32) (p[2] << s) << 18 | (stbi__uint32) e << 27;
+   }
+   if (stbi__rgb9e5_mantissa(m, s) == 512) { ++e; --s; }
+   if (e > 31) { // too bright: clamp through the float path
+      float f = (float) ldexp(1.0f, p[3] - (int)(128 + 8));
+      return stbi__float_to_rgb9e5(p[0] * f, p[1] * f, p[2] * f);
+   }
+   return (stbi__uint32) stbi__rgb9e5_mantissa(p[0], s)
+        | (stbi__uint32) stbi__rgb9e5_mantissa(p[1], s) << 9
+        | (stbi__uint32) stbi__rgb9e5_mantissa(p[2], s) << 18
+        | (stbi__uint32) e << 27;
+}
+
+static void *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri)
 {
    char buffer[STBI__HDR_BUFLEN];
    char *token;
    int valid = 0;
    int width, height;
    stbi_uc *scanline;
-   float *hdr_data;
+   stbi_uc *hdr_data;
+   float *row = NULL;
    int len;
    unsigned char count, value;
    int i, j, k, c1,c2, z;
+   int format = s->hdr_format, pixel_bytes, flat, simd;
    const char *headerToken;
    STBI_NOTUSED(ri);
 
@@ -7200,87 +10264,99 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
    *y = height;
 
    if (comp) *comp = 3;
-   if (req_comp == 0) req_comp = 3;
+   if (req_comp == 0 || format == STBI__HDR_rgb9e5) req_comp = 3;
+   pixel_bytes = stbi__hdr_pixel_bytes(format, req_comp);
 
-   if (!stbi__mad4sizes_valid(width, height, req_comp, sizeof(float), 0))
+   if (!stbi__mad3sizes_valid(width, height, pixel_bytes, 0) || !stbi__mad3sizes_valid(width, req_comp, sizeof(float), 0))
       return stbi__errpf("too large", "HDR image is too large");
 
    // Read data
-   hdr_data = (float *) stbi__malloc_mad4(width, height, req_comp, sizeof(float), 0);
-   if (!hdr_data)
+   hdr_data = (stbi_uc *) stbi__malloc_mad3(width, height, pixel_bytes, 0);
+   scanline = (stbi_uc *) stbi__malloc_mad2(width, 4, 0);
+   if (format == STBI__HDR_half)
+      row = (float *) stbi__malloc_mad3(width, req_comp, sizeof(float), 0);
+   if (!hdr_data || !scanline || (format == STBI__HDR_half && !row)) {
+      stbi__free(hdr_data); stbi__free(scanline); stbi__free(row);
       return stbi__errpf("outofmem", "Out of memory");
+   }
+   simd = stbi__hdr_simd();
 
    // Load image data
-   // image data is stored as some number of sca
-   if ( width < 8 || width >= 32768) {
-      // Read flat data
-      for (j=0; j < height; ++j) {
-         for (i=0; i < width; ++i) {
-            stbi_uc rgbe[4];
-           main_decode_loop:
-            stbi__getn(s, rgbe, 4);
-            stbi__hdr_convert(hdr_data + j * width * req_comp + i * req_comp, rgbe, req_comp);
-         }
-      }
-   } else {
-      // Read RLE-encoded data
-      scanline = NULL;
-
-      for (j = 0; j < height; ++j) {
+   // image data is stored as some number of scanlines, each either flat RGBE
+   // or run-length encoded per channel; every scanline is gathered as RGBE
+   // and then converted to the output format in one go
+   flat = width < 8 || width >= 32768;
+   for (j = 0; j < height; ++j) {
+      i = 0;
+      if (!flat) {
          c1 = stbi__get8(s);
          c2 = stbi__get8(s);
          len = stbi__get8(s);
          if (c1 != 2 || c2 != 2 || (len & 0x80)) {
             // not run-length encoded, so we have to actually use THIS data as a decoded
-            // pixel (note this can't be a valid pixel--one of RGB must be >= 128)
-            stbi_uc rgbe[4];
-            rgbe[0] = (stbi_uc) c1;
-            rgbe[1] = (stbi_uc) c2;
-            rgbe[2] = (stbi_uc) len;
-            rgbe[3] = (stbi_uc) stbi__get8(s);
-            stbi__hdr_convert(hdr_data, rgbe, req_comp);
+            // pixel (note this can't be a valid pixel--one of RGB must be >= 128); the
+            // rest of the file is read as flat data
+            scanline[0] = (stbi_uc) c1;
+            scanline[1] = (stbi_uc) c2;
+            scanline[2] = (stbi_uc) len;
+            scanline[3] = (stbi_uc) stbi__get8(s);
             i = 1;
-            j = 0;
-            STBI_FREE(scanline);
-            goto main_decode_loop; // yes, this makes no sense
-         }
-         len <<= 8;
-         len |= stbi__get8(s);
-         if (len != width) { STBI_FREE(hdr_data); STBI_FREE(scanline); return stbi__errpf("invalid decoded scanline length", "corrupt HDR"); }
-         if (scanline == NULL) {
-            scanline = (stbi_uc *) stbi__malloc_mad2(width, 4, 0);
-            if (!scanline) {
-               STBI_FREE(hdr_data);
-               return stbi__errpf("outofmem", "Out of memory");
-            }
-         }
-
-         for (k = 0; k < 4; ++k) {
-            int nleft;
-            i = 0;
-            while ((nleft = width - i) > 0) {
-               count = stbi__get8(s);
-               if (count > 128) {
-                  // Run
-                  value = stbi__get8(s);
-                  count -= 128;
-                  if ((count == 0) || (count > nleft)) { STBI_FREE(hdr_data); STBI_FREE(scanline); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
-                  for (z = 0; z < count; ++z)
-                     scanline[i++ * 4 + k] = value;
-               } else {
-                  // Dump
-                  if ((count == 0) || (count > nleft)) { STBI_FREE(hdr_data); STBI_FREE(scanline); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
-                  for (z = 0; z < count; ++z)
-                     scanline[i++ * 4 + k] = stbi__get8(s);
+            flat = 1;
+         } else {
+            len <<= 8;
+            len |= stbi__get8(s);
+            if (len != width) { stbi__free(hdr_data); stbi__free(scanline); stbi__free(row); return stbi__errpf("invalid decoded scanline length", "corrupt HDR"); }
+
+            for (k = 0; k < 4; ++k) {
+               int nleft;
+               i = 0;
+               while ((nleft = width - i) > 0) {
+                  count = stbi__get8(s);
+                  if (count > 128) {
+                     // Run
+                     value = stbi__get8(s);
+                     count -= 128;
+                     if ((count == 0) || (count > nleft)) { stbi__free(hdr_data); stbi__free(scanline); stbi__free(row); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
+                     for (z = 0; z < count; ++z)
+                        scanline[i++ * 4 + k] = value;
+                  } else {
+                     // Dump
+                     if ((count == 0) || (count > nleft)) { stbi__free(hdr_data); stbi__free(scanline); stbi__free(row); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
+                     if (s->img_buffer_end - s->img_buffer >= count) {
+                        // copy straight out of the read buffer when the whole dump is there
+                        stbi_uc *src = s->img_buffer;
+                        for (z = 0; z < count; ++z)
+                           scanline[i++ * 4 + k] = src[z];
+                        s->img_buffer += count;
+                     } else {
+                        for (z = 0; z < count; ++z)
+                           scanline[i++ * 4 + k] = stbi__get8(s);
+                     }
+                  }
                }
             }
          }
-         for (i=0; i < width; ++i)
-            stbi__hdr_convert(hdr_data+(j*width + i)*req_comp, scanline + i*4, req_comp);
       }
-      if (scanline)
-         STBI_FREE(scanline);
+      // Read flat data
+      if (i < width)
+         stbi__getn(s, scanline + i*4, (width - i) * 4);
+
+      switch (format) {
+         case STBI__HDR_half:
+            stbi__hdr_convert_row(row, scanline, width, req_comp, simd);
+            stbi__float_to_half_row((stbi__uint16 *) (hdr_data + (size_t) j * width * pixel_bytes), row, width * req_comp, simd);
+            break;
+         case STBI__HDR_rgb9e5:
+            for (i=0; i < width; ++i)
+               ((stbi__uint32 *) hdr_data)[(size_t) j * width + i] = stbi__rgbe_to_rgb9e5(scanline + i*4);
+            break;
+         default:
+            stbi__hdr_convert_row((float *) hdr_data + (size_t) j * width * req_comp, scanline, width, req_comp, simd);
+            break;
+      }
    }
+   stbi__free(scanline);
+   stbi__free(row);
 
    return hdr_data;
 }
@@ -7504,7 +10580,9 @@ static int      stbi__pnm_test(stbi__context *s)
 
 static void *stbi__pnm_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri)
 {
-   stbi_uc *out;
+   stbi_uc *out, *row;
+   stbi__uint32 j;
+   int simd = 0;
    STBI_NOTUSED(ri);
 
    ri->bits_per_channel = stbi__pnm_info(s, (int *)&s->img_x, (int *)&s->img_y, (int *)&s->img_n);
@@ -7521,10 +10599,36 @@ static void *stbi__pnm_load(stbi__context *s, int *x, int *y, int *comp, int req
    if (!stbi__mad4sizes_valid(s->img_n, s->img_x, s->img_y, ri->bits_per_channel / 8, 0))
       return stbi__errpuc("too large", "PNM too large");
 
+   if (ri->bits_per_channel == 8 && req_comp && req_comp != s->img_n) {
+      // convert each row as it is read, into an image that is already req_comp wide
+      if (!stbi__mad3sizes_valid(req_comp, s->img_x, s->img_y, 0))
+         return stbi__errpuc("too large", "PNM too large");
+      out = (stbi_uc *) stbi__malloc_mad3(req_comp, s->img_x, s->img_y, 0);
+      row = (stbi_uc *) stbi__malloc_mad2(s->img_n, s->img_x, 0);
+      if (!out || !row) {
+         stbi__free(out);
+         stbi__free(row);
+         return stbi__errpuc("outofmem", "Out of memory");
+      }
+      #ifdef STBI__SSSE3
+      simd = stbi__ssse3_available();
+      #endif
+      for (j=0; j < s->img_y; ++j) {
+         if (!stbi__getn(s, row, s->img_n * s->img_x)) {
+            stbi__free(out);
+            stbi__free(row);
+            return stbi__errpuc("bad PNM", "PNM file truncated");
+         }
+         stbi__convert_format_row(row, out + (size_t) j * s->img_x * req_comp, s->img_n, req_comp, s->img_x, simd);
+      }
+      stbi__free(row);
+      return out;
+   }
+
    out = (stbi_uc *) stbi__malloc_mad4(s->img_n, s->img_x, s->img_y, ri->bits_per_channel / 8, 0);
    if (!out) return stbi__errpuc("outofmem", "Out of memory");
    if (!stbi__getn(s, out, s->img_n * s->img_x * s->img_y * (ri->bits_per_channel / 8))) {
-      STBI_FREE(out);
+      stbi__free(out);
       return stbi__errpuc("bad PNM", "PNM file truncated");
    }
 
@@ -7704,6 +10808,7 @@ STBIDEF int stbi_info_from_file(FILE *f, int *x, int *y, int *comp)
    long pos = ftell(f);
    stbi__start_file(&s, f);
    r = stbi__info_main(&s,x,y,comp);
+   stbi__stop_file(&s, f);
    fseek(f,pos,SEEK_SET);
    return r;
 }
@@ -7725,11 +10830,66 @@ STBIDEF int stbi_is_16_bit_from_file(FILE *f)
    long pos = ftell(f);
    stbi__start_file(&s, f);
    r = stbi__is_16_main(&s);
+   stbi__stop_file(&s, f);
    fseek(f,pos,SEEK_SET);
    return r;
 }
 #endif // !STBI_NO_STDIO
 
+static int stbi__layout_main(stbi__context *s, int req_comp, int bytes_per_channel, stbi_layout *layout)
+{
+   int x, y, comp;
+   if (req_comp < 0 || req_comp > 4) return stbi__err("bad req_comp", "Internal error");
+   if (bytes_per_channel != 1 && bytes_per_channel != 2) return stbi__err("bad bytes_per_channel", "bytes_per_channel must be 1 or 2");
+   if (!stbi__info_main(s, &x, &y, &comp)) return 0;
+   layout->w = x;
+   layout->h = y;
+   layout->channels_in_file = comp;
+   layout->channels = req_comp ? req_comp : comp;
+   layout->bytes_per_channel = bytes_per_channel;
+   layout->row_bytes = (size_t) x * layout->channels * bytes_per_channel;
+   layout->size = layout->row_bytes * y;
+   return 1;
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_info_layout(char const *filename, int req_comp, int bytes_per_channel, stbi_layout *layout)
+{
+    FILE *f = stbi__fopen(filename, "rb");
+    int result;
+    if (!f) return stbi__err("can't fopen", "Unable to open file");
+    result = stbi_info_layout_from_file(f, req_comp, bytes_per_channel, layout);
+    fclose(f);
+    return result;
+}
+
+STBIDEF int stbi_info_layout_from_file(FILE *f, int req_comp, int bytes_per_channel, stbi_layout *layout)
+{
+   int r;
+   stbi__context s;
+   long pos = ftell(f);
+   stbi__start_file(&s, f);
+   r = stbi__layout_main(&s, req_comp, bytes_per_channel, layout);
+   stbi__stop_file(&s, f);
+   fseek(f,pos,SEEK_SET);
+   return r;
+}
+#endif // !STBI_NO_STDIO
+
+STBIDEF int stbi_info_layout_from_memory(stbi_uc const *buffer, int len, int req_comp, int bytes_per_channel, stbi_layout *layout)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__layout_main(&s, req_comp, bytes_per_channel, layout);
+}
+
+STBIDEF int stbi_info_layout_from_callbacks(stbi_io_callbacks const *c, void *user, int req_comp, int bytes_per_channel, stbi_layout *layout)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) c, user);
+   return stbi__layout_main(&s, req_comp, bytes_per_channel, layout);
+}
+
 STBIDEF int stbi_info_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp)
 {
    stbi__context s;